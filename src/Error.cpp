@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "Error.h"
+
+#include <cstring>
+#include <sharemind/Concat.h>
+#include "assemble.h"
+#include "SourceFile.h"
+#include "tokenizer.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+char const * errorCodeToString(ErrorCode const code) noexcept {
+    #define SHAREMIND_LIBAS_ERROR_T(v,msg) case ErrorCode::v: return msg
+    switch (code) {
+        SHAREMIND_LIBAS_ERROR_T(InvalidByteOrderMark,
+                                "Invalid UTF-8 byte-order-mark");
+        SHAREMIND_LIBAS_ERROR_T(UnexpectedCharacter, "Unexpected character");
+        SHAREMIND_LIBAS_ERROR_T(HexadecimalTooBig,
+                                "64-bit signed hexadecimal too big");
+        SHAREMIND_LIBAS_ERROR_T(HexadecimalTooSmall,
+                                "64-bit signed hexadecimal too small");
+        SHAREMIND_LIBAS_ERROR_T(HexadecimalTooManyDigits,
+                                "64-bit hexadecimal has too many digits");
+        SHAREMIND_LIBAS_ERROR_T(UnexpectedEndOfFile, "Unexpected end-of-file");
+        SHAREMIND_LIBAS_ERROR_T(EmptyProgram, "Empty program");
+        SHAREMIND_LIBAS_ERROR_T(UnexpectedToken, "Unexpected token");
+        SHAREMIND_LIBAS_ERROR_T(InvalidParameter, "Invalid parameter");
+        SHAREMIND_LIBAS_ERROR_T(UnknownDirective, "Unknown directive");
+        SHAREMIND_LIBAS_ERROR_T(UnknownInstruction, "Unknown instruction");
+        SHAREMIND_LIBAS_ERROR_T(InvalidNumberOfArguments,
+                                "Invalid number of instruction arguments");
+        SHAREMIND_LIBAS_ERROR_T(DuplicateLabel, "Duplicate label");
+        SHAREMIND_LIBAS_ERROR_T(InvalidLabel, "Invalid label");
+        SHAREMIND_LIBAS_ERROR_T(InvalidLabelOffset, "Invalid label offset");
+        SHAREMIND_LIBAS_ERROR_T(InvalidJumpTarget, "Invalid jump target");
+        SHAREMIND_LIBAS_ERROR_T(UndefinedLabel, "Undefined label");
+        SHAREMIND_LIBAS_ERROR_T(SectionTooLarge, "Section grew too large");
+        SHAREMIND_LIBAS_ERROR_T(InvalidExpression, "Invalid expression");
+        SHAREMIND_LIBAS_ERROR_T(FileAccessDisabled,
+                                "Access to files is disabled");
+        SHAREMIND_LIBAS_ERROR_T(FileReadError, "Failed to read file");
+        SHAREMIND_LIBAS_ERROR_T(IncludeCycle, "Recursive file inclusion");
+        SHAREMIND_LIBAS_ERROR_T(DuplicateMacro, "Duplicate macro");
+        SHAREMIND_LIBAS_ERROR_T(RecursiveMacro, "Recursive macro expansion");
+        SHAREMIND_LIBAS_ERROR_T(TooManyTokens, "Too many tokens");
+        SHAREMIND_LIBAS_ERROR_T(SectionSizeLimitExceeded,
+                                "Section size limit exceeded");
+        SHAREMIND_LIBAS_ERROR_T(TooManyPendingRelocations,
+                                "Too many pending label references");
+        SHAREMIND_LIBAS_ERROR_T(DeadlineExceeded, "Deadline exceeded");
+        SHAREMIND_LIBAS_ERROR_T(Cancelled, "Cancelled");
+        SHAREMIND_LIBAS_ERROR_T(InvalidBinaryIr, "Invalid binary IR");
+        SHAREMIND_LIBAS_ERROR_T(OutputError, "Failed to write output");
+        SHAREMIND_LIBAS_ERROR_T(OutOfMemory, "Out of memory");
+    }
+    #undef SHAREMIND_LIBAS_ERROR_T
+    return "Unknown error";
+}
+
+bool isTokenizerError(ErrorCode const code) noexcept {
+    switch (code) {
+        case ErrorCode::InvalidByteOrderMark:
+        case ErrorCode::UnexpectedCharacter:
+        case ErrorCode::HexadecimalTooBig:
+        case ErrorCode::HexadecimalTooSmall:
+        case ErrorCode::HexadecimalTooManyDigits:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::string Error::message(char const * program, std::size_t length) const {
+    if (m_sourceFile) {
+        auto const & file = *m_sourceFile;
+        std::string r(file.path());
+        r.append(": ");
+        /* Files which failed to tokenize are not tokenized at all, otherwise
+           the tokens are kept, hence the error token can be found without
+           tokenizing the file again: */
+        auto const & ts = file.tokens();
+        if (isTokenizerError(m_code) || ts.empty())
+            return r.append(tokenizerErrorMessage(*this,
+                                                  file.text(),
+                                                  file.size()));
+        auto it(ts.end());
+        if (m_code != ErrorCode::UnexpectedEndOfFile)
+            for (it = ts.begin(); it != ts.end(); ++it)
+                if (static_cast<std::size_t>(it->text() - file.text())
+                    >= m_offset)
+                    break;
+        return r.append(assembleErrorMessage(m_code, it, ts.end()));
+    }
+    if ((m_code == ErrorCode::OutOfMemory)
+        || (m_code == ErrorCode::OutputError))
+        return errorCodeToString(m_code);
+    if (m_objectIndex != noObject) {
+        std::string r(errorCodeToString(m_code));
+        if (m_label)
+            r.append(" \"").append(*m_label).append("\"");
+        if (m_offsetType == OffsetType::TokenIndex)
+            r.append(concat(" at token ", m_offset));
+        return r.append(concat(" in object ", m_objectIndex, '!'));
+    }
+    switch (m_offsetType) {
+        case OffsetType::Text:
+            break;
+        case OffsetType::TokenIndex:
+            return concat(errorCodeToString(m_code), " at token ", m_offset,
+                          '!');
+        case OffsetType::None:
+            return concat(errorCodeToString(m_code), '!');
+        case OffsetType::BinaryIr:
+            return concat(errorCodeToString(m_code), " at byte ", m_offset,
+                          " of the binary IR!");
+        case OffsetType::Statement:
+            return concat(errorCodeToString(m_code), " in statement ",
+                          m_offset, '!');
+    }
+    if (m_code == ErrorCode::InvalidBinaryIr)
+        return errorCodeToString(m_code);
+    if (isTokenizerError(m_code))
+        return tokenizerErrorMessage(*this, program, length);
+
+    /* Errors reported by the assembler were found in a program which
+       tokenized successfully, hence we can tokenize it again to find the
+       token the error refers to. As tokens do not span lines, only the text
+       up to the end of the line of the error is needed, which keeps this
+       within the work done before the error, e.g. for TooManyTokens: */
+    assert(m_offset <= length);
+    auto prefixLength = length;
+    if (m_code != ErrorCode::UnexpectedEndOfFile) {
+        auto const * const lineEnd =
+                static_cast<char const *>(
+                    std::memchr(program + m_offset, '\n', length - m_offset));
+        if (lineEnd)
+            prefixLength = static_cast<std::size_t>(lineEnd - program);
+    }
+    TokensVector ts;
+    Error tokenizerError;
+    if (!tokenize(program, prefixLength, ts, tokenizerError))
+        return tokenizerErrorMessage(tokenizerError, program, length);
+    if (m_code == ErrorCode::UnexpectedEndOfFile)
+        return assembleErrorMessage(m_code, ts.end(), ts.end());
+    auto it(ts.begin());
+    for (; it != ts.end(); ++it)
+        if (static_cast<std::size_t>(it->text() - program) >= m_offset)
+            break;
+    return assembleErrorMessage(m_code, it, ts.end());
+}
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
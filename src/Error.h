@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_ERROR_H
+#define SHAREMIND_LIBAS_ERROR_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+
+namespace sharemind {
+namespace Assembler {
+
+enum class ErrorCode : std::uint8_t {
+
+    /* Tokenizer errors: */
+    InvalidByteOrderMark = 1u,
+    UnexpectedCharacter,
+    HexadecimalTooBig,
+    HexadecimalTooSmall,
+    HexadecimalTooManyDigits,
+
+    /* Tokenizer and assembler errors: */
+    UnexpectedEndOfFile,
+
+    /* Assembler errors: */
+    EmptyProgram,
+    UnexpectedToken,
+    InvalidParameter,
+    UnknownDirective,
+    UnknownInstruction,
+    InvalidNumberOfArguments,
+    DuplicateLabel,
+    InvalidLabel,
+    InvalidLabelOffset,
+    InvalidJumpTarget,
+    UndefinedLabel,
+    SectionTooLarge,
+    InvalidExpression,
+    FileAccessDisabled,
+    FileReadError,
+    IncludeCycle,
+    DuplicateMacro,
+    RecursiveMacro,
+
+    /* Errors on exceeding the limits given in Options: */
+    TooManyTokens,
+    SectionSizeLimitExceeded,
+    TooManyPendingRelocations,
+    DeadlineExceeded,
+    Cancelled,
+
+    /* Other errors: */
+    InvalidBinaryIr,
+    OutputError,
+    OutOfMemory
+
+};
+
+/** \returns a short static description of the given error code. */
+char const * errorCodeToString(ErrorCode const code) noexcept;
+
+bool isTokenizerError(ErrorCode const code) noexcept;
+
+class SourceFile;
+
+class Error {
+
+public: /* Types: */
+
+    /** What the offset of an error counts. */
+    enum class OffsetType : std::uint8_t {
+
+        /** Bytes from the beginning of the program text, or of the text of
+            sourceFile() if set. */
+        Text,
+
+        /** Tokens from the beginning of the tokens assembled. */
+        TokenIndex,
+
+        /** Bytes from the beginning of a program in the binary IR. */
+        BinaryIr,
+
+        /** Statements added to an ExecutableBuilder. */
+        Statement,
+
+        /** The error has no position, the offset is zero. */
+        None
+
+    };
+
+/* Constants: */
+
+    static constexpr std::size_t const noObject =
+            std::numeric_limits<std::size_t>::max();
+
+public: /* Methods: */
+
+    Error() noexcept
+        : m_offset(0u)
+        , m_code(ErrorCode::OutOfMemory)
+        , m_offsetType(OffsetType::Text)
+    {}
+
+    Error(ErrorCode const code,
+          std::size_t const offset,
+          std::shared_ptr<SourceFile const> sourceFile = nullptr) noexcept
+        : m_offset(offset)
+        , m_code(code)
+        , m_offsetType(OffsetType::Text)
+        , m_sourceFile(std::move(sourceFile))
+    {}
+
+    Error(ErrorCode const code,
+          std::size_t const offset,
+          OffsetType const offsetType) noexcept
+        : m_offset(offset)
+        , m_code(code)
+        , m_offsetType(offsetType)
+    {}
+
+    /**
+      \brief Constructs an error of link().
+      \param[in] tokenIndex The index of the token of the error in the tokens
+                            assembled into the object, or
+                            Object::noToken if not known.
+      \param[in] label The name of the label of the error, if any.
+    */
+    static Error linkError(ErrorCode const code,
+                           std::size_t const objectIndex,
+                           std::size_t const tokenIndex,
+                           std::shared_ptr<std::string const> label) noexcept
+    {
+        bool const hasToken =
+                tokenIndex != std::numeric_limits<std::size_t>::max();
+        Error error(code,
+                    hasToken ? tokenIndex : 0u,
+                    hasToken ? OffsetType::TokenIndex : OffsetType::None);
+        error.m_objectIndex = objectIndex;
+        error.m_label = std::move(label);
+        return error;
+    }
+
+    ErrorCode code() const noexcept { return m_code; }
+
+    /** \returns the offset of the error, counted as given by offsetType(). */
+    std::size_t offset() const noexcept { return m_offset; }
+
+    OffsetType offsetType() const noexcept { return m_offsetType; }
+
+    /** \returns the index of the object given to link() which the error
+                 occurred in, or noObject. The offsets of such errors are in
+                 the tokens assembled into that object. */
+    std::size_t objectIndex() const noexcept { return m_objectIndex; }
+
+    /** \returns the name of the label the error refers to, or null. Local
+                 labels are suffixed with '@' and the index of their scope. */
+    std::shared_ptr<std::string const> const & label() const noexcept
+    { return m_label; }
+
+    /** \returns the included file the error occurred in, or null if the error
+                 occurred in the program text itself. */
+    std::shared_ptr<SourceFile const> const & sourceFile() const noexcept
+    { return m_sourceFile; }
+
+    char const * description() const noexcept
+    { return errorCodeToString(m_code); }
+
+    /**
+      \brief Formats a human-readable error message, including the line and
+             column of the error.
+      \param[in] program The program text which produced this error.
+      \param[in] length The length of the program text in bytes.
+      \note Errors in included files are formatted using the text of the file
+            instead, prefixed by the path of the file.
+      \note Only the program text up to the end of the line of the error is
+            tokenized again.
+      \note Errors whose offsets are not in the program text are formatted
+            with the offset instead, and the program text is not used.
+    */
+    std::string message(char const * program, std::size_t length) const;
+
+private: /* Fields: */
+
+    std::size_t m_offset;
+    ErrorCode m_code;
+    OffsetType m_offsetType;
+    std::size_t m_objectIndex = noObject;
+    std::shared_ptr<SourceFile const> m_sourceFile;
+    std::shared_ptr<std::string const> m_label;
+
+};
+
+template <typename T>
+class Result {
+
+    static_assert(std::is_nothrow_move_constructible<T>::value, "");
+
+public: /* Methods: */
+
+    Result(T && value) noexcept
+        : m_value(std::move(value))
+        , m_hasValue(true)
+    {}
+
+    Result(Error const error) noexcept
+        : m_error(error)
+        , m_hasValue(false)
+    {}
+
+    Result(Result &&) noexcept = default;
+    Result & operator=(Result &&) noexcept = default;
+
+    bool hasValue() const noexcept { return m_hasValue; }
+    explicit operator bool() const noexcept { return m_hasValue; }
+
+    T & value() & noexcept { assert(m_hasValue); return m_value; }
+    T const & value() const & noexcept { assert(m_hasValue); return m_value; }
+    T && value() && noexcept { assert(m_hasValue); return std::move(m_value); }
+
+    T & operator*() & noexcept { return value(); }
+    T const & operator*() const & noexcept { return value(); }
+    T && operator*() && noexcept { return std::move(*this).value(); }
+
+    T * operator->() noexcept { return &value(); }
+    T const * operator->() const noexcept { return &value(); }
+
+    Error const & error() const noexcept { assert(!m_hasValue); return m_error; }
+
+private: /* Fields: */
+
+    T m_value;
+    Error m_error;
+    bool m_hasValue;
+
+};
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_ERROR_H */
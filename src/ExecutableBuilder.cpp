@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "ExecutableBuilder.h"
+
+#include <sharemind/AssertReturn.h>
+#include <sharemind/Concat.h>
+#include "assemble.h"
+#include "TokenWriter.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+SHAREMIND_DEFINE_EXCEPTION_CONST_STDSTRING_NOINLINE(Exception,,
+                                                    ExecutableBuilderException);
+
+namespace {
+
+constexpr char const * const sectionNames[] = {
+    "TEXT", "RODATA", "DATA", "BSS", "BIND", "PDBIND", "DEBUG"
+};
+
+constexpr char const * const dataTypeNames[] = {
+    "uint8", "uint16", "uint32", "uint64", "int8", "int16", "int32", "int64"
+};
+
+} // anonymous namespace
+
+struct ExecutableBuilder::Inner {
+
+/* Methods: */
+
+    Inner(std::pmr::memory_resource * memoryResource)
+        : m_tokens(memoryResource)
+        , m_writer(m_tokens)
+        , m_assembler(memoryResource)
+    {}
+
+    /** \brief Starts a new statement. */
+    void newStatement() {
+        if (m_numStatements)
+            m_writer.newline();
+        ++m_numStatements;
+    }
+
+    /**
+      \brief Checks an argument before anything of its statement is written,
+             so that no partial statements are left behind.
+    */
+    static void checkArgument(Argument const & argument) {
+        using Kind = Argument::Kind;
+        if ((argument.m_kind == Kind::Label)
+            && !TokenWriter::isValidLabelName(argument.m_text))
+            throw ExecutableBuilderException(
+                    concat("Invalid label name: ", argument.m_text));
+        if ((argument.m_kind == Kind::Expression)
+            && !TokenWriter::isValidExpression(argument.m_text))
+            throw ExecutableBuilderException(
+                    concat("Invalid expression: ", argument.m_text));
+    }
+
+    void addArgument(Argument const & argument) {
+        using Kind = Argument::Kind;
+        switch (argument.m_kind) {
+        case Kind::Unsigned:
+            return m_writer.uhex(argument.m_value);
+        case Kind::Signed:
+            if (!(argument.m_value >> 63u))
+                return m_writer.uhex(argument.m_value);
+            return m_writer.hex(static_cast<std::int64_t>(argument.m_value));
+        case Kind::Label:
+            return m_writer.label(argument.m_text,
+                                  static_cast<std::int64_t>(argument.m_value));
+        case Kind::Expression:
+            return m_writer.expression(argument.m_text);
+        }
+    }
+
+/* Fields: */
+
+    TokensVector m_tokens;
+    TokenWriter m_writer;
+    std::size_t m_numStatements = 0u;
+    Assembler m_assembler;
+
+};
+
+ExecutableBuilder::ExecutableBuilder(
+        std::pmr::memory_resource * memoryResource)
+    : m_inner(std::make_unique<Inner>(assertReturn(memoryResource)))
+{}
+
+ExecutableBuilder::ExecutableBuilder(ExecutableBuilder &&) noexcept = default;
+ExecutableBuilder::~ExecutableBuilder() noexcept = default;
+
+ExecutableBuilder & ExecutableBuilder::operator=(ExecutableBuilder &&) noexcept
+        = default;
+
+ExecutableBuilder & ExecutableBuilder::instruction(
+        std::string_view name,
+        std::initializer_list<Argument> arguments)
+{
+    if (!TokenWriter::isValidKeyword(name))
+        throw ExecutableBuilderException(
+                concat("Invalid instruction name: ", name));
+    for (auto const & argument : arguments)
+        Inner::checkArgument(argument);
+    auto & inner = *assertReturn(m_inner);
+    inner.newStatement();
+    inner.m_writer.keyword(name);
+    for (auto const & argument : arguments)
+        inner.addArgument(argument);
+    return *this;
+}
+
+ExecutableBuilder & ExecutableBuilder::label(std::string_view name) {
+    if (!TokenWriter::isValidLabelName(name))
+        throw ExecutableBuilderException(concat("Invalid label name: ", name));
+    auto & inner = *assertReturn(m_inner);
+    inner.newStatement();
+    inner.m_writer.label(name);
+    return *this;
+}
+
+ExecutableBuilder & ExecutableBuilder::section(Section section) {
+    auto & inner = *assertReturn(m_inner);
+    inner.newStatement();
+    inner.m_writer.directive("section");
+    inner.m_writer.keyword(sectionNames[static_cast<unsigned>(section)]);
+    return *this;
+}
+
+ExecutableBuilder & ExecutableBuilder::linkingUnit(std::uint8_t index) {
+    auto & inner = *assertReturn(m_inner);
+    inner.newStatement();
+    inner.m_writer.directive("linking_unit");
+    inner.m_writer.uhex(index);
+    return *this;
+}
+
+ExecutableBuilder & ExecutableBuilder::data(DataType type,
+                                            Argument const & value)
+{
+    Inner::checkArgument(value);
+    auto & inner = *assertReturn(m_inner);
+    inner.newStatement();
+    inner.m_writer.directive("data");
+    inner.m_writer.keyword(dataTypeNames[static_cast<unsigned>(type)]);
+    inner.addArgument(value);
+    return *this;
+}
+
+ExecutableBuilder & ExecutableBuilder::data(std::string_view string) {
+    auto & inner = *assertReturn(m_inner);
+    inner.newStatement();
+    inner.m_writer.directive("data");
+    inner.m_writer.keyword("string");
+    inner.m_writer.string(string);
+    return *this;
+}
+
+ExecutableBuilder & ExecutableBuilder::fill(std::uint16_t count,
+                                            DataType type,
+                                            Argument const & value)
+{
+    Inner::checkArgument(value);
+    auto & inner = *assertReturn(m_inner);
+    inner.newStatement();
+    inner.m_writer.directive("fill");
+    inner.m_writer.uhex(count);
+    inner.m_writer.keyword(dataTypeNames[static_cast<unsigned>(type)]);
+    inner.addArgument(value);
+    return *this;
+}
+
+ExecutableBuilder & ExecutableBuilder::align(std::uint64_t alignment,
+                                             std::uint8_t fill)
+{
+    auto & inner = *assertReturn(m_inner);
+    inner.newStatement();
+    inner.m_writer.directive("align");
+    inner.m_writer.uhex(alignment);
+    if (fill)
+        inner.m_writer.uhex(fill);
+    return *this;
+}
+
+ExecutableBuilder & ExecutableBuilder::bind(std::string_view name) {
+    auto & inner = *assertReturn(m_inner);
+    inner.newStatement();
+    inner.m_writer.directive("bind");
+    inner.m_writer.string(name);
+    return *this;
+}
+
+std::size_t ExecutableBuilder::numStatements() const noexcept
+{ return assertReturn(m_inner)->m_numStatements; }
+
+TokensVector const & ExecutableBuilder::tokens() const noexcept
+{ return assertReturn(m_inner)->m_tokens; }
+
+void ExecutableBuilder::clear() noexcept {
+    auto & inner = *assertReturn(m_inner);
+    inner.m_writer.clear();
+    inner.m_numStatements = 0u;
+}
+
+Executable ExecutableBuilder::build(Options const & options) {
+    auto & inner = *assertReturn(m_inner);
+    return inner.m_assembler.assemble(inner.m_tokens, options);
+}
+
+Result<Executable> ExecutableBuilder::tryBuild(Options const & options)
+        noexcept
+{
+    auto & inner = *assertReturn(m_inner);
+    auto r(inner.m_assembler.tryAssemble(inner.m_tokens, options));
+    if (r || (r.error().code() == ErrorCode::OutOfMemory))
+        return r;
+    auto const & ts = inner.m_tokens;
+    auto const i = r.error().offset();
+    return Error(r.error().code(),
+                 (i < ts.size()) ? ts[i].startLine() - 1u
+                                 : inner.m_numStatements,
+                 Error::OffsetType::Statement);
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_EXECUTABLEBUILDER_H
+#define SHAREMIND_LIBAS_EXECUTABLEBUILDER_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <memory_resource>
+#include <sharemind/ExceptionMacros.h>
+#include <sharemind/libexecutable/Executable.h>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "Error.h"
+#include "Exception.h"
+#include "Options.h"
+#include "tokens.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+SHAREMIND_DECLARE_EXCEPTION_CONST_STDSTRING_NOINLINE(
+        Exception,
+        ExecutableBuilderException);
+
+/**
+  \brief Builds an executable from statements given through method calls
+         instead of program text.
+
+  Every method appends one statement, equivalent to one line of a program, to
+  the tokens of the program, which are then assembled by build() exactly like
+  tokenized text. The executable is therefore identical to the one assembled
+  from the equivalent text. The values given are stored in the tokens as they
+  are, and the text of the tokens is only written for printing them and for
+  locating errors, see TokenWriter. Expressions are parsed from their text
+  like in programs.
+
+  Instructions are given by their full names as in the libvmi instruction table
+  and checked by build(), for example:
+
+  \code
+  b.instruction("mov_imm_reg", 0x1234u, 2u);
+  b.instruction("jmp_imm", ExecutableBuilder::Argument::label("loop"));
+  \endcode
+*/
+class ExecutableBuilder {
+
+public: /* Types: */
+
+    enum class Section { Text, RoData, Data, Bss, Bind, PdBind, Debug };
+
+    enum class DataType {
+        UInt8, UInt16, UInt32, UInt64, Int8, Int16, Int32, Int64
+    };
+
+    /**
+      \brief An argument of an instruction, or a value of data: an integer, a
+             label with an optional offset, or an expression.
+      \note Label names and expressions are copied by the builder, so they only
+            need to outlive the call they are given to.
+    */
+    class Argument {
+
+        friend class ExecutableBuilder;
+
+    private: /* Types: */
+
+        enum class Kind { Unsigned, Signed, Label, Expression };
+
+    public: /* Methods: */
+
+        template <typename T,
+                  std::enable_if_t<std::is_integral<T>::value
+                                   && std::is_unsigned<T>::value, int> = 0>
+        constexpr Argument(T const value) noexcept
+            : m_kind(Kind::Unsigned)
+            , m_value(value)
+        {}
+
+        template <typename T,
+                  std::enable_if_t<std::is_integral<T>::value
+                                   && std::is_signed<T>::value, int> = 0>
+        constexpr Argument(T const value) noexcept
+            : m_kind(Kind::Signed)
+            , m_value(static_cast<std::uint64_t>(value))
+        {}
+
+        /** \brief A label, like :name or :name+0x10 in program text. */
+        static constexpr Argument label(std::string_view name,
+                                        std::int64_t offset = 0) noexcept
+        {
+            return Argument(Kind::Label,
+                            static_cast<std::uint64_t>(offset),
+                            name);
+        }
+
+        /** \brief An expression, like (:end - :start) in program text. */
+        static constexpr Argument expression(std::string_view text) noexcept
+        { return Argument(Kind::Expression, 0u, text); }
+
+    private: /* Methods: */
+
+        constexpr Argument(Kind const kind,
+                           std::uint64_t const value,
+                           std::string_view const text) noexcept
+            : m_kind(kind)
+            , m_value(value)
+            , m_text(text)
+        {}
+
+    private: /* Fields: */
+
+        Kind m_kind;
+        std::uint64_t m_value;
+        std::string_view m_text;
+
+    };
+
+public: /* Methods: */
+
+    /**
+      \param[in] memoryResource The memory resource used for the tokens and for
+                                assembling, as by Assembler.
+    */
+    ExecutableBuilder(std::pmr::memory_resource * memoryResource =
+                              std::pmr::get_default_resource());
+    ExecutableBuilder(ExecutableBuilder &&) noexcept;
+    ExecutableBuilder(ExecutableBuilder const &) = delete;
+    ~ExecutableBuilder() noexcept;
+
+    ExecutableBuilder & operator=(ExecutableBuilder &&) noexcept;
+    ExecutableBuilder & operator=(ExecutableBuilder const &) = delete;
+
+    /**
+      \brief Appends an instruction with the given full name.
+      \throws ExecutableBuilderException if the name is not a valid keyword or
+              a label name or an expression in the arguments is invalid, in
+              which case nothing is appended.
+    */
+    ExecutableBuilder & instruction(std::string_view name,
+                                    std::initializer_list<Argument> arguments);
+
+    template <typename ... Args>
+    ExecutableBuilder & instruction(std::string_view name, Args && ... args)
+    { return instruction(name, {Argument(std::forward<Args>(args))...}); }
+
+    /**
+      \brief Defines a label at the current position, like :name on a line of
+             its own in program text. Names starting with a dot are local
+             labels.
+      \throws ExecutableBuilderException if the name is not a valid label name.
+    */
+    ExecutableBuilder & label(std::string_view name);
+
+    /** \brief Switches sections, like .section. */
+    ExecutableBuilder & section(Section section);
+
+    /** \brief Switches linking units, like .linking_unit. */
+    ExecutableBuilder & linkingUnit(std::uint8_t index);
+
+    /**
+      \brief Appends a value, like .data.
+      \throws ExecutableBuilderException if a label name or an expression
+              given as the value is invalid, in which case nothing is
+              appended.
+    */
+    ExecutableBuilder & data(DataType type, Argument const & value);
+
+    /** \brief Appends the bytes of a string without a terminating null byte,
+               like .data string. */
+    ExecutableBuilder & data(std::string_view string);
+
+    /**
+      \brief Appends the given number of copies of a value, like .fill.
+      \throws ExecutableBuilderException as data().
+    */
+    ExecutableBuilder & fill(std::uint16_t count,
+                             DataType type,
+                             Argument const & value);
+
+    /** \brief Pads the section to a multiple of the given power of two with
+                  the given byte, like .align. */
+    ExecutableBuilder & align(std::uint64_t alignment, std::uint8_t fill = 0u);
+
+    /** \brief Appends a binding to the BIND or PDBIND section, like .bind. */
+    ExecutableBuilder & bind(std::string_view name);
+
+    /** \returns the number of statements appended so far. */
+    std::size_t numStatements() const noexcept;
+
+    /** \returns the tokens of the statements appended so far. */
+    TokensVector const & tokens() const noexcept;
+
+    /** \brief Removes all statements, keeping the allocated capacity. */
+    void clear() noexcept;
+
+    /**
+      \brief Assembles the statements appended so far, like assemble().
+      \throws AssembleException on invalid programs. Its token iterator points
+              into tokens(), and the start line of its tokens is the index of
+              their statement plus one.
+    */
+    Executable build(Options const & options = Options());
+
+    /**
+      \brief Assembles the statements appended so far without throwing on
+             invalid programs.
+      \returns the executable, or the code of the first error. The offset of
+               such errors is the index of the statement which caused it, or
+               numStatements() for errors at the end of the program.
+    */
+    Result<Executable> tryBuild(Options const & options = Options()) noexcept;
+
+private: /* Fields: */
+
+    struct Inner;
+    std::unique_ptr<Inner> m_inner;
+
+};
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_EXECUTABLEBUILDER_H */
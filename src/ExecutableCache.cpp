@@ -0,0 +1,552 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "ExecutableCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <istream>
+#include <limits>
+#include <new>
+#include <sharemind/AssertReturn.h>
+#include <sharemind/libvmi/instr.h>
+#include <sstream>
+#include <streambuf>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "assemble.h"
+#include "readFile.h"
+
+
+#ifndef SHAREMIND_LIBAS_VERSION
+#error SHAREMIND_LIBAS_VERSION is not defined!
+#endif
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+/** Increment when the format of the entries changes. */
+constexpr std::uint64_t const entryFormatVersion = 2u;
+
+constexpr char const entryMagic[8u] = {'S','M','A','S','E','X','E','\0'};
+constexpr char const entrySuffix[] = ".exe";
+constexpr std::size_t const entryNameLength = 32u + sizeof(entrySuffix) - 1u;
+constexpr char const tempPrefix[] = "tmp-";
+constexpr std::size_t const tempNameLength = sizeof(tempPrefix) - 1u + 33u;
+
+/** Temporary files older than this are left over from crashed processes. */
+constexpr ::time_t const staleTempSeconds = 60 * 60;
+
+struct Hash {
+
+/* Fields: */
+
+    std::uint64_t first;
+    std::uint64_t second;
+
+};
+
+inline bool operator==(Hash const & lhs, Hash const & rhs) noexcept
+{ return (lhs.first == rhs.first) && (lhs.second == rhs.second); }
+
+constexpr std::uint64_t const hashPrime1 = 0x9e3779b97f4a7c15u;
+constexpr std::uint64_t const hashPrime2 = 0xc2b2ae3d27d4eb4fu;
+
+inline std::uint64_t rotateLeft(std::uint64_t const v, unsigned const n)
+        noexcept
+{ return (v << n) | (v >> (64u - n)); }
+
+inline std::uint64_t finalMix(std::uint64_t h) noexcept {
+    h ^= h >> 33u;
+    h *= 0xff51afd7ed558ccdu;
+    h ^= h >> 33u;
+    h *= 0xc4ceb9fe1a85ec53u;
+    h ^= h >> 33u;
+    return h;
+}
+
+/** A fast, non-cryptographic 128-bit hash reading 8 bytes at a time. */
+Hash hashBytes(void const * const data,
+               std::size_t size,
+               Hash const & seed) noexcept
+{
+    auto const * ptr = static_cast<unsigned char const *>(data);
+    auto h1 = seed.first ^ (size * hashPrime1);
+    auto h2 = seed.second ^ (size * hashPrime2);
+    auto const mix =
+            [&h1, &h2](std::uint64_t const word) noexcept {
+                h1 = rotateLeft(h1 ^ (word * hashPrime2), 31u) * hashPrime1;
+                h2 = rotateLeft(h2 ^ (word * hashPrime1), 27u) * hashPrime2
+                     + h1;
+            };
+    for (; size >= 8u; ptr += 8u, size -= 8u) {
+        std::uint64_t word;
+        std::memcpy(&word, ptr, 8u);
+        mix(word);
+    }
+    if (size) {
+        std::uint64_t word = 0u;
+        std::memcpy(&word, ptr, size);
+        mix(word);
+    }
+    return Hash{finalMix(h1 + h2), finalMix(h2 ^ rotateLeft(h1, 32u))};
+}
+
+/**
+  \returns the hash of the version of this library and of the instruction set,
+           which seeds the hashes of the programs.
+*/
+Hash const & environmentHash() {
+    static Hash const hash(
+        []() {
+            static constexpr char const version[] = SHAREMIND_LIBAS_VERSION;
+            auto h(hashBytes(version,
+                             sizeof(version) - 1u,
+                             Hash{entryFormatVersion, 0u}));
+            /* The iteration order of the map is unspecified: */
+            Hash sum{0u, 0u};
+            for (auto const & vp : instructionNameMap()) {
+                std::uint64_t const values[] = {vp.second.code,
+                                                vp.second.numArgs};
+                auto const eh(hashBytes(values, sizeof(values),
+                                        hashBytes(vp.first.data(),
+                                                  vp.first.size(),
+                                                  h)));
+                sum.first += eh.first;
+                sum.second += eh.second;
+            }
+            return hashBytes(&sum, sizeof(sum), h);
+        }());
+    return hash;
+}
+
+/**
+  \returns the seed of the hashes of programs assembled with the given
+           options, as the optimizations enabled, the execution profile used
+           and the alignment of data change the executables.
+*/
+Hash seedHash(Options const & options) {
+    if (!options.optimizes() && !options.alignData)
+        return environmentHash();
+    std::uint64_t const optimizations =
+            (options.peephole ? 1u : 0u)
+            | (options.gcSections ? 2u : 0u)
+            | (options.profile ? 4u : 0u)
+            | (options.pruneBindings ? 8u : 0u)
+            | (options.mergeRoData ? 16u : 0u)
+            | (options.alignData ? 32u : 0u)
+            | (options.foldCode ? 64u : 0u)
+            | (options.zeroDataToBss ? 128u : 0u);
+    auto h(hashBytes(&optimizations, sizeof(optimizations), environmentHash()));
+    if (options.profile) {
+        for (auto const & entry : options.profile->entries()) {
+            h = hashBytes(entry.first.data(), entry.first.size() + 1u, h);
+            for (auto const & count : entry.second) {
+                std::uint64_t const values[] = { count.first, count.second };
+                h = hashBytes(values, sizeof(values), h);
+            }
+        }
+    }
+    return h;
+}
+
+/**
+  Every entry consists of this header, followed by the program and by the
+  serialized executable. The program is compared on every hit, so that an
+  entry is never used for a different program with the same hash.
+*/
+struct EntryHeader {
+
+/* Fields: */
+
+    char magic[8u];
+    std::uint64_t programSize;
+    Hash seedHash;
+    Hash programHash;
+    std::uint64_t executableSize;
+
+};
+
+class MemoryStreamBuffer: public std::streambuf {
+
+public: /* Methods: */
+
+    MemoryStreamBuffer(char * const data, std::size_t const size) noexcept
+    { setg(data, data, data + size); }
+
+};
+
+class FileDescriptor {
+
+public: /* Methods: */
+
+    FileDescriptor(int const fd) noexcept : m_fd(fd) {}
+
+    FileDescriptor(FileDescriptor const &) = delete;
+    FileDescriptor & operator=(FileDescriptor const &) = delete;
+
+    ~FileDescriptor() noexcept { close(); }
+
+    int get() const noexcept { return m_fd; }
+
+    bool close() noexcept {
+        if (m_fd < 0)
+            return true;
+        auto const r = ::close(m_fd);
+        m_fd = -1;
+        return r == 0;
+    }
+
+private: /* Fields: */
+
+    int m_fd;
+
+};
+
+bool writeFully(int const fd, char const * data, std::size_t size) noexcept {
+    while (size) {
+        auto const r = ::write(fd, data, size);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        auto const n = static_cast<std::size_t>(r);
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+void appendHex(std::string & str, std::uint64_t const value) {
+    static constexpr char const digits[] = "0123456789abcdef";
+    for (unsigned shift = 64u; shift;) {
+        shift -= 4u;
+        str.push_back(digits[(value >> shift) & 0xfu]);
+    }
+}
+
+} // anonymous namespace
+
+struct ExecutableCache::Inner {
+
+/* Types: */
+
+    struct EntryInfo {
+
+    /* Fields: */
+
+        std::string name;
+        std::uint64_t size;
+        struct ::timespec lastUse;
+
+    };
+
+/* Methods: */
+
+    Inner(std::string directory,
+          std::uint64_t const maxSize,
+          std::pmr::memory_resource * const memoryResource)
+        : m_directory(std::move(directory))
+        , m_maxSize(maxSize)
+        , m_memoryResource(memoryResource)
+        , m_assembler(memoryResource)
+    {
+        if (m_directory.empty())
+            m_directory = ".";
+        ::mkdir(m_directory.c_str(), 0777);
+    }
+
+    std::string entryPath(Hash const & hash) const {
+        std::string path(m_directory);
+        path.reserve(path.size() + 1u + entryNameLength);
+        path.push_back('/');
+        appendHex(path, hash.first);
+        appendHex(path, hash.second);
+        path.append(entrySuffix);
+        return path;
+    }
+
+    /** \returns whether the executable was read from the given entry. */
+    bool readEntry(std::string const & path,
+                   std::string_view const program,
+                   Hash const & seed,
+                   Hash const & hash,
+                   Executable & exe)
+    {
+        std::shared_ptr<void> data;
+        std::size_t size;
+        if (readFile(path.c_str(), 0u, readFileToEnd, m_memoryResource, data,
+                     size) != ReadFileResult::Ok)
+            return false;
+
+        /* Check the entry, removing it if it is corrupt: */
+        EntryHeader header;
+        if (size < sizeof(header)) {
+            ::unlink(path.c_str());
+            return false;
+        }
+        std::memcpy(&header, data.get(), sizeof(header));
+        auto const bodySize = size - sizeof(header);
+        if ((std::memcmp(header.magic, entryMagic, sizeof(entryMagic)) != 0)
+            || (header.programSize > bodySize)
+            || (header.executableSize != bodySize - header.programSize))
+        {
+            ::unlink(path.c_str());
+            return false;
+        }
+        auto * const entryProgram =
+                static_cast<char *>(data.get()) + sizeof(header);
+        if ((header.programSize != program.size())
+            || !(header.seedHash == seed)
+            || !(header.programHash == hash)
+            || (std::memcmp(entryProgram, program.data(), program.size())
+                != 0))
+            return false;
+
+        MemoryStreamBuffer buffer(entryProgram + header.programSize,
+                                  header.executableSize);
+        std::istream is(&buffer);
+        is >> exe;
+        if (!is) {
+            ::unlink(path.c_str());
+            return false;
+        }
+
+        /* Mark the entry as recently used: */
+        ::utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+        return true;
+    }
+
+    void writeEntry(std::string const & path,
+                    std::string_view const program,
+                    Hash const & seed,
+                    Hash const & hash,
+                    Executable const & exe)
+    {
+        std::ostringstream oss;
+        oss << exe;
+        if (!oss)
+            return;
+        auto const serialized(oss.str());
+
+        EntryHeader header;
+        std::memcpy(header.magic, entryMagic, sizeof(entryMagic));
+        header.programSize = program.size();
+        header.seedHash = seed;
+        header.programHash = hash;
+        header.executableSize = serialized.size();
+
+        /* Write to a temporary file and rename it, so that other processes
+           never see partially written entries: */
+        static std::atomic<std::uint64_t> tempCounter(0u);
+        std::string tempPath(m_directory);
+        tempPath.append("/").append(tempPrefix);
+        appendHex(tempPath, static_cast<std::uint64_t>(::getpid()));
+        tempPath.push_back('-');
+        appendHex(tempPath,
+                  tempCounter.fetch_add(1u, std::memory_order_relaxed));
+        FileDescriptor fd(::open(tempPath.c_str(),
+                                 O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                                 0666));
+        if (fd.get() < 0)
+            return;
+        if (!writeFully(fd.get(),
+                        reinterpret_cast<char const *>(&header),
+                        sizeof(header))
+            || !writeFully(fd.get(), program.data(), program.size())
+            || !writeFully(fd.get(), serialized.data(), serialized.size())
+            || !fd.close()
+            || (::rename(tempPath.c_str(), path.c_str()) != 0))
+        {
+            ::unlink(tempPath.c_str());
+            return;
+        }
+
+        if (m_maxSize) {
+            std::uint64_t const entrySize =
+                    sizeof(header) + program.size() + serialized.size();
+            /* Saturate, as the total size is initially the maximum: */
+            constexpr auto const maxTotal =
+                    std::numeric_limits<std::uint64_t>::max();
+            m_totalSize = (entrySize > maxTotal - m_totalSize)
+                          ? maxTotal
+                          : m_totalSize + entrySize;
+            if (m_totalSize > m_maxSize)
+                evict();
+        }
+    }
+
+    /**
+      \brief Removes the least recently used entries until the total size of
+             the entries is within the limit.
+
+      The total size is only recounted here, hence entries added by other
+      processes are only taken into account once the entries added by this
+      process exceed the limit. Temporary files older than an hour, left
+      behind by processes which crashed before renaming them, are removed
+      here too. Newer temporary files count towards the total size.
+    */
+    void evict() {
+        std::vector<EntryInfo> entries;
+        m_totalSize = 0u;
+        if (auto * const dir = ::opendir(m_directory.c_str())) {
+            std::string path;
+            auto const now = ::time(nullptr);
+            while (auto const * const dirEntry = ::readdir(dir)) {
+                std::string_view const name(dirEntry->d_name);
+                bool const isTemp = (name.size() == tempNameLength)
+                                    && (name.substr(0u, sizeof(tempPrefix) - 1u)
+                                        == tempPrefix);
+                if (!isTemp
+                    && ((name.size() != entryNameLength)
+                        || (name.substr(32u) != entrySuffix)))
+                    continue;
+                path.assign(m_directory).append("/").append(name);
+                struct ::stat st;
+                if ((::stat(path.c_str(), &st) != 0) || !S_ISREG(st.st_mode))
+                    continue;
+                auto const entrySize = static_cast<std::uint64_t>(st.st_size);
+                if (isTemp) {
+                    if ((now - st.st_mtim.tv_sec > staleTempSeconds)
+                        && ((::unlink(path.c_str()) == 0) || (errno == ENOENT)))
+                        continue;
+                    m_totalSize += entrySize;
+                    continue;
+                }
+                entries.push_back(EntryInfo{std::string(name),
+                                            entrySize,
+                                            st.st_mtim});
+                m_totalSize += entrySize;
+            }
+            ::closedir(dir);
+        }
+        if (m_totalSize <= m_maxSize)
+            return;
+
+        std::sort(entries.begin(),
+                  entries.end(),
+                  [](EntryInfo const & lhs, EntryInfo const & rhs) noexcept {
+                      if (lhs.lastUse.tv_sec != rhs.lastUse.tv_sec)
+                          return lhs.lastUse.tv_sec < rhs.lastUse.tv_sec;
+                      return lhs.lastUse.tv_nsec < rhs.lastUse.tv_nsec;
+                  });
+        std::string path;
+        for (auto const & entry : entries) {
+            if (m_totalSize <= m_maxSize)
+                break;
+            path.assign(m_directory).append("/").append(entry.name);
+            if ((::unlink(path.c_str()) == 0) || (errno == ENOENT))
+                m_totalSize -= entry.size;
+        }
+    }
+
+/* Fields: */
+
+    std::string m_directory;
+    std::uint64_t const m_maxSize;
+    std::pmr::memory_resource * const m_memoryResource;
+    Assembler m_assembler;
+
+    /** The total size of the entries, as far as this process knows. Set to
+        the maximum initially to count the entries on the first write. */
+    std::uint64_t m_totalSize = std::numeric_limits<std::uint64_t>::max();
+
+    std::uint64_t m_numHits = 0u;
+    std::uint64_t m_numMisses = 0u;
+
+};
+
+ExecutableCache::ExecutableCache(std::string directory,
+                                 std::uint64_t maxSize,
+                                 std::pmr::memory_resource * memoryResource)
+    : m_inner(new Inner(std::move(directory),
+                        maxSize,
+                        assertReturn(memoryResource)))
+{}
+
+ExecutableCache::ExecutableCache(ExecutableCache &&) noexcept = default;
+ExecutableCache::~ExecutableCache() noexcept = default;
+ExecutableCache & ExecutableCache::operator=(ExecutableCache &&) noexcept
+        = default;
+
+Result<Executable> ExecutableCache::tryAssemble(char const * program,
+                                                std::size_t length,
+                                                Options const & options)
+        noexcept
+{
+    assert(program);
+    auto & inner = *assertReturn(m_inner);
+    std::string_view const text(program, length);
+
+    /* The results of programs using other files depend on those files: */
+    bool const cacheable = (text.find(".include") == std::string_view::npos)
+                           && (text.find(".incbin") == std::string_view::npos);
+    Hash seed{0u, 0u};
+    Hash hash{0u, 0u};
+    std::string path;
+    if (cacheable) {
+        try {
+            seed = seedHash(options);
+            hash = hashBytes(program, length, seed);
+            path = inner.entryPath(hash);
+            Executable exe;
+            if (inner.readEntry(path, text, seed, hash, exe)) {
+                ++inner.m_numHits;
+                return Result<Executable>(std::move(exe));
+            }
+        } catch (...) {
+            path.clear();
+        }
+    }
+
+    ++inner.m_numMisses;
+    auto r(inner.m_assembler.tryAssemble(program, length, options));
+    if (r && !path.empty()) {
+        try {
+            inner.writeEntry(path, text, seed, hash, *r);
+        } catch (...) {}
+    }
+    return r;
+}
+
+std::uint64_t ExecutableCache::numHits() const noexcept
+{ return assertReturn(m_inner)->m_numHits; }
+
+std::uint64_t ExecutableCache::numMisses() const noexcept
+{ return assertReturn(m_inner)->m_numMisses; }
+
+void ExecutableCache::resetCounters() noexcept {
+    auto & inner = *assertReturn(m_inner);
+    inner.m_numHits = 0u;
+    inner.m_numMisses = 0u;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
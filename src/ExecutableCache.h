@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_EXECUTABLECACHE_H
+#define SHAREMIND_LIBAS_EXECUTABLECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <sharemind/libexecutable/Executable.h>
+#include <string>
+#include "Error.h"
+#include "Options.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief An assembler which stores the executables it assembles in a directory,
+         and on later calls for the same program reads them back from there
+         instead of assembling the program again.
+
+  Entries are keyed by a hash of the program, of the version of this library,
+  of the instruction set of libvmi and of the optimizations enabled in the
+  options. Entries are written to temporary files which are then renamed, so
+  several processes may share a directory. If the total size of the entries
+  exceeds the given limit, the least recently used entries are removed.
+
+  Programs which fail to assemble are not cached, hence the errors are always
+  those of Assembler::tryAssemble(). Programs which use .include or .incbin
+  depend on other files and are always assembled.
+
+  \note The resource limits in Options are only enforced when a program is
+        assembled, not when its executable is read from the cache.
+  \note Entries also store their programs, which are compared on every hit,
+        hence a collision of the fast, non-cryptographic hash can not return
+        the executable of another program. The entries are not authenticated
+        however, so do not share a cache directory with untrusted parties.
+  \note An instance is not thread-safe, use one instance per thread. Several
+        instances, also in different processes, may share a directory.
+  \note All memory for the returned executables which libexecutable allows is
+        allocated from the memory resource given on construction. That
+        resource must outlive both the cache and any executables returned by
+        it.
+*/
+class ExecutableCache {
+
+public: /* Methods: */
+
+    /**
+      \param[in] directory The directory to store the entries in, created if
+                           it does not exist.
+      \param[in] maxSize The maximum total size in bytes of the entries, or 0
+                         for no limit.
+    */
+    ExecutableCache(std::string directory,
+                    std::uint64_t maxSize = 0u,
+                    std::pmr::memory_resource * memoryResource =
+                            std::pmr::get_default_resource());
+    ExecutableCache(ExecutableCache &&) noexcept;
+    ExecutableCache(ExecutableCache const &) = delete;
+    ~ExecutableCache() noexcept;
+
+    ExecutableCache & operator=(ExecutableCache &&) noexcept;
+    ExecutableCache & operator=(ExecutableCache const &) = delete;
+
+    /**
+      \brief Reads the executable of the given program from the cache, or
+             tokenizes and assembles the program like Assembler::tryAssemble()
+             and stores the result in the cache.
+      \note Failures to read or write entries are not errors, such programs
+            are just assembled.
+    */
+    Result<Executable> tryAssemble(char const * program,
+                                   std::size_t length,
+                                   Options const & options = Options())
+            noexcept;
+
+    /** \returns the number of executables read from the cache. */
+    std::uint64_t numHits() const noexcept;
+
+    /** \returns the number of programs assembled, including the programs
+                 which could not be cached. */
+    std::uint64_t numMisses() const noexcept;
+
+    void resetCounters() noexcept;
+
+private: /* Fields: */
+
+    struct Inner;
+    std::unique_ptr<Inner> m_inner;
+
+};
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_EXECUTABLECACHE_H */
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "ExecutionProfile.h"
+
+#include <charconv>
+#include <istream>
+#include <limits>
+#include <utility>
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+bool isSpace(char const c) noexcept
+{ return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\v'); }
+
+/** \returns the next whitespace separated field of the line. */
+std::string_view nextField(std::string_view & line) noexcept {
+    std::size_t begin = 0u;
+    while ((begin < line.size()) && isSpace(line[begin]))
+        ++begin;
+    auto end = begin;
+    while ((end < line.size()) && !isSpace(line[end]))
+        ++end;
+    auto const r(line.substr(begin, end - begin));
+    line.remove_prefix(end);
+    return r;
+}
+
+bool parseNumber(std::string_view s, std::uint64_t & value) noexcept {
+    int base = 10;
+    if ((s.size() > 2u) && (s[0u] == '0') && ((s[1u] | 0x20) == 'x')) {
+        s.remove_prefix(2u);
+        base = 16;
+    }
+    if (s.empty())
+        return false;
+    auto const * const end = s.data() + s.size();
+    auto const r(std::from_chars(s.data(), end, value, base));
+    return (r.ec == std::errc()) && (r.ptr == end);
+}
+
+} // anonymous namespace
+
+void ExecutionProfile::add(std::string_view const label,
+                           std::uint64_t const offset,
+                           std::uint64_t const count)
+{
+    auto it(m_entries.find(label));
+    if (it == m_entries.end())
+        it = m_entries.emplace(std::string(label), Counts()).first;
+    auto & c = it->second[offset];
+    c = (count > std::numeric_limits<std::uint64_t>::max() - c)
+        ? std::numeric_limits<std::uint64_t>::max()
+        : c + count;
+}
+
+std::uint64_t ExecutionProfile::count(std::string_view const label,
+                                      std::uint64_t const offset)
+        const noexcept
+{
+    auto const it(m_entries.find(label));
+    if (it == m_entries.end())
+        return 0u;
+    auto const jt(it->second.find(offset));
+    return (jt != it->second.end()) ? jt->second : 0u;
+}
+
+std::istream & operator>>(std::istream & is, ExecutionProfile & profile) {
+    ExecutionProfile r(profile);
+    bool success = true;
+    for (std::string buffer; std::getline(is, buffer);) {
+        std::string_view line(buffer);
+        line = line.substr(0u, line.find('#'));
+        auto label(nextField(line));
+        if (label.empty())
+            continue;
+        if (label.front() == ':')
+            label.remove_prefix(1u);
+        std::uint64_t offset;
+        std::uint64_t count;
+        if (label.empty()
+            || !parseNumber(nextField(line), offset)
+            || !parseNumber(nextField(line), count)
+            || !nextField(line).empty())
+        {
+            success = false;
+            break;
+        }
+        r.add(label, offset, count);
+    }
+    if (success && !is.bad()) {
+        profile = std::move(r);
+        /* Reading up to the end of the stream is not a failure: */
+        if (is.eof())
+            is.clear(std::istream::eofbit);
+    } else {
+        is.setstate(std::istream::failbit);
+    }
+    return is;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
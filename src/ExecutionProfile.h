@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_EXECUTIONPROFILE_H
+#define SHAREMIND_LIBAS_EXECUTIONPROFILE_H
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <string_view>
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief Execution counts of the instructions of a program, e.g. as dumped by
+         the VM, used to lay out code, see layoutCode().
+
+  An instruction is identified by a non-local label and the offset in code
+  blocks of the instruction from the label. Entries for local labels, for
+  labels not in the TEXT sections and for offsets not at instructions are
+  ignored.
+
+  The text form of a profile has one entry per line, given as a label with an
+  optional leading colon, the offset and the count, separated by whitespace.
+  The numbers are decimal, or hexadecimal if prefixed with "0x". Empty lines
+  and anything following a '#' are ignored.
+*/
+class ExecutionProfile {
+
+public: /* Types: */
+
+    /** The counts of the instructions following a label, by offset. */
+    using Counts = std::map<std::uint64_t, std::uint64_t>;
+
+    using Entries = std::map<std::string, Counts, std::less<> >;
+
+public: /* Methods: */
+
+    bool empty() const noexcept { return m_entries.empty(); }
+
+    Entries const & entries() const noexcept { return m_entries; }
+
+    /**
+      \brief Adds the given count to the count of the instruction at the given
+             offset from the given label, saturating at the maximum count.
+    */
+    void add(std::string_view label, std::uint64_t offset, std::uint64_t count);
+
+    /** \returns the count of the instruction at the given offset from the
+                 given label, or 0 if it has no entry. */
+    std::uint64_t count(std::string_view label, std::uint64_t offset)
+            const noexcept;
+
+private: /* Fields: */
+
+    Entries m_entries;
+
+};
+
+/**
+  \brief Reads a profile in its text form, adding the entries read to the
+         given profile.
+  \note On failure sets the failbit of the stream and leaves the profile as it
+        was.
+*/
+std::istream & operator>>(std::istream & is, ExecutionProfile & profile);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_EXECUTIONPROFILE_H */
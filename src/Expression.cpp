@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "Expression.h"
+
+#include <cstring>
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+inline bool isIdHead(char const c) noexcept {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+inline bool isIdTail(char const c) noexcept
+{ return isIdHead(c) || (c >= '0' && c <= '9'); }
+
+inline int hexDigitValue(char const c) noexcept {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+inline void skipWhitespace(char const * & c, char const * const e) noexcept {
+    while (c != e && (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\v'
+                      || *c == '\f'))
+        ++c;
+}
+
+inline bool skipToken(char const * & c,
+                      char const * const e,
+                      char const * const token) noexcept
+{
+    auto const length = std::strlen(token);
+    if (static_cast<std::size_t>(e - c) < length
+        || std::strncmp(c, token, length) != 0)
+        return false;
+    c += length;
+    return true;
+}
+
+bool sectionTypeFromName(char const * const name,
+                         std::size_t const length,
+                         Expression::SectionType & type) noexcept
+{
+    using ST = Expression::SectionType;
+    #define SHAREMIND_LIBAS_EXPRESSION_SECTION(n,t) \
+        if (length == sizeof(n) - 1u && std::strncmp(name, n, length) == 0) { \
+            type = ST::t; \
+            return true; \
+        }
+    SHAREMIND_LIBAS_EXPRESSION_SECTION("TEXT", Text)
+    SHAREMIND_LIBAS_EXPRESSION_SECTION("RODATA", RoData)
+    SHAREMIND_LIBAS_EXPRESSION_SECTION("DATA", Data)
+    SHAREMIND_LIBAS_EXPRESSION_SECTION("BSS", Bss)
+    SHAREMIND_LIBAS_EXPRESSION_SECTION("BIND", Bind)
+    SHAREMIND_LIBAS_EXPRESSION_SECTION("PDBIND", PdBind)
+    SHAREMIND_LIBAS_EXPRESSION_SECTION("DEBUG", Debug)
+    #undef SHAREMIND_LIBAS_EXPRESSION_SECTION
+    return false;
+}
+
+} // anonymous namespace
+
+bool Expression::parse(char const * const text, std::size_t const length) {
+    assert(text);
+    assert(length >= 2u);
+    assert(text[0u] == '(');
+    assert(text[length - 1u] == ')');
+
+    clear();
+    m_nestingDepth = 0u;
+    char const * c = text + 1u;
+    char const * const e = text + length - 1u;
+    if (!parseShift(c, e))
+        return false;
+    skipWhitespace(c, e);
+    return c == e;
+}
+
+bool Expression::assign(std::pmr::vector<Op> ops,
+                        std::pmr::vector<LabelReference> labels)
+{
+    clear();
+    std::size_t depth = 0u;
+    bool usesSectionSizes = false;
+    for (auto const & op : ops) {
+        switch (op.code) {
+            case OpCode::Constant:
+                break;
+            case OpCode::Label:
+                if (op.value >= labels.size())
+                    return false;
+                break;
+            case OpCode::SectionSize:
+                if (op.value >= static_cast<std::uint64_t>(SectionType::Count))
+                    return false;
+                usesSectionSizes = true;
+                break;
+            case OpCode::Negate:
+                if (depth < 1u)
+                    return false;
+                continue;
+            case OpCode::Add:
+            case OpCode::Subtract:
+            case OpCode::Multiply:
+            case OpCode::ShiftLeft:
+            case OpCode::ShiftRight:
+                if (depth < 2u)
+                    return false;
+                --depth;
+                continue;
+            default:
+                return false;
+        }
+        ++depth;
+    }
+    if (depth != 1u)
+        return false;
+    m_ops = std::move(ops);
+    m_labels = std::move(labels);
+    m_usesSectionSizes = usesSectionSizes;
+    return true;
+}
+
+bool Expression::parseShift(char const * & c, char const * const e) {
+    if (!parseAdditive(c, e))
+        return false;
+    for (;;) {
+        skipWhitespace(c, e);
+        OpCode code;
+        if (skipToken(c, e, "<<")) {
+            code = OpCode::ShiftLeft;
+        } else if (skipToken(c, e, ">>")) {
+            code = OpCode::ShiftRight;
+        } else {
+            return true;
+        }
+        if (!parseAdditive(c, e))
+            return false;
+        emit(code);
+    }
+}
+
+bool Expression::parseAdditive(char const * & c, char const * const e) {
+    if (!parseMultiplicative(c, e))
+        return false;
+    for (;;) {
+        skipWhitespace(c, e);
+        if (c == e || (*c != '+' && *c != '-'))
+            return true;
+        auto const code = (*c == '+') ? OpCode::Add : OpCode::Subtract;
+        ++c;
+        if (!parseMultiplicative(c, e))
+            return false;
+        emit(code);
+    }
+}
+
+bool Expression::parseMultiplicative(char const * & c, char const * const e) {
+    if (!parseUnary(c, e))
+        return false;
+    for (;;) {
+        skipWhitespace(c, e);
+        if (c == e || *c != '*')
+            return true;
+        ++c;
+        if (!parseUnary(c, e))
+            return false;
+        emit(OpCode::Multiply);
+    }
+}
+
+bool Expression::parseUnary(char const * & c, char const * const e) {
+    /* Unary operators are parsed iteratively, as chains of them may be
+       long: */
+    std::size_t numNegations = 0u;
+    for (;;) {
+        skipWhitespace(c, e);
+        if (c == e)
+            return false;
+        if (*c == '-') {
+            ++numNegations;
+        } else if (*c != '+') {
+            break;
+        }
+        ++c;
+    }
+    if (!parsePrimary(c, e))
+        return false;
+    for (; numNegations; --numNegations)
+        emit(OpCode::Negate);
+    return true;
+}
+
+bool Expression::parsePrimary(char const * & c, char const * const e) {
+    assert(c != e);
+
+    /* Parenthesized subexpression: */
+    if (*c == '(') {
+        if (++m_nestingDepth > maxNestingDepth)
+            return false;
+        ++c;
+        if (!parseShift(c, e))
+            return false;
+        skipWhitespace(c, e);
+        if (c == e || *c != ')')
+            return false;
+        ++c;
+        --m_nestingDepth;
+        return true;
+    }
+
+    /* Unsigned hexadecimal literal: */
+    if (*c == '0') {
+        if (++c == e || *c != 'x')
+            return false;
+        ++c;
+        std::uint64_t value = 0u;
+        unsigned numDigits = 0u;
+        for (; c != e; ++c) {
+            auto const digit = hexDigitValue(*c);
+            if (digit < 0)
+                break;
+            if (++numDigits > 16u)
+                return false;
+            value = (value << 4u) | static_cast<unsigned>(digit);
+        }
+        if (!numDigits)
+            return false;
+        emit(OpCode::Constant, value);
+        return true;
+    }
+
+    /* Label, either global or local: */
+    if (*c == ':') {
+        auto const nameStart = ++c;
+        if (c != e && *c == '.')
+            ++c;
+        if (c == e || !isIdHead(*c))
+            return false;
+        while (++c != e && isIdTail(*c));
+        std::pmr::string name(nameStart,
+                              static_cast<std::size_t>(c - nameStart),
+                              m_labels.get_allocator());
+        std::size_t i = 0u;
+        while (i < m_labels.size() && m_labels[i].name != name)
+            ++i;
+        if (i == m_labels.size())
+            m_labels.emplace_back(std::move(name));
+        emit(OpCode::Label, i);
+        return true;
+    }
+
+    /* sizeof(SECTION): */
+    if (skipToken(c, e, "sizeof")) {
+        skipWhitespace(c, e);
+        if (c == e || *c != '(')
+            return false;
+        ++c;
+        skipWhitespace(c, e);
+        auto const nameStart = c;
+        while (c != e && isIdTail(*c))
+            ++c;
+        SectionType type;
+        if (!sectionTypeFromName(nameStart,
+                                 static_cast<std::size_t>(c - nameStart),
+                                 type))
+            return false;
+        skipWhitespace(c, e);
+        if (c == e || *c != ')')
+            return false;
+        ++c;
+        emit(OpCode::SectionSize, static_cast<std::uint64_t>(type));
+        m_usesSectionSizes = true;
+        return true;
+    }
+
+    return false;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_EXPRESSION_H
+#define SHAREMIND_LIBAS_EXPRESSION_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <sharemind/libexecutable/libexecutable_0x0.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief An assemble-time constant expression over literals, labels and
+         section sizes.
+
+  Expressions are stored in postfix order. All arithmetic is done on 64-bit
+  unsigned integers modulo 2^64.
+*/
+class Expression {
+
+public: /* Constants: */
+
+    /** The maximum nesting depth of parentheses in parsed expressions, which
+        bounds the recursion of the parser. */
+    static constexpr std::size_t const maxNestingDepth = 256u;
+
+public: /* Types: */
+
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+    using SectionType = ExecutableSectionHeader0x0::SectionType;
+
+    enum class OpCode : std::uint8_t {
+        Constant,    /* Pushes value. */
+        Label,       /* Pushes the value of labels()[value]. */
+        SectionSize, /* Pushes the size of section type value. */
+        Negate,
+        Add,
+        Subtract,
+        Multiply,
+        ShiftLeft,
+        ShiftRight
+    };
+
+    struct Op {
+
+    /* Fields: */
+
+        OpCode code;
+        std::uint64_t value;
+
+    };
+
+    struct LabelReference {
+
+    /* Types: */
+
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    /* Methods: */
+
+        LabelReference(std::pmr::string name_,
+                       allocator_type const & allocator = allocator_type())
+            : name(std::move(name_), allocator)
+        {}
+
+        LabelReference(LabelReference && move,
+                       allocator_type const & allocator)
+            : name(std::move(move.name), allocator)
+            , value(move.value)
+            , resolved(move.resolved)
+        {}
+
+        LabelReference(LabelReference const & copy,
+                       allocator_type const & allocator)
+            : name(copy.name, allocator)
+            , value(copy.value)
+            , resolved(copy.resolved)
+        {}
+
+        LabelReference(LabelReference &&) = default;
+        LabelReference(LabelReference const &) = default;
+        LabelReference & operator=(LabelReference &&) = default;
+        LabelReference & operator=(LabelReference const &) = default;
+
+    /* Fields: */
+
+        std::pmr::string name;
+        std::uint64_t value = 0u;
+        bool resolved = false;
+
+    };
+
+    enum class EvaluationResult {
+        Ok,
+        Unresolved, /* A label or section size is not yet known. */
+        Invalid     /* E.g. a shift by 64 or more bits. */
+    };
+
+public: /* Methods: */
+
+    Expression(allocator_type const & allocator = allocator_type())
+        : m_ops(allocator)
+        , m_labels(allocator)
+    {}
+
+    Expression(Expression && move, allocator_type const & allocator)
+        : m_ops(std::move(move.m_ops), allocator)
+        , m_labels(std::move(move.m_labels), allocator)
+        , m_usesSectionSizes(move.m_usesSectionSizes)
+    {}
+
+    Expression(Expression const & copy, allocator_type const & allocator)
+        : m_ops(copy.m_ops, allocator)
+        , m_labels(copy.m_labels, allocator)
+        , m_usesSectionSizes(copy.m_usesSectionSizes)
+    {}
+
+    Expression(Expression &&) = default;
+    Expression(Expression const &) = default;
+    Expression & operator=(Expression &&) = default;
+    Expression & operator=(Expression const &) = default;
+
+    /**
+      \brief Parses an expression from the given text, replacing the contents
+             of this expression.
+      \param[in] text The text of the expression, including the enclosing
+                      parentheses.
+      \returns whether parsing succeeded, which fails if parentheses are
+               nested deeper than maxNestingDepth.
+    */
+    bool parse(char const * text, std::size_t length);
+
+    /**
+      \brief Replaces the contents of this expression with the given ops and
+             label references, e.g. of a serialized expression.
+      \returns whether the ops form a valid expression, otherwise the
+               expression is left empty.
+    */
+    bool assign(std::pmr::vector<Op> ops,
+                std::pmr::vector<LabelReference> labels);
+
+    void clear() noexcept {
+        m_ops.clear();
+        m_labels.clear();
+        m_usesSectionSizes = false;
+    }
+
+    std::pmr::vector<Op> const & ops() const noexcept { return m_ops; }
+
+    std::pmr::vector<LabelReference> & labels() noexcept { return m_labels; }
+    std::pmr::vector<LabelReference> const & labels() const noexcept
+    { return m_labels; }
+
+    bool usesSectionSizes() const noexcept { return m_usesSectionSizes; }
+
+    /**
+      \brief Evaluates the expression.
+      \param[out] result Where to write the result on success.
+      \param[in] sectionSize A function which given a SectionType and a
+                             std::uint64_t & returns whether the size of the
+                             section is known, writing it into the latter.
+    */
+    template <typename SectionSizeFunction>
+    EvaluationResult evaluate(std::uint64_t & result,
+                              SectionSizeFunction && sectionSize) const;
+
+    EvaluationResult evaluate(std::uint64_t & result) const {
+        return evaluate(result,
+                        [](SectionType, std::uint64_t &) noexcept
+                        { return false; });
+    }
+
+private: /* Methods: */
+
+    void emit(OpCode code, std::uint64_t value = 0u)
+    { m_ops.push_back(Op{code, value}); }
+
+    bool parseShift(char const * & c, char const * const e);
+    bool parseAdditive(char const * & c, char const * const e);
+    bool parseMultiplicative(char const * & c, char const * const e);
+    bool parseUnary(char const * & c, char const * const e);
+    bool parsePrimary(char const * & c, char const * const e);
+
+private: /* Fields: */
+
+    std::pmr::vector<Op> m_ops;
+    std::pmr::vector<LabelReference> m_labels;
+    bool m_usesSectionSizes = false;
+
+    /** The number of parentheses open while parsing. */
+    std::size_t m_nestingDepth = 0u;
+
+};
+
+template <typename SectionSizeFunction>
+Expression::EvaluationResult Expression::evaluate(
+        std::uint64_t & result,
+        SectionSizeFunction && sectionSize) const
+{
+    /* Expressions are short, hence a small fixed stack suffices for most: */
+    std::uint64_t smallStack[16u];
+    std::vector<std::uint64_t> largeStack;
+    std::uint64_t * stack = smallStack;
+    if (m_ops.size() > sizeof(smallStack) / sizeof(smallStack[0u])) {
+        largeStack.resize(m_ops.size());
+        stack = largeStack.data();
+    }
+    std::size_t top = 0u;
+
+    for (auto const & op : m_ops) {
+        switch (op.code) {
+            case OpCode::Constant:
+                stack[top++] = op.value;
+                break;
+            case OpCode::Label: {
+                auto const & label = m_labels[op.value];
+                if (!label.resolved)
+                    return EvaluationResult::Unresolved;
+                stack[top++] = label.value;
+                break;
+            }
+            case OpCode::SectionSize:
+                if (!sectionSize(static_cast<SectionType>(op.value),
+                                 stack[top]))
+                    return EvaluationResult::Unresolved;
+                ++top;
+                break;
+            case OpCode::Negate:
+                assert(top >= 1u);
+                stack[top - 1u] = -stack[top - 1u];
+                break;
+            default: {
+                assert(top >= 2u);
+                auto const rhs = stack[--top];
+                auto & lhs = stack[top - 1u];
+                switch (op.code) {
+                    case OpCode::Add: lhs += rhs; break;
+                    case OpCode::Subtract: lhs -= rhs; break;
+                    case OpCode::Multiply: lhs *= rhs; break;
+                    case OpCode::ShiftLeft:
+                        if (rhs >= 64u)
+                            return EvaluationResult::Invalid;
+                        lhs <<= rhs;
+                        break;
+                    default:
+                        assert(op.code == OpCode::ShiftRight);
+                        if (rhs >= 64u)
+                            return EvaluationResult::Invalid;
+                        lhs >>= rhs;
+                        break;
+                }
+                break;
+            }
+        }
+    }
+    assert(top == 1u);
+    result = stack[0u];
+    return EvaluationResult::Ok;
+}
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_EXPRESSION_H */
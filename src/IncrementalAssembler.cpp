@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "IncrementalAssembler.h"
+
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <new>
+#include <sharemind/AssertReturn.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "assemble.h"
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+struct Part {
+
+/* Fields: */
+
+    std::size_t begin;
+    std::size_t end;
+    Object::Successor successor;
+
+    /** Whether the part does not depend on the contents of other files. */
+    bool cacheable;
+
+};
+
+inline bool isSeparator(char const c) noexcept {
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\v')
+           || (c == '\f') || (c == '\n') || (c == '#');
+}
+
+/** \returns whether the given line starts with the given directive. */
+bool startsWithDirective(std::string_view const line,
+                         std::string_view const directive) noexcept
+{
+    return (line.compare(0u, directive.size(), directive) == 0)
+           && ((line.size() == directive.size())
+               || isSeparator(line[directive.size()]));
+}
+
+inline bool operator==(Object::Position const & lhs,
+                       Object::Position const & rhs) noexcept
+{
+    return (lhs.linkingUnit == rhs.linkingUnit)
+           && (lhs.section == rhs.section)
+           && (lhs.numLinkingUnits == rhs.numLinkingUnits);
+}
+
+/**
+  \brief Splits the given program into parts at the lines starting with a
+         non-local label or with a .section directive outside of .rept blocks.
+  \returns false if the program can only be assembled as a whole.
+*/
+bool splitProgram(std::string_view const program,
+                  std::pmr::vector<Part> & parts)
+{
+    /* Macros may be defined and used in different parts: */
+    if (program.find(".macro") != std::string_view::npos)
+        return false;
+
+    parts.clear();
+    std::size_t partBegin = 0u;
+    auto const addPart =
+            [&program, &parts, &partBegin](std::size_t const end,
+                                           Object::Successor const successor)
+            {
+                auto const text(program.substr(partBegin, end - partBegin));
+                bool const cacheable =
+                        (text.find(".include") == std::string_view::npos)
+                        && (text.find(".incbin") == std::string_view::npos);
+                parts.push_back(Part{partBegin, end, successor, cacheable});
+                partBegin = end;
+            };
+
+    std::size_t depth = 0u;
+    for (std::size_t lineBegin = 0u; lineBegin < program.size();) {
+        auto lineEnd = program.find('\n', lineBegin);
+        lineEnd = (lineEnd == std::string_view::npos)
+                  ? program.size()
+                  : lineEnd + 1u;
+        auto line(program.substr(lineBegin, lineEnd - lineBegin));
+        while (!line.empty() && isSeparator(line.front())
+               && (line.front() != '#'))
+            line.remove_prefix(1u);
+
+        if (!depth && (lineBegin != partBegin)) {
+            if ((line.size() >= 2u)
+                && (line[0u] == ':')
+                && (line[1u] != '.'))
+            {
+                addPart(lineBegin, Object::Successor::Label);
+            } else if (startsWithDirective(line, ".section")) {
+                addPart(lineBegin, Object::Successor::Other);
+            }
+        }
+        if (startsWithDirective(line, ".rept")) {
+            ++depth;
+        } else if (depth && startsWithDirective(line, ".endr")) {
+            --depth;
+        }
+        lineBegin = lineEnd;
+    }
+    addPart(program.size(), Object::Successor::EndOfProgram);
+    return true;
+}
+
+} // anonymous namespace
+
+struct IncrementalAssembler::Inner {
+
+/* Types: */
+
+    struct CachedObject {
+
+    /* Fields: */
+
+        /** The text of the part, to tell apart parts with equal hashes. */
+        std::pmr::string text;
+
+        Object object;
+
+        /** The number of the last call to tryAssemble() using the object. */
+        std::uint64_t generation;
+
+    };
+
+/* Methods: */
+
+    Inner(std::pmr::memory_resource * const memoryResource)
+        : m_memoryResource(memoryResource)
+        , m_assembler(memoryResource)
+        , m_cache(memoryResource)
+        , m_parts(memoryResource)
+        , m_uncachedObjects(memoryResource)
+    {}
+
+    Object const * findObject(std::string_view const text,
+                              std::size_t const hash,
+                              Object::Position const & start,
+                              Object::Successor const successor)
+    {
+        auto const range(m_cache.equal_range(hash));
+        for (auto it = range.first; it != range.second; ++it) {
+            auto & cached = it->second;
+            if ((cached.object.start == start)
+                && (cached.object.successor == successor)
+                && (std::string_view(cached.text) == text))
+            {
+                cached.generation = m_generation;
+                return &cached.object;
+            }
+        }
+        return nullptr;
+    }
+
+    /**
+      \brief Assembles the program in parts, reusing the cached objects of the
+             parts which did not change.
+      \returns false if the program has to be assembled as a whole.
+    */
+    bool assembleParts(char const * program,
+                       std::size_t length,
+                       Options const & options,
+                       Executable & exe);
+
+/* Fields: */
+
+    std::pmr::memory_resource * const m_memoryResource;
+    Assembler m_assembler;
+    std::pmr::unordered_multimap<std::size_t, CachedObject> m_cache;
+    std::uint64_t m_generation = 0u;
+    std::pmr::vector<Part> m_parts;
+    std::vector<Object const *> m_objects;
+    std::pmr::deque<Object> m_uncachedObjects;
+    std::size_t m_numParts = 0u;
+    std::size_t m_numAssembledParts = 0u;
+
+};
+
+bool IncrementalAssembler::Inner::assembleParts(char const * const program,
+                                                std::size_t const length,
+                                                Options const & options,
+                                                Executable & exe)
+{
+    m_numParts = 0u;
+    m_numAssembledParts = 0u;
+    if (options.maxPendingRelocations
+        || options.optimizes()
+        || options.alignData)
+        return false;
+    std::string_view const text(program, length);
+    if (!splitProgram(text, m_parts))
+        return false;
+
+    ++m_generation;
+    m_objects.clear();
+    m_uncachedObjects.clear();
+    Object::Position position;
+    std::size_t numTokens = 0u;
+    for (std::size_t i = 0u; i < m_parts.size(); ++i) {
+        auto const begin = m_parts[i].begin;
+        bool cacheable = m_parts[i].cacheable;
+        std::size_t numLabels = 1u;
+        Object const * object;
+        for (;;) {
+            auto const & part = m_parts[i];
+            auto const partText(text.substr(begin, part.end - begin));
+            auto const hash = std::hash<std::string_view>()(partText);
+            object = cacheable
+                     ? findObject(partText, hash, position, part.successor)
+                     : nullptr;
+            if (!object) {
+                ++m_numAssembledParts;
+                auto r(m_assembler.tryAssembleObject(partText.data(),
+                                                     partText.size(),
+                                                     position,
+                                                     part.successor,
+                                                     options));
+                if (!r)
+                    return false;
+                if (cacheable) {
+                    object = &m_cache.emplace(
+                                hash,
+                                CachedObject{
+                                    std::pmr::string(partText,
+                                                     m_memoryResource),
+                                    std::move(*r),
+                                    m_generation})->second.object;
+                } else {
+                    m_uncachedObjects.emplace_back(std::move(*r));
+                    object = &m_uncachedObjects.back();
+                }
+            }
+
+            /* Local labels may not be split from their scope, hence such
+               parts are assembled together with the following parts, up to a
+               non-local label which may end the scope. The number of such
+               labels included is doubled on every attempt: */
+            if (!object->localScopeOpen)
+                break;
+            for (auto n = numLabels; n; --n) {
+                do {
+                    assert(i + 1u < m_parts.size());
+                    ++i;
+                    cacheable = cacheable && m_parts[i].cacheable;
+                } while (m_parts[i].successor == Object::Successor::Other);
+                if (m_parts[i].successor == Object::Successor::EndOfProgram)
+                    break;
+            }
+            numLabels *= 2u;
+        }
+
+        /* The linker aligns the start of aligned sections of later parts,
+           which assembling the program as a whole does not: */
+        if (!m_objects.empty() && !object->alignments.empty())
+            return false;
+
+        numTokens += object->numTokens;
+        if (options.maxTokens && (numTokens > options.maxTokens))
+            return false;
+        m_objects.push_back(object);
+        position = object->end;
+    }
+    m_numParts = m_objects.size();
+
+    /* Forget the parts which no longer exist: */
+    for (auto it = m_cache.begin(); it != m_cache.end();) {
+        if (it->second.generation != m_generation) {
+            it = m_cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    /* Empty programs are reported by the assembler: */
+    if (!numTokens)
+        return false;
+
+    auto r(link(m_objects, options, m_memoryResource));
+    m_objects.clear();
+    m_uncachedObjects.clear();
+    if (!r)
+        return false;
+    exe = std::move(*r);
+    return true;
+}
+
+IncrementalAssembler::IncrementalAssembler(
+        std::pmr::memory_resource * memoryResource)
+    : m_inner(new Inner(assertReturn(memoryResource)))
+{}
+
+IncrementalAssembler::IncrementalAssembler(IncrementalAssembler &&) noexcept
+        = default;
+IncrementalAssembler::~IncrementalAssembler() noexcept = default;
+IncrementalAssembler & IncrementalAssembler::operator=(
+        IncrementalAssembler &&) noexcept = default;
+
+Result<Executable> IncrementalAssembler::tryAssemble(
+        char const * program,
+        std::size_t length,
+        Options const & options) noexcept
+{
+    assert(program);
+    auto & inner = *assertReturn(m_inner);
+    try {
+        Executable exe;
+        if (inner.assembleParts(program, length, options, exe))
+            return Result<Executable>(std::move(exe));
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
+    }
+
+    /* Assemble the program as a whole for its canonical result or error: */
+    inner.m_numParts = 0u;
+    inner.m_numAssembledParts = 0u;
+    return inner.m_assembler.tryAssemble(program, length, options);
+}
+
+std::size_t IncrementalAssembler::numParts() const noexcept
+{ return assertReturn(m_inner)->m_numParts; }
+
+std::size_t IncrementalAssembler::numAssembledParts() const noexcept
+{ return assertReturn(m_inner)->m_numAssembledParts; }
+
+void IncrementalAssembler::clear() noexcept {
+    auto & inner = *assertReturn(m_inner);
+    inner.m_cache.clear();
+    inner.m_objects.clear();
+    inner.m_uncachedObjects.clear();
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_INCREMENTALASSEMBLER_H
+#define SHAREMIND_LIBAS_INCREMENTALASSEMBLER_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <sharemind/libexecutable/Executable.h>
+#include "Error.h"
+#include "Options.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief An assembler for successive versions of a program, which only
+         assembles the parts of the program which changed since the previous
+         version.
+
+  The program is split into parts at lines starting with a non-local label or
+  with a .section directive. Each part is assembled into an Object, which is
+  cached by the contents of the part and by the linking unit and section it
+  starts in. The objects are then linked into the executable. Parts which
+  include files are assembled every time.
+
+  Programs which define macros, which can not be assembled in parts, which
+  align data after their first part or which fail to assemble are assembled
+  as a whole, hence the results and errors are always those of
+  Assembler::tryAssemble().
+
+  \note Options::maxPendingRelocations is defined in terms of assembling the
+        whole program in one pass, hence programs are assembled as a whole if
+        it is set. Programs are also assembled as a whole if any optimization
+        is enabled, as optimizations apply to whole programs, and if
+        Options::alignData is set, as labels are aligned by the values
+        following them, which may be in the next part.
+  \note All memory for the cached objects and for the returned executables is
+        allocated from the memory resource given on construction. That
+        resource must outlive both the assembler and any executables
+        assembled by it.
+*/
+class IncrementalAssembler {
+
+public: /* Methods: */
+
+    IncrementalAssembler(std::pmr::memory_resource * memoryResource =
+                                 std::pmr::get_default_resource());
+    IncrementalAssembler(IncrementalAssembler &&) noexcept;
+    IncrementalAssembler(IncrementalAssembler const &) = delete;
+    ~IncrementalAssembler() noexcept;
+
+    IncrementalAssembler & operator=(IncrementalAssembler &&) noexcept;
+    IncrementalAssembler & operator=(IncrementalAssembler const &) = delete;
+
+    /**
+      \brief Tokenizes and assembles the given program like
+             Assembler::tryAssemble(), reusing the objects of the parts of the
+             program which did not change since the previous call.
+    */
+    Result<Executable> tryAssemble(char const * program,
+                                   std::size_t length,
+                                   Options const & options = Options())
+            noexcept;
+
+    /**
+      \returns the number of parts the program was split into by the last call
+               to tryAssemble(), or zero if it was assembled as a whole.
+    */
+    std::size_t numParts() const noexcept;
+
+    /**
+      \returns the number of parts assembled by the last call to tryAssemble(),
+               the objects of the other parts were reused.
+    */
+    std::size_t numAssembledParts() const noexcept;
+
+    /** \brief Removes all objects from the cache. */
+    void clear() noexcept;
+
+private: /* Fields: */
+
+    struct Inner;
+    std::unique_ptr<Inner> m_inner;
+
+};
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_INCREMENTALASSEMBLER_H */
@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "Object.h"
+
+#include <algorithm>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <utility>
+
+
+/*
+  The relocatable object format stores all integers in little-endian order:
+
+    magic        8 bytes "SMASOBJ\0"
+    version      uint64
+    start        Position
+    end          Position
+    successor    uint8
+    scopeOpen    uint8
+    numTokens    uint64
+    executable   uint64 size, followed by the serialized Executable
+    starts       uint64 count, for each linking unit a bit vector
+    symbols      uint64 count, for each: string name, uint64 offset,
+                 uint8 section, uint8 linking unit
+    relocations  uint64 count, for each: string label, uint64 addend,
+                 uint64 code index, uint64 jump offset, uint8 linking unit,
+                 uint8 isJump, uint64 token index (not present before
+                 version 3)
+    expressions  uint64 count, for each: uint64 op count, for each op uint8
+                 code and uint64 value; uint64 label count, for each label
+                 string name, uint8 resolved and uint64 value; uint8 linking
+                 unit, uint8 section, uint64 offset, uint64 multiplier, uint8
+                 data type, uint64 token index (not present before version 3)
+    alignments   uint64 count, for each: uint8 linking unit, uint8 section,
+                 uint64 alignment; not present in version 1
+
+  where a Position is an uint8 linking unit, an uint8 section and an uint64
+  number of linking units, a string is an uint64 size followed by the
+  characters, and a bit vector is an uint64 size followed by the bits packed
+  into bytes, least significant bit first.
+*/
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+using SectionType = Object::SectionType;
+
+constexpr char const objectMagic[8u] = {'S','M','A','S','O','B','J','\0'};
+constexpr std::uint64_t const objectFormatVersion = 3u;
+
+constexpr std::size_t const dataTypeWidths[8u] =
+        { 1u, 2u, 4u, 8u, 1u, 2u, 4u, 8u };
+
+void writeUint8(std::ostream & os, std::uint8_t const value)
+{ os.put(static_cast<char>(value)); }
+
+void writeUint64(std::ostream & os, std::uint64_t const value) {
+    char bytes[8u];
+    for (unsigned i = 0u; i < 8u; ++i)
+        bytes[i] = static_cast<char>(value >> (i * 8u));
+    os.write(bytes, sizeof(bytes));
+}
+
+void writeString(std::ostream & os, char const * data, std::size_t size) {
+    writeUint64(os, size);
+    os.write(data, static_cast<std::streamsize>(size));
+}
+
+void writePosition(std::ostream & os, Object::Position const & position) {
+    writeUint8(os, position.linkingUnit);
+    writeUint8(os, static_cast<std::uint8_t>(position.section));
+    writeUint64(os, position.numLinkingUnits);
+}
+
+bool readUint8(std::istream & is, std::uint8_t & value) {
+    char c;
+    if (!is.get(c))
+        return false;
+    value = static_cast<std::uint8_t>(c);
+    return true;
+}
+
+bool readUint64(std::istream & is, std::uint64_t & value) {
+    char bytes[8u];
+    if (!is.read(bytes, sizeof(bytes)))
+        return false;
+    value = 0u;
+    for (unsigned i = 8u; i;) {
+        --i;
+        value = (value << 8u) | static_cast<unsigned char>(bytes[i]);
+    }
+    return true;
+}
+
+template <typename T>
+bool readSize(std::istream & is, T & value) {
+    std::uint64_t v;
+    if (!readUint64(is, v) || (v > std::numeric_limits<T>::max()))
+        return false;
+    value = static_cast<T>(v);
+    return true;
+}
+
+/** Reads in chunks, so that corrupt sizes fail at the end of the input
+    instead of allocating the memory up front. */
+template <typename String>
+bool readString(std::istream & is, String & str) {
+    std::uint64_t size;
+    if (!readUint64(is, size))
+        return false;
+    str.clear();
+    while (size) {
+        auto const chunk = std::min<std::uint64_t>(size, 4096u);
+        auto const oldSize = str.size();
+        str.resize(oldSize + static_cast<std::size_t>(chunk));
+        if (!is.read(&str[oldSize], static_cast<std::streamsize>(chunk)))
+            return false;
+        size -= chunk;
+    }
+    return true;
+}
+
+bool readSectionType(std::istream & is, SectionType & section) {
+    std::uint8_t value;
+    if (!readUint8(is, value))
+        return false;
+    section = static_cast<SectionType>(value);
+    return value < static_cast<std::uint8_t>(SectionType::Count);
+}
+
+/** Token indexes only locate errors, hence indexes which do not fit are
+    read as unknown. */
+bool readTokenIndex(std::istream & is, std::size_t & tokenIndex) {
+    std::uint64_t v;
+    if (!readUint64(is, v))
+        return false;
+    tokenIndex = (v > std::numeric_limits<std::size_t>::max())
+                 ? Object::noToken
+                 : static_cast<std::size_t>(v);
+    return true;
+}
+
+bool readPosition(std::istream & is, Object::Position & position) {
+    return readUint8(is, position.linkingUnit)
+           && readSectionType(is, position.section)
+           && readSize(is, position.numLinkingUnits)
+           && (position.linkingUnit < position.numLinkingUnits);
+}
+
+std::size_t sectionSize(Executable::LinkingUnit const & lu,
+                        SectionType const sectionType) noexcept
+{
+    switch (sectionType) {
+        case SectionType::Text:
+            return lu.textSection ? lu.textSection->instructions.size() : 0u;
+        case SectionType::RoData:
+            return lu.roDataSection ? lu.roDataSection->sizeInBytes : 0u;
+        case SectionType::Data:
+            return lu.rwDataSection ? lu.rwDataSection->sizeInBytes : 0u;
+        case SectionType::Bss:
+            return lu.bssSection ? lu.bssSection->sizeInBytes : 0u;
+        case SectionType::Bind:
+            return lu.syscallBindingsSection
+                   ? lu.syscallBindingsSection->syscallBindings.size()
+                   : 0u;
+        case SectionType::PdBind:
+            return lu.pdBindingsSection
+                   ? lu.pdBindingsSection->pdBindings.size()
+                   : 0u;
+        default:
+            return lu.debugSection ? lu.debugSection->sizeInBytes : 0u;
+    }
+}
+
+/** \returns whether all references of the object are within its sections. */
+bool checkObject(Object const & object) {
+    auto const & lus = object.executable.linkingUnits;
+    if ((object.start.numLinkingUnits > lus.size())
+        || (object.end.numLinkingUnits != lus.size())
+        || (object.instructionStarts.size() != lus.size()))
+        return false;
+    for (std::size_t i = 0u; i < lus.size(); ++i)
+        if (object.instructionStarts[i].size()
+            != sectionSize(lus[i], SectionType::Text))
+            return false;
+
+    for (auto const & symbol : object.symbols)
+        if (symbol.name.empty()
+            || (symbol.linkingUnit >= lus.size())
+            || (symbol.offset > sectionSize(lus[symbol.linkingUnit],
+                                            symbol.section)))
+            return false;
+
+    for (auto const & r : object.relocations) {
+        if (r.label.empty() || (r.linkingUnit >= lus.size()))
+            return false;
+        auto const textSize = sectionSize(lus[r.linkingUnit],
+                                          SectionType::Text);
+        if ((r.codeIndex >= textSize) || (r.jumpOffset > textSize))
+            return false;
+    }
+
+    for (auto const & p : object.expressions) {
+        if ((p.linkingUnit >= lus.size()) || (p.dataType >= 8u))
+            return false;
+        for (auto const & label : p.expression.labels())
+            if (!label.resolved && label.name.empty())
+                return false;
+        auto const size = sectionSize(lus[p.linkingUnit], p.section);
+        switch (p.section) {
+            case SectionType::Text:
+                if (p.offset >= size)
+                    return false;
+                break;
+            case SectionType::RoData:
+            case SectionType::Data:
+            case SectionType::Debug: {
+                auto const width = dataTypeWidths[p.dataType];
+                if ((p.offset > size)
+                    || (p.multiplier > (size - p.offset) / width))
+                    return false;
+                break;
+            }
+            case SectionType::Bss:
+                break;
+            default:
+                return false;
+        }
+    }
+
+    for (auto const & a : object.alignments)
+        if ((a.linkingUnit >= lus.size())
+            || ((a.section != SectionType::RoData)
+                && (a.section != SectionType::Data)
+                && (a.section != SectionType::Bss))
+            || (a.alignment < 2u)
+            || (a.alignment > Object::Alignment::maxAlignment)
+            || (a.alignment & (a.alignment - 1u)))
+            return false;
+    return true;
+}
+
+bool readObject(std::istream & is, Object & object) {
+    char magic[sizeof(objectMagic)];
+    std::uint64_t version;
+    if (!is.read(magic, sizeof(magic))
+        || !std::equal(magic, magic + sizeof(magic), objectMagic)
+        || !readUint64(is, version)
+        || !version
+        || (version > objectFormatVersion))
+        return false;
+
+    std::uint8_t successor;
+    std::uint8_t localScopeOpen;
+    if (!readPosition(is, object.start)
+        || !readPosition(is, object.end)
+        || !readUint8(is, successor)
+        || (successor > static_cast<std::uint8_t>(Object::Successor::Other))
+        || !readUint8(is, localScopeOpen)
+        || (localScopeOpen > 1u)
+        || !readSize(is, object.numTokens))
+        return false;
+    object.successor = static_cast<Object::Successor>(successor);
+    object.localScopeOpen = localScopeOpen;
+
+    {
+        std::string serialized;
+        if (!readString(is, serialized))
+            return false;
+        std::istringstream iss(std::move(serialized));
+        if (!(iss >> object.executable))
+            return false;
+    }
+
+    std::uint64_t count;
+    if (!readUint64(is, count))
+        return false;
+    for (; count; --count) {
+        std::uint64_t size;
+        if (!readUint64(is, size))
+            return false;
+        std::vector<bool> starts;
+        for (std::uint64_t i = 0u; i < size; i += 8u) {
+            std::uint8_t bits;
+            if (!readUint8(is, bits))
+                return false;
+            for (unsigned j = 0u; (j < 8u) && (i + j < size); ++j)
+                starts.push_back((bits >> j) & 1u);
+        }
+        object.instructionStarts.emplace_back(std::move(starts));
+    }
+
+    if (!readUint64(is, count))
+        return false;
+    for (; count; --count) {
+        Object::Symbol symbol;
+        if (!readString(is, symbol.name)
+            || !readSize(is, symbol.offset)
+            || !readSectionType(is, symbol.section)
+            || !readUint8(is, symbol.linkingUnit))
+            return false;
+        object.symbols.emplace_back(std::move(symbol));
+    }
+
+    if (!readUint64(is, count))
+        return false;
+    for (; count; --count) {
+        Object::Relocation r;
+        std::uint64_t addend;
+        std::uint8_t isJump;
+        if (!readString(is, r.label)
+            || !readUint64(is, addend)
+            || !readSize(is, r.codeIndex)
+            || !readSize(is, r.jumpOffset)
+            || !readUint8(is, r.linkingUnit)
+            || !readUint8(is, isJump)
+            || (isJump > 1u)
+            || ((version >= 3u) && !readTokenIndex(is, r.tokenIndex)))
+            return false;
+        r.addend = static_cast<std::int64_t>(addend);
+        r.isJump = isJump;
+        object.relocations.emplace_back(std::move(r));
+    }
+
+    if (!readUint64(is, count))
+        return false;
+    for (; count; --count) {
+        std::uint64_t numOps;
+        if (!readUint64(is, numOps))
+            return false;
+        std::pmr::vector<Expression::Op> ops;
+        for (; numOps; --numOps) {
+            std::uint8_t code;
+            Expression::Op op;
+            if (!readUint8(is, code) || !readUint64(is, op.value))
+                return false;
+            op.code = static_cast<Expression::OpCode>(code);
+            ops.push_back(op);
+        }
+        std::uint64_t numLabels;
+        if (!readUint64(is, numLabels))
+            return false;
+        std::pmr::vector<Expression::LabelReference> labels;
+        for (; numLabels; --numLabels) {
+            std::pmr::string name;
+            std::uint8_t resolved;
+            if (!readString(is, name)
+                || !readUint8(is, resolved)
+                || (resolved > 1u))
+                return false;
+            labels.emplace_back(std::move(name));
+            labels.back().resolved = resolved;
+            if (!readUint64(is, labels.back().value))
+                return false;
+        }
+        Object::PendingExpression p;
+        std::uint8_t dataType;
+        if (!p.expression.assign(std::move(ops), std::move(labels))
+            || !readUint8(is, p.linkingUnit)
+            || !readSectionType(is, p.section)
+            || !readSize(is, p.offset)
+            || !readSize(is, p.multiplier)
+            || !readUint8(is, dataType)
+            || ((version >= 3u) && !readTokenIndex(is, p.tokenIndex)))
+            return false;
+        p.dataType = dataType;
+        object.expressions.emplace_back(std::move(p));
+    }
+
+    if (version >= 2u) {
+        if (!readUint64(is, count))
+            return false;
+        for (; count; --count) {
+            Object::Alignment a;
+            if (!readUint8(is, a.linkingUnit)
+                || !readSectionType(is, a.section)
+                || !readSize(is, a.alignment))
+                return false;
+            object.alignments.push_back(a);
+        }
+    }
+    return checkObject(object);
+}
+
+} // anonymous namespace
+
+std::ostream & operator<<(std::ostream & os, Object const & object) {
+    os.write(objectMagic, sizeof(objectMagic));
+    writeUint64(os, objectFormatVersion);
+    writePosition(os, object.start);
+    writePosition(os, object.end);
+    writeUint8(os, static_cast<std::uint8_t>(object.successor));
+    writeUint8(os, object.localScopeOpen);
+    writeUint64(os, object.numTokens);
+
+    {
+        std::ostringstream oss;
+        oss << object.executable;
+        auto const serialized(oss.str());
+        writeString(os, serialized.data(), serialized.size());
+    }
+
+    writeUint64(os, object.instructionStarts.size());
+    for (auto const & starts : object.instructionStarts) {
+        writeUint64(os, starts.size());
+        for (std::size_t i = 0u; i < starts.size(); i += 8u) {
+            std::uint8_t bits = 0u;
+            for (unsigned j = 0u; (j < 8u) && (i + j < starts.size()); ++j)
+                if (starts[i + j])
+                    bits |= static_cast<std::uint8_t>(1u << j);
+            writeUint8(os, bits);
+        }
+    }
+
+    writeUint64(os, object.symbols.size());
+    for (auto const & symbol : object.symbols) {
+        writeString(os, symbol.name.data(), symbol.name.size());
+        writeUint64(os, symbol.offset);
+        writeUint8(os, static_cast<std::uint8_t>(symbol.section));
+        writeUint8(os, symbol.linkingUnit);
+    }
+
+    writeUint64(os, object.relocations.size());
+    for (auto const & r : object.relocations) {
+        writeString(os, r.label.data(), r.label.size());
+        writeUint64(os, static_cast<std::uint64_t>(r.addend));
+        writeUint64(os, r.codeIndex);
+        writeUint64(os, r.jumpOffset);
+        writeUint8(os, r.linkingUnit);
+        writeUint8(os, r.isJump);
+        writeUint64(os, r.tokenIndex);
+    }
+
+    writeUint64(os, object.expressions.size());
+    for (auto const & p : object.expressions) {
+        auto const & ops = p.expression.ops();
+        writeUint64(os, ops.size());
+        for (auto const & op : ops) {
+            writeUint8(os, static_cast<std::uint8_t>(op.code));
+            writeUint64(os, op.value);
+        }
+        auto const & labels = p.expression.labels();
+        writeUint64(os, labels.size());
+        for (auto const & label : labels) {
+            writeString(os, label.name.data(), label.name.size());
+            writeUint8(os, label.resolved);
+            writeUint64(os, label.value);
+        }
+        writeUint8(os, p.linkingUnit);
+        writeUint8(os, static_cast<std::uint8_t>(p.section));
+        writeUint64(os, p.offset);
+        writeUint64(os, p.multiplier);
+        writeUint8(os, static_cast<std::uint8_t>(p.dataType));
+        writeUint64(os, p.tokenIndex);
+    }
+
+    writeUint64(os, object.alignments.size());
+    for (auto const & a : object.alignments) {
+        writeUint8(os, a.linkingUnit);
+        writeUint8(os, static_cast<std::uint8_t>(a.section));
+        writeUint64(os, a.alignment);
+    }
+    return os;
+}
+
+std::istream & operator>>(std::istream & is, Object & object) {
+    Object r;
+    bool success;
+    try {
+        success = readObject(is, r);
+    } catch (...) { /* E.g. corrupt sizes in the executable */
+        success = false;
+    }
+    if (success) {
+        object = std::move(r);
+    } else {
+        is.setstate(std::istream::failbit);
+    }
+    return is;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_OBJECT_H
+#define SHAREMIND_LIBAS_OBJECT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <limits>
+#include <sharemind/libexecutable/Executable.h>
+#include <sharemind/libexecutable/libexecutable_0x0.h>
+#include <string>
+#include <vector>
+#include "Expression.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief A part of a program assembled without resolving the labels it uses,
+         to be linked with the other parts of the program by link().
+
+  The sections of the object start at offset zero. Label uses and expressions
+  which could not be evaluated are written as zeroes into the sections and are
+  recorded as relocations and pending expressions instead.
+*/
+struct Object {
+
+/* Constants: */
+
+    /** The token index of label uses whose tokens are not known. */
+    static constexpr std::size_t const noToken =
+            std::numeric_limits<std::size_t>::max();
+
+/* Types: */
+
+    using SectionType = ExecutableSectionHeader0x0::SectionType;
+
+    /** The linking unit and section at a boundary between parts. */
+    struct Position {
+
+    /* Fields: */
+
+        std::uint8_t linkingUnit = 0u;
+        SectionType section = SectionType::Text;
+        std::size_t numLinkingUnits = 1u;
+
+    };
+
+    /** What follows the part in the program. */
+    enum class Successor {
+        EndOfProgram,
+        Label, /* A line starting with a non-local label. */
+        Other
+    };
+
+    /** A label defined by the object. */
+    struct Symbol {
+
+    /* Fields: */
+
+        /** The name of the label. Local labels are suffixed with '@' and the
+            index of their scope in the object. */
+        std::string name;
+        std::size_t offset;
+        SectionType section;
+        std::uint8_t linkingUnit;
+
+    };
+
+    /** A use of a label as an argument of an instruction. */
+    struct Relocation {
+
+    /* Fields: */
+
+        std::string label;
+        std::int64_t addend;
+
+        /** The index of the code block to write the value of the label to. */
+        std::size_t codeIndex;
+
+        /** For relative jumps, the index of the code block to jump from. */
+        std::size_t jumpOffset;
+
+        std::uint8_t linkingUnit;
+        bool isJump;
+
+        /** The index of the token of the use in the tokens assembled, or
+            noToken if it is in an included file. */
+        std::size_t tokenIndex = noToken;
+
+    };
+
+    /** An expression to evaluate once all labels and section sizes are
+        known. */
+    struct PendingExpression {
+
+    /* Fields: */
+
+        Expression expression;
+        std::uint8_t linkingUnit;
+        SectionType section;
+        std::size_t offset; /* Code block index or byte offset */
+        std::size_t multiplier;
+        std::uint_fast8_t dataType;
+
+        /** The index of the token of the expression in the tokens assembled,
+            or noToken if it is in an included file. */
+        std::size_t tokenIndex = noToken;
+
+    };
+
+    /** The alignment required by a data section of the object, which its
+        start is padded to when linking. */
+    struct Alignment {
+
+    /* Constants: */
+
+        /** The largest alignment allowed by .align. */
+        static constexpr std::size_t const maxAlignment = 65536u;
+
+    /* Fields: */
+
+        std::uint8_t linkingUnit;
+        SectionType section;
+
+        /** A power of two greater than 1. */
+        std::size_t alignment;
+
+    };
+
+/* Fields: */
+
+    /** The position the part starts at. */
+    Position start;
+
+    /** The position the part ends at. */
+    Position end;
+
+    Successor successor = Successor::EndOfProgram;
+
+    /**
+      Whether the scope of the local labels at the end of the part continues
+      into the next part. Such objects can not be linked, instead the part has
+      to be assembled together with the next part.
+    */
+    bool localScopeOpen = false;
+
+    /** The number of tokens assembled, including the tokens of included files
+        and expansions. */
+    std::size_t numTokens = 0u;
+
+    Executable executable;
+
+    /** For each linking unit, which code blocks of the TEXT section start an
+        instruction. */
+    std::vector<std::vector<bool> > instructionStarts;
+
+    std::vector<Symbol> symbols;
+    std::vector<Relocation> relocations;
+    std::vector<PendingExpression> expressions;
+
+    /** At most one alignment per section, for the sections using .align or
+        aligned by Options::alignData. */
+    std::vector<Alignment> alignments;
+
+};
+
+/**
+  \brief Writes the given object to the given stream in the relocatable object
+         format, so that it can be linked without assembling it again.
+*/
+std::ostream & operator<<(std::ostream & os, Object const & object);
+
+/**
+  \brief Reads an object in the relocatable object format from the given
+         stream.
+
+  The object is checked to only refer to linking units, sections and offsets
+  which exist in it, so that objects read from untrusted sources can be linked
+  safely. On failure, including when reading the executable throws, the
+  failbit of the stream is set and the object is left unchanged.
+*/
+std::istream & operator>>(std::istream & is, Object & object);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_OBJECT_H */
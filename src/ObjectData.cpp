@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "ObjectData.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <memory>
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+std::shared_ptr<Executable::DataSection> * dataSection(
+        Object & object,
+        std::uint8_t const linkingUnit,
+        Object::SectionType const section) noexcept
+{
+    auto & lus = object.executable.linkingUnits;
+    if (linkingUnit >= lus.size())
+        return nullptr;
+    switch (section) {
+        case Object::SectionType::RoData:
+            return &lus[linkingUnit].roDataSection;
+        case Object::SectionType::Data:
+            return &lus[linkingUnit].rwDataSection;
+        default:
+            return nullptr;
+    }
+}
+
+} // anonymous namespace
+
+ObjectData::ObjectData(Object & object,
+                       std::uint8_t const linkingUnit,
+                       SectionType const section)
+    : m_object(object)
+    , m_linkingUnit(linkingUnit)
+    , m_section(section)
+{
+    assert((section == SectionType::RoData)
+           || (section == SectionType::Data));
+    for (std::size_t i = 0u; i < object.symbols.size(); ++i)
+        m_symbols.emplace(object.symbols[i].name, i);
+}
+
+std::size_t ObjectData::size() const noexcept {
+    auto const * const s = dataSection(m_object, m_linkingUnit, m_section);
+    return (s && *s) ? (*s)->sizeInBytes : 0u;
+}
+
+std::size_t ObjectData::alignment() const noexcept {
+    for (auto const & a : m_object.alignments)
+        if ((a.linkingUnit == m_linkingUnit) && (a.section == m_section))
+            return a.alignment;
+    return 1u;
+}
+
+char const * ObjectData::data() const noexcept {
+    auto const * const s = dataSection(m_object, m_linkingUnit, m_section);
+    return (s && *s) ? static_cast<char const *>((*s)->data.get()) : nullptr;
+}
+
+Object::Symbol const * ObjectData::symbol(std::string_view const name)
+        const noexcept
+{
+    auto const it(m_symbols.find(name));
+    return (it != m_symbols.end()) ? &m_object.symbols[it->second] : nullptr;
+}
+
+std::vector<std::size_t> ObjectData::symbolOffsets() const {
+    std::vector<std::size_t> r;
+    for (auto const & symbol : m_object.symbols)
+        if (contains(symbol))
+            r.push_back(symbol.offset);
+    std::sort(r.begin(), r.end());
+    r.erase(std::unique(r.begin(), r.end()), r.end());
+    return r;
+}
+
+void ObjectData::remove(std::size_t const begin, std::size_t const end) {
+    assert(begin <= end);
+    assert(end <= size());
+    if (begin < end)
+        m_removed.emplace_back(begin, end);
+}
+
+void ObjectData::redirect(std::size_t const begin,
+                          std::size_t const end,
+                          std::size_t const to)
+{
+    assert(to + (end - begin) <= size());
+    if (begin < end) {
+        m_removed.emplace_back(begin, end);
+        m_redirects.emplace_back(begin, end, to);
+    }
+}
+
+std::size_t ObjectData::rangeBefore(std::size_t const offset) const noexcept {
+    auto const it(std::upper_bound(
+                      m_removed.begin(),
+                      m_removed.end(),
+                      offset,
+                      [](std::size_t const o, auto const & range) noexcept
+                      { return o < range.first; }));
+    return static_cast<std::size_t>(it - m_removed.begin());
+}
+
+bool ObjectData::isRemoved(std::size_t const offset) const noexcept {
+    auto const i = rangeBefore(offset);
+    return i && (offset < m_removed[i - 1u].second);
+}
+
+std::size_t ObjectData::newOffset(std::size_t const offset) const noexcept {
+    auto const i = rangeBefore(offset);
+    if (!i)
+        return offset;
+    auto const & range = m_removed[i - 1u];
+    auto const removed = m_removedBefore[i - 1u];
+    if (offset < range.second)
+        return range.first - removed;
+    return offset - removed - (range.second - range.first);
+}
+
+std::size_t ObjectData::mappedOffset(std::size_t offset) const noexcept {
+    /* The bytes redirected to may have been redirected again: */
+    std::size_t n = 0u;
+    for (; n <= m_redirects.size(); ++n) {
+        auto const it(std::upper_bound(
+                          m_redirects.begin(),
+                          m_redirects.end(),
+                          offset,
+                          [](std::size_t const o, auto const & redirect)
+                                  noexcept
+                          { return o < std::get<0u>(redirect); }));
+        if (it == m_redirects.begin())
+            break;
+        auto const & redirect = *(it - 1);
+        if (offset >= std::get<1u>(redirect))
+            break;
+        offset = std::get<2u>(redirect) + (offset - std::get<0u>(redirect));
+    }
+    /* Bytes redirected to are kept, other removed bytes map to the end of
+       the bytes kept before them: */
+    assert(!n || !isRemoved(offset));
+    return newOffset(offset);
+}
+
+void ObjectData::commit() {
+    if (m_removed.empty())
+        return;
+
+    /* Sort and merge the ranges: */
+    std::sort(m_removed.begin(), m_removed.end());
+    std::size_t n = 0u;
+    for (std::size_t i = 1u; i < m_removed.size(); ++i) {
+        if (m_removed[i].first <= m_removed[n].second) {
+            m_removed[n].second = std::max(m_removed[n].second,
+                                           m_removed[i].second);
+        } else {
+            m_removed[++n] = m_removed[i];
+        }
+    }
+    m_removed.resize(n + 1u);
+    std::sort(m_redirects.begin(), m_redirects.end());
+    m_removedBefore.resize(m_removed.size());
+    std::size_t removed = 0u;
+    for (std::size_t i = 0u; i < m_removed.size(); ++i) {
+        m_removedBefore[i] = removed;
+        removed += m_removed[i].second - m_removed[i].first;
+    }
+
+    auto const oldSize = size();
+
+    /* Adjust the addends of labels with offsets into the section, before the
+       symbols are moved: */
+    for (auto & r : m_object.relocations) {
+        if (!r.addend)
+            continue;
+        auto const * const s = symbol(r.label);
+        if (!s || !contains(*s))
+            continue;
+        auto const target = static_cast<std::int64_t>(s->offset) + r.addend;
+        if ((target < 0) || (static_cast<std::uint64_t>(target) > oldSize))
+            continue;
+        r.addend = static_cast<std::int64_t>(
+                        mappedOffset(static_cast<std::size_t>(target)))
+                   - static_cast<std::int64_t>(mappedOffset(s->offset));
+    }
+
+    auto & expressions = m_object.expressions;
+    expressions.erase(
+                std::remove_if(
+                    expressions.begin(),
+                    expressions.end(),
+                    [this](Object::PendingExpression & p) {
+                        if ((p.linkingUnit != m_linkingUnit)
+                            || (p.section != m_section))
+                            return false;
+                        if (isRemoved(p.offset))
+                            return true;
+                        p.offset = newOffset(p.offset);
+                        return false;
+                    }),
+                expressions.end());
+
+    for (auto & symbol : m_object.symbols)
+        if (contains(symbol) && (symbol.offset <= oldSize))
+            symbol.offset = mappedOffset(symbol.offset);
+
+    /* The data may be shared with other sections, hence it is copied: */
+    auto & section = *dataSection(m_object, m_linkingUnit, m_section);
+    auto const newSize = newOffset(oldSize);
+    if (!newSize) {
+        section.reset();
+    } else {
+        std::shared_ptr<char> data(new char[newSize],
+                                   std::default_delete<char[]>());
+        auto const * const in = static_cast<char const *>(section->data.get());
+        auto * out = data.get();
+        std::size_t from = 0u;
+        for (auto const & range : m_removed) {
+            std::memcpy(out, in + from, range.first - from);
+            out += range.first - from;
+            from = range.second;
+        }
+        std::memcpy(out, in + from, oldSize - from);
+        section = std::make_shared<Executable::DataSection>(
+                    std::shared_ptr<void>(data, data.get()),
+                    newSize);
+    }
+    m_removed.clear();
+    m_removedBefore.clear();
+    m_redirects.clear();
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_OBJECTDATA_H
+#define SHAREMIND_LIBAS_OBJECTDATA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Object.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief A RODATA or DATA section of a linking unit of an object, from which
+         ranges of bytes can be removed while keeping the symbols, relocations
+         and pending expressions of the object consistent.
+
+  \note The data is assumed to be accessed only through the labels referring
+        to it, i.e. a label refers to the bytes up to the next label.
+*/
+class ObjectData {
+
+public: /* Types: */
+
+    using SectionType = Object::SectionType;
+
+public: /* Methods: */
+
+    ObjectData(Object & object, std::uint8_t linkingUnit, SectionType section);
+
+    Object & object() const noexcept { return m_object; }
+    std::uint8_t linkingUnit() const noexcept { return m_linkingUnit; }
+    SectionType section() const noexcept { return m_section; }
+
+    std::size_t size() const noexcept;
+
+    /**
+      \returns the alignment the object records for the section, or 1. Bytes
+               should not be removed from aligned sections, as that would move
+               the data after them off its alignment.
+    */
+    std::size_t alignment() const noexcept;
+    char const * data() const noexcept;
+
+    /** \returns whether the given symbol is defined in this section. */
+    bool contains(Object::Symbol const & symbol) const noexcept {
+        return (symbol.section == m_section)
+               && (symbol.linkingUnit == m_linkingUnit);
+    }
+
+    /** \returns the symbol with the given name, or null if there is none. */
+    Object::Symbol const * symbol(std::string_view name) const noexcept;
+
+    /**
+      \returns the distinct offsets of the symbols in this section in
+               ascending order, which split the section into blocks.
+    */
+    std::vector<std::size_t> symbolOffsets() const;
+
+    /** \brief Marks the given range of bytes to be removed by commit(). */
+    void remove(std::size_t begin, std::size_t end);
+
+    /**
+      \brief Marks the given range of bytes to be removed by commit(), with
+             the symbols in it moved to the equal bytes at the given offset,
+             which must be kept or be redirected themselves.
+    */
+    void redirect(std::size_t begin, std::size_t end, std::size_t to);
+
+    /**
+      \brief Removes the marked ranges from the section.
+
+      Symbols in removed ranges move to the end of the bytes kept before them,
+      or to where the ranges were redirected to. Pending expressions in
+      removed ranges are dropped, and the offsets of the others and the
+      addends of labels in the section are adjusted.
+    */
+    void commit();
+
+private: /* Methods: */
+
+    /** \returns the number of removed ranges starting at or before the given
+                 offset. */
+    std::size_t rangeBefore(std::size_t offset) const noexcept;
+
+    /** \returns the offset of the given byte after commit(), where removed
+                 bytes map to the end of the bytes kept before them. */
+    std::size_t newOffset(std::size_t offset) const noexcept;
+
+    /** \returns whether the byte at the given offset is removed. */
+    bool isRemoved(std::size_t offset) const noexcept;
+
+    /** \returns newOffset() of the given byte, or of the byte it is
+                 redirected to, following redirects of redirected bytes. */
+    std::size_t mappedOffset(std::size_t offset) const noexcept;
+
+private: /* Fields: */
+
+    Object & m_object;
+    std::uint8_t const m_linkingUnit;
+    SectionType const m_section;
+
+    /** The ranges to remove, sorted and merged by commit(). */
+    std::vector<std::pair<std::size_t, std::size_t> > m_removed;
+
+    /** For each range, the number of bytes removed before it. */
+    std::vector<std::size_t> m_removedBefore;
+
+    /** The redirected ranges as begin, end and target offsets, sorted by
+        commit(). */
+    std::vector<std::tuple<std::size_t, std::size_t, std::size_t> >
+            m_redirects;
+
+    /** The symbols of the object by name. */
+    std::unordered_map<std::string_view, std::size_t> m_symbols;
+
+};
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_OBJECTDATA_H */
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "ObjectText.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sharemind/libvmi/instr.h>
+#include <string>
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+using SectionType = Object::SectionType;
+
+/** \returns the entries of the instruction table by code. */
+std::unordered_map<std::uint64_t,
+                   std::pair<std::string const, Instruction> const *> const &
+instructionCodeMap() {
+    static auto const map(
+                []() {
+                    std::unordered_map<
+                            std::uint64_t,
+                            std::pair<std::string const,
+                                      Instruction> const *> r;
+                    for (auto const & p : instructionNameMap())
+                        r.emplace(p.second.code, &p);
+                    return r;
+                }());
+    return map;
+}
+
+} // anonymous namespace
+
+ObjectText::ObjectText(Object & object, std::uint8_t const linkingUnit)
+    : m_object(object)
+    , m_linkingUnit(linkingUnit)
+{
+    for (std::size_t i = 0u; i < object.symbols.size(); ++i)
+        m_symbols.emplace(object.symbols[i].name, i);
+    decode();
+}
+
+void ObjectText::decode() {
+    m_editable = false;
+    m_instructions.clear();
+    m_instructionAt.clear();
+    m_relocationAt.clear();
+    m_patched.clear();
+    m_removed.clear();
+    m_redirects.clear();
+    m_numRemoved = 0u;
+
+    auto & lus = m_object.executable.linkingUnits;
+    if ((m_linkingUnit >= lus.size()) || !lus[m_linkingUnit].textSection) {
+        m_text = nullptr;
+        return;
+    }
+    auto & text = lus[m_linkingUnit].textSection->instructions;
+    m_text = &text;
+    if (m_linkingUnit >= m_object.instructionStarts.size())
+        return;
+    auto const & starts = m_object.instructionStarts[m_linkingUnit];
+    if (starts.size() != text.size())
+        return;
+
+    m_instructionAt.assign(text.size(), npos);
+    m_patched.assign(text.size(), false);
+    auto const & relocations = m_object.relocations;
+    for (std::size_t i = 0u; i < relocations.size(); ++i) {
+        auto const & r = relocations[i];
+        if (r.linkingUnit != m_linkingUnit)
+            continue;
+        if (r.codeIndex >= text.size())
+            return;
+        m_relocationAt.emplace(r.codeIndex, i);
+        m_patched[r.codeIndex] = true;
+    }
+    for (auto const & p : m_object.expressions) {
+        /* Arithmetic on code addresses would not follow the code: */
+        if (p.expression.ops().size() != 1u) {
+            for (auto const & label : p.expression.labels()) {
+                auto const it(m_symbols.find(label.name));
+                if ((it != m_symbols.end())
+                    && (m_object.symbols[it->second].section
+                        == SectionType::Text)
+                    && (m_object.symbols[it->second].linkingUnit
+                        == m_linkingUnit))
+                    return;
+            }
+        }
+        if ((p.linkingUnit != m_linkingUnit)
+            || (p.section != SectionType::Text))
+            continue;
+        if (p.offset >= text.size())
+            return;
+        m_patched[p.offset] = true;
+    }
+
+    auto const & codeMap = instructionCodeMap();
+    for (std::size_t offset = 0u; offset < text.size();) {
+        if (!starts[offset])
+            return;
+        auto const it(codeMap.find(text[offset].uint64[0u]));
+        if (it == codeMap.end())
+            return;
+        std::string_view const name(it->second->first);
+        auto const & info = it->second->second;
+        if (info.numArgs >= text.size() - offset)
+            return;
+        for (std::size_t i = 1u; i <= info.numArgs; ++i)
+            if (starts[offset + i])
+                return;
+
+        Instruction instruction;
+        instruction.name = name;
+        auto const dot = name.rfind('.');
+        instruction.baseName =
+                (dot == std::string_view::npos) ? name : name.substr(dot + 1u);
+        instruction.code = info.code;
+        instruction.offset = offset;
+        instruction.numArgs = info.numArgs;
+        {
+            char c[sizeof(info.code)];
+            std::memcpy(c, &(info.code), sizeof(info.code));
+            instruction.isJump = (c[0u] == 0x04      /* Jump namespace */
+                                  && c[2u] == 0x01   /* imm first argument */
+                                  && info.numArgs);
+        }
+
+        /* Jumps and calls to raw offsets can not be followed: */
+        if ((instruction.isJump
+             || (instruction.baseName.substr(0u, 8u) == "call_imm"))
+            && !relocationAt(offset + 1u))
+            return;
+
+        m_instructionAt[offset] = m_instructions.size();
+        m_instructions.push_back(instruction);
+        offset += info.numArgs + 1u;
+    }
+
+    /* Labels with offsets must refer to instructions to follow them: */
+    for (auto const & r : relocations) {
+        if (!r.addend)
+            continue;
+        auto const it(m_symbols.find(r.label));
+        if ((it == m_symbols.end())
+            || (m_object.symbols[it->second].section != SectionType::Text)
+            || (m_object.symbols[it->second].linkingUnit != m_linkingUnit))
+            continue;
+        std::size_t t;
+        if (!target(r, t) || (m_instructionAt[t] == npos))
+            return;
+    }
+
+    m_removed.assign(m_instructions.size(), false);
+    m_redirects.assign(m_instructions.size(), npos);
+    m_editable = true;
+}
+
+std::size_t ObjectText::instructionAt(std::size_t const offset) const noexcept
+{ return (offset < m_instructionAt.size()) ? m_instructionAt[offset] : npos; }
+
+Object::Relocation * ObjectText::relocationAt(std::size_t const offset)
+        const noexcept
+{
+    auto const it(m_relocationAt.find(offset));
+    return (it != m_relocationAt.end())
+           ? &m_object.relocations[it->second]
+           : nullptr;
+}
+
+bool ObjectText::target(std::string_view const label,
+                        std::int64_t const addend,
+                        std::size_t & offset) const noexcept
+{
+    if (!m_text)
+        return false;
+    auto const it(m_symbols.find(label));
+    if (it == m_symbols.end())
+        return false;
+    auto const & symbol = m_object.symbols[it->second];
+    if ((symbol.section != SectionType::Text)
+        || (symbol.linkingUnit != m_linkingUnit))
+        return false;
+    std::size_t t = symbol.offset;
+    if (addend >= 0) {
+        auto const a = static_cast<std::uint64_t>(addend);
+        if (a >= m_text->size() - std::min(t, m_text->size()))
+            return false;
+        t += a;
+    } else {
+        auto const a = static_cast<std::uint64_t>(-(addend + 1)) + 1u;
+        if (a > t)
+            return false;
+        t -= a;
+    }
+    if (t >= m_text->size())
+        return false;
+    offset = t;
+    return true;
+}
+
+void ObjectText::remove(std::size_t const index) noexcept {
+    assert(m_editable);
+    assert(index < m_instructions.size());
+    if (!m_removed[index]) {
+        m_removed[index] = true;
+        ++m_numRemoved;
+    }
+}
+
+void ObjectText::redirect(std::size_t const index, std::size_t const to)
+        noexcept
+{
+    assert(to < m_instructions.size());
+    assert(m_instructions[index].numArgs == m_instructions[to].numArgs);
+    remove(index);
+    m_redirects[index] = to;
+}
+
+void ObjectText::commit() {
+    if (!m_numRemoved)
+        return;
+    std::vector<std::size_t> order(m_instructions.size());
+    for (std::size_t i = 0u; i < order.size(); ++i)
+        order[i] = i;
+    commit(order);
+}
+
+void ObjectText::commit(std::vector<std::size_t> const & order) {
+    assert(m_editable);
+    assert(order.size() == m_instructions.size());
+    auto & text = *m_text;
+    auto const size = text.size();
+
+    /* The new offset of every code block, with the blocks of removed
+       instructions at the next instruction kept in the new order: */
+    std::vector<std::size_t> newOffsets(size + 1u);
+    std::vector<bool> removedBlocks(size, false);
+    std::vector<std::size_t> pendingRemoved;
+    std::size_t next = 0u;
+    for (auto const i : order) {
+        auto const & instruction = m_instructions[i];
+        auto const blocks = instruction.numArgs + 1u;
+        if (m_removed[i]) {
+            for (std::size_t j = 0u; j < blocks; ++j)
+                removedBlocks[instruction.offset + j] = true;
+            pendingRemoved.push_back(i);
+            continue;
+        }
+        for (auto const r : pendingRemoved)
+            for (std::size_t j = 0u; j <= m_instructions[r].numArgs; ++j)
+                newOffsets[m_instructions[r].offset + j] = next;
+        pendingRemoved.clear();
+        for (std::size_t j = 0u; j < blocks; ++j)
+            newOffsets[instruction.offset + j] = next + j;
+        next += blocks;
+    }
+    for (auto const r : pendingRemoved)
+        for (std::size_t j = 0u; j <= m_instructions[r].numArgs; ++j)
+            newOffsets[m_instructions[r].offset + j] = next;
+    newOffsets[size] = next;
+    for (std::size_t i = 0u; i < m_instructions.size(); ++i) {
+        auto const to = m_redirects[i];
+        if (to == npos)
+            continue;
+        assert(!m_removed[to]);
+        for (std::size_t j = 0u; j <= m_instructions[i].numArgs; ++j)
+            newOffsets[m_instructions[i].offset + j] =
+                    newOffsets[m_instructions[to].offset + j];
+    }
+
+    /* Adjust the addends of labels with offsets into the section, before the
+       symbols are moved: */
+    for (auto & r : m_object.relocations) {
+        std::size_t t;
+        if (!r.addend || !target(r, t))
+            continue;
+        auto const & symbol = m_object.symbols[m_symbols.find(r.label)->second];
+        r.addend = static_cast<std::int64_t>(newOffsets[t])
+                   - static_cast<std::int64_t>(newOffsets[symbol.offset]);
+    }
+
+    auto & relocations = m_object.relocations;
+    relocations.erase(
+                std::remove_if(
+                    relocations.begin(),
+                    relocations.end(),
+                    [this, &newOffsets, &removedBlocks](
+                            Object::Relocation & r)
+                    {
+                        if (r.linkingUnit != m_linkingUnit)
+                            return false;
+                        if (removedBlocks[r.codeIndex])
+                            return true;
+                        r.codeIndex = newOffsets[r.codeIndex];
+                        if (r.isJump)
+                            r.jumpOffset = newOffsets[r.jumpOffset];
+                        return false;
+                    }),
+                relocations.end());
+
+    auto & expressions = m_object.expressions;
+    expressions.erase(
+                std::remove_if(
+                    expressions.begin(),
+                    expressions.end(),
+                    [this, &newOffsets, &removedBlocks](
+                            Object::PendingExpression & p)
+                    {
+                        if ((p.linkingUnit != m_linkingUnit)
+                            || (p.section != SectionType::Text))
+                            return false;
+                        if (removedBlocks[p.offset])
+                            return true;
+                        p.offset = newOffsets[p.offset];
+                        return false;
+                    }),
+                expressions.end());
+
+    for (auto & symbol : m_object.symbols)
+        if ((symbol.section == SectionType::Text)
+            && (symbol.linkingUnit == m_linkingUnit)
+            && (symbol.offset <= size))
+            symbol.offset = newOffsets[symbol.offset];
+
+    std::vector<SharemindCodeBlock> newText;
+    newText.reserve(next);
+    auto & starts = m_object.instructionStarts[m_linkingUnit];
+    std::vector<bool> newStarts;
+    newStarts.reserve(next);
+    for (auto const i : order) {
+        if (m_removed[i])
+            continue;
+        auto const & instruction = m_instructions[i];
+        for (std::size_t j = 0u; j <= instruction.numArgs; ++j) {
+            newText.push_back(text[instruction.offset + j]);
+            newStarts.push_back(starts[instruction.offset + j]);
+        }
+    }
+    text = std::move(newText);
+    starts = std::move(newStarts);
+    decode();
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
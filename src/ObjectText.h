@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_OBJECTTEXT_H
+#define SHAREMIND_LIBAS_OBJECTTEXT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <sharemind/codeblock.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "Object.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief The decoded TEXT section of a linking unit of an object, from which
+         instructions can be removed or reordered while keeping the symbols,
+         relocations and pending expressions of the object consistent.
+
+  The section is editable only if every code address in it is given by a
+  label, i.e. all jumps and calls to immediate targets use relocations and no
+  expression computes an address from a label in the section. Programs which
+  jump to raw offsets are left as they are.
+
+  \note The object must contain all code of its program, as code addresses of
+        the section used by other objects are not known.
+*/
+class ObjectText {
+
+public: /* Types: */
+
+    static constexpr std::size_t const npos =
+            std::numeric_limits<std::size_t>::max();
+
+    struct Instruction {
+
+    /* Fields: */
+
+        /** The name of the instruction in the libvmi instruction table. */
+        std::string_view name;
+
+        /** The name without any namespace prefix, e.g. "mov_imm_reg". */
+        std::string_view baseName;
+
+        std::uint64_t code;
+
+        /** The index of the code block of the instruction. */
+        std::size_t offset;
+
+        std::size_t numArgs;
+
+        /** Whether the first argument is the relative offset of a jump. */
+        bool isJump;
+
+    };
+
+public: /* Methods: */
+
+    ObjectText(Object & object, std::uint8_t linkingUnit);
+
+    Object & object() const noexcept { return m_object; }
+    std::uint8_t linkingUnit() const noexcept { return m_linkingUnit; }
+
+    bool isEditable() const noexcept { return m_editable; }
+
+    std::vector<Instruction> const & instructions() const noexcept
+    { return m_instructions; }
+
+    /** \returns the value of the given code block. */
+    SharemindCodeBlock const & block(std::size_t offset) const noexcept
+    { return (*m_text)[offset]; }
+
+    /** \returns the index of the instruction at the given code block, or npos
+                 if no instruction starts there. */
+    std::size_t instructionAt(std::size_t offset) const noexcept;
+
+    /** \returns the relocation written to the given code block, or null. */
+    Object::Relocation * relocationAt(std::size_t offset) const noexcept;
+
+    /** \returns whether the given code block is written by a relocation or a
+                 pending expression, i.e. its value is not yet known. */
+    bool isPatched(std::size_t offset) const noexcept
+    { return m_patched[offset]; }
+
+    /**
+      \brief Finds the code block the given label and addend refer to.
+      \returns whether the label is defined in this section and the code block
+               is in it.
+    */
+    bool target(std::string_view label,
+                std::int64_t addend,
+                std::size_t & offset) const noexcept;
+
+    bool target(Object::Relocation const & relocation, std::size_t & offset)
+            const noexcept
+    { return target(relocation.label, relocation.addend, offset); }
+
+    /** \brief Marks the given instruction to be removed by commit(). */
+    void remove(std::size_t index) noexcept;
+
+    /**
+      \brief Marks the given instruction to be removed by commit(), with the
+             symbols at it and the labels referring to it moved to the given
+             instruction, which must have the same size and be kept.
+    */
+    void redirect(std::size_t index, std::size_t to) noexcept;
+
+    bool isRemoved(std::size_t index) const noexcept
+    { return m_removed[index]; }
+
+    /** \returns the number of instructions marked to be removed. */
+    std::size_t numRemoved() const noexcept { return m_numRemoved; }
+
+    /**
+      \brief Removes the marked instructions from the section and decodes it
+             again.
+
+      Symbols at removed instructions move to the next instruction which is
+      kept, or to the instruction they were redirected to. Relocations and
+      pending expressions in removed instructions are dropped, and the offsets
+      and addends of the others are adjusted.
+    */
+    void commit();
+
+    /**
+      \brief Like commit(), but also lays the instructions out in the given
+             order, which must be a permutation of the indices of all
+             instructions. Symbols at removed instructions move to the
+             instruction kept next in this order.
+    */
+    void commit(std::vector<std::size_t> const & order);
+
+private: /* Methods: */
+
+    void decode();
+
+private: /* Fields: */
+
+    Object & m_object;
+    std::uint8_t const m_linkingUnit;
+    std::vector<SharemindCodeBlock> * m_text = nullptr;
+    bool m_editable = false;
+    std::vector<Instruction> m_instructions;
+    std::vector<std::size_t> m_instructionAt;
+    std::unordered_map<std::size_t, std::size_t> m_relocationAt;
+    std::vector<bool> m_patched;
+    std::vector<bool> m_removed;
+
+    /** For every instruction, the instruction it is redirected to, or npos. */
+    std::vector<std::size_t> m_redirects;
+    std::size_t m_numRemoved = 0u;
+
+    /** The symbols of the object by name. */
+    std::unordered_map<std::string_view, std::size_t> m_symbols;
+
+};
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_OBJECTTEXT_H */
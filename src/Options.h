@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_OPTIONS_H
+#define SHAREMIND_LIBAS_OPTIONS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include "ExecutionProfile.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief Resource limits and optimizations for tokenization and assembly.
+  \note Limits set to 0 are not enforced.
+*/
+struct Options {
+
+/* Types: */
+
+    using Clock = std::chrono::steady_clock;
+
+/* Methods: */
+
+    bool isCancelled() const noexcept
+    { return cancelFlag && cancelFlag->load(std::memory_order_relaxed); }
+
+    bool isPastDeadline() const noexcept {
+        return (deadline != Clock::time_point::max())
+               && (Clock::now() >= deadline);
+    }
+
+    /** \returns whether any optimization of the output is enabled. */
+    bool optimizes() const noexcept {
+        return peephole || gcSections || foldCode || mergeRoData
+               || pruneBindings || zeroDataToBss || profile;
+    }
+
+/* Fields: */
+
+    /** The maximum number of tokens in the input, counting the tokens of
+        included files and of every repetition of .rept blocks and macro
+        expansions by the assembler. Also limits the number of strings
+        defined by a program of binary IR. */
+    std::size_t maxTokens = 0u;
+
+    /** The maximum size in bytes of any TEXT, RODATA, DATA, BSS or DEBUG
+        section of the output. */
+    std::size_t maxSectionSize = 0u;
+
+    /** The maximum number of label uses, jump targets and expressions waiting
+        for labels defined later in the input. */
+    std::size_t maxPendingRelocations = 0u;
+
+    /** The time after which tokenization and assembly fail, checked once per
+        line of input. */
+    Clock::time_point deadline = Clock::time_point::max();
+
+    /** If not null, tokenization and assembly fail once the flag is set,
+        checked once per line of input. */
+    std::atomic<bool> const * cancelFlag = nullptr;
+
+    /** Whether the .incbin and .include directives may read files. This is
+        off by default, as it would let untrusted programs read any file the
+        process can. */
+    bool allowFileAccess = false;
+
+    /** Whether to pad every numeric .data and .fill value in the RODATA, DATA
+        and BSS sections to a multiple of its size, with labels directly
+        followed by such a directive referring to the value. */
+    bool alignData = false;
+
+    /** Whether to apply peephole optimizations to the TEXT sections of whole
+        programs, see peephole(). Objects are never optimized. */
+    bool peephole = false;
+
+    /** Whether to remove unreachable code and unreferenced RODATA and DATA
+        from whole programs, see gcSections(). */
+    bool gcSections = false;
+
+    /** Whether to merge identical procedures of whole programs, see
+        foldCode(). */
+    bool foldCode = false;
+
+    /** Whether to store equal constants in the RODATA sections of whole
+        programs only once, see mergeRoData(). */
+    bool mergeRoData = false;
+
+    /** Whether to remove unreferenced and duplicate entries of the BIND and
+        PDBIND sections of whole programs, see pruneBindings(). */
+    bool pruneBindings = false;
+
+    /** Whether to move DATA sections which only contain zeroes to the empty
+        BSS sections of whole programs, see zeroDataToBss(). The programs must
+        refer to the memory pointer of the DATA section only by the :DATA
+        label constant, which objects assembled with this option leave to the
+        linker. */
+    bool zeroDataToBss = false;
+
+    /** If not null, the code of whole programs is laid out by the execution
+        counts in the profile, see layoutCode(). The profile must outlive the
+        assembly. */
+    ExecutionProfile const * profile = nullptr;
+
+};
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_OPTIONS_H */
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "SourceFile.h"
+
+#include <cassert>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <sys/stat.h>
+#include <unordered_map>
+#include "readFile.h"
+#include "tokenizer.h"
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+struct CacheEntry {
+    std::shared_ptr<SourceFile const> file;
+    struct ::timespec modificationTime;
+    std::size_t hash;
+
+    /** The approximate number of bytes used by the file. */
+    std::size_t cost;
+
+    /** The position of the entry in Cache::recentlyUsed. */
+    std::list<std::string const *>::iterator use;
+};
+
+/** The files most recently used, up to a total cost of maxCost. */
+class Cache {
+
+public: /* Methods: */
+
+    /** \returns the entry of the given file, marked as used, or null. */
+    CacheEntry * find(std::string const & path) {
+        auto const it(m_entries.find(path));
+        if (it == m_entries.end())
+            return nullptr;
+        auto & entry = it->second;
+        m_recentlyUsed.splice(m_recentlyUsed.begin(),
+                              m_recentlyUsed,
+                              entry.use);
+        return &entry;
+    }
+
+    /**
+      \brief Adds or replaces the entry of the given file, evicting the least
+             recently used files to stay within maxCost.
+    */
+    void insert(std::shared_ptr<SourceFile const> file,
+                struct ::timespec const & modificationTime,
+                std::size_t const hash)
+    {
+        auto const cost = sizeof(SourceFile) + file->size()
+                          + file->tokens().capacity() * sizeof(Token);
+        erase(file->path());
+        if (cost > m_maxCost)
+            return;
+        auto const & path = file->path();
+        m_recentlyUsed.push_front(nullptr);
+        try {
+            auto const it(m_entries.emplace(path,
+                                            CacheEntry{std::move(file),
+                                                       modificationTime,
+                                                       hash,
+                                                       cost,
+                                                       m_recentlyUsed.begin()}
+                                            ).first);
+            m_recentlyUsed.front() = &it->first;
+        } catch (...) {
+            m_recentlyUsed.pop_front();
+            throw;
+        }
+        m_cost += cost;
+        evict();
+    }
+
+    void setMaxCost(std::size_t const maxCost) noexcept {
+        m_maxCost = maxCost;
+        evict();
+    }
+
+    std::size_t cost() const noexcept { return m_cost; }
+
+    /** \brief Moves the entries into the given map. */
+    void clear(std::unordered_map<std::string, CacheEntry> & entries)
+            noexcept
+    {
+        entries.swap(m_entries);
+        m_recentlyUsed.clear();
+        m_cost = 0u;
+    }
+
+public: /* Fields: */
+
+    std::mutex mutex;
+
+private: /* Methods: */
+
+    void erase(std::string const & path) noexcept {
+        auto const it(m_entries.find(path));
+        if (it == m_entries.end())
+            return;
+        m_cost -= it->second.cost;
+        m_recentlyUsed.erase(it->second.use);
+        m_entries.erase(it);
+    }
+
+    void evict() noexcept {
+        while (m_cost > m_maxCost)
+            erase(*m_recentlyUsed.back());
+    }
+
+private: /* Fields: */
+
+    std::unordered_map<std::string, CacheEntry> m_entries;
+    std::list<std::string const *> m_recentlyUsed;
+    std::size_t m_cost = 0u;
+    std::size_t m_maxCost = defaultSourceFileCacheLimit;
+
+};
+
+Cache & cache() {
+    static Cache c;
+    return c;
+}
+
+bool operator==(struct ::timespec const & lhs,
+                struct ::timespec const & rhs) noexcept
+{ return (lhs.tv_sec == rhs.tv_sec) && (lhs.tv_nsec == rhs.tv_nsec); }
+
+std::size_t hashContents(std::shared_ptr<void> const & contents,
+                         std::size_t const size) noexcept
+{
+    return std::hash<std::string_view>()(
+                std::string_view(static_cast<char const *>(contents.get()),
+                                 size));
+}
+
+} // anonymous namespace
+
+SourceFile::SourceFile(std::string path,
+                       std::shared_ptr<void> contents,
+                       std::size_t const size)
+    : m_path(std::move(path))
+    , m_contents(std::move(contents))
+    , m_size(size)
+    /* Cached tokens may outlive any memory resource given by the user: */
+    , m_tokens(std::pmr::new_delete_resource())
+{}
+
+bool loadSourceFile(char const * path,
+                    Options const & options,
+                    std::shared_ptr<SourceFile const> & sourceFile,
+                    Error & error)
+{
+    assert(path);
+
+    std::string canonicalPath;
+    {
+        char * const resolved = ::realpath(path, nullptr);
+        if (!resolved) {
+            error = Error(ErrorCode::FileReadError, 0u);
+            return false;
+        }
+        try {
+            canonicalPath = resolved;
+        } catch (...) {
+            std::free(resolved);
+            throw;
+        }
+        std::free(resolved);
+    }
+
+    struct ::stat st;
+    if (::stat(canonicalPath.c_str(), &st) != 0) {
+        error = Error(ErrorCode::FileReadError, 0u);
+        return false;
+    }
+
+    auto & c = cache();
+    {
+        std::lock_guard<std::mutex> const guard(c.mutex);
+        auto const * const entry = c.find(canonicalPath);
+        if (entry
+            && (entry->modificationTime == st.st_mtim)
+            && (static_cast<off_t>(entry->file->size()) == st.st_size))
+        {
+            sourceFile = entry->file;
+            return true;
+        }
+    }
+
+    /* The contents are read instead of mapped, because the tokens point into
+       the contents for as long as the file is cached: */
+    std::shared_ptr<void> contents;
+    std::size_t size;
+    if (readFile(canonicalPath.c_str(),
+                 0u,
+                 readFileToEnd,
+                 std::pmr::new_delete_resource(),
+                 contents,
+                 size,
+                 false) != ReadFileResult::Ok)
+    {
+        error = Error(ErrorCode::FileReadError, 0u);
+        return false;
+    }
+    auto const hash = hashContents(contents, size);
+
+    /* Files which were only touched need not be tokenized again: */
+    {
+        std::lock_guard<std::mutex> const guard(c.mutex);
+        if (auto * const entry = c.find(canonicalPath)) {
+            if ((entry->hash == hash)
+                && (entry->file->size() == size)
+                && (!size
+                    || std::memcmp(entry->file->text(),
+                                   contents.get(),
+                                   size) == 0))
+            {
+                entry->modificationTime = st.st_mtim;
+                sourceFile = entry->file;
+                return true;
+            }
+        }
+    }
+
+    /* Tokenize without holding the lock. Only the deadline and cancellation
+       flag apply, the other limits are checked by the assembler: */
+    auto file(std::make_shared<SourceFile>(std::move(canonicalPath),
+                                           std::move(contents),
+                                           size));
+    Options tokenizerOptions;
+    tokenizerOptions.deadline = options.deadline;
+    tokenizerOptions.cancelFlag = options.cancelFlag;
+    Error tokenizerError;
+    if (!tokenize(file->text() ? file->text() : "",
+                  size,
+                  file->tokens(),
+                  tokenizerError,
+                  tokenizerOptions))
+    {
+        file->tokens().clear();
+        error = Error(tokenizerError.code(),
+                      tokenizerError.offset(),
+                      std::move(file));
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> const guard(c.mutex);
+        c.insert(file, st.st_mtim, hash);
+    }
+    sourceFile = std::move(file);
+    return true;
+}
+
+void clearSourceFileCache() noexcept {
+    auto & c = cache();
+    std::unordered_map<std::string, CacheEntry> entries;
+    {
+        std::lock_guard<std::mutex> const guard(c.mutex);
+        c.clear(entries);
+    }
+    /* The files are destroyed here, outside the lock. */
+}
+
+void setSourceFileCacheLimit(std::size_t const maxBytes) noexcept {
+    auto & c = cache();
+    std::lock_guard<std::mutex> const guard(c.mutex);
+    c.setMaxCost(maxBytes);
+}
+
+std::size_t sourceFileCacheSize() noexcept {
+    auto & c = cache();
+    std::lock_guard<std::mutex> const guard(c.mutex);
+    return c.cost();
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
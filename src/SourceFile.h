@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_SOURCEFILE_H
+#define SHAREMIND_LIBAS_SOURCEFILE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "Error.h"
+#include "Options.h"
+#include "tokens.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/** \brief The contents and tokens of a source file, e.g. an included file. */
+class SourceFile {
+
+public: /* Methods: */
+
+    SourceFile(std::string path,
+               std::shared_ptr<void> contents,
+               std::size_t size);
+
+    SourceFile(SourceFile const &) = delete;
+    SourceFile & operator=(SourceFile const &) = delete;
+
+    /** \returns the canonical path of the file. */
+    std::string const & path() const noexcept { return m_path; }
+
+    char const * text() const noexcept
+    { return static_cast<char const *>(m_contents.get()); }
+
+    std::size_t size() const noexcept { return m_size; }
+
+    TokensVector const & tokens() const noexcept { return m_tokens; }
+    TokensVector & tokens() noexcept { return m_tokens; }
+
+    /** \returns whether the given pointer points into the text of the file. */
+    bool containsText(char const * const ptr) const noexcept
+    { return m_size && (ptr >= text()) && (ptr < text() + m_size); }
+
+private: /* Fields: */
+
+    std::string const m_path;
+    std::shared_ptr<void> const m_contents;
+    std::size_t const m_size;
+    TokensVector m_tokens;
+
+};
+
+/**
+  \brief Loads and tokenizes the given source file, or returns the tokens of
+         the file from a cache if the file has not changed since it was last
+         loaded.
+
+  The cache is shared by all threads of the process and keyed by the canonical
+  path of the file. A file is considered unchanged if either its modification
+  time and size, or its contents are unchanged. The least recently used files
+  are evicted from the cache to keep its size within the limit set by
+  setSourceFileCacheLimit().
+
+  \param[in] path The path of the file.
+  \param[in] options Only the deadline and the cancellation flag are used.
+  \param[out] sourceFile Where to store the file on success.
+  \param[out] error Where to store the error on failure. The source file of
+                    tokenizer errors is set to the file.
+  \returns whether the file was loaded successfully.
+*/
+bool loadSourceFile(char const * path,
+                    Options const & options,
+                    std::shared_ptr<SourceFile const> & sourceFile,
+                    Error & error);
+
+/** \brief Removes all files from the cache used by loadSourceFile(). */
+void clearSourceFileCache() noexcept;
+
+/** The default limit of the cache used by loadSourceFile(), in bytes. */
+constexpr std::size_t const defaultSourceFileCacheLimit = 64u * 1024u * 1024u;
+
+/**
+  \brief Sets the limit of the approximate number of bytes used by the files
+         in the cache used by loadSourceFile(), evicting the least recently
+         used files as needed. Files larger than the limit are not cached.
+*/
+void setSourceFileCacheLimit(std::size_t maxBytes) noexcept;
+
+/**
+  \returns the approximate number of bytes used by the files in the cache used
+           by loadSourceFile().
+*/
+std::size_t sourceFileCacheSize() noexcept;
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_SOURCEFILE_H */
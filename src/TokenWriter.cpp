@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "TokenWriter.h"
+
+#include <cassert>
+#include <cstring>
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+inline bool isIdHead(char const c) noexcept {
+    return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'))
+           || (c == '_');
+}
+
+inline bool isIdTail(char const c) noexcept
+{ return isIdHead(c) || ((c >= '0') && (c <= '9')); }
+
+/** \returns the number of hexadecimal digits needed to write the value. */
+inline std::size_t hexLength(std::uint64_t v) noexcept {
+    std::size_t r = 1u;
+    while (v >>= 4u)
+        ++r;
+    return r;
+}
+
+/** \brief Writes 0x and the hexadecimal digits of the value. */
+inline char * writeHex(char * out, std::uint64_t v) noexcept {
+    static constexpr char const digits[] = "0123456789abcdef";
+    *out++ = '0';
+    *out++ = 'x';
+    auto const length = hexLength(v);
+    for (auto * c = out + length; c != out; v >>= 4u)
+        *--c = digits[v & 0xfu];
+    return out + length;
+}
+
+/** \returns the escape character for the given character, or 0 if none. */
+inline char escapeOf(char const c) noexcept {
+    switch (c) {
+        case '\n': return 'n';
+        case '\r': return 'r';
+        case '\t': return 't';
+        case '\v': return 'v';
+        case '\b': return 'b';
+        case '\f': return 'f';
+        case '\a': return 'a';
+        case '\0': return '0';
+        case '"': return '"';
+        case '\\': return '\\';
+        default: return '\0';
+    }
+}
+
+} // anonymous namespace
+
+TokenWriter::TokenWriter(TokensVector & tokens)
+    : m_tokens(tokens)
+    , m_textResource(tokens.get_allocator().resource())
+{}
+
+void TokenWriter::clear() noexcept {
+    m_tokens.clear();
+    m_textResource.release();
+    m_line = 1u;
+    m_column = 1u;
+}
+
+char * TokenWriter::allocateText(std::size_t const size)
+{ return static_cast<char *>(m_textResource.allocate(size, alignof(char))); }
+
+void TokenWriter::add(Token::Type const type,
+                      char const * const text,
+                      std::size_t const length,
+                      std::string_view const parsedString,
+                      std::uint64_t const parsedNumeric)
+{
+    m_tokens.emplace_back(type,
+                          text,
+                          length,
+                          m_line,
+                          m_column,
+                          parsedString,
+                          parsedNumeric);
+    ++m_column;
+}
+
+void TokenWriter::newline() {
+    add(Token::Type::NEWLINE, "\n", 1u, {}, 0u);
+    ++m_line;
+    m_column = 1u;
+}
+
+void TokenWriter::keyword(std::string_view const keyword) {
+    auto * const text = allocateText(keyword.size());
+    std::memcpy(text, keyword.data(), keyword.size());
+    add(Token::Type::KEYWORD, text, keyword.size(), keyword, 0u);
+}
+
+void TokenWriter::directive(std::string_view const directive) {
+    auto * const text = allocateText(directive.size() + 1u);
+    text[0u] = '.';
+    std::memcpy(text + 1u, directive.data(), directive.size());
+    add(Token::Type::DIRECTIVE,
+        text,
+        directive.size() + 1u,
+        directive,
+        0u);
+}
+
+void TokenWriter::uhex(std::uint64_t const value) {
+    auto * const text = allocateText(hexLength(value) + 2u);
+    auto * const end = writeHex(text, value);
+    add(Token::Type::UHEX,
+        text,
+        static_cast<std::size_t>(end - text),
+        {},
+        value);
+}
+
+void TokenWriter::hex(std::int64_t const value) {
+    auto const v = static_cast<std::uint64_t>(value);
+    auto const magnitude = (value < 0) ? ~v + 1u : v;
+    auto * const text = allocateText(hexLength(magnitude) + 3u);
+    text[0u] = (value < 0) ? '-' : '+';
+    auto * const end = writeHex(text + 1u, magnitude);
+    add(Token::Type::HEX, text, static_cast<std::size_t>(end - text), {}, v);
+}
+
+void TokenWriter::string(std::string_view const string) {
+    std::size_t length = string.size() + 2u;
+    for (auto const c : string)
+        if (escapeOf(c))
+            ++length;
+    auto * const text = allocateText(length);
+    auto * out = text;
+    *out++ = '"';
+    for (auto const c : string) {
+        if (auto const e = escapeOf(c)) {
+            *out++ = '\\';
+            *out++ = e;
+        } else {
+            *out++ = c;
+        }
+    }
+    *out = '"';
+    add(Token::Type::STRING, text, length, string, 0u);
+}
+
+void TokenWriter::label(std::string_view const name,
+                        std::int64_t const offset)
+{
+    assert(isValidLabelName(name));
+    if (!offset) {
+        auto * const text = allocateText(name.size() + 1u);
+        text[0u] = ':';
+        std::memcpy(text + 1u, name.data(), name.size());
+        return add(Token::Type::LABEL, text, name.size() + 1u, name, 0u);
+    }
+    auto const v = static_cast<std::uint64_t>(offset);
+    auto const magnitude = (offset < 0) ? ~v + 1u : v;
+    auto * const text = allocateText(name.size() + hexLength(magnitude) + 4u);
+    text[0u] = ':';
+    std::memcpy(text + 1u, name.data(), name.size());
+    auto * const sign = text + 1u + name.size();
+    *sign = (offset < 0) ? '-' : '+';
+    auto * const end = writeHex(sign + 1u, magnitude);
+    add(Token::Type::LABEL_O,
+        text,
+        static_cast<std::size_t>(end - text),
+        name,
+        v);
+}
+
+void TokenWriter::expression(std::string_view const expression) {
+    assert(isValidExpression(expression));
+    auto * const text = allocateText(expression.size());
+    std::memcpy(text, expression.data(), expression.size());
+    add(Token::Type::EXPRESSION, text, expression.size(), {}, 0u);
+}
+
+bool TokenWriter::isValidKeyword(std::string_view const name) noexcept {
+    if (name.empty() || !isIdHead(name.front()))
+        return false;
+    for (std::size_t i = 1u; i < name.size(); ++i) {
+        if (name[i] == '.') {
+            if ((++i == name.size()) || !isIdHead(name[i]))
+                return false;
+        } else if (!isIdTail(name[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TokenWriter::isValidLabelName(std::string_view name) noexcept {
+    if (!name.empty() && (name.front() == '.'))
+        name.remove_prefix(1u);
+    if (name.empty() || !isIdHead(name.front()))
+        return false;
+    for (auto const c : name.substr(1u))
+        if (!isIdTail(c))
+            return false;
+    return true;
+}
+
+bool TokenWriter::isValidExpression(std::string_view const text) noexcept {
+    if (text.empty() || (text.front() != '('))
+        return false;
+    std::size_t depth = 0u;
+    for (std::size_t i = 0u; i < text.size(); ++i) {
+        switch (text[i]) {
+            case '(': ++depth; break;
+            case ')':
+                if (!--depth)
+                    return i + 1u == text.size();
+                break;
+            case '\n': case '#': return false;
+            default: break;
+        }
+    }
+    return false;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
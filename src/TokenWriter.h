@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_TOKENWRITER_H
+#define SHAREMIND_LIBAS_TOKENWRITER_H
+
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include "tokens.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief Appends tokens to a tokens vector without tokenizing any text.
+
+  The values of the tokens are given as they are instead of being parsed from
+  their text. The text of every token is still written as the tokenizer would
+  have found it in a program, and kept by the writer, so the tokens can be
+  printed and located in errors like tokenized ones. The start line of the tokens is one plus the number of
+  preceding newlines, and their start column is their index on that line plus
+  one.
+
+  \note The writer does not validate its input. Label names, keywords,
+        directives and expressions given to it must be valid as checked by the
+        static methods of this class.
+*/
+class TokenWriter {
+
+public: /* Methods: */
+
+    /**
+      \param[in] tokens The vector to append to, which must outlive the writer.
+      \note The texts of the tokens are allocated from the memory resource of
+            the vector.
+    */
+    TokenWriter(TokensVector & tokens);
+    TokenWriter(TokenWriter const &) = delete;
+    TokenWriter & operator=(TokenWriter const &) = delete;
+
+    TokensVector & tokens() const noexcept { return m_tokens; }
+
+    /** \returns the start line of the next token. */
+    std::size_t line() const noexcept { return m_line; }
+
+    /** \brief Clears the tokens and frees their texts. */
+    void clear() noexcept;
+
+    void newline();
+    void keyword(std::string_view keyword);
+
+    /** \param[in] directive The name of the directive without the dot. */
+    void directive(std::string_view directive);
+
+    void uhex(std::uint64_t value);
+    void hex(std::int64_t value);
+
+    /** \brief Appends the given string quoted and escaped as needed. */
+    void string(std::string_view string);
+
+    /** \brief Appends a label, with an offset unless it is zero. */
+    void label(std::string_view name, std::int64_t offset = 0);
+
+    void expression(std::string_view expression);
+
+    /** \returns whether the tokenizer accepts the name as a keyword. */
+    static bool isValidKeyword(std::string_view name) noexcept;
+
+    /** \returns whether the tokenizer accepts :name as a label. */
+    static bool isValidLabelName(std::string_view name) noexcept;
+
+    /** \returns whether the tokenizer accepts the text as an expression. */
+    static bool isValidExpression(std::string_view text) noexcept;
+
+private: /* Methods: */
+
+    char * allocateText(std::size_t size);
+
+    /** \brief Appends a token with the given text and parsed values, see
+               Token. */
+    void add(Token::Type type,
+             char const * text,
+             std::size_t length,
+             std::string_view parsedString,
+             std::uint64_t parsedNumeric);
+
+private: /* Fields: */
+
+    TokensVector & m_tokens;
+    std::pmr::monotonic_buffer_resource m_textResource;
+    std::size_t m_line = 1u;
+    std::size_t m_column = 1u;
+
+};
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_TOKENWRITER_H */
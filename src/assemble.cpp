@@ -19,20 +19,41 @@
 
 #include "assemble.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
+#include <functional>
 #include <limits>
+#include <new>
 #include <sharemind/codeblock.h>
 #include <sharemind/Concat.h>
 #include <sharemind/IntegralComparisons.h>
 #include <sharemind/libexecutable/libexecutable_0x0.h>
 #include <sharemind/libvmi/instr.h>
 #include <sharemind/likely.h>
-#include <sharemind/SimpleUnorderedStringMap.h>
+#include <memory_resource>
+#include <mutex>
 #include <sstream>
+#include <string_view>
+#include <thread>
 #include <tuple>
+#include <unordered_map>
 #include <utility>
+#include "Expression.h"
+#include "foldCode.h"
+#include "gcSections.h"
+#include "layoutCode.h"
+#include "mergeRoData.h"
+#include "peephole.h"
+#include "pruneBindings.h"
+#include "readFile.h"
+#include "SourceFile.h"
+#include "tokenizer.h"
+#include "zeroDataToBss.h"
 
 
 namespace sharemind {
@@ -125,7 +146,10 @@ struct LabelLocation {
 
 };
 
-using LabelLocationMap = SimpleUnorderedStringMap<LabelLocation>;
+template <typename T>
+using StringMap = std::pmr::unordered_map<std::pmr::string, T>;
+
+using LabelLocationMap = StringMap<LabelLocation>;
 
 struct LabelSlot {
 
@@ -154,185 +178,2447 @@ struct LabelSlot {
     std::uint8_t linkingUnit;
 };
 
-struct LabelSlotsVector: public std::vector<LabelSlot> {
+struct LabelSlotsVector: public std::pmr::vector<LabelSlot> {
+
+/* Methods: */
+
+    using std::pmr::vector<LabelSlot>::vector;
+    using std::pmr::vector<LabelSlot>::operator=;
+
+};
+
+struct PendingJumpTarget {
+
+/* Fields: */
+
+    std::size_t target;
+    TokensVector::const_iterator tokenIt;
+    std::uint8_t linkingUnit;
+
+};
+
+/**
+  An expression which could not be evaluated when it was assembled, because it
+  refers to labels not yet defined or to section sizes. Its value is written
+  either to a code block, to all copies of a value in a data section, or
+  nowhere (for BSS sections).
+*/
+struct PendingExpression {
+
+/* Methods: */
+
+    PendingExpression(Expression expression_,
+                      TokensVector::const_iterator tokenIt_,
+                      std::uint8_t linkingUnit_) noexcept
+        : expression(std::move(expression_))
+        , tokenIt(tokenIt_)
+        , linkingUnit(linkingUnit_)
+    {}
+
+/* Fields: */
+
+    Expression expression;
+    TokensVector::const_iterator tokenIt;
+    std::uint8_t linkingUnit;
+    decltype(Executable::TextSection::instructions) * codeSection = nullptr;
+    Executable::DataSection * dataSection = nullptr;
+    SectionType section = SectionType::Text;
+    std::size_t offset = 0u; /* Code block index or byte offset */
+    std::size_t multiplier = 1u;
+    std::uint_fast8_t dataType = 3u;
+
+};
+
+/** A macro defined by the .macro directive. */
+struct MacroDefinition {
+
+/* Methods: */
+
+    MacroDefinition(std::pmr::memory_resource * memoryResource)
+        : parameters(memoryResource)
+        , tokens(memoryResource)
+    {}
+
+/* Fields: */
+
+    /** The KEYWORD tokens naming the parameters. */
+    std::pmr::vector<TokensVector::const_iterator> parameters;
+
+    /** The NEWLINE token ending the .macro line. */
+    TokensVector::const_iterator bodyIt;
+
+    /** The .endm directive. */
+    TokensVector::const_iterator endIt;
+
+    /** The file the macro was defined in. */
+    SourceFile const * file;
+
+    /** For macros defined by macro expansions, a copy of the tokens of the
+        definition, as the tokens of expansions are reused. */
+    TokensVector tokens;
+
+};
+
+/**
+  The position to continue from after the end of an included file, or after
+  the expansion of a .rept block or of a macro.
+*/
+struct ExpansionFrame {
+
+/* Types: */
+
+    enum class Kind { Include, Repeat, Macro };
+
+/* Fields: */
+
+    Kind kind;
+    TokensVector::const_iterator resumeIt;
+    TokensVector::const_iterator endIt;
+    SourceFile const * file;
+
+    /* For .rept blocks, the NEWLINE token starting the block: */
+    TokensVector::const_iterator repeatIt;
+    std::uint64_t repeatsLeft;
+
+    /* For macros, the macro being expanded: */
+    MacroDefinition const * macro;
+
+};
+
+struct LabelSlotsMap: public StringMap<LabelSlotsVector> {
+
+/* Methods: */
+
+    using StringMap<LabelSlotsVector>::StringMap;
+    using StringMap<LabelSlotsVector>::operator=;
+
+};
+
+class ResizableDataSection: public Executable::DataSection {
+
+private: /* Types: */
+
+    using Container = std::pmr::vector<char>;
+    static_assert(std::is_same<Container::size_type, std::size_t>::value, "");
+
+public: /* Methods: */
+
+    ResizableDataSection(std::pmr::memory_resource * const memoryResource,
+                         void const * const dataPtr,
+                         std::size_t const dataSize,
+                         std::size_t multiplier = 1u)
+        : ResizableDataSection(
+            [](std::pmr::memory_resource * const memoryResource_,
+               void const * dataPtr_,
+               std::size_t const dataSize_,
+               std::size_t multiplier_)
+            {
+                if ((std::numeric_limits<std::size_t>::max() / multiplier_)
+                    < dataSize_)
+                    throw std::bad_array_new_length();
+                auto r(makeContainer(memoryResource_,
+                                     dataSize_ * multiplier_));
+                writeData(r->data(), dataPtr_, dataSize_, multiplier_);
+                return r;
+            }(memoryResource, dataPtr, dataSize, multiplier))
+    {}
+
+    /**
+      \brief Creates a section which refers to the given data without copying
+             it, until more data is added to the section.
+    */
+    ResizableDataSection(std::pmr::memory_resource * const memoryResource,
+                         std::shared_ptr<void> externalData,
+                         std::size_t const dataSize)
+        : Executable::DataSection(std::move(externalData), dataSize)
+        , m_container(makeContainer(memoryResource, 0u))
+        , m_isExternal(true)
+    {}
+
+    void addData(void const * const dataPtr,
+                 std::size_t const dataSize,
+                 std::size_t multiplier = 1u)
+    {
+        assert(this->data);
+        assert(m_isExternal || (this->data.get() == m_container->data()));
+
+        if (std::numeric_limits<std::size_t>::max() / multiplier < dataSize)
+            throw std::bad_array_new_length();
+        auto const toAdd = dataSize * multiplier;
+        auto const oldSize = this->sizeInBytes;
+        if ((std::numeric_limits<std::size_t>::max() - oldSize) < toAdd)
+            throw std::bad_array_new_length();
+        auto const totalDataSize = oldSize + toAdd;
+        if (m_isExternal) {
+            /* Copy the external data, releasing it afterwards: */
+            m_container->reserve(totalDataSize);
+            auto const * const external =
+                    static_cast<char const *>(this->data.get());
+            m_container->assign(external, external + oldSize);
+            m_isExternal = false;
+        }
+        m_container->resize(totalDataSize);
+        writeData(m_container->data() + oldSize, dataPtr, dataSize, multiplier);
+        this->data = std::shared_ptr<void>(m_container, m_container->data());
+        this->sizeInBytes = totalDataSize;
+    }
+
+private: /* Methods: */
+
+    ResizableDataSection(std::shared_ptr<Container> containerPtr)
+        : Executable::DataSection(
+              std::shared_ptr<void>(containerPtr, containerPtr->data()),
+              containerPtr->size())
+        , m_container(std::move(containerPtr))
+    {}
+
+    static std::shared_ptr<Container> makeContainer(
+            std::pmr::memory_resource * const memoryResource,
+            std::size_t const size)
+    {
+        return std::allocate_shared<Container>(
+                    std::pmr::polymorphic_allocator<Container>(memoryResource),
+                    size);
+    }
+
+    static void writeData(char * writePtr,
+                          void const * const data,
+                          std::size_t const dataSize,
+                          std::size_t multiplier)
+    {
+        for (;;) {
+            std::memcpy(writePtr, data, dataSize);
+            if (!--multiplier)
+                break;
+            writePtr += dataSize;
+        }
+    }
+
+private: /* Fields: */
+
+    std::shared_ptr<Container> m_container;
+    bool m_isExternal = false;
+
+};
+
+bool dataSectionCreateOrAddData(
+        std::shared_ptr<Executable::DataSection> & sectionPtr,
+        std::pmr::memory_resource * const memoryResource,
+        void const * const data,
+        std::size_t const dataSize,
+        std::size_t multiplier = 1u)
+{
+    if (!dataSize || !multiplier)
+        return true;
+
+    assert(data);
+
+    /* Check for overflows of the section size: */
+    if ((std::numeric_limits<std::size_t>::max() / multiplier) < dataSize)
+        return false;
+    if (sectionPtr
+        && ((std::numeric_limits<std::size_t>::max() - sectionPtr->sizeInBytes)
+            < dataSize * multiplier))
+        return false;
+
+    if (!sectionPtr) {
+        sectionPtr = std::allocate_shared<ResizableDataSection>(
+                         std::pmr::polymorphic_allocator<ResizableDataSection>(
+                             memoryResource),
+                         memoryResource,
+                         data,
+                         dataSize,
+                         multiplier);
+    } else {
+        auto & resizeableSection =
+                *static_cast<ResizableDataSection *>(sectionPtr.get());
+        resizeableSection.addData(data, dataSize, multiplier);
+    }
+    return true;
+}
+
+/**
+  \brief Like dataSectionCreateOrAddData(), except that a new section refers to
+         the given data instead of copying it.
+*/
+bool dataSectionCreateOrAddSharedData(
+        std::shared_ptr<Executable::DataSection> & sectionPtr,
+        std::pmr::memory_resource * const memoryResource,
+        std::shared_ptr<void> data,
+        std::size_t const dataSize)
+{
+    if (sectionPtr || !dataSize)
+        return dataSectionCreateOrAddData(sectionPtr,
+                                          memoryResource,
+                                          data.get(),
+                                          dataSize);
+    assert(data);
+    sectionPtr = std::allocate_shared<ResizableDataSection>(
+                     std::pmr::polymorphic_allocator<ResizableDataSection>(
+                         memoryResource),
+                     memoryResource,
+                     std::move(data),
+                     dataSize);
+    return true;
+}
+
+std::shared_ptr<Executable::DataSection> & dataSectionPtr(
+        Executable::LinkingUnit & lu,
+        SectionType const sectionType) noexcept
+{
+    switch (sectionType) {
+        case SectionType::RoData:
+            return lu.roDataSection;
+        case SectionType::Data:
+            return lu.rwDataSection;
+        default:
+            assert(sectionType == SectionType::Debug);
+            return lu.debugSection;
+    }
+}
+
+std::shared_ptr<Executable::DataSection> const & dataSectionPtr(
+        Executable::LinkingUnit const & lu,
+        SectionType const sectionType) noexcept
+{
+    return dataSectionPtr(const_cast<Executable::LinkingUnit &>(lu),
+                          sectionType);
+}
+
+template <typename String>
+inline bool isLocalLabel(String const & label) noexcept
+{ return label.front() == '.'; }
+
+constexpr std::size_t const dataTypeWidths[8u] =
+        { 1u, 2u, 4u, 8u, 1u, 2u, 4u, 8u };
+
+/**
+  \returns whether the given 64-bit two's complement value is in the range of
+           the given .data type (0-3 for uint8-uint64, 4-7 for int8-int64).
+*/
+bool valueFitsDataType(std::uint64_t const v, std::uint_fast8_t const type)
+        noexcept
+{
+    auto const s = static_cast<std::int64_t>(v);
+    switch (type) {
+        case 0u: return v <= std::numeric_limits<std::uint8_t>::max();
+        case 1u: return v <= std::numeric_limits<std::uint16_t>::max();
+        case 2u: return v <= std::numeric_limits<std::uint32_t>::max();
+        case 4u:
+            return s >= std::numeric_limits<std::int8_t>::min()
+                   && s <= std::numeric_limits<std::int8_t>::max();
+        case 5u:
+            return s >= std::numeric_limits<std::int16_t>::min()
+                   && s <= std::numeric_limits<std::int16_t>::max();
+        case 6u:
+            return s >= std::numeric_limits<std::int32_t>::min()
+                   && s <= std::numeric_limits<std::int32_t>::max();
+        default:
+            assert(type == 3u || type == 7u);
+            return true;
+    }
+}
+
+std::size_t sectionSize(Executable::LinkingUnit const & lu,
+                        SectionType const sectionType) noexcept
+{
+    switch (sectionType) {
+        case SectionType::Text:
+            return lu.textSection ? lu.textSection->instructions.size() : 0u;
+        case SectionType::RoData:
+            return lu.roDataSection ? lu.roDataSection->sizeInBytes : 0u;
+        case SectionType::Data:
+            return lu.rwDataSection ? lu.rwDataSection->sizeInBytes : 0u;
+        case SectionType::Bss:
+            return lu.bssSection ? lu.bssSection->sizeInBytes : 0u;
+        case SectionType::Bind:
+            return lu.syscallBindingsSection
+                   ? lu.syscallBindingsSection->syscallBindings.size()
+                   : 0u;
+        case SectionType::PdBind:
+            return lu.pdBindingsSection
+                   ? lu.pdBindingsSection->pdBindings.size()
+                   : 0u;
+        default:
+            assert(sectionType == SectionType::Debug);
+            return lu.debugSection ? lu.debugSection->sizeInBytes : 0u;
+    }
+}
+
+/**
+  \returns the matching directive closing the block which contains the given
+           token, or end if the block is not closed.
+*/
+TokensVector::const_iterator findBlockEnd(TokensVector::const_iterator it,
+                                          TokensVector::const_iterator const end,
+                                          char const * const openDirective,
+                                          char const * const closeDirective)
+{
+    std::size_t depth = 0u;
+    for (; it != end; ++it) {
+        if (it->type() != Token::Type::DIRECTIVE)
+            continue;
+        if (it->directiveValue() == openDirective) {
+            ++depth;
+        } else if (it->directiveValue() == closeDirective) {
+            if (!depth)
+                return it;
+            --depth;
+        }
+    }
+    return end;
+}
+
+/**
+  \returns the given path, relative paths resolved against the directory of
+           the given including file, or against the current working directory
+           for the program itself.
+*/
+std::string resolvePath(std::pmr::string const & path,
+                        SourceFile const * const includingFile)
+{
+    if (!includingFile || path.empty() || (path.front() == '/'))
+        return std::string(path.begin(), path.end());
+    auto const & base = includingFile->path();
+    auto r(base.substr(0u, base.rfind('/') + 1u));
+    r.append(path.begin(), path.end());
+    return r;
+}
+
+#define LINK_FAIL(code) \
+    do { \
+        m_errorCode = ErrorCode::code; \
+        return false; \
+    } while ((0))
+
+#define SCRATCH_FAIL(code) \
+    do { \
+        scratch.errorCode = ErrorCode::code; \
+        return false; \
+    } while ((0))
+
+/** Links objects into an executable, see link(). */
+class Linker {
+
+private: /* Types: */
+
+    using SectionBases =
+            std::array<std::size_t,
+                       static_cast<std::size_t>(SectionType::Count)>;
+
+    /** The state of a thread resolving the label uses of objects. */
+    struct Scratch {
+
+    /* Methods: */
+
+        Scratch(std::pmr::memory_resource * const memoryResource)
+            : localLabelLocations(memoryResource)
+            , label(memoryResource)
+            , expression(memoryResource)
+        {}
+
+    /* Fields: */
+
+        LabelLocationMap localLabelLocations;
+        std::pmr::string label;
+        Expression expression;
+        ErrorCode errorCode = ErrorCode::OutOfMemory;
+        std::size_t errorToken = Object::noToken;
+        std::string errorLabel;
+
+    };
+
+public: /* Methods: */
+
+    Linker(std::pmr::memory_resource * const memoryResource,
+           Options const & options)
+        : m_memoryResource(memoryResource)
+        , m_options(options)
+        , m_labelLocations(memoryResource)
+        , m_bases(memoryResource)
+        , m_firstBases(memoryResource)
+        , m_instructionStarts(memoryResource)
+        , m_scratch(memoryResource)
+    {}
+
+    bool link(std::vector<Object const *> const & objects,
+              Executable & exe,
+              std::size_t numThreads)
+    {
+        std::size_t numLinkingUnits = 0u;
+        std::size_t numTokens = 0u;
+        for (auto const * const object : objects) {
+            numLinkingUnits =
+                    std::max(numLinkingUnits,
+                             object->executable.linkingUnits.size());
+            numTokens += object->numTokens;
+        }
+        if (!numLinkingUnits || !numTokens)
+            LINK_FAIL(EmptyProgram);
+        auto & lus = exe.linkingUnits;
+        lus.resize(numLinkingUnits);
+        m_instructionStarts.resize(numLinkingUnits);
+
+        m_labelLocations.emplace("RODATA", 1u);
+        m_labelLocations.emplace("DATA", 2u);
+        m_labelLocations.emplace("BSS", 3u);
+
+        /* Append the sections of the objects in order, and define the
+           non-local labels of the objects: */
+        for (auto const * const object : objects) {
+            if (unlikely(m_options.isCancelled()))
+                LINK_FAIL(Cancelled);
+            if (unlikely(m_options.isPastDeadline()))
+                LINK_FAIL(DeadlineExceeded);
+            m_errorObject = m_firstBases.size();
+
+            /* Keep the alignment of the sections of the object: */
+            for (auto const & a : object->alignments)
+                if (!alignSection(lus[a.linkingUnit], a.section, a.alignment))
+                    return false;
+
+            auto const firstBases = m_bases.size();
+            m_firstBases.push_back(firstBases);
+            auto const & objectLus = object->executable.linkingUnits;
+            for (std::size_t i = 0u; i < objectLus.size(); ++i) {
+                SectionBases bases;
+                for (std::size_t j = 0u; j < bases.size(); ++j)
+                    bases[j] = sectionSize(lus[i], static_cast<SectionType>(j));
+                m_bases.push_back(bases);
+                if (!appendSections(lus[i],
+                                    m_instructionStarts[i],
+                                    objectLus[i],
+                                    object->instructionStarts[i]))
+                    return false;
+            }
+
+            for (auto const & symbol : object->symbols) {
+                if (!isLocalLabel(symbol.name)
+                    && !defineLabel(m_scratch,
+                                    m_labelLocations,
+                                    symbol,
+                                    firstBases))
+                {
+                    m_errorLabel = symbol.name;
+                    LINK_FAIL(DuplicateLabel);
+                }
+            }
+            m_errorObject = Error::noObject;
+        }
+
+        /* Check the sizes of the sections: */
+        if (auto const max = m_options.maxSectionSize) {
+            for (auto const & lu : lus) {
+                if (lu.textSection
+                    && (lu.textSection->instructions.size()
+                        > max / sizeof(SharemindCodeBlock)))
+                    LINK_FAIL(SectionSizeLimitExceeded);
+                for (auto const type : { SectionType::RoData,
+                                         SectionType::Data,
+                                         SectionType::Bss,
+                                         SectionType::Debug })
+                    if (sectionSize(lu, type) > max)
+                        LINK_FAIL(SectionSizeLimitExceeded);
+            }
+        }
+
+        /* Resolve the label uses and pending expressions of the objects. As
+           the objects patch disjoint parts of the sections, this can be done
+           concurrently: */
+        if (!numThreads) {
+            numThreads = std::thread::hardware_concurrency();
+            if (!numThreads)
+                numThreads = 1u;
+        }
+        numThreads = std::min(numThreads, objects.size());
+        if (numThreads <= 1u) {
+            for (std::size_t i = 0u; i < objects.size(); ++i) {
+                if (!resolve(m_scratch, lus, *objects[i], m_firstBases[i])) {
+                    m_errorCode = m_scratch.errorCode;
+                    m_errorObject = i;
+                    m_errorToken = m_scratch.errorToken;
+                    m_errorLabel = std::move(m_scratch.errorLabel);
+                    return false;
+                }
+            }
+            return true;
+        }
+        return resolveConcurrently(objects, lus, numThreads);
+    }
+
+    ErrorCode errorCode() const noexcept { return m_errorCode; }
+
+    /** \returns the index of the object of the last error, or
+                 Error::noObject. */
+    std::size_t errorObject() const noexcept { return m_errorObject; }
+
+    /** \returns the index of the token of the last error in the tokens of its
+                 object, or Object::noToken. */
+    std::size_t errorToken() const noexcept { return m_errorToken; }
+
+    /** \returns the label of the last error, or an empty string. */
+    std::string const & errorLabel() const noexcept { return m_errorLabel; }
+
+private: /* Methods: */
+
+    template <typename T, typename ... Args>
+    std::shared_ptr<T> makeShared(Args && ... args) {
+        return std::allocate_shared<T>(
+                    std::pmr::polymorphic_allocator<T>(m_memoryResource),
+                    std::forward<Args>(args)...);
+    }
+
+    /** \brief Pads a RODATA, DATA or BSS section with zeroes to a multiple
+                  of the given power of two. */
+    bool alignSection(Executable::LinkingUnit & lu,
+                      SectionType const sectionType,
+                      std::size_t const alignment)
+    {
+        auto const size = sectionSize(lu, sectionType);
+        auto const padding = (alignment - (size & (alignment - 1u)))
+                             & (alignment - 1u);
+        if (!padding)
+            return true;
+        if (sectionType == SectionType::Bss) {
+            if (!lu.bssSection) {
+                lu.bssSection = makeShared<Executable::BssSection>(padding);
+            } else {
+                if ((std::numeric_limits<std::size_t>::max() - padding) < size)
+                    LINK_FAIL(SectionTooLarge);
+                lu.bssSection->sizeInBytes = size + padding;
+            }
+        } else {
+            char const zero = 0;
+            if (!dataSectionCreateOrAddData(dataSectionPtr(lu, sectionType),
+                                            m_memoryResource,
+                                            &zero,
+                                            1u,
+                                            padding))
+                LINK_FAIL(SectionTooLarge);
+        }
+        return true;
+    }
+
+    bool appendSections(Executable::LinkingUnit & lu,
+                        std::pmr::vector<bool> & instructionStarts,
+                        Executable::LinkingUnit const & objectLu,
+                        std::vector<bool> const & objectInstructionStarts)
+    {
+        if (objectLu.textSection) {
+            if (!lu.textSection)
+                lu.textSection = makeShared<Executable::TextSection>();
+            auto const & instructions = objectLu.textSection->instructions;
+            lu.textSection->instructions.insert(
+                        lu.textSection->instructions.end(),
+                        instructions.begin(),
+                        instructions.end());
+            instructionStarts.insert(instructionStarts.end(),
+                                     objectInstructionStarts.begin(),
+                                     objectInstructionStarts.end());
+        }
+        for (auto const type : { SectionType::RoData,
+                                 SectionType::Data,
+                                 SectionType::Debug })
+        {
+            /* The data is copied, because it is patched below: */
+            auto const & objectSection = dataSectionPtr(objectLu, type);
+            if (objectSection
+                && !dataSectionCreateOrAddData(dataSectionPtr(lu, type),
+                                               m_memoryResource,
+                                               objectSection->data.get(),
+                                               objectSection->sizeInBytes))
+                LINK_FAIL(SectionTooLarge);
+        }
+        if (objectLu.bssSection) {
+            auto const size = objectLu.bssSection->sizeInBytes;
+            if (!lu.bssSection) {
+                lu.bssSection = makeShared<Executable::BssSection>(size);
+            } else {
+                auto const oldSizeInBytes = lu.bssSection->sizeInBytes;
+                if ((std::numeric_limits<std::size_t>::max() - size)
+                    < oldSizeInBytes)
+                    LINK_FAIL(SectionTooLarge);
+                lu.bssSection->sizeInBytes = oldSizeInBytes + size;
+            }
+        }
+        if (objectLu.syscallBindingsSection) {
+            using SBS = Executable::SyscallBindingsSection;
+            if (!lu.syscallBindingsSection)
+                lu.syscallBindingsSection = makeShared<SBS>();
+            auto const & bindings =
+                    objectLu.syscallBindingsSection->syscallBindings;
+            lu.syscallBindingsSection->syscallBindings.insert(
+                        lu.syscallBindingsSection->syscallBindings.end(),
+                        bindings.begin(),
+                        bindings.end());
+        }
+        if (objectLu.pdBindingsSection) {
+            if (!lu.pdBindingsSection)
+                lu.pdBindingsSection =
+                        makeShared<Executable::PdBindingsSection>();
+            auto const & bindings = objectLu.pdBindingsSection->pdBindings;
+            lu.pdBindingsSection->pdBindings.insert(
+                        lu.pdBindingsSection->pdBindings.end(),
+                        bindings.begin(),
+                        bindings.end());
+        }
+        return true;
+    }
+
+    std::size_t base(std::size_t const firstBases,
+                     std::uint8_t const linkingUnit,
+                     SectionType const section) const noexcept
+    {
+        return m_bases[firstBases + linkingUnit][
+                    static_cast<std::size_t>(section)];
+    }
+
+    /** \returns false if the label is already defined. */
+    bool defineLabel(Scratch & scratch,
+                     LabelLocationMap & labels,
+                     Object::Symbol const & symbol,
+                     std::size_t const firstBases) const
+    {
+        scratch.label.assign(symbol.name.data(), symbol.name.size());
+        return labels.emplace(
+                    std::piecewise_construct,
+                    std::forward_as_tuple(scratch.label),
+                    std::make_tuple(
+                        LabelLocation(base(firstBases,
+                                           symbol.linkingUnit,
+                                           symbol.section) + symbol.offset,
+                                      symbol.section,
+                                      symbol.linkingUnit))).second;
+    }
+
+    LabelLocation const * findLabel(Scratch & scratch,
+                                    std::string_view const name) const
+    {
+        auto const & labels = isLocalLabel(name)
+                              ? scratch.localLabelLocations
+                              : m_labelLocations;
+        scratch.label.assign(name.data(), name.size());
+        auto const it(labels.find(scratch.label));
+        return (it != labels.end()) ? &it->second : nullptr;
+    }
+
+    /** \brief Resolves the label uses and pending expressions of an object. */
+    bool resolve(Scratch & scratch,
+                 decltype(Executable::linkingUnits) & lus,
+                 Object const & object,
+                 std::size_t const firstBases) const
+    {
+        scratch.localLabelLocations.clear();
+        scratch.errorToken = Object::noToken;
+        scratch.errorLabel.clear();
+        for (auto const & symbol : object.symbols) {
+            if (isLocalLabel(symbol.name)
+                && !defineLabel(scratch,
+                                scratch.localLabelLocations,
+                                symbol,
+                                firstBases))
+            {
+                scratch.errorLabel = symbol.name;
+                SCRATCH_FAIL(DuplicateLabel);
+            }
+        }
+        for (auto const & relocation : object.relocations) {
+            if (!relocate(scratch, lus, relocation, firstBases)) {
+                scratch.errorToken = relocation.tokenIndex;
+                scratch.errorLabel = relocation.label;
+                return false;
+            }
+        }
+        for (auto const & expression : object.expressions) {
+            if (!evaluate(scratch, lus, expression, firstBases)) {
+                scratch.errorToken = expression.tokenIndex;
+                /* The label not found was looked up last: */
+                if (scratch.errorCode == ErrorCode::UndefinedLabel)
+                    scratch.errorLabel.assign(scratch.label.data(),
+                                              scratch.label.size());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+      \brief Resolves the objects on the given number of threads, reporting the
+             error of the first object which fails, like resolving them in
+             order would.
+    */
+    bool resolveConcurrently(std::vector<Object const *> const & objects,
+                             decltype(Executable::linkingUnits) & lus,
+                             std::size_t const numThreads)
+    {
+        std::atomic<std::size_t> nextObject(0u);
+        std::atomic<std::size_t> firstFailed(objects.size());
+        std::mutex errorMutex;
+        auto const worker =
+                [this, &objects, &lus, &nextObject, &firstFailed, &errorMutex](
+                        Scratch & scratch) noexcept
+                {
+                    for (;;) {
+                        auto const i =
+                                nextObject.fetch_add(1u,
+                                                     std::memory_order_relaxed);
+                        if (i >= firstFailed.load(std::memory_order_relaxed))
+                            return;
+                        bool success;
+                        try {
+                            success = resolve(scratch,
+                                              lus,
+                                              *objects[i],
+                                              m_firstBases[i]);
+                        } catch (...) {
+                            scratch.errorCode = ErrorCode::OutOfMemory;
+                            success = false;
+                        }
+                        if (success)
+                            continue;
+                        std::lock_guard<std::mutex> const guard(errorMutex);
+                        if (i < firstFailed.load(std::memory_order_relaxed)) {
+                            firstFailed.store(i, std::memory_order_relaxed);
+                            m_errorCode = scratch.errorCode;
+                            m_errorObject = i;
+                            m_errorToken = scratch.errorToken;
+                            m_errorLabel.swap(scratch.errorLabel);
+                        }
+                    }
+                };
+
+        /* Objects not claimed by threads we failed to start are resolved by
+           the threads already running: */
+        std::vector<std::unique_ptr<Scratch> > scratches;
+        std::vector<std::thread> threads;
+        threads.reserve(numThreads - 1u);
+        for (std::size_t i = 1u; i < numThreads; ++i) {
+            try {
+                scratches.emplace_back(
+                            new Scratch(std::pmr::new_delete_resource()));
+                threads.emplace_back(worker, std::ref(*scratches.back()));
+            } catch (...) {
+                break;
+            }
+        }
+        worker(m_scratch);
+        for (auto & thread : threads)
+            thread.join();
+        return firstFailed.load(std::memory_order_relaxed) == objects.size();
+    }
+
+    /** \brief Writes the value of a label use like fillSlots() does. */
+    bool relocate(Scratch & scratch,
+                  decltype(Executable::linkingUnits) & lus,
+                  Object::Relocation const & r,
+                  std::size_t const firstBases) const
+    {
+        auto const * const l = findLabel(scratch, r.label);
+        if (!l)
+            SCRATCH_FAIL(UndefinedLabel);
+
+        std::size_t absTarget = l->offset;
+        if (l->section == SectionType::Invalid) {
+            if (r.addend != 0)
+                SCRATCH_FAIL(InvalidLabelOffset);
+        } else if (!assign_add_sizet_int64(&absTarget, r.addend)) {
+            SCRATCH_FAIL(InvalidLabelOffset);
+        }
+
+        auto const textBase =
+                base(firstBases, r.linkingUnit, SectionType::Text);
+        SharemindCodeBlock toWrite;
+        if (!r.isJump) { /* Normal absolute label */
+            toWrite.uint64[0u] = absTarget;
+        } else { /* Relative jump label */
+            if ((l->section != SectionType::Text)
+                || (l->linkingUnit != r.linkingUnit))
+                SCRATCH_FAIL(InvalidLabel);
+            if (!substract_2sizet_to_int64(&toWrite.int64[0u],
+                                           absTarget,
+                                           textBase + r.jumpOffset))
+                SCRATCH_FAIL(InvalidLabelOffset);
+            auto const & starts = m_instructionStarts[r.linkingUnit];
+            if ((absTarget >= starts.size()) || !starts[absTarget])
+                SCRATCH_FAIL(InvalidJumpTarget);
+        }
+        lus[r.linkingUnit].textSection->instructions[textBase + r.codeIndex] =
+                toWrite;
+        return true;
+    }
+
+    /**
+      \brief Evaluates and writes a pending expression like
+             Assembler::Inner::evaluatePendingExpressions() does.
+    */
+    bool evaluate(Scratch & scratch,
+                  decltype(Executable::linkingUnits) & lus,
+                  Object::PendingExpression const & p,
+                  std::size_t const firstBases) const
+    {
+        auto & expression = scratch.expression;
+        expression = p.expression;
+        for (auto & label : expression.labels()) {
+            if (label.resolved)
+                continue;
+            auto const * const l = findLabel(scratch, label.name);
+            if (!l)
+                SCRATCH_FAIL(UndefinedLabel);
+            label.value = l->offset;
+            label.resolved = true;
+        }
+
+        auto & lu = lus[p.linkingUnit];
+        std::uint64_t value;
+        if (expression.evaluate(
+                value,
+                [&lu](SectionType const type, std::uint64_t & size) noexcept
+                {
+                    size = sectionSize(lu, type);
+                    return true;
+                }) != Expression::EvaluationResult::Ok)
+            SCRATCH_FAIL(InvalidExpression);
+
+        auto const offset = base(firstBases, p.linkingUnit, p.section)
+                            + p.offset;
+        if (p.section == SectionType::Text) {
+            lu.textSection->instructions[offset].uint64[0u] = value;
+            return true;
+        }
+        if (!valueFitsDataType(value, p.dataType))
+            SCRATCH_FAIL(InvalidParameter);
+        if ((p.section != SectionType::Bss) && p.multiplier) {
+            auto const width = dataTypeWidths[p.dataType];
+            auto const & section = dataSectionPtr(lu, p.section);
+            auto * writePtr =
+                    static_cast<char *>(section->data.get()) + offset;
+            for (auto i = p.multiplier; i; --i, writePtr += width)
+                std::memcpy(writePtr, &value, width);
+        }
+        return true;
+    }
+
+private: /* Fields: */
+
+    std::pmr::memory_resource * const m_memoryResource;
+    Options const & m_options;
+    LabelLocationMap m_labelLocations;
+
+    /** For each linking unit of each object, the offsets of its sections in
+        the sections of the executable. */
+    std::pmr::vector<SectionBases> m_bases;
+
+    /** For each object, the index of its first linking unit in m_bases. */
+    std::pmr::vector<std::size_t> m_firstBases;
+
+    std::pmr::vector<std::pmr::vector<bool> > m_instructionStarts;
+    Scratch m_scratch;
+    ErrorCode m_errorCode = ErrorCode::OutOfMemory;
+    std::size_t m_errorObject = Error::noObject;
+    std::size_t m_errorToken = Object::noToken;
+    std::string m_errorLabel;
+
+};
+
+#undef SCRATCH_FAIL
+#undef LINK_FAIL
+
+/** \brief Applies the optimizations enabled in the options to the object of a
+           whole program. */
+void optimizeObject(Object & object, Options const & options) {
+    if (options.gcSections)
+        gcSections(object);
+    if (options.peephole) {
+        peephole(object);
+        /* Threaded jumps may leave jumps unreachable: */
+        if (options.gcSections)
+            gcSections(object);
+    }
+    if (options.foldCode)
+        foldCode(object);
+    if (options.mergeRoData)
+        mergeRoData(object);
+    if (options.pruneBindings)
+        pruneBindings(object);
+    if (options.zeroDataToBss)
+        zeroDataToBss(object);
+    if (options.profile)
+        layoutCode(object, *options.profile);
+}
+
+} // anonymous namespace
+
+#define EOF_TEST     (unlikely(  t >= e))
+#define INC_EOF_TEST (unlikely(++t >= e))
+
+#define ASSEMBLE_FAIL(code, it) \
+    do { \
+        m_errorCode = ErrorCode::code; \
+        m_errorToken = (it); \
+        return false; \
+    } while ((0))
+
+#define INC_CHECK_EOF \
+    if (INC_EOF_TEST) { \
+        ASSEMBLE_FAIL(UnexpectedEndOfFile, e); \
+    } else (void) 0
+
+#define DO_EOL(eof,noexpect) \
+    do { \
+        if (EOF_TEST) \
+            goto eof; \
+        if (unlikely(t->type() != Token::Type::NEWLINE)) \
+            goto noexpect; \
+    } while ((0))
+
+#define INC_DO_EOL(eof,noexpect) \
+    do { \
+        t++; \
+        DO_EOL(eof,noexpect); \
+    } while ((0))
+
+struct Assembler::Inner {
+
+/* Methods: */
+
+    Inner(std::pmr::memory_resource * const memoryResource)
+        : m_memoryResource(memoryResource)
+        , m_labelLocations(memoryResource)
+        , m_labelSlots(memoryResource)
+        , m_localLabelLocations(memoryResource)
+        , m_localLabelSlots(memoryResource)
+        , m_freeSlots(memoryResource)
+        , m_instructionStarts(memoryResource)
+        , m_pendingJumpTargets(memoryResource)
+        , m_expression(memoryResource)
+        , m_pendingExpressions(memoryResource)
+        , m_relocationTokens(memoryResource)
+        , m_frames(memoryResource)
+        , m_sourceFiles(memoryResource)
+        , m_macros(memoryResource)
+        , m_expansions(memoryResource)
+        , m_label(memoryResource)
+        , m_dataToWrite(memoryResource)
+        , m_tokens(memoryResource)
+    {}
+
+    template <typename T, typename ... Args>
+    std::shared_ptr<T> makeShared(Args && ... args) {
+        return std::allocate_shared<T>(
+                    std::pmr::polymorphic_allocator<T>(m_memoryResource),
+                    std::forward<Args>(args)...);
+    }
+
+    void reset() {
+        for (auto & labelSlots : m_labelSlots)
+            recycleSlots(labelSlots.second);
+        m_labelSlots.clear();
+        for (auto & labelSlots : m_localLabelSlots)
+            recycleSlots(labelSlots.second);
+        m_localLabelSlots.clear();
+        m_localLabelLocations.clear();
+        m_labelLocations.clear();
+        m_labelLocations.emplace("RODATA", 1u);
+        m_labelLocations.emplace("DATA", 2u);
+        m_labelLocations.emplace("BSS", 3u);
+        for (auto & instructionStarts : m_instructionStarts)
+            instructionStarts.clear();
+        m_pendingJumpTargets.clear();
+        m_pendingExpressions.clear();
+        m_localScopeFirstExpression = 0u;
+        m_relocationTokens.clear();
+        m_localScopeFirstRelocation = 0u;
+        m_localScopeIndex = 0u;
+        m_numPendingRelocations = 0u;
+        m_numTokens = 0u;
+        m_frames.clear();
+        m_sourceFiles.clear();
+        m_macros.clear();
+        m_numExpansions = 0u;
+        m_currentFile = nullptr;
+        m_includeError = Error();
+    }
+
+    /**
+      \brief Accounts for another label use, jump target or expression which
+             waits for labels defined later in the input.
+      \returns false if this exceeds Options::maxPendingRelocations.
+    */
+    bool addPendingRelocation(TokensVector::const_iterator const tokenIt) {
+        auto const max = m_options->maxPendingRelocations;
+        if (unlikely(max && (m_numPendingRelocations >= max)))
+            ASSEMBLE_FAIL(TooManyPendingRelocations, tokenIt);
+        ++m_numPendingRelocations;
+        return true;
+    }
+
+    /**
+      \returns whether adding multiplier copies of dataSize bytes to a section
+               of oldSize bytes keeps it within Options::maxSectionSize.
+    */
+    bool fitsSectionSizeLimit(std::size_t const oldSize,
+                              std::size_t const dataSize,
+                              std::size_t const multiplier) const noexcept
+    {
+        auto const max = m_options->maxSectionSize;
+        if (!max || !dataSize || !multiplier)
+            return true;
+        return (oldSize <= max) && ((max - oldSize) / multiplier >= dataSize);
+    }
+
+    std::pmr::vector<bool> & instructionStarts(std::uint8_t const lu) {
+        if (lu >= m_instructionStarts.size())
+            m_instructionStarts.resize(lu + 1u);
+        return m_instructionStarts[lu];
+    }
+
+    /**
+      \brief Checks whether an instruction starts at the given jump target.
+      \returns false if the target is known to be invalid.
+      \note Checks for targets past the instructions written so far are
+            deferred to checkPendingJumpTargets().
+    */
+    bool checkJumpTarget(std::uint8_t const lu,
+                         std::size_t const target,
+                         TokensVector::const_iterator const tokenIt)
+    {
+        auto const & starts = instructionStarts(lu);
+        if (target < starts.size()) {
+            if (!starts[target])
+                ASSEMBLE_FAIL(InvalidJumpTarget, tokenIt);
+            return true;
+        }
+        if (!addPendingRelocation(tokenIt))
+            return false;
+        m_pendingJumpTargets.push_back(
+                    PendingJumpTarget{target, originalToken(tokenIt), lu});
+        return true;
+    }
+
+    bool checkPendingJumpTargets() {
+        for (auto const & p : m_pendingJumpTargets) {
+            auto const & starts = instructionStarts(p.linkingUnit);
+            if ((p.target >= starts.size()) || !starts[p.target])
+                ASSEMBLE_FAIL(InvalidJumpTarget, p.tokenIt);
+        }
+        return true;
+    }
+
+    bool fillSlots(LabelSlotsVector & slots,
+                   LabelLocation const & l,
+                   TokensVector::const_iterator const labelIt,
+                   TokensVector::const_iterator const endIt)
+    {
+        for (auto & value : slots) {
+            assert(value.tokenIt != endIt);
+
+            std::size_t absTarget = l.offset;
+            if (!assign_add_sizet_int64(&absTarget, value.extraOffset))
+                ASSEMBLE_FAIL(InvalidLabelOffset, value.tokenIt);
+
+            SharemindCodeBlock toWrite;
+            if (!value.doJumpLabel) { /* Normal absolute label */
+                toWrite.uint64[0u] = absTarget;
+            } else { /* Relative jump label */
+                if ((l.section != SectionType::Text)
+                    || (value.linkingUnit != l.linkingUnit))
+                    ASSEMBLE_FAIL(InvalidLabel, labelIt);
+
+                assert(value.jmpOffset < l.offset); /* Because we're one-pass. */
+
+                if (!substract_2sizet_to_int64(&toWrite.int64[0u],
+                                               absTarget,
+                                               value.jmpOffset))
+                    ASSEMBLE_FAIL(InvalidLabelOffset, value.tokenIt);
+                if (!checkJumpTarget(l.linkingUnit, absTarget, value.tokenIt))
+                    return false;
+            }
+            value.codeSection[value.cbdata_index] = toWrite;
+            value.tokenIt = endIt;
+        }
+        m_numPendingRelocations -= slots.size();
+        return true;
+    }
+
+    LabelSlotsVector & slotsFor(LabelSlotsMap & labelSlots,
+                                std::pmr::string const & label)
+    {
+        auto it(labelSlots.find(label));
+        if (it == labelSlots.end()) {
+            if (m_freeSlots.empty()) {
+                it = labelSlots.emplace(label, LabelSlotsVector()).first;
+            } else {
+                it = labelSlots.emplace(label,
+                                        std::move(m_freeSlots.back())).first;
+                m_freeSlots.pop_back();
+            }
+        }
+        return it->second;
+    }
+
+    /**
+      \brief Ends the scope of the current local labels, releasing them.
+      \returns false if any of the local labels used was not defined.
+    */
+    bool closeLocalLabelScope() {
+        if (unlikely(!m_localLabelSlots.empty()))
+            ASSEMBLE_FAIL(UndefinedLabel,
+                          m_localLabelSlots.begin()->second.begin()->tokenIt);
+        if (m_object)
+            return closeObjectLocalLabelScope();
+
+        /* Resolve the local labels of expressions deferred in this scope: */
+        for (auto i = m_localScopeFirstExpression;
+             i < m_pendingExpressions.size();
+             ++i)
+        {
+            auto & p = m_pendingExpressions[i];
+            for (auto & label : p.expression.labels()) {
+                if (label.resolved || !isLocalLabel(label.name))
+                    continue;
+                auto const it(m_localLabelLocations.find(label.name));
+                if (it == m_localLabelLocations.end())
+                    ASSEMBLE_FAIL(UndefinedLabel, p.tokenIt);
+                label.value = it->second.offset;
+                label.resolved = true;
+            }
+        }
+        m_localScopeFirstExpression = m_pendingExpressions.size();
+
+        m_localLabelLocations.clear();
+        return true;
+    }
+
+    /**
+      \brief Ends the scope of the current local labels of an object, making
+             the names of the labels and of their uses unique in the object.
+      \returns false if any of the local labels used was not defined.
+    */
+    bool closeObjectLocalLabelScope() {
+        auto & object = *m_object;
+        auto const suffix(concat('@', m_localScopeIndex));
+        auto const isDefined =
+                [this](auto const & label) {
+                    m_label.assign(label.data(), label.size());
+                    return m_localLabelLocations.find(m_label)
+                           != m_localLabelLocations.end();
+                };
+
+        auto & relocations = object.relocations;
+        for (auto i = m_localScopeFirstRelocation;
+             i < relocations.size();
+             ++i)
+        {
+            auto & label = relocations[i].label;
+            if (!isLocalLabel(label))
+                continue;
+            if (!isDefined(label))
+                ASSEMBLE_FAIL(UndefinedLabel, m_relocationTokens[i]);
+            label.append(suffix);
+        }
+        m_localScopeFirstRelocation = relocations.size();
+
+        for (auto i = m_localScopeFirstExpression;
+             i < m_pendingExpressions.size();
+             ++i)
+        {
+            auto & p = m_pendingExpressions[i];
+            for (auto & label : p.expression.labels()) {
+                if (label.resolved || !isLocalLabel(label.name))
+                    continue;
+                if (!isDefined(label.name))
+                    ASSEMBLE_FAIL(UndefinedLabel, p.tokenIt);
+                label.name.append(suffix.begin(), suffix.end());
+            }
+        }
+        m_localScopeFirstExpression = m_pendingExpressions.size();
+
+        for (auto const & label : m_localLabelLocations) {
+            auto const & l = label.second;
+            object.symbols.push_back(
+                        Object::Symbol{
+                            concat(std::string(label.first.begin(),
+                                               label.first.end()),
+                                   suffix),
+                            l.offset,
+                            l.section,
+                            l.linkingUnit});
+        }
+        m_localLabelLocations.clear();
+        ++m_localScopeIndex;
+        return true;
+    }
+
+    /**
+      \returns whether the current scope of local labels of an object defines
+               or uses any local labels.
+    */
+    bool objectLocalLabelScopeIsUsed() const noexcept {
+        if (!m_localLabelLocations.empty())
+            return true;
+        auto const & relocations = m_object->relocations;
+        for (auto i = m_localScopeFirstRelocation;
+             i < relocations.size();
+             ++i)
+            if (isLocalLabel(relocations[i].label))
+                return true;
+        for (auto i = m_localScopeFirstExpression;
+             i < m_pendingExpressions.size();
+             ++i)
+            for (auto const & label
+                 : m_pendingExpressions[i].expression.labels())
+                if (!label.resolved && isLocalLabel(label.name))
+                    return true;
+        return false;
+    }
+
+    /**
+      \brief Completes m_object with its labels, its pending expressions and
+             the state of the assembler at the end of the part.
+    */
+    /**
+      \returns the index of the given token, or of its original if it was
+               copied by a macro expansion, in the tokens assembled, or
+               Object::noToken if it is in an included file.
+    */
+    std::size_t assembledTokenIndex(TokensVector::const_iterator const it)
+            const noexcept
+    {
+        auto const & ts = *m_assembledTokens;
+        std::less<Token const *> const less;
+        auto const * const token = &*it;
+        if (!less(token, ts.data()) && less(token, ts.data() + ts.size()))
+            return static_cast<std::size_t>(token - ts.data());
+        auto const * const text = token->text();
+        auto const original(std::lower_bound(
+                          ts.begin(),
+                          ts.end(),
+                          text,
+                          [](Token const & t, char const * const ptr) {
+                              return std::less<char const *>()(t.text(), ptr);
+                          }));
+        if ((original != ts.end()) && (original->text() == text))
+            return static_cast<std::size_t>(original - ts.begin());
+        return Object::noToken;
+    }
+
+    bool finishObject(Executable const & exe,
+                      std::uint8_t const lu_index,
+                      SectionType const sectionType)
+    {
+        auto & object = *m_object;
+        object.end.linkingUnit = lu_index;
+        object.end.section = sectionType;
+        object.end.numLinkingUnits = exe.linkingUnits.size();
+        object.numTokens = m_numTokens;
+
+        /* Whether the scope of local labels ends with the part: */
+        bool const scopeEnds =
+                (object.successor == Object::Successor::EndOfProgram)
+                || ((object.successor == Object::Successor::Label)
+                    && (sectionType == SectionType::Text));
+        if (!scopeEnds && objectLocalLabelScopeIsUsed()) {
+            object.localScopeOpen = true;
+            return true;
+        }
+        if (!closeLocalLabelScope())
+            return false;
+
+        for (auto const & label : m_labelLocations) {
+            auto const & l = label.second;
+            if (l.section == SectionType::Invalid)
+                continue;
+            object.symbols.push_back(
+                        Object::Symbol{std::string(label.first.begin(),
+                                                   label.first.end()),
+                                       l.offset,
+                                       l.section,
+                                       l.linkingUnit});
+        }
+
+        for (auto & p : m_pendingExpressions)
+            object.expressions.push_back(
+                        Object::PendingExpression{
+                                            std::move(p.expression),
+                                            p.linkingUnit,
+                                            p.section,
+                                            p.offset,
+                                            p.multiplier,
+                                            p.dataType,
+                                            assembledTokenIndex(p.tokenIt)});
+        m_pendingExpressions.clear();
+
+        auto & starts = object.instructionStarts;
+        starts.resize(exe.linkingUnits.size());
+        for (std::size_t i = 0u;
+             (i < starts.size()) && (i < m_instructionStarts.size());
+             ++i)
+            starts[i].assign(m_instructionStarts[i].begin(),
+                             m_instructionStarts[i].end());
+        return true;
+    }
+
+    /**
+      \brief Parses the given EXPRESSION token into m_expression and evaluates
+             it if all labels it refers to are already defined.
+      \param[out] value Where to write the value if it was evaluated.
+      \param[out] evaluated Whether the value was evaluated.
+    */
+    bool parseExpression(TokensVector::const_iterator const tokenIt,
+                         std::uint64_t & value,
+                         bool & evaluated)
+    {
+        auto & expression = m_expression;
+        if (!expression.parse(tokenIt->text(), tokenIt->length()))
+            ASSEMBLE_FAIL(InvalidExpression, tokenIt);
+        for (auto & label : expression.labels()) {
+            auto const & labels = isLocalLabel(label.name)
+                                  ? m_localLabelLocations
+                                  : m_labelLocations;
+            auto const it(labels.find(label.name));
+            /* Objects refer to their own labels by name until linked: */
+            if ((it != labels.end())
+                && (!m_object
+                    || (it->second.section == SectionType::Invalid)))
+            {
+                label.value = it->second.offset;
+                label.resolved = true;
+            }
+        }
+        switch (expression.evaluate(value)) {
+            case Expression::EvaluationResult::Ok:
+                evaluated = true;
+                return true;
+            case Expression::EvaluationResult::Unresolved:
+                evaluated = false;
+                return true;
+            default:
+                ASSEMBLE_FAIL(InvalidExpression, tokenIt);
+        }
+    }
+
+    /** \brief Defers the evaluation of m_expression to the end of assembly. */
+    PendingExpression & deferExpression(
+            TokensVector::const_iterator const tokenIt,
+            std::uint8_t const lu)
+    {
+        m_pendingExpressions.emplace_back(std::move(m_expression),
+                                          originalToken(tokenIt),
+                                          lu);
+        m_expression = Expression(m_memoryResource);
+        return m_pendingExpressions.back();
+    }
+
+    /**
+      \brief Appends the given range of a file to a RODATA, DATA or DEBUG
+             section, sharing the mapping of the file if possible.
+      \param[in] lastIt The last token of the directive.
+    */
+    bool includeBinary(Executable::LinkingUnit & lu,
+                       SectionType const sectionType,
+                       TokensVector::const_iterator const pathIt,
+                       TokensVector::const_iterator const lastIt,
+                       std::uint64_t const offset,
+                       std::uint64_t const length)
+    {
+        auto & sectionPtr = dataSectionPtr(lu, sectionType);
+        auto const oldSize = sectionPtr ? sectionPtr->sizeInBytes : 0u;
+
+        /* Nothing is read past the size limit of the section: */
+        auto maxLength = readFileToEnd;
+        if (auto const max = m_options->maxSectionSize)
+            maxLength = (oldSize < max) ? max - oldSize : 0u;
+
+        std::shared_ptr<void> data;
+        std::size_t size;
+        switch (readFile(resolvePath(pathIt->stringValue(),
+                                     m_currentFile).c_str(),
+                         offset,
+                         length,
+                         m_memoryResource,
+                         data,
+                         size,
+                         true,
+                         maxLength))
+        {
+            case ReadFileResult::Ok:
+                break;
+            case ReadFileResult::InvalidRange:
+                ASSEMBLE_FAIL(InvalidParameter, lastIt);
+            case ReadFileResult::TooLarge:
+                ASSEMBLE_FAIL(SectionSizeLimitExceeded, pathIt);
+            default:
+                ASSEMBLE_FAIL(FileReadError, pathIt);
+        }
+
+        if (!fitsSectionSizeLimit(oldSize, size, 1u))
+            ASSEMBLE_FAIL(SectionSizeLimitExceeded, pathIt);
+        if (!dataSectionCreateOrAddSharedData(sectionPtr,
+                                              m_memoryResource,
+                                              std::move(data),
+                                              size))
+            ASSEMBLE_FAIL(SectionTooLarge, pathIt);
+        return true;
+    }
+
+    /**
+      \brief Pads a RODATA, DATA or BSS section with the given byte to a
+             multiple of the given power of two, which objects record so that
+             it is kept by linking.
+      \param[in] it The token to report errors at.
+    */
+    bool alignSection(Executable::LinkingUnit & lu,
+                      std::uint8_t const lu_index,
+                      SectionType const sectionType,
+                      std::size_t const alignment,
+                      std::uint8_t const fill,
+                      TokensVector::const_iterator const it)
+    {
+        assert(alignment && !(alignment & (alignment - 1u)));
+        if (alignment <= 1u)
+            return true;
+        if (m_object) {
+            auto & alignments = m_object->alignments;
+            auto const a(std::find_if(
+                             alignments.begin(),
+                             alignments.end(),
+                             [lu_index, sectionType](
+                                     Object::Alignment const & a_) noexcept
+                             {
+                                 return (a_.linkingUnit == lu_index)
+                                        && (a_.section == sectionType);
+                             }));
+            if (a == alignments.end()) {
+                alignments.push_back(
+                            Object::Alignment{lu_index, sectionType, alignment});
+            } else {
+                a->alignment = std::max(a->alignment, alignment);
+            }
+        }
+
+        auto const size = sectionSize(lu, sectionType);
+        auto const padding = (alignment - (size & (alignment - 1u)))
+                             & (alignment - 1u);
+        if (!padding)
+            return true;
+        if (!fitsSectionSizeLimit(size, padding, 1u))
+            ASSEMBLE_FAIL(SectionSizeLimitExceeded, it);
+        if (sectionType == SectionType::Bss) {
+            if (!lu.bssSection) {
+                lu.bssSection = makeShared<Executable::BssSection>(padding);
+            } else {
+                if ((std::numeric_limits<std::size_t>::max() - padding) < size)
+                    ASSEMBLE_FAIL(SectionTooLarge, it);
+                lu.bssSection->sizeInBytes = size + padding;
+            }
+        } else if (!dataSectionCreateOrAddData(dataSectionPtr(lu, sectionType),
+                                               m_memoryResource,
+                                               &fill,
+                                               1u,
+                                               padding))
+        {
+            ASSEMBLE_FAIL(SectionTooLarge, it);
+        }
+        return true;
+    }
+
+    /**
+      \returns the natural alignment of the values of the .data or .fill
+               directive following the given label after only newlines and
+               labels, or 1 if there is none.
+    */
+    static std::size_t alignmentAfterLabel(
+            TokensVector::const_iterator t,
+            TokensVector::const_iterator const e) noexcept
+    {
+        while ((++t != e)
+               && ((t->type() == Token::Type::NEWLINE)
+                   || (t->type() == Token::Type::LABEL)))
+        {}
+        if ((t == e) || (t->type() != Token::Type::DIRECTIVE))
+            return 1u;
+        if (t->directiveValue() == "fill") {
+            if ((++t == e) || (t->type() != Token::Type::UHEX))
+                return 1u;
+        } else if (t->directiveValue() != "data") {
+            return 1u;
+        }
+        if ((++t == e) || (t->type() != Token::Type::KEYWORD))
+            return 1u;
+        auto const type(t->keywordValue());
+        if ((type == "uint16") || (type == "int16"))
+            return 2u;
+        if ((type == "uint32") || (type == "int32"))
+            return 4u;
+        if ((type == "uint64") || (type == "int64"))
+            return 8u;
+        return 1u;
+    }
+
+    /**
+      \brief Continues assembly from the tokens of the given included file.
+      \param[in,out] t The path of the .include directive, set to the first
+                       token of the file.
+      \param[in,out] e The end of the current tokens, set to the end of the
+                       tokens of the file.
+    */
+    bool enterSourceFile(TokensVector::const_iterator & t,
+                         TokensVector::const_iterator & e)
+    {
+        std::shared_ptr<SourceFile const> file;
+        {
+            Error error;
+            if (!loadSourceFile(resolvePath(t->stringValue(),
+                                            m_currentFile).c_str(),
+                                *m_options,
+                                file,
+                                error))
+            {
+                /* Keep the full error of files which failed to tokenize: */
+                if (error.sourceFile()) {
+                    m_includeError = std::move(error);
+                    ASSEMBLE_FAIL(FileReadError, t);
+                }
+                m_errorCode = error.code();
+                m_errorToken = t;
+                return false;
+            }
+        }
+
+        /* Check for cycles: */
+        if (m_currentFile && (m_currentFile->path() == file->path()))
+            ASSEMBLE_FAIL(IncludeCycle, t);
+        for (auto const & frame : m_frames)
+            if (frame.file && (frame.file->path() == file->path()))
+                ASSEMBLE_FAIL(IncludeCycle, t);
+
+        if (!countTokens(file->tokens().size(), t))
+            return false;
+
+        m_frames.push_back(ExpansionFrame{ExpansionFrame::Kind::Include,
+                                          t + 1,
+                                          e,
+                                          m_currentFile,
+                                          {},
+                                          0u,
+                                          nullptr});
+        m_currentFile = file.get();
+        t = file->tokens().begin();
+        e = file->tokens().end();
+        /* The tokens of the file are referred to until assembly finishes: */
+        for (auto const & sourceFile : m_sourceFiles)
+            if (sourceFile == file)
+                return true;
+        m_sourceFiles.emplace_back(std::move(file));
+        return true;
+    }
+
+    /**
+      \brief Continues assembly from the first repetition of a .rept block.
+      \param[in,out] t The NEWLINE token ending the .rept line, set to the
+                       position to continue from.
+      \param[in,out] e The end of the current tokens, set to the .endr
+                       directive unless the block is skipped.
+    */
+    bool enterRepeat(TokensVector::const_iterator & t,
+                     TokensVector::const_iterator & e,
+                     std::uint64_t const count)
+    {
+        auto const endIt(findBlockEnd(t + 1, e, "rept", "endr"));
+        if (unlikely(endIt == e))
+            ASSEMBLE_FAIL(UnexpectedEndOfFile, e);
+        auto const resumeIt(endIt + 1);
+        if (unlikely((resumeIt != e)
+                     && (resumeIt->type() != Token::Type::NEWLINE)))
+            ASSEMBLE_FAIL(UnexpectedToken, resumeIt);
+
+        /* Skip empty blocks and blocks repeated zero times: */
+        if (!count || ((t + 1) == endIt)) {
+            t = resumeIt;
+            return true;
+        }
+
+        if (!countTokens(static_cast<std::size_t>(endIt - t), t))
+            return false;
+        m_frames.push_back(ExpansionFrame{ExpansionFrame::Kind::Repeat,
+                                          resumeIt,
+                                          e,
+                                          m_currentFile,
+                                          t,
+                                          count - 1u,
+                                          nullptr});
+        e = endIt;
+        return true;
+    }
+
+    /**
+      \brief Defines a macro.
+      \param[in,out] t The .macro directive, set to the token after the .endm
+                       directive.
+    */
+    bool defineMacro(TokensVector::const_iterator & t,
+                     TokensVector::const_iterator const e)
+    {
+        INC_CHECK_EOF;
+        if (unlikely(t->type() != Token::Type::KEYWORD))
+            ASSEMBLE_FAIL(InvalidParameter, t);
+        auto const nameIt(t);
+
+        MacroDefinition macro(m_memoryResource);
+        for (;;) {
+            INC_CHECK_EOF;
+            if (t->type() == Token::Type::NEWLINE)
+                break;
+            if (unlikely(t->type() != Token::Type::KEYWORD))
+                ASSEMBLE_FAIL(InvalidParameter, t);
+            for (auto const & parameterIt : macro.parameters)
+                if (parameterIt->keywordValue() == t->keywordValue())
+                    ASSEMBLE_FAIL(InvalidParameter, t);
+            macro.parameters.emplace_back(t);
+        }
+        macro.bodyIt = t;
+        macro.endIt = findBlockEnd(t + 1, e, "macro", "endm");
+        if (unlikely(macro.endIt == e))
+            ASSEMBLE_FAIL(UnexpectedEndOfFile, e);
+        macro.file = m_currentFile;
+        t = macro.endIt + 1;
+        if (unlikely((t != e) && (t->type() != Token::Type::NEWLINE)))
+            ASSEMBLE_FAIL(UnexpectedToken, t);
+
+        auto const r(m_macros.emplace(nameIt->keywordValue(),
+                                      std::move(macro)));
+        if (!r.second)
+            ASSEMBLE_FAIL(DuplicateMacro, nameIt);
+        if (m_numExpansions
+            && containsToken(m_expansions[m_numExpansions - 1u], nameIt))
+            copyMacroTokens(r.first->second, nameIt + 1);
+        return true;
+    }
+
+    /**
+      rief Points a macro defined by a macro expansion to a copy of the
+             tokens of its definition from the given token to its end.
+    */
+    static void copyMacroTokens(MacroDefinition & macro,
+                                TokensVector::const_iterator const firstIt)
+    {
+        auto & tokens = macro.tokens;
+        tokens.assign(firstIt, macro.endIt + 1);
+        auto const copyOf =
+                [&tokens, firstIt](TokensVector::const_iterator const it) {
+                    return tokens.cbegin() + (it - firstIt);
+                };
+        for (auto & parameterIt : macro.parameters)
+            parameterIt = copyOf(parameterIt);
+        macro.bodyIt = copyOf(macro.bodyIt);
+        macro.endIt = copyOf(macro.endIt);
+    }
+
+    /**
+      \brief Continues assembly from a copy of the body of the given macro
+             with its parameters replaced by the arguments of the call.
+      \param[in,out] t The directive calling the macro, set to the first token
+                       of the copy.
+      \param[in,out] e The end of the current tokens, set to the copy of the
+                       .endm directive.
+    */
+    bool expandMacro(TokensVector::const_iterator & t,
+                     TokensVector::const_iterator & e,
+                     MacroDefinition const & macro)
+    {
+        for (auto const & frame : m_frames)
+            if (frame.macro == &macro)
+                ASSEMBLE_FAIL(RecursiveMacro, t);
+
+        auto const argumentsIt(t + 1);
+        auto argumentsEnd(argumentsIt);
+        while ((argumentsEnd != e)
+               && (argumentsEnd->type() != Token::Type::NEWLINE))
+            ++argumentsEnd;
+        auto const & parameters = macro.parameters;
+        if (unlikely(static_cast<std::size_t>(argumentsEnd - argumentsIt)
+                     != parameters.size()))
+            ASSEMBLE_FAIL(InvalidNumberOfArguments, t);
+
+        /* The copies refer to the text of the original tokens and are
+           allocated from m_memoryResource by the deque. The tokens of every
+           level of nested expansions are reused by later expansions, as no
+           references to them are kept, see originalToken(): */
+        if (m_numExpansions == m_expansions.size())
+            m_expansions.emplace_back();
+        auto & tokens = m_expansions[m_numExpansions];
+        tokens.clear();
+        tokens.reserve(static_cast<std::size_t>(macro.endIt - macro.bodyIt)
+                       + 1u);
+        for (auto it(macro.bodyIt); it != macro.endIt; ++it) {
+            auto source(it);
+            if (it->type() == Token::Type::KEYWORD) {
+                for (std::size_t i = 0u; i < parameters.size(); ++i) {
+                    if (parameters[i]->keywordValue() == it->keywordValue()) {
+                        source = argumentsIt + static_cast<std::ptrdiff_t>(i);
+                        break;
+                    }
+                }
+            }
+            tokens.emplace_back(*source);
+        }
+        tokens.emplace_back(*macro.endIt);
+
+        if (!countTokens(tokens.size(), t))
+            return false;
+        m_frames.push_back(ExpansionFrame{ExpansionFrame::Kind::Macro,
+                                          argumentsEnd,
+                                          e,
+                                          m_currentFile,
+                                          {},
+                                          0u,
+                                          &macro});
+        ++m_numExpansions;
+        m_currentFile = macro.file;
+        t = tokens.cbegin();
+        e = tokens.cend() - 1;
+        return true;
+    }
+
+    /**
+      \brief Continues assembly from the next repetition of the current .rept
+             block, or after the end of the current expansion.
+    */
+    bool leaveFrame(TokensVector::const_iterator & t,
+                    TokensVector::const_iterator & e)
+    {
+        assert(!m_frames.empty());
+        auto & frame = m_frames.back();
+        if (frame.repeatsLeft) {
+            --frame.repeatsLeft;
+            t = frame.repeatIt;
+            return countTokens(static_cast<std::size_t>(e - t), t);
+        }
+        t = frame.resumeIt;
+        e = frame.endIt;
+        m_currentFile = frame.file;
+        if (frame.kind == ExpansionFrame::Kind::Macro)
+            --m_numExpansions;
+        m_frames.pop_back();
+        return true;
+    }
+
+    /** eturns whether the given token is one of the given tokens. */
+    static bool containsToken(TokensVector const & ts,
+                              TokensVector::const_iterator const it) noexcept
+    {
+        std::less<Token const *> const less;
+        auto const * const token = &*it;
+        return !less(token, ts.data()) && less(token, ts.data() + ts.size());
+    }
+
+    /**
+      eturns the given token, or if it was copied by the current macro
+               expansions, the token in the definition of the macro or in the
+               arguments of the call it was copied from. Tokens kept past the
+               current statement must not refer to the copies, which are
+               reused.
+    */
+    TokensVector::const_iterator originalToken(
+            TokensVector::const_iterator it) const noexcept
+    {
+        auto expansion = m_numExpansions;
+        for (auto frame(m_frames.rbegin());
+             expansion && (frame != m_frames.rend());
+             ++frame)
+        {
+            if (frame->kind != ExpansionFrame::Kind::Macro)
+                continue;
+            auto const & tokens = m_expansions[--expansion];
+            if (!containsToken(tokens, it))
+                continue;
+            auto const & macro = *frame->macro;
+            it = macro.bodyIt + (it - tokens.cbegin());
+            if (it->type() != Token::Type::KEYWORD)
+                continue;
+            auto const & parameters = macro.parameters;
+            for (std::size_t i = 0u; i < parameters.size(); ++i) {
+                if (parameters[i]->keywordValue() == it->keywordValue()) {
+                    /* The arguments end where the caller resumes: */
+                    it = frame->resumeIt
+                         - static_cast<std::ptrdiff_t>(parameters.size() - i);
+                    break;
+                }
+            }
+        }
+        return it;
+    }
+
+    /**
+      \brief Accounts for the given number of tokens assembled in addition to
+             the assembled tokens vector.
+    */
+    bool countTokens(std::size_t const numTokens,
+                     TokensVector::const_iterator const tokenIt)
+    {
+        auto const maxTokens = m_options->maxTokens;
+        if (!maxTokens)
+            return true;
+        if (unlikely(numTokens > maxTokens - m_numTokens))
+            ASSEMBLE_FAIL(TooManyTokens, tokenIt);
+        m_numTokens += numTokens;
+        return true;
+    }
 
-/* Methods: */
+    /**
+      \returns whether the last error is an end-of-file error at the end of
+               the program or of an included file.
+    */
+    bool errorAtEndOfFile() const noexcept {
+        return ((m_errorCode == ErrorCode::UnexpectedEndOfFile)
+                || (m_errorCode == ErrorCode::EmptyProgram))
+               && (m_frames.empty()
+                   || (m_frames.back().kind == ExpansionFrame::Kind::Include));
+    }
 
-    using std::vector<LabelSlot>::vector;
-    using std::vector<LabelSlot>::operator=;
+    /**
+      \brief Points m_errorToken to the original token in the program or in an
+             included file if it points to a token copied by a macro expansion.
+    */
+    void locateErrorToken(TokensVector const & ts) noexcept {
+        if (errorAtEndOfFile())
+            return;
+        auto const * const text = m_errorToken->text();
+        auto const * tokens = &ts;
+        for (auto const & sourceFile : m_sourceFiles) {
+            if (sourceFile->containsText(text)) {
+                tokens = &sourceFile->tokens();
+                break;
+            }
+        }
+        auto const it(std::lower_bound(
+                          tokens->begin(),
+                          tokens->end(),
+                          text,
+                          [](Token const & token, char const * const ptr)
+                          { return std::less<char const *>()(token.text(), ptr); }));
+        if ((it != tokens->end()) && (it->text() == text))
+            m_errorToken = it;
+    }
 
-    bool fillSlots(LabelLocation const & l,
-                   TokensVector::const_iterator const endIt)
-            noexcept
-    {
-        for (auto & value : *this) {
-            assert(value.tokenIt != endIt);
+    /**
+      \returns the included file which contains the token of the last error,
+               or null if the token is in the program itself.
+    */
+    std::shared_ptr<SourceFile const> errorSourceFile() const noexcept {
+        /* End-of-file errors refer to the end of the current file: */
+        if (errorAtEndOfFile()) {
+            for (auto const & sourceFile : m_sourceFiles)
+                if (sourceFile.get() == m_currentFile)
+                    return sourceFile;
+            return nullptr;
+        }
+        for (auto const & sourceFile : m_sourceFiles)
+            if (sourceFile->containsText(m_errorToken->text()))
+                return sourceFile;
+        return nullptr;
+    }
 
-            std::size_t absTarget = l.offset;
-            if (!assign_add_sizet_int64(&absTarget, value.extraOffset))
-                return false; /**< \todo Provide better diagnostics */
+    /** \returns the last error, with the offset relative to its file. */
+    Error lastError(char const * program, std::size_t length) const noexcept {
+        if (m_includeError.sourceFile())
+            return m_includeError;
+        auto sourceFile(errorSourceFile());
+        auto const * const text = sourceFile ? sourceFile->text() : program;
+        auto const offset =
+                errorAtEndOfFile()
+                ? (sourceFile ? sourceFile->size() : length)
+                : static_cast<std::size_t>(m_errorToken->text() - text);
+        return Error(m_errorCode, offset, std::move(sourceFile));
+    }
 
-            SharemindCodeBlock toWrite;
-            if (!value.doJumpLabel) { /* Normal absolute label */
-                toWrite.uint64[0u] = absTarget;
-            } else { /* Relative jump label */
-                if (value.linkingUnit != l.linkingUnit)
-                    return false; /**< \todo Provide better diagnostics */
+    /**
+      \returns the last error, with the offset being the index of its token in
+               the given tokens, unless it is in an included file.
+    */
+    Error lastTokenError(TokensVector const & ts) const noexcept {
+        if (m_includeError.sourceFile())
+            return m_includeError;
+        if (auto sourceFile = errorSourceFile()) {
+            auto const offset =
+                    errorAtEndOfFile()
+                    ? sourceFile->size()
+                    : static_cast<std::size_t>(m_errorToken->text()
+                                               - sourceFile->text());
+            return Error(m_errorCode, offset, std::move(sourceFile));
+        }
+        using OT = Error::OffsetType;
+        if (errorAtEndOfFile())
+            return Error(m_errorCode, ts.size(), OT::TokenIndex);
+        std::less<Token const *> const less;
+        auto const * const token = &*m_errorToken;
+        if (!less(token, ts.data()) && less(token, ts.data() + ts.size()))
+            return Error(m_errorCode,
+                         static_cast<std::size_t>(token - ts.data()),
+                         OT::TokenIndex);
+        /* The texts of tokens which were not tokenized from a single program
+           are not ordered, hence locateErrorToken() might not have found the
+           original of a token copied by a macro expansion: */
+        for (std::size_t i = 0u; i < ts.size(); ++i)
+            if (ts[i].text() == token->text())
+                return Error(m_errorCode, i, OT::TokenIndex);
+        return Error(m_errorCode, ts.size(), OT::TokenIndex);
+    }
 
-                assert(value.jmpOffset < l.offset); /* Because we're one-pass. */
+    /** \brief Throws an AssembleException for the last error. */
+    [[noreturn]] void throwLastError(TokensVector const & ts) {
+        locateErrorToken(ts);
+        auto sourceFile(errorSourceFile());
+        std::string message;
+        if (m_includeError.sourceFile()) {
+            message = m_includeError.message(nullptr, 0u);
+        } else if (sourceFile) {
+            message = concat(sourceFile->path(), ": ",
+                             assembleErrorMessage(m_errorCode,
+                                                  m_errorToken,
+                                                  sourceFile->tokens().end()));
+        } else {
+            message = assembleErrorMessage(m_errorCode, m_errorToken, ts.end());
+        }
+        throw AssembleException(m_errorCode,
+                                m_errorToken,
+                                std::move(message),
+                                std::move(sourceFile));
+    }
 
-                if (!substract_2sizet_to_int64(&toWrite.int64[0u],
-                                               absTarget,
-                                               value.jmpOffset))
-                    return false; /**< \todo Provide better diagnostics */
-                /** \todo Maybe check whether there's really an instruction there */
+    /**
+      \brief Evaluates and writes all deferred expressions once all labels and
+             sections sizes are known.
+    */
+    bool evaluatePendingExpressions(Executable const & exe) {
+        for (auto & p : m_pendingExpressions) {
+            for (auto & label : p.expression.labels()) {
+                if (label.resolved)
+                    continue;
+                auto const it(m_labelLocations.find(label.name));
+                if (it == m_labelLocations.end())
+                    ASSEMBLE_FAIL(UndefinedLabel, p.tokenIt);
+                label.value = it->second.offset;
+                label.resolved = true;
+            }
+
+            auto const & lu = exe.linkingUnits[p.linkingUnit];
+            std::uint64_t value;
+            if (p.expression.evaluate(
+                    value,
+                    [&lu](SectionType const type, std::uint64_t & size) noexcept
+                    {
+                        size = sectionSize(lu, type);
+                        return true;
+                    }) != Expression::EvaluationResult::Ok)
+                ASSEMBLE_FAIL(InvalidExpression, p.tokenIt);
+
+            if (p.codeSection) {
+                (*p.codeSection)[p.offset].uint64[0u] = value;
+                continue;
+            }
+            if (!valueFitsDataType(value, p.dataType))
+                ASSEMBLE_FAIL(InvalidParameter, p.tokenIt);
+            if (p.dataSection) {
+                auto const width = dataTypeWidths[p.dataType];
+                auto * writePtr =
+                        static_cast<char *>(p.dataSection->data.get())
+                        + p.offset;
+                for (auto i = p.multiplier; i; --i, writePtr += width)
+                    std::memcpy(writePtr, &value, width);
             }
-            value.codeSection[value.cbdata_index] = toWrite;
-            value.tokenIt = endIt;
         }
         return true;
     }
 
-};
+    void recycleSlots(LabelSlotsVector & slots) {
+        slots.clear();
+        if (slots.capacity())
+            m_freeSlots.emplace_back(std::move(slots));
+    }
 
-struct LabelSlotsMap: public SimpleUnorderedStringMap<LabelSlotsVector> {
+    bool assemble(TokensVector const & ts,
+                  Executable & exe,
+                  Options const & options,
+                  Object * object = nullptr);
+
+    /**
+      \brief Assembles a whole program, applying the optimizations enabled in
+             the options.
+
+      Programs to optimize are assembled into an object, which is optimized
+      and linked. Errors of the linker are reported at the token of the label
+      use or expression which caused them, or at the last token if that is
+      not known.
+    */
+    bool assembleExecutable(TokensVector const & ts,
+                            Executable & exe,
+                            Options const & options)
+    {
+        if (!options.optimizes())
+            return assemble(ts, exe, options);
+        Object object;
+        if (!assemble(ts, object.executable, options, &object))
+            return false;
+        optimizeObject(object, options);
+        Linker linker(m_memoryResource, options);
+        if (linker.link({&object}, exe, 1u))
+            return true;
+        exe = Executable();
+        m_errorCode = linker.errorCode();
+        m_errorToken = linkErrorToken(ts, linker);
+        return false;
+    }
 
-/* Methods: */
+    /** \returns the token of the last error of linking the object of the
+                 given whole program. */
+    TokensVector::const_iterator linkErrorToken(TokensVector const & ts,
+                                                Linker const & linker)
+            const noexcept
+    {
+        assert(!ts.empty());
+        std::string_view label(linker.errorLabel());
+        label = label.substr(0u, label.find('@'));
+        auto useIt(ts.end() - 1);
+        auto const tokenIndex = linker.errorToken();
+        if (tokenIndex < ts.size()) {
+            useIt = ts.begin() + static_cast<std::ptrdiff_t>(tokenIndex);
+        } else if (!label.empty()) {
+            /* Label uses in included files are found by their labels: */
+            for (auto const & it : m_relocationTokens) {
+                if (it->labelValue() == label) {
+                    useIt = it;
+                    break;
+                }
+            }
+        }
 
-    using SimpleUnorderedStringMap<LabelSlotsVector>::SimpleUnorderedStringMap;
-    using SimpleUnorderedStringMap<LabelSlotsVector>::operator=;
+        /* Like when assembling, invalid jumps to labels defined later are
+           reported at the definitions of the labels: */
+        if ((linker.errorCode() == ErrorCode::InvalidLabel)
+            && (tokenIndex < ts.size())
+            && !label.empty())
+            for (auto it = useIt + 1; it != ts.end(); ++it)
+                if ((it->type() == Token::Type::LABEL)
+                    && (it->labelValue() == label))
+                    return it;
+        return useIt;
+    }
 
-};
+/* Fields: */
 
-class ResizableDataSection: public Executable::DataSection {
+    std::pmr::memory_resource * const m_memoryResource;
+    LabelLocationMap m_labelLocations;
+    LabelSlotsMap m_labelSlots;
+    LabelLocationMap m_localLabelLocations;
+    LabelSlotsMap m_localLabelSlots;
+    std::pmr::vector<LabelSlotsVector> m_freeSlots;
+    std::pmr::vector<std::pmr::vector<bool> > m_instructionStarts;
+    std::pmr::vector<PendingJumpTarget> m_pendingJumpTargets;
+    Expression m_expression;
+    std::pmr::vector<PendingExpression> m_pendingExpressions;
+    std::size_t m_localScopeFirstExpression = 0u;
+
+    /* When assembling an object, the object, the tokens assembled and the
+       tokens of its label uses: */
+    Object * m_object = nullptr;
+    TokensVector const * m_assembledTokens = nullptr;
+    std::pmr::vector<TokensVector::const_iterator> m_relocationTokens;
+    std::size_t m_localScopeFirstRelocation = 0u;
+    std::size_t m_localScopeIndex = 0u;
+
+    std::size_t m_numPendingRelocations = 0u;
+    std::size_t m_numTokens = 0u;
+    std::pmr::vector<ExpansionFrame> m_frames;
+    std::pmr::vector<std::shared_ptr<SourceFile const> > m_sourceFiles;
+    StringMap<MacroDefinition> m_macros;
+    std::pmr::deque<TokensVector> m_expansions;
+    std::size_t m_numExpansions = 0u;
+    SourceFile const * m_currentFile = nullptr;
+    Error m_includeError;
+    Options const * m_options = nullptr;
+    std::string m_instructionName;
+    std::pmr::string m_label;
+    std::pmr::vector<char> m_dataToWrite;
+    TokensVector m_tokens;
+
+    ErrorCode m_errorCode;
+    TokensVector::const_iterator m_errorToken;
 
-private: /* Types: */
+};
 
-    using Container = std::vector<char>;
-    static_assert(std::is_same<Container::size_type, std::size_t>::value, "");
+Assembler::Assembler(std::pmr::memory_resource * memoryResource)
+    : m_inner(new Inner(assertReturn(memoryResource)))
+{}
 
-public: /* Methods: */
+Assembler::Assembler(Assembler &&) noexcept = default;
+Assembler::~Assembler() noexcept = default;
+Assembler & Assembler::operator=(Assembler &&) noexcept = default;
 
-    ResizableDataSection(void const * const dataPtr,
-                         std::size_t const dataSize,
-                         std::size_t multiplier = 1u)
-        : ResizableDataSection(
-            [](void const * dataPtr_,
-               std::size_t const dataSize_,
-               std::size_t multiplier_)
-            {
-                if ((std::numeric_limits<std::size_t>::max() / multiplier_)
-                    < dataSize_)
-                    throw std::bad_array_new_length();
-                auto r(std::make_shared<Container>(dataSize_ * multiplier_));
-                writeData(r->data(), dataPtr_, dataSize_, multiplier_);
-                return r;
-            }(dataPtr, dataSize, multiplier),
-            dataSize)
-    {}
+Executable Assembler::assemble(TokensVector const & ts,
+                               Options const & options)
+{
+    auto & inner = *assertReturn(m_inner);
+    Executable exe;
+    if (!inner.assembleExecutable(ts, exe, options))
+        inner.throwLastError(ts);
+    return exe;
+}
 
-    void addData(void const * const dataPtr,
-                 std::size_t const dataSize,
-                 std::size_t multiplier = 1u)
-    {
-        assert(this->data);
-        assert(this->data.get() == m_container.data());
+Object Assembler::assembleObject(TokensVector const & ts,
+                                 Options const & options)
+{
+    auto & inner = *assertReturn(m_inner);
+    Object object;
+    if (!inner.assemble(ts, object.executable, options, &object))
+        inner.throwLastError(ts);
+    return object;
+}
 
-        if (std::numeric_limits<std::size_t>::max() / multiplier < dataSize)
-            throw std::bad_array_new_length();
-        auto const toAdd = dataSize * multiplier;
-        auto const oldSize = m_container.size();
-        if ((std::numeric_limits<std::size_t>::max() - oldSize) < toAdd)
-            throw std::bad_array_new_length();
-        auto const totalDataSize = oldSize + toAdd;
-        m_container.resize(totalDataSize);
-        writeData(m_container.data() + oldSize, dataPtr, dataSize, multiplier);
-        this->data = std::shared_ptr<void>(this->data, m_container.data());
-        this->sizeInBytes = totalDataSize;
+Result<Executable> Assembler::tryAssemble(TokensVector const & ts,
+                                          Options const & options) noexcept
+{
+    auto & inner = *assertReturn(m_inner);
+    try {
+        Executable exe;
+        if (!inner.assembleExecutable(ts, exe, options)) {
+            inner.locateErrorToken(ts);
+            return inner.lastTokenError(ts);
+        }
+        return Result<Executable>(std::move(exe));
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
     }
+}
 
-private: /* Methods: */
-
-    ResizableDataSection(std::shared_ptr<Container> containerPtr,
-                         std::size_t const dataSize)
-        : Executable::DataSection(
-              std::shared_ptr<void>(containerPtr, containerPtr->data()),
-              dataSize)
-        , m_container(*containerPtr)
-    {}
+Result<Executable> Assembler::tryAssemble(char const * program,
+                                          std::size_t length,
+                                          Options const & options) noexcept
+{
+    assert(program);
+    auto & inner = *assertReturn(m_inner);
+    try {
+        auto & ts = inner.m_tokens;
+        Error error;
+        if (!tokenize(program, length, ts, error, options))
+            return error;
+
+        Executable exe;
+        if (!inner.assembleExecutable(ts, exe, options)) {
+            inner.locateErrorToken(ts);
+            return inner.lastError(program, length);
+        }
+        return Result<Executable>(std::move(exe));
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
+    }
+}
 
-    static void writeData(char * writePtr,
-                          void const * const data,
-                          std::size_t const dataSize,
-                          std::size_t multiplier)
-    {
-        for (;;) {
-            std::memcpy(writePtr, data, dataSize);
-            if (!--multiplier)
-                break;
-            writePtr += dataSize;
+Result<Object> Assembler::tryAssembleObject(char const * program,
+                                            std::size_t length,
+                                            Object::Position const & start,
+                                            Object::Successor successor,
+                                            Options const & options) noexcept
+{
+    assert(program);
+    auto & inner = *assertReturn(m_inner);
+    try {
+        auto & ts = inner.m_tokens;
+        Error error;
+        if (!tokenize(program, length, ts, error, options))
+            return error;
+
+        Object object;
+        object.start = start;
+        object.successor = successor;
+        if (!inner.assemble(ts, object.executable, options, &object)) {
+            inner.locateErrorToken(ts);
+            return inner.lastError(program, length);
         }
+        return Result<Object>(std::move(object));
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
     }
+}
 
-private: /* Fields: */
+Executable assemble(TokensVector const & ts,
+                    std::pmr::memory_resource * memoryResource)
+{ return Assembler(memoryResource).assemble(ts); }
+
+Executable assemble(TokensVector const & ts,
+                    Options const & options,
+                    std::pmr::memory_resource * memoryResource)
+{ return Assembler(memoryResource).assemble(ts, options); }
+
+Result<Executable> tryAssemble(char const * program,
+                               std::size_t length,
+                               std::pmr::memory_resource * memoryResource)
+        noexcept
+{ return tryAssemble(program, length, Options(), memoryResource); }
+
+Result<Executable> tryAssemble(char const * program,
+                               std::size_t length,
+                               Options const & options,
+                               std::pmr::memory_resource * memoryResource)
+        noexcept
+{
+    try {
+        return Assembler(memoryResource).tryAssemble(program, length, options);
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
+    }
+}
 
-    Container & m_container;
+Object assembleObject(TokensVector const & ts,
+                      std::pmr::memory_resource * memoryResource)
+{ return Assembler(memoryResource).assembleObject(ts); }
 
-};
+Object assembleObject(TokensVector const & ts,
+                      Options const & options,
+                      std::pmr::memory_resource * memoryResource)
+{ return Assembler(memoryResource).assembleObject(ts, options); }
 
-void dataSectionCreateOrAddData(
-        std::shared_ptr<Executable::DataSection> & sectionPtr,
-        void const * const data,
-        std::size_t const dataSize,
-        std::size_t multiplier = 1u)
+Result<Object> tryAssembleObject(char const * program,
+                                 std::size_t length,
+                                 Options const & options,
+                                 std::pmr::memory_resource * memoryResource)
+        noexcept
 {
-    if (!dataSize || !multiplier)
-        return;
-
-    assert(data);
-
-    if (!sectionPtr) {
-        sectionPtr = std::make_shared<ResizableDataSection>(data,
-                                                            dataSize,
-                                                            multiplier);
-    } else {
-        auto & resizeableSection =
-                *static_cast<ResizableDataSection *>(sectionPtr.get());
-        resizeableSection.addData(data, dataSize, multiplier);
+    try {
+        return Assembler(memoryResource).tryAssembleObject(
+                    program,
+                    length,
+                    Object::Position(),
+                    Object::Successor::EndOfProgram,
+                    options);
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
     }
 }
 
-} // anonymous namespace
-
-#define EOF_TEST     (unlikely(  t >= e))
-#define INC_EOF_TEST (unlikely(++t >= e))
+Result<Executable> link(std::vector<Object const *> const & objects,
+                        Options const & options,
+                        std::pmr::memory_resource * memoryResource,
+                        std::size_t numThreads) noexcept
+{
+    try {
+        Linker linker(memoryResource, options);
+        Executable exe;
+        if (!linker.link(objects, exe, numThreads)) {
+            auto const & label = linker.errorLabel();
+            return Error::linkError(
+                        linker.errorCode(),
+                        linker.errorObject(),
+                        linker.errorToken(),
+                        label.empty()
+                        ? nullptr
+                        : std::make_shared<std::string const>(label));
+        }
+        return Result<Executable>(std::move(exe));
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
+    }
+}
 
-#define INC_CHECK_EOF \
-    if (INC_EOF_TEST) { \
-        throw AssembleException(ts.end(), "Unexpected end-of-file!"); \
-    } else (void) 0
+std::string assembleErrorMessage(ErrorCode const code,
+                                 TokensVector::const_iterator const tokenIt,
+                                 TokensVector::const_iterator const end)
+{
+    auto const where =
+            [tokenIt, end]() {
+                if (tokenIt == end)
+                    return std::string();
+                return concat(" at ", tokenIt->startLine(), ':',
+                              tokenIt->startColumn());
+            };
+    switch (code) {
+        case ErrorCode::EmptyProgram:
+            return "Won't assemble an empty tokens vector!";
+        case ErrorCode::UnexpectedToken:
+            assert(tokenIt != end);
+            return concat("Unexpected token: ", *tokenIt);
+        case ErrorCode::UnknownDirective:
+            assert(tokenIt != end);
+            return concat("Unknown directive: .", tokenIt->directiveValue(),
+                          where());
+        case ErrorCode::UnknownInstruction:
+        case ErrorCode::InvalidNumberOfArguments: {
+            assert(tokenIt != end);
+            if (tokenIt->type() == Token::Type::DIRECTIVE)
+                return concat("Invalid number of arguments to macro .",
+                              tokenIt->directiveValue(), where(), '!');
+            std::string name(tokenIt->keywordValue());
+            std::size_t args = 0u;
+            for (auto it(tokenIt + 1);
+                 (it != end) && (it->type() != Token::Type::NEWLINE);
+                 ++it)
+            {
+                if (it->type() == Token::Type::KEYWORD) {
+                    name.push_back('_');
+                    name.append(it->keywordValue());
+                } else {
+                    ++args;
+                }
+            }
+            if (code == ErrorCode::UnknownInstruction)
+                return concat("Unknown instruction: ", name, where());
+            auto const & instrNameMap = instructionNameMap();
+            auto const instrIt(instrNameMap.find(name));
+            /* The arguments of instructions in macros are not known here: */
+            if (instrIt == instrNameMap.end())
+                return concat(errorCodeToString(code), " of \"", name, '"',
+                              where(), '!');
+            return concat("Instruction \"", name, "\" expects ",
+                          instrIt->second.numArgs, " arguments, but only ",
+                          args, " given", where(), '!');
+        }
+        case ErrorCode::DuplicateLabel:
+        case ErrorCode::InvalidLabel:
+        case ErrorCode::UndefinedLabel:
+            assert(tokenIt != end);
+            if (tokenIt->type() == Token::Type::EXPRESSION)
+                return concat(errorCodeToString(code), " in expression ",
+                              std::string(tokenIt->text(), tokenIt->length()),
+                              where());
+            return concat(errorCodeToString(code), ": \"",
+                          tokenIt->labelValue(), '"', where());
+        default:
+            return concat(errorCodeToString(code), where(), '!');
+    }
+}
 
-#define DO_EOL(eof,noexpect) \
-    do { \
-        if (EOF_TEST) \
-            goto eof; \
-        if (unlikely(t->type() != Token::Type::NEWLINE)) \
-            goto noexpect; \
-    } while ((0))
+bool Assembler::Inner::assemble(TokensVector const & ts,
+                                Executable & exe,
+                                Options const & options,
+                                Object * const object)
+{
+    reset();
+    m_object = object;
+    m_assembledTokens = &ts;
+    TokensVector::const_iterator e(ts.end());
+    if (ts.empty()) {
+        if (!object)
+            ASSEMBLE_FAIL(EmptyProgram, e);
+        /* Parts of programs may be empty: */
+        exe.linkingUnits.resize(object->start.numLinkingUnits);
+        return finishObject(exe,
+                            object->start.linkingUnit,
+                            object->start.section);
+    }
 
-#define INC_DO_EOL(eof,noexpect) \
-    do { \
-        t++; \
-        DO_EOL(eof,noexpect); \
-    } while ((0))
+    if (unlikely(options.maxTokens && (ts.size() > options.maxTokens)))
+        ASSEMBLE_FAIL(TooManyTokens,
+                      ts.begin() + static_cast<std::ptrdiff_t>(
+                                        options.maxTokens));
+    m_options = &options;
+    m_numTokens = ts.size();
 
-Executable assemble(TokensVector const & ts) {
-    if (ts.empty())
-        throw AssembleException(ts.end(),
-                                "Won't assemble an empty tokens vector!");
+    /* Leave the memory pointer to the linker, as zeroDataToBss() may move
+       the section: */
+    if (object && options.zeroDataToBss)
+        m_labelLocations.erase("DATA");
 
     TokensVector::const_iterator t(ts.begin());
-    TokensVector::const_iterator const e(ts.end());
     std::uint8_t lu_index = 0u;
     auto sectionType = SectionType::Text;
     std::size_t dataToWriteLength = 0u;
@@ -340,96 +2626,76 @@ Executable assemble(TokensVector const & ts) {
     /* for .data and .fill: */
     std::uint64_t multiplier;
     std::uint_fast8_t type;
-    static std::size_t const widths[8] = { 1u, 2u, 4u, 8u, 1u, 2u, 4u, 8u };
+    TokensVector::const_iterator dataExpressionIt;
 
-    LabelLocationMap ll;
-    ll.emplace("RODATA", 1u);
-    ll.emplace("DATA", 2u);
-    ll.emplace("BSS", 3u);
-
-    LabelSlotsMap lst;
-
-    Executable exe;
-    if (unlikely(ts.empty()))
-        return exe;
+    auto & ll = m_labelLocations;
+    auto & lst = m_labelSlots;
 
     auto & lus = exe.linkingUnits;
-    lus.emplace_back();
-    auto lu = &lus.back();
+    if (object) {
+        assert(object->start.linkingUnit < object->start.numLinkingUnits);
+        lus.resize(object->start.numLinkingUnits);
+        lu_index = object->start.linkingUnit;
+        sectionType = object->start.section;
+    } else {
+        lus.emplace_back();
+    }
+    auto lu = &lus[lu_index];
 
 
 assemble_newline:
     switch (t->type()) {
         case Token::Type::NEWLINE:
+            if (unlikely(options.isCancelled()))
+                ASSEMBLE_FAIL(Cancelled, t);
+            if (unlikely(options.isPastDeadline()))
+                ASSEMBLE_FAIL(DeadlineExceeded, t);
             break;
         case Token::Type::LABEL:
         {
-            auto const registerLabel =
-                    [&ll, &lst, &ts, t, sectionType, lu_index](
-                            std::size_t offset)
-                    {
-                        auto const r(
-                                ll.emplace(
-                                    std::piecewise_construct,
-                                    std::make_tuple(t->labelValue()),
-                                    std::make_tuple(
-                                            LabelLocation(offset,
-                                                          sectionType,
-                                                          lu_index))));
-                        if (!r.second)
-                            throw AssembleException(t, concat("Duplicate label: \"",
-                                                              t->labelValue(), '"'));
-
-                        /* Fill pending label slots: */
-                        auto const recordIt(lst.find(r.first->first));
-                        if (recordIt != lst.end()) {
-                            if (!recordIt->second.fillSlots(r.first->second, ts.end()))
-                                throw AssembleException(t, concat("Invalid label: \"",
-                                                                  t->labelValue(), '"'));
-                            lst.erase(recordIt);
-                        }
-                    };
-
-            switch (sectionType) {
-                case SectionType::Text:
-                    registerLabel(lu->textSection
-                                  ? lu->textSection->instructions.size()
-                                  : 0u);
-                    break;
-                case SectionType::RoData:
-                    registerLabel(lu->roDataSection
-                                  ? lu->roDataSection->sizeInBytes
-                                  : 0u);
-                    break;
-                case SectionType::Data:
-                    registerLabel(lu->rwDataSection
-                                  ? lu->rwDataSection->sizeInBytes
-                                  : 0u);
-                    break;
-                case SectionType::Bss:
-                    registerLabel(lu->bssSection
-                                  ? lu->bssSection->sizeInBytes
-                                  : 0u);
-                    break;
-                case SectionType::Bind:
-                    registerLabel(
-                            lu->syscallBindingsSection
-                            ? lu->syscallBindingsSection->syscallBindings.size()
-                            : 0u);
-                    break;
-                case SectionType::PdBind:
-                    registerLabel(lu->pdBindingsSection
-                                  ? lu->pdBindingsSection->pdBindings.size()
-                                  : 0u);
-                    break;
-                default:
-                    assert(sectionType == SectionType::Debug);
-                    registerLabel(lu->debugSection
-                                  ? lu->debugSection->sizeInBytes
-                                  : 0u);
-                    break;
+            bool const isLocal = isLocalLabel(t->labelValue());
+            if (isLocal) {
+                if (unlikely(sectionType != SectionType::Text))
+                    ASSEMBLE_FAIL(InvalidLabel, t);
+            } else if (sectionType == SectionType::Text) {
+                if (!closeLocalLabelScope())
+                    return false;
             }
+            auto & labels = isLocal ? m_localLabelLocations : ll;
+            auto & labelSlots = isLocal ? m_localLabelSlots : lst;
+
+            /* Labels of values refer to them after the padding: */
+            if (options.alignData
+                && ((sectionType == SectionType::RoData)
+                    || (sectionType == SectionType::Data)
+                    || (sectionType == SectionType::Bss))
+                && !alignSection(*lu,
+                                 lu_index,
+                                 sectionType,
+                                 alignmentAfterLabel(t, e),
+                                 0u,
+                                 t))
+                return false;
 
+            auto const r(
+                    labels.emplace(
+                        std::piecewise_construct,
+                        std::forward_as_tuple(t->labelValue()),
+                        std::make_tuple(
+                                LabelLocation(sectionSize(*lu, sectionType),
+                                              sectionType,
+                                              lu_index))));
+            if (!r.second)
+                ASSEMBLE_FAIL(DuplicateLabel, t);
+
+            /* Fill pending label slots: */
+            auto const recordIt(labelSlots.find(r.first->first));
+            if (recordIt != labelSlots.end()) {
+                if (!fillSlots(recordIt->second, r.first->second, t, e))
+                    return false;
+                recycleSlots(recordIt->second);
+                labelSlots.erase(recordIt);
+            }
             break;
         }
         case Token::Type::DIRECTIVE:
@@ -445,6 +2711,8 @@ assemble_newline:
                 if (likely(v != lu_index)) {
                     if (unlikely(v > lus.size()))
                         goto assemble_invalid_parameter_t;
+                    if (!closeLocalLabelScope())
+                        return false;
                     if (v == lus.size()) {
                         lus.emplace_back();
                         lu = &lus.back();
@@ -500,6 +2768,121 @@ assemble_newline:
                     goto assemble_invalid_parameter_t;
 
                 goto assemble_data_or_fill;
+            } else if ((t->directiveValue() == "align")
+                       || (t->directiveValue() == "balign"))
+            {
+                if (unlikely((sectionType != SectionType::RoData)
+                             && (sectionType != SectionType::Data)
+                             && (sectionType != SectionType::Bss)))
+                    goto assemble_unexpected_token_t;
+
+                INC_CHECK_EOF;
+
+                if (unlikely(t->type() != Token::Type::UHEX))
+                    goto assemble_invalid_parameter_t;
+                auto const alignment = t->uhexValue();
+                if (unlikely(!alignment
+                             || (alignment & (alignment - 1u))
+                             || (alignment > Object::Alignment::maxAlignment)))
+                    goto assemble_invalid_parameter_t;
+
+                /* Parse the optional fill byte: */
+                std::uint8_t fill = 0u;
+                if (((t + 1) != e) && ((t + 1)->type() == Token::Type::UHEX)) {
+                    if (unlikely((++t)->uhexValue()
+                                 > std::numeric_limits<std::uint8_t>::max()))
+                        goto assemble_invalid_parameter_t;
+                    fill = static_cast<std::uint8_t>(t->uhexValue());
+                }
+
+                if (!alignSection(*lu,
+                                  lu_index,
+                                  sectionType,
+                                  static_cast<std::size_t>(alignment),
+                                  fill,
+                                  t))
+                    return false;
+            } else if (t->directiveValue() == "incbin") {
+                if (unlikely((sectionType != SectionType::RoData)
+                             && (sectionType != SectionType::Data)
+                             && (sectionType != SectionType::Debug)))
+                    goto assemble_unexpected_token_t;
+                if (unlikely(!options.allowFileAccess))
+                    ASSEMBLE_FAIL(FileAccessDisabled, t);
+
+                INC_CHECK_EOF;
+                if (unlikely(t->type() != Token::Type::STRING))
+                    goto assemble_invalid_parameter_t;
+
+                /* Parse the optional offset and length: */
+                auto const pathIt(t);
+                std::uint64_t offset = 0u;
+                std::uint64_t length = readFileToEnd;
+                if (((t + 1) != e) && ((t + 1)->type() == Token::Type::UHEX)) {
+                    offset = (++t)->uhexValue();
+                    if (((t + 1) != e)
+                        && ((t + 1)->type() == Token::Type::UHEX))
+                    {
+                        length = (++t)->uhexValue();
+                        if (unlikely(length == readFileToEnd))
+                            goto assemble_invalid_parameter_t;
+                    }
+                }
+
+                if (!includeBinary(*lu, sectionType, pathIt, t, offset, length))
+                    return false;
+            } else if (t->directiveValue() == "include") {
+                if (unlikely(!options.allowFileAccess))
+                    ASSEMBLE_FAIL(FileAccessDisabled, t);
+
+                INC_CHECK_EOF;
+                if (unlikely(t->type() != Token::Type::STRING))
+                    goto assemble_invalid_parameter_t;
+                if (((t + 1) != e)
+                    && unlikely((t + 1)->type() != Token::Type::NEWLINE))
+                {
+                    ++t;
+                    goto assemble_unexpected_token_t;
+                }
+
+                if (!enterSourceFile(t, e))
+                    return false;
+                if (EOF_TEST)
+                    goto assemble_end_of_tokens;
+                goto assemble_newline;
+            } else if (t->directiveValue() == "rept") {
+                INC_CHECK_EOF;
+                std::uint64_t count;
+                if (t->type() == Token::Type::UHEX) {
+                    count = t->uhexValue();
+                } else if (t->type() == Token::Type::EXPRESSION) {
+                    bool evaluated;
+                    if (!parseExpression(t, count, evaluated))
+                        return false;
+                    if (unlikely(!evaluated))
+                        ASSEMBLE_FAIL(InvalidExpression, t);
+                } else {
+                    goto assemble_invalid_parameter_t;
+                }
+                INC_CHECK_EOF;
+                if (unlikely(t->type() != Token::Type::NEWLINE))
+                    goto assemble_unexpected_token_t;
+
+                if (!enterRepeat(t, e, count))
+                    return false;
+                if (EOF_TEST)
+                    goto assemble_end_of_tokens;
+                goto assemble_newline;
+            } else if (t->directiveValue() == "macro") {
+                if (!defineMacro(t, e))
+                    return false;
+                if (EOF_TEST)
+                    goto assemble_end_of_tokens;
+                goto assemble_newline;
+            } else if (unlikely((t->directiveValue() == "endr")
+                                || (t->directiveValue() == "endm")))
+            {
+                goto assemble_unexpected_token_t;
             } else if (likely(t->directiveValue() == "bind")) {
                 if (unlikely((sectionType != SectionType::Bind)
                              && (sectionType != SectionType::PdBind)))
@@ -513,23 +2896,27 @@ assemble_newline:
                 if (sectionType == SectionType::Bind) {
                     using SBS = Executable::SyscallBindingsSection;
                     if (!lu->syscallBindingsSection)
-                        lu->syscallBindingsSection = std::make_shared<SBS>();
+                        lu->syscallBindingsSection = makeShared<SBS>();
                     lu->syscallBindingsSection->syscallBindings.emplace_back(
                                 t->stringValue());
                 } else {
                     assert(sectionType == SectionType::PdBind);
                     if (!lu->pdBindingsSection)
                         lu->pdBindingsSection =
-                            std::make_shared<Executable::PdBindingsSection>();
+                            makeShared<Executable::PdBindingsSection>();
                     lu->pdBindingsSection->pdBindings.emplace_back(
                                 t->stringValue());
                 }
             } else {
-                throw AssembleException(t, concat("Unknown directive: .",
-                                                  t->directiveValue()));
+                auto const macroIt(m_macros.find(t->directiveValue()));
+                if (unlikely(macroIt == m_macros.end()))
+                    ASSEMBLE_FAIL(UnknownDirective, t);
+                if (!expandMacro(t, e, macroIt->second))
+                    return false;
+                goto assemble_newline;
             }
 
-            INC_DO_EOL(assemble_check_labels, assemble_unexpected_token_t);
+            INC_DO_EOL(assemble_end_of_tokens, assemble_unexpected_token_t);
             goto assemble_newline;
         case Token::Type::KEYWORD:
         {
@@ -537,7 +2924,8 @@ assemble_newline:
                 goto assemble_unexpected_token_t;
 
             std::size_t args = 0u;
-            std::string name = t->keywordValue();
+            auto & name = m_instructionName;
+            name.assign(t->keywordValue());
 
             auto ot(t);
             /* Collect instruction name and count arguments: */
@@ -552,7 +2940,8 @@ assemble_newline:
                 } else if (likely((t->type() == Token::Type::UHEX)
                                   || (t->type() == Token::Type::HEX)
                                   || (t->type() == Token::Type::LABEL)
-                                  || (t->type() == Token::Type::LABEL_O)))
+                                  || (t->type() == Token::Type::LABEL_O)
+                                  || (t->type() == Token::Type::EXPRESSION)))
                 {
                     args++;
                 } else {
@@ -563,25 +2952,28 @@ assemble_newline:
             /* Detect and check instruction: */
             auto const & instrNameMap = instructionNameMap();
             auto const instrIt(instrNameMap.find(name));
-            if (instrIt == instrNameMap.end()) {
-                throw AssembleException(ot,
-                                        concat("Unknown instruction: ", name));
-            }
+            if (instrIt == instrNameMap.end())
+                ASSEMBLE_FAIL(UnknownInstruction, ot);
             auto const & i = instrIt->second;
             if (unlikely(i.numArgs != args))
-                throw AssembleException(ot,
-                                        concat("Instruction \"", name,
-                                               "\" expects ", i.numArgs,
-                                               " arguments, but only ", args,
-                                               " given!"));
+                ASSEMBLE_FAIL(InvalidNumberOfArguments, ot);
 
             // Create code section, if not yet created:
             if (!lu->textSection)
-                lu->textSection = std::make_shared<Executable::TextSection>();
+                lu->textSection = makeShared<Executable::TextSection>();
             auto & csi = lu->textSection->instructions;
+            if (!fitsSectionSizeLimit(csi.size() * sizeof(SharemindCodeBlock),
+                                      sizeof(SharemindCodeBlock),
+                                      args + 1u))
+                ASSEMBLE_FAIL(SectionSizeLimitExceeded, ot);
+            auto & starts = instructionStarts(lu_index);
+            assert(starts.size() == csi.size());
             auto const addCode =
-                    [&csi](SharemindCodeBlock c)
-                    { csi.emplace_back(std::move(c)); };
+                    [&csi, &starts](SharemindCodeBlock c)
+                    {
+                        csi.emplace_back(std::move(c));
+                        starts.push_back(false);
+                    };
 
             /* Detect offset for jump instructions */
             std::size_t jmpOffset;
@@ -604,7 +2996,8 @@ assemble_newline:
             {
                 SharemindCodeBlock toWrite;
                 toWrite.uint64[0] = i.code;
-                addCode(std::move(toWrite));
+                csi.emplace_back(std::move(toWrite));
+                starts.push_back(true);
             }
 
             /* Write arguments: */
@@ -625,21 +3018,27 @@ assemble_newline:
                                   || (ot->type()
                                       == Token::Type::LABEL_O)))
                 {
-                    auto label(ot->labelValue());
+                    auto const & label = ot->labelValue();
                     SharemindCodeBlock toWrite;
 
                     /* Check whether label is defined: */
-                    auto const recordIt(ll.find(label));
-                    if (recordIt != ll.end()) {
+                    bool const isLocal = isLocalLabel(label);
+                    auto & labels = isLocal ? m_localLabelLocations : ll;
+                    auto recordIt(labels.find(label));
+                    /* Objects refer to their own labels through
+                       relocations: */
+                    if (object
+                        && (recordIt != labels.end())
+                        && (recordIt->second.section != SectionType::Invalid))
+                        recordIt = labels.end();
+                    if (recordIt != labels.end()) {
                         auto const & loc = recordIt->second;
 
                         /* Is this a jump instruction location? */
                         if (doJumpLabel) {
                             if ((loc.section != SectionType::Text)
                                 || (loc.linkingUnit != lu_index))
-                                throw AssembleException(
-                                        ot,
-                                        concat("Invalid label: ", label));
+                                ASSEMBLE_FAIL(InvalidLabel, ot);
 
                             /* Because the label was defined & we're one-pass:*/
                             assert(jmpOffset >= loc.offset);
@@ -650,36 +3049,47 @@ assemble_newline:
                                 || !substract_2sizet_to_int64(&toWrite.int64[0],
                                                               absTarget,
                                                               jmpOffset))
-                                throw AssembleException(
-                                        ot,
-                                        "Invalid label offset!");
-                            /** \todo Maybe check whether there's really an
-                                      instruction there. */
+                                ASSEMBLE_FAIL(InvalidLabelOffset, ot);
+                            if (!checkJumpTarget(lu_index, absTarget, ot))
+                                return false;
                         } else {
                             auto absTarget = loc.offset;
                             auto const offset = ot->labelOffset();
                             if (loc.section == SectionType::Invalid) {
                                 if (offset != 0)
-                                    throw AssembleException(
-                                            ot,
-                                            "Invalid label offset!");
+                                    ASSEMBLE_FAIL(InvalidLabelOffset, ot);
                             } else {
                                 if (!assign_add_sizet_int64(&absTarget, offset))
-                                    throw AssembleException(
-                                            ot,
-                                            "Invalid label offset!");
+                                    ASSEMBLE_FAIL(InvalidLabelOffset, ot);
                             }
                             toWrite.uint64[0] = absTarget;
                         }
+                    } else if (object) {
+                        object->relocations.push_back(
+                                    Object::Relocation{
+                                        std::string(label.begin(),
+                                                    label.end()),
+                                        ot->labelOffset(),
+                                        csi.size(),
+                                        jmpOffset,
+                                        lu_index,
+                                        doJumpLabel,
+                                        assembledTokenIndex(ot)});
+                        m_relocationTokens.push_back(originalToken(ot));
+                        toWrite.uint64[0u] = 0u;
                     } else {
+                        if (!addPendingRelocation(ot))
+                            return false;
+
                         /* Signal a relative jump label: */
                         auto const offset = csi.size();
-                        lst[std::move(label)].emplace_back(
+                        slotsFor(isLocal ? m_localLabelSlots : lst,
+                                 label).emplace_back(
                                     ot->labelOffset(),
                                     jmpOffset,
                                     csi,
                                     offset,
-                                    ot,
+                                    originalToken(ot),
                                     doJumpLabel,
                                     lu_index);
 
@@ -691,6 +3101,23 @@ assemble_newline:
                     }
                     addCode(std::move(toWrite));
                     doJumpLabel = false; /* Past first argument */
+                } else if (ot->type() == Token::Type::EXPRESSION) {
+                    /* Expressions are written as is, even as the first
+                       argument of jump instructions: */
+                    doJumpLabel = false;
+                    SharemindCodeBlock toWrite;
+                    bool evaluated;
+                    if (!parseExpression(ot, toWrite.uint64[0u], evaluated))
+                        return false;
+                    if (!evaluated) {
+                        if (!addPendingRelocation(ot))
+                            return false;
+                        auto & p = deferExpression(ot, lu_index);
+                        p.codeSection = &csi;
+                        p.offset = csi.size();
+                        toWrite.uint64[0u] = 0u;
+                    }
+                    addCode(std::move(toWrite));
                 } else {
                     /* Skip keywords, because they're already included in the
                        instruction code. */
@@ -698,27 +3125,42 @@ assemble_newline:
                 }
             }
 
-            DO_EOL(assemble_check_labels, assemble_unexpected_token_t);
+            DO_EOL(assemble_end_of_tokens, assemble_unexpected_token_t);
             goto assemble_newline;
         }
         case Token::Type::HEX:
         case Token::Type::UHEX:
         case Token::Type::STRING:
         case Token::Type::LABEL_O:
+        case Token::Type::EXPRESSION:
             goto assemble_unexpected_token_t;
     } /* switch */
 
     if (!INC_EOF_TEST)
         goto assemble_newline;
 
-assemble_check_labels:
+assemble_end_of_tokens:
+
+    /* Repeat the current .rept block, or continue after the end of the
+       current included file or expansion: */
+    if (!m_frames.empty()) {
+        if (!leaveFrame(t, e))
+            return false;
+        if (EOF_TEST)
+            goto assemble_end_of_tokens;
+        goto assemble_newline;
+    }
+
+    if (object)
+        return finishObject(exe, lu_index, sectionType);
+
+    if (!closeLocalLabelScope())
+        return false;
 
     /* Check for undefined labels: */
-    if (likely(lst.empty()))
-        return exe;
-    throw AssembleException(
-            lst.begin()->second.begin()->tokenIt,
-            concat("Undefined label: ", lst.begin()->first));
+    if (unlikely(!lst.empty()))
+        ASSEMBLE_FAIL(UndefinedLabel, lst.begin()->second.begin()->tokenIt);
+    return checkPendingJumpTargets() && evaluatePendingExpressions(exe);
 
 assemble_data_or_fill:
 
@@ -750,7 +3192,7 @@ assemble_data_or_fill:
     }
 
     if (type < 8u) {
-        dataToWriteLength = widths[type];
+        dataToWriteLength = dataTypeWidths[type];
     } else {
         assert(type == 8u);
         dataToWriteLength = 0u;
@@ -759,7 +3201,9 @@ assemble_data_or_fill:
     INC_CHECK_EOF;
 
     {
-        std::vector<char> dataToWrite;
+        auto & dataToWrite = m_dataToWrite;
+        dataToWrite.clear();
+        dataExpressionIt = e;
         if (t->type() == Token::Type::UHEX) {
             auto const v = t->uhexValue();
             switch (type) {
@@ -847,6 +3291,25 @@ assemble_data_or_fill:
                 dataToWrite.resize(dataToWriteLength);
                 std::memcpy(dataToWrite.data(), &v, dataToWriteLength);
             }
+        } else if (t->type() == Token::Type::EXPRESSION && type < 8u) {
+            std::uint64_t v;
+            bool evaluated;
+            if (!parseExpression(t, v, evaluated))
+                return false;
+            if (evaluated) {
+                if (!valueFitsDataType(v, type))
+                    goto assemble_invalid_parameter_t;
+            } else {
+                if (!addPendingRelocation(t))
+                    return false;
+                /* Write a placeholder and fill it in later: */
+                dataExpressionIt = t;
+                v = 0u;
+            }
+            if (sectionType != SectionType::Bss) {
+                dataToWrite.resize(dataToWriteLength);
+                std::memcpy(dataToWrite.data(), &v, dataToWriteLength);
+            }
         } else if (t->type() == Token::Type::STRING && type == 8u) {
             auto const s(t->stringValue());
             dataToWriteLength = s.size();
@@ -859,59 +3322,87 @@ assemble_data_or_fill:
         } else {
             goto assemble_invalid_parameter_t;
         }
-        assert(!dataToWrite.empty());
+        assert((sectionType == SectionType::Bss) || !dataToWrite.empty());
 
         INC_DO_EOL(assemble_data_write, assemble_unexpected_token_t);
 
 assemble_data_write:
 
+        if (options.alignData
+            && (type < 8u)
+            && (sectionType != SectionType::Debug)
+            && !alignSection(*lu,
+                             lu_index,
+                             sectionType,
+                             dataTypeWidths[type],
+                             0u,
+                             t))
+            return false;
         if (sectionType == SectionType::Bss) {
-            if ((std::numeric_limits<std::size_t>::max() / multiplier)
-                < dataToWriteLength)
-                throw AssembleException(t, "BSS section grew too large!");
+            if (multiplier
+                && ((std::numeric_limits<std::size_t>::max() / multiplier)
+                    < dataToWriteLength))
+                ASSEMBLE_FAIL(SectionTooLarge, t);
+            if (!fitsSectionSizeLimit(lu->bssSection
+                                      ? lu->bssSection->sizeInBytes
+                                      : 0u,
+                                      dataToWriteLength,
+                                      multiplier))
+                ASSEMBLE_FAIL(SectionSizeLimitExceeded, t);
             if (!lu->bssSection) {
                 lu->bssSection =
-                        std::make_shared<Executable::BssSection>(
+                        makeShared<Executable::BssSection>(
                             multiplier * dataToWriteLength);
             } else {
                 auto const toAdd = multiplier * dataToWriteLength;
                 auto const oldSizeInBytes = lu->bssSection->sizeInBytes;
                 if ((std::numeric_limits<std::size_t>::max() - toAdd)
                     < oldSizeInBytes)
-                    throw AssembleException(t, "BSS section grew too large!");
+                    ASSEMBLE_FAIL(SectionTooLarge, t);
                 lu->bssSection->sizeInBytes = oldSizeInBytes + toAdd;
             }
+            if (dataExpressionIt != e) {
+                auto & p = deferExpression(dataExpressionIt, lu_index);
+                p.section = sectionType;
+                p.dataType = type;
+            }
         } else {
             /* Actually write the values. */
             assert(!dataToWrite.empty());
-            std::shared_ptr<Executable::DataSection> * sectionPtrPtr;
-            switch (sectionType) {
-            case SectionType::RoData:
-                sectionPtrPtr = &lu->roDataSection;
-                break;
-            case SectionType::Data:
-                sectionPtrPtr = &lu->rwDataSection;
-                break;
-            default:
-                assert(sectionType == SectionType::Debug);
-                sectionPtrPtr = &lu->debugSection;
-                break;
+            auto * const sectionPtrPtr = &dataSectionPtr(*lu, sectionType);
+            auto const oldSizeInBytes =
+                    *sectionPtrPtr ? (*sectionPtrPtr)->sizeInBytes : 0u;
+            if (!fitsSectionSizeLimit(oldSizeInBytes,
+                                      dataToWriteLength,
+                                      multiplier))
+                ASSEMBLE_FAIL(SectionSizeLimitExceeded, t);
+            if (!dataSectionCreateOrAddData(*sectionPtrPtr,
+                                            m_memoryResource,
+                                            dataToWrite.data(),
+                                            dataToWriteLength,
+                                            multiplier))
+                ASSEMBLE_FAIL(SectionTooLarge, t);
+            if (dataExpressionIt != e) {
+                auto & p = deferExpression(dataExpressionIt, lu_index);
+                p.dataSection = sectionPtrPtr->get();
+                p.section = sectionType;
+                p.offset = oldSizeInBytes;
+                p.multiplier = multiplier;
+                p.dataType = type;
             }
-            dataSectionCreateOrAddData(*sectionPtrPtr,
-                                       dataToWrite.data(),
-                                       dataToWriteLength,
-                                       multiplier);
         }
+        if (EOF_TEST)
+            goto assemble_end_of_tokens;
         goto assemble_newline;
     }
 
 assemble_unexpected_token_t:
 
-    throw AssembleException(t, concat("Unexpected token: ", *t));
+    ASSEMBLE_FAIL(UnexpectedToken, t);
 
 assemble_invalid_parameter_t:
 
-    throw AssembleException(t, "Invalid parameter!");
+    ASSEMBLE_FAIL(InvalidParameter, t);
 
 }
 
@@ -20,11 +20,17 @@
 #ifndef SHAREMIND_LIBAS_ASSEMBLE_H
 #define SHAREMIND_LIBAS_ASSEMBLE_H
 
+#include <memory>
+#include <memory_resource>
 #include <sharemind/AssertReturn.h>
 #include <sharemind/ExceptionMacros.h>
 #include <sharemind/libexecutable/Executable.h>
 #include <sharemind/preprocessor.h>
+#include <vector>
+#include "Error.h"
 #include "Exception.h"
+#include "Object.h"
+#include "Options.h"
 #include "tokens.h"
 
 
@@ -39,40 +45,210 @@ private: /* Types: */
 
     /* Methods: */
 
-        template <typename ... Args>
-        Data(TokensVector::const_iterator tokenIterator,
-             Args && ... args)
-            : m_tokenIterator(tokenIterator)
-            , m_message(std::forward<Args>(args)...)
+        Data(ErrorCode code,
+             TokensVector::const_iterator tokenIterator,
+             std::string message,
+             std::shared_ptr<SourceFile const> sourceFile)
+            : m_code(code)
+            , m_tokenIterator(tokenIterator)
+            , m_message(std::move(message))
+            , m_sourceFile(std::move(sourceFile))
         {}
 
     /* Fields: */
 
+        ErrorCode m_code;
         TokensVector::const_iterator m_tokenIterator;
         std::string m_message;
+        std::shared_ptr<SourceFile const> m_sourceFile;
 
     };
 
 public: /* Methods: */
 
-    template <typename ... Args>
-    AssembleException(Args && ... args)
-        : m_data(std::make_shared<Data>(std::forward<Args>(args)...))
+    AssembleException(ErrorCode code,
+                      TokensVector::const_iterator tokenIterator,
+                      std::string message,
+                      std::shared_ptr<SourceFile const> sourceFile = nullptr)
+        : m_data(std::make_shared<Data>(code,
+                                        tokenIterator,
+                                        std::move(message),
+                                        std::move(sourceFile)))
     {}
 
     char const * what() const noexcept final override
     { return assertReturn(m_data)->m_message.c_str(); }
 
+    ErrorCode code() const noexcept { return assertReturn(m_data)->m_code; }
+
     TokensVector::const_iterator const & tokenIterator() noexcept
     { return assertReturn(m_data)->m_tokenIterator; }
 
+    /**
+      \returns the included file whose tokens tokenIterator() refers to, or null
+               if it refers to the assembled tokens.
+    */
+    std::shared_ptr<SourceFile const> const & sourceFile() const noexcept
+    { return assertReturn(m_data)->m_sourceFile; }
+
 private: /* Fields: */
 
     std::shared_ptr<Data> m_data;
 
 };
 
-Executable assemble(TokensVector const & ts);
+/**
+  \brief An assembler context which reuses its internal label tables and
+         scratch buffers for subsequent assemblies, keeping their capacity.
+  \note The executables returned by assemble() do not share any state with the
+        context which assembled them.
+  \note All memory for the internal tables of the context, and as much of the
+        memory for the sections of the returned executables as libexecutable
+        allows, is allocated from the memory resource given on construction.
+        That resource must outlive both the context and any executables
+        assembled by it.
+*/
+class Assembler {
+
+public: /* Methods: */
+
+    Assembler(std::pmr::memory_resource * memoryResource =
+                      std::pmr::get_default_resource());
+    Assembler(Assembler &&) noexcept;
+    Assembler(Assembler const &) = delete;
+    ~Assembler() noexcept;
+
+    Assembler & operator=(Assembler &&) noexcept;
+    Assembler & operator=(Assembler const &) = delete;
+
+    Executable assemble(TokensVector const & ts,
+                        Options const & options = Options());
+
+    /**
+      \brief Assembles the given tokens of a whole program or library into an
+             object, leaving the labels it uses but does not define to be
+             resolved by link().
+    */
+    Object assembleObject(TokensVector const & ts,
+                          Options const & options = Options());
+
+    /**
+      \brief Assembles the given tokens without throwing on invalid input.
+      \returns the executable, or the code of the first error. Unless the
+               error is in an included file, its offset is the index of its
+               token in the given tokens, or their number for errors at the
+               end of the program, and its offset type is
+               Error::OffsetType::TokenIndex.
+    */
+    Result<Executable> tryAssemble(TokensVector const & ts,
+                                   Options const & options = Options())
+            noexcept;
+
+    /**
+      \brief Tokenizes and assembles the given program without throwing on
+             invalid input.
+      \returns the executable, or the code and offset of the first error.
+    */
+    Result<Executable> tryAssemble(char const * program,
+                                   std::size_t length,
+                                   Options const & options = Options())
+            noexcept;
+
+    /**
+      \brief Tokenizes and assembles the given part of a program into an
+             object, leaving the labels it uses to be resolved by link().
+      \param[in] start The position in the program the part starts at.
+      \param[in] successor What follows the part in the program.
+      \returns the object, or the code and offset of the first error.
+    */
+    Result<Object> tryAssembleObject(char const * program,
+                                     std::size_t length,
+                                     Object::Position const & start,
+                                     Object::Successor successor,
+                                     Options const & options = Options())
+            noexcept;
+
+private: /* Fields: */
+
+    struct Inner;
+    std::unique_ptr<Inner> m_inner;
+
+};
+
+Executable assemble(TokensVector const & ts,
+                    std::pmr::memory_resource * memoryResource =
+                            std::pmr::get_default_resource());
+
+Executable assemble(TokensVector const & ts,
+                    Options const & options,
+                    std::pmr::memory_resource * memoryResource =
+                            std::pmr::get_default_resource());
+
+Result<Executable> tryAssemble(char const * program,
+                               std::size_t length,
+                               std::pmr::memory_resource * memoryResource =
+                                       std::pmr::get_default_resource())
+        noexcept;
+
+Result<Executable> tryAssemble(char const * program,
+                               std::size_t length,
+                               Options const & options,
+                               std::pmr::memory_resource * memoryResource =
+                                       std::pmr::get_default_resource())
+        noexcept;
+
+Object assembleObject(TokensVector const & ts,
+                      std::pmr::memory_resource * memoryResource =
+                              std::pmr::get_default_resource());
+
+Object assembleObject(TokensVector const & ts,
+                      Options const & options,
+                      std::pmr::memory_resource * memoryResource =
+                              std::pmr::get_default_resource());
+
+/**
+  \brief Tokenizes and assembles the given program or library into an object
+         without throwing on invalid input.
+  \returns the object, or the code and offset of the first error.
+*/
+Result<Object> tryAssembleObject(char const * program,
+                                 std::size_t length,
+                                 Options const & options = Options(),
+                                 std::pmr::memory_resource * memoryResource =
+                                         std::pmr::get_default_resource())
+        noexcept;
+
+/**
+  \brief Links objects into an executable.
+
+  The objects are either the consecutive parts of a program, or separately
+  assembled programs and libraries. The sections of the objects are
+  concatenated in the given order, and the label uses and pending expressions
+  of the objects are resolved against the non-local labels of all objects.
+
+  \param[in] numThreads The maximum number of threads to resolve the label uses
+                        and pending expressions of the objects with (including
+                        the calling thread), or 0 to use one thread per
+                        hardware thread.
+  \returns the executable, or the first error found. Errors in an object give
+           the index of the object in objectIndex(), the label of the error
+           in label() and, if the token of the error is known, its index in
+           the tokens assembled into the object as the offset, with the offset
+           type Error::OffsetType::TokenIndex.
+  \note The memory resource is only used by the calling thread, the other
+        threads allocate their scratch tables with operator new.
+*/
+Result<Executable> link(std::vector<Object const *> const & objects,
+                        Options const & options = Options(),
+                        std::pmr::memory_resource * memoryResource =
+                                std::pmr::get_default_resource(),
+                        std::size_t numThreads = 1u)
+        noexcept;
+
+/** \returns the message of an AssembleException for the given error. */
+std::string assembleErrorMessage(ErrorCode const code,
+                                 TokensVector::const_iterator const tokenIt,
+                                 TokensVector::const_iterator const end);
 
 } /* namespace Assembler { */
 } /* namespace sharemind { */
@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "assembleMany.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sharemind/libvmi/instr.h>
+#include <system_error>
+#include <thread>
+#include "assemble.h"
+#include "tokenizer.h"
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+/**
+  Every worker owns a contiguous range of job indexes. Jobs are claimed from a
+  range by atomically incrementing its next index, both by the owner and by
+  other workers which have run out of jobs in their own ranges. Hence claiming
+  a job never blocks, and workers stay busy until all ranges are exhausted.
+*/
+struct WorkRange {
+
+/* Methods: */
+
+    WorkRange() noexcept : next(0u), end(0u) {}
+
+    bool claim(std::size_t & jobIndex) noexcept {
+        /* Avoid bumping the counter once the range has been exhausted: */
+        if (next.load(std::memory_order_relaxed) >= end)
+            return false;
+        jobIndex = next.fetch_add(1u, std::memory_order_relaxed);
+        return jobIndex < end;
+    }
+
+/* Fields: */
+
+    std::atomic<std::size_t> next;
+    std::size_t end;
+
+    /* Keep the counters of different workers on separate cache lines: */
+    char padding[64u - sizeof(std::atomic<std::size_t>) - sizeof(std::size_t)];
+
+};
+
+void assembleJob(Assembler & assembler,
+                 AssemblySource const & source,
+                 AssembleManyResult & result) noexcept
+{
+    try {
+        result.setExecutable(
+                    assembler.assemble(
+                        tokenize(source.program, source.length)));
+    } catch (...) {
+        result.setError(std::current_exception());
+    }
+}
+
+void runWorker(std::size_t const workerIndex,
+               Assembler & assembler,
+               WorkRange * const ranges,
+               std::size_t const numRanges,
+               AssemblySource const * const sources,
+               AssembleManyResult * const results) noexcept
+{
+    std::size_t jobIndex;
+
+    /* Process own jobs first: */
+    while (ranges[workerIndex].claim(jobIndex))
+        assembleJob(assembler, sources[jobIndex], results[jobIndex]);
+
+    /* Steal jobs from other workers: */
+    for (std::size_t i = 1u; i < numRanges; ++i) {
+        auto & victim = ranges[(workerIndex + i) % numRanges];
+        while (victim.claim(jobIndex))
+            assembleJob(assembler, sources[jobIndex], results[jobIndex]);
+    }
+}
+
+std::size_t resolveNumThreads(std::size_t numThreads) noexcept {
+    if (!numThreads) {
+        numThreads = std::thread::hardware_concurrency();
+        if (!numThreads)
+            numThreads = 1u;
+    }
+    return numThreads;
+}
+
+} // anonymous namespace
+
+/**
+  Worker 0 is the thread calling assembleMany(). The other workers wait for
+  the generation counter to change, run the new batch, and report back by
+  decrementing the number of busy workers. The mutex is only taken when a
+  batch starts or finishes, never to claim jobs.
+*/
+struct AssemblerPool::Inner {
+
+/* Methods: */
+
+    Inner(std::size_t const numThreads)
+        : m_assemblers(numThreads)
+        , m_ranges(new WorkRange[numThreads])
+        , m_numWorkers(numThreads)
+    {
+        /* Initialize the shared instruction tables before starting any
+           workers, so that all workers only read immutable data: */
+        instructionNameMap();
+
+        m_threads.reserve(numThreads - 1u);
+        for (std::size_t i = 1u; i < numThreads; ++i) {
+            try {
+                m_threads.emplace_back(&Inner::workerLoop, this, i);
+            } catch (std::system_error const &) {
+                /* Make do with the workers already running: */
+                m_numWorkers = i;
+                break;
+            } catch (...) {
+                /* The destructor is not run for a partially constructed
+                   object, so the running workers must be joined here: */
+                stopWorkers();
+                throw;
+            }
+        }
+    }
+
+    ~Inner() noexcept { stopWorkers(); }
+
+    void stopWorkers() noexcept {
+        {
+            std::lock_guard<std::mutex> const guard(m_mutex);
+            m_stop = true;
+        }
+        m_wakeCondition.notify_all();
+        for (auto & thread : m_threads)
+            thread.join();
+        m_threads.clear();
+    }
+
+    void workerLoop(std::size_t const workerIndex) noexcept {
+        std::size_t seenGeneration = 0u;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wakeCondition.wait(
+                        lock,
+                        [this, seenGeneration]() noexcept
+                        { return m_stop || m_generation != seenGeneration; });
+                if (m_stop)
+                    return;
+                seenGeneration = m_generation;
+            }
+            runBatch(workerIndex);
+            {
+                std::lock_guard<std::mutex> const guard(m_mutex);
+                if (!--m_numBusy)
+                    m_doneCondition.notify_one();
+            }
+        }
+    }
+
+    void runBatch(std::size_t const workerIndex) noexcept {
+        runWorker(workerIndex,
+                  m_assemblers[workerIndex],
+                  m_ranges.get(),
+                  m_numWorkers,
+                  m_sources,
+                  m_results);
+    }
+
+    std::vector<AssembleManyResult> assembleMany(
+            AssemblySource const * const sources,
+            std::size_t const numSources)
+    {
+        assert(sources || !numSources);
+
+        std::vector<AssembleManyResult> results(numSources);
+        if (!numSources)
+            return results;
+
+        std::lock_guard<std::mutex> const batchGuard(m_batchMutex);
+        for (std::size_t i = 0u; i < m_numWorkers; ++i) {
+            m_ranges[i].next.store((numSources * i) / m_numWorkers,
+                                   std::memory_order_relaxed);
+            m_ranges[i].end = (numSources * (i + 1u)) / m_numWorkers;
+        }
+
+        {
+            std::lock_guard<std::mutex> const guard(m_mutex);
+            m_sources = sources;
+            m_results = results.data();
+            m_numBusy = m_numWorkers - 1u;
+            ++m_generation;
+        }
+        m_wakeCondition.notify_all();
+
+        runBatch(0u);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_doneCondition.wait(lock, [this]() noexcept { return !m_numBusy; });
+        return results;
+    }
+
+/* Fields: */
+
+    /* Every worker reuses its own assembler context for all its jobs: */
+    std::vector<Assembler> m_assemblers;
+    std::unique_ptr<WorkRange[]> m_ranges;
+    std::size_t m_numWorkers;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_batchMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_doneCondition;
+    std::size_t m_generation = 0u;
+    std::size_t m_numBusy = 0u;
+    bool m_stop = false;
+
+    AssemblySource const * m_sources = nullptr;
+    AssembleManyResult * m_results = nullptr;
+
+};
+
+AssemblerPool::AssemblerPool(std::size_t numThreads)
+    : m_inner(std::make_unique<Inner>(resolveNumThreads(numThreads)))
+{}
+
+AssemblerPool::~AssemblerPool() noexcept = default;
+
+std::size_t AssemblerPool::numThreads() const noexcept
+{ return m_inner->m_numWorkers; }
+
+std::vector<AssembleManyResult> AssemblerPool::assembleMany(
+        AssemblySource const * sources,
+        std::size_t numSources)
+{ return m_inner->assembleMany(sources, numSources); }
+
+std::vector<AssembleManyResult> assembleMany(AssemblySource const * sources,
+                                             std::size_t numSources,
+                                             std::size_t numThreads)
+{
+    assert(sources || !numSources);
+    if (!numSources)
+        return {};
+    return AssemblerPool(std::min(resolveNumThreads(numThreads), numSources))
+            .assembleMany(sources, numSources);
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_ASSEMBLEMANY_H
+#define SHAREMIND_LIBAS_ASSEMBLEMANY_H
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <sharemind/libexecutable/Executable.h>
+#include <vector>
+
+
+namespace sharemind {
+namespace Assembler {
+
+struct AssemblySource {
+
+/* Fields: */
+
+    char const * program;
+    std::size_t length;
+
+};
+
+class AssembleManyResult {
+
+public: /* Methods: */
+
+    AssembleManyResult() noexcept = default;
+    AssembleManyResult(AssembleManyResult &&) noexcept = default;
+    AssembleManyResult(AssembleManyResult const &) = default;
+
+    AssembleManyResult & operator=(AssembleManyResult &&) noexcept = default;
+    AssembleManyResult & operator=(AssembleManyResult const &) = default;
+
+    bool hasError() const noexcept { return static_cast<bool>(m_error); }
+    explicit operator bool() const noexcept { return !m_error; }
+
+    /** \returns the exception thrown by tokenize() or assemble() for this
+                 job, or an empty pointer on success. */
+    std::exception_ptr const & error() const noexcept { return m_error; }
+
+    /** \pre !hasError() */
+    Executable & executable() noexcept { return m_executable; }
+    Executable const & executable() const noexcept { return m_executable; }
+
+    void setExecutable(Executable executable) noexcept
+    { m_executable = std::move(executable); }
+
+    void setError(std::exception_ptr error) noexcept
+    { m_error = std::move(error); }
+
+private: /* Fields: */
+
+    Executable m_executable;
+    std::exception_ptr m_error;
+
+};
+
+/**
+  \brief A set of worker threads, each with its own assembler context, which
+         are kept alive between batches of sources.
+*/
+class AssemblerPool {
+
+public: /* Methods: */
+
+    /**
+      \param[in] numThreads The number of threads to use (including the
+                            calling thread), or 0 to use one thread per
+                            hardware thread.
+    */
+    explicit AssemblerPool(std::size_t numThreads = 0u);
+    AssemblerPool(AssemblerPool const &) = delete;
+    ~AssemblerPool() noexcept;
+
+    AssemblerPool & operator=(AssemblerPool const &) = delete;
+
+    /** \returns the number of threads used, including the calling thread. */
+    std::size_t numThreads() const noexcept;
+
+    /**
+      \brief Tokenizes and assembles the given sources concurrently.
+      \param[in] sources Pointer to the first of numSources sources.
+      \param[in] numSources The number of sources to assemble.
+      \returns a result for every source, in the order of the sources.
+      \note Concurrent calls on the same pool are run one after another.
+    */
+    std::vector<AssembleManyResult> assembleMany(
+            AssemblySource const * sources,
+            std::size_t numSources);
+
+private: /* Fields: */
+
+    struct Inner;
+    std::unique_ptr<Inner> m_inner;
+
+};
+
+/**
+  \brief Tokenizes and assembles the given sources concurrently.
+  \param[in] sources Pointer to the first of numSources sources.
+  \param[in] numSources The number of sources to assemble.
+  \param[in] numThreads The maximum number of threads to use (including the
+                        calling thread), or 0 to use one thread per hardware
+                        thread.
+  \returns a result for every source, in the order of the sources.
+  \note This starts and joins its threads and creates their assembler
+        contexts on every call. Use an AssemblerPool to avoid this cost when
+        assembling several batches.
+*/
+std::vector<AssembleManyResult> assembleMany(AssemblySource const * sources,
+                                             std::size_t numSources,
+                                             std::size_t numThreads = 0u);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_ASSEMBLEMANY_H */
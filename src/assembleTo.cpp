@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "assembleTo.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <streambuf>
+#include <sys/uio.h>
+#include <unistd.h>
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+/** Only counts the bytes written, for sizing the output buffer. */
+class CountingStreamBuffer: public std::streambuf {
+
+public: /* Methods: */
+
+    std::size_t size() const noexcept { return m_size; }
+
+protected: /* Methods: */
+
+    int_type overflow(int_type c) final override {
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            ++m_size;
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(char const *, std::streamsize n) final override {
+        m_size += static_cast<std::size_t>(n);
+        return n;
+    }
+
+private: /* Fields: */
+
+    std::size_t m_size = 0u;
+
+};
+
+/** Writes into a fixed buffer, failing when it is full. */
+class BufferStreamBuffer: public std::streambuf {
+
+public: /* Methods: */
+
+    BufferStreamBuffer(char * const data, std::size_t const size) noexcept
+    { setp(data, data + size); }
+
+    std::size_t size() const noexcept
+    { return static_cast<std::size_t>(pptr() - pbase()); }
+
+};
+
+/**
+  Buffers small writes, and writes large ones together with the buffered data
+  using writev(), so that the contents of sections are not copied.
+*/
+class FileStreamBuffer: public std::streambuf {
+
+public: /* Methods: */
+
+    FileStreamBuffer(int const fd) noexcept : m_fd(fd)
+    { setp(m_buffer, m_buffer + sizeof(m_buffer)); }
+
+    std::size_t size() const noexcept {
+        return m_written + static_cast<std::size_t>(pptr() - pbase());
+    }
+
+protected: /* Methods: */
+
+    int_type overflow(int_type c) final override {
+        if (!writeBuffered(nullptr, 0u))
+            return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(char const * s, std::streamsize n) final override {
+        auto const size = static_cast<std::size_t>(n);
+        if (size < sizeof(m_buffer))
+            return std::streambuf::xsputn(s, n);
+        return writeBuffered(s, size) ? n : 0;
+    }
+
+    int sync() final override { return writeBuffered(nullptr, 0u) ? 0 : -1; }
+
+private: /* Methods: */
+
+    /** Writes the buffered data followed by the given data. */
+    bool writeBuffered(char const * data, std::size_t size) noexcept {
+        ::iovec iov[2u];
+        iov[0u].iov_base = pbase();
+        iov[0u].iov_len = static_cast<std::size_t>(pptr() - pbase());
+        iov[1u].iov_base = const_cast<char *>(data);
+        iov[1u].iov_len = size;
+        ::iovec * first = iov;
+        int count = 2;
+        while (count) {
+            if (!first->iov_len) {
+                ++first;
+                --count;
+                continue;
+            }
+            auto const r = ::writev(m_fd, first, count);
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            auto n = static_cast<std::size_t>(r);
+            m_written += n;
+            while (n) {
+                auto const chunk = std::min(n, first->iov_len);
+                first->iov_base = static_cast<char *>(first->iov_base) + chunk;
+                first->iov_len -= chunk;
+                n -= chunk;
+                if (!first->iov_len) {
+                    ++first;
+                    --count;
+                }
+            }
+        }
+        setp(m_buffer, m_buffer + sizeof(m_buffer));
+        return true;
+    }
+
+private: /* Fields: */
+
+    int const m_fd;
+    std::size_t m_written = 0u;
+    char m_buffer[65536u];
+
+};
+
+} // anonymous namespace
+
+std::size_t serializedSize(Executable const & exe) {
+    CountingStreamBuffer buffer;
+    std::ostream os(&buffer);
+    os << exe;
+    return buffer.size();
+}
+
+Result<std::size_t> writeExecutable(Executable const & exe,
+                                    OutputBufferAllocator const & allocator)
+        noexcept
+{
+    assert(allocator);
+    try {
+        auto const size = serializedSize(exe);
+        auto * const data = static_cast<char *>(allocator(size));
+        if (!data)
+            return Error(ErrorCode::OutputError, 0u);
+        BufferStreamBuffer buffer(data, size);
+        std::ostream os(&buffer);
+        if (!(os << exe) || (buffer.size() != size))
+            return Error(ErrorCode::OutputError, 0u);
+        return Result<std::size_t>(std::size_t(size));
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
+    } catch (...) {
+        return Error(ErrorCode::OutputError, 0u);
+    }
+}
+
+Result<std::size_t> writeExecutable(Executable const & exe, int fd) noexcept {
+    try {
+        std::unique_ptr<FileStreamBuffer> buffer(new FileStreamBuffer(fd));
+        std::ostream os(buffer.get());
+        if (!(os << exe) || !os.flush())
+            return Error(ErrorCode::OutputError, 0u);
+        return Result<std::size_t>(buffer->size());
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
+    } catch (...) {
+        return Error(ErrorCode::OutputError, 0u);
+    }
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
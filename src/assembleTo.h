@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_ASSEMBLETO_H
+#define SHAREMIND_LIBAS_ASSEMBLETO_H
+
+#include <cstddef>
+#include <functional>
+#include <sharemind/libexecutable/Executable.h>
+#include "Error.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief A function which is given the size in bytes of a serialized
+         executable, and returns a buffer of at least that size to serialize
+         the executable into, or null on failure.
+*/
+using OutputBufferAllocator = std::function<void * (std::size_t size)>;
+
+/** \returns the size in bytes of the given executable when serialized. */
+std::size_t serializedSize(Executable const & exe);
+
+/**
+  \brief Serializes the given executable into a buffer obtained from the given
+         allocator, which is given the exact size of the serialized executable.
+
+  The size is found by serializing the executable into a counter first, hence
+  the executable is encoded twice, but only written to memory once.
+
+  \returns the size of the serialized executable, or an error with code
+           OutputError if the allocator failed.
+*/
+Result<std::size_t> writeExecutable(Executable const & exe,
+                                    OutputBufferAllocator const & allocator)
+        noexcept;
+
+/**
+  \brief Serializes the given executable into the given file descriptor at its
+         current position.
+
+  Headers are buffered, but the contents of large sections are written with
+  writev() directly from the sections, without copying them.
+
+  \returns the size of the serialized executable, or an error with code
+           OutputError if writing failed.
+*/
+Result<std::size_t> writeExecutable(Executable const & exe, int fd) noexcept;
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_ASSEMBLETO_H */
@@ -0,0 +1,686 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "binaryIr.h"
+
+#include <algorithm>
+#include <cassert>
+#include <istream>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <sharemind/AssertReturn.h>
+#include <sharemind/libvmi/instr.h>
+#include <sharemind/likely.h>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "assemble.h"
+#include "tokenizer.h"
+#include "TokenWriter.h"
+
+
+/*
+  A program of binary IR is a header followed by records:
+
+    magic     8 bytes "SMASIR\0\0"
+    version   varint
+    records   each an uint8 tag followed by its fields, up to an end record
+
+  where the records are
+
+    END          0  the end of the program
+    DEFINE       1  varint size followed by the bytes of a string, which gets
+                    the next string ID, starting from zero
+    NEWLINE      2
+    INSTRUCTION  3  uint64 code of an instruction in the libvmi instruction
+                    table, standing for the keywords of the instruction
+    KEYWORD      4  varint string ID
+    DIRECTIVE    5  varint string ID of the name without the dot
+    UHEX         6  uint64 value
+    HEX          7  int64 value
+    STRING       8  varint string ID of the unescaped value
+    LABEL        9  varint string ID of the name without the colon
+    LABEL_O     10  varint string ID of the name, int64 offset
+    EXPRESSION  11  varint string ID of the text of the expression
+
+  A varint is an unsigned integer in groups of 7 bits, least significant group
+  first, with the high bit of every byte but the last set. Fixed-size integers
+  are stored in little-endian order. Strings are defined before they are
+  first used, hence programs can be written and read in a single pass.
+*/
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+constexpr char const irMagic[8u] = {'S','M','A','S','I','R','\0','\0'};
+constexpr std::uint64_t const irFormatVersion = 1u;
+
+enum class Tag : std::uint8_t {
+    End,
+    Define,
+    Newline,
+    Instruction,
+    Keyword,
+    Directive,
+    Uhex,
+    Hex,
+    String,
+    Label,
+    LabelO,
+    Expression
+};
+
+/** \returns the names of the instructions in the instruction table by code. */
+std::unordered_map<std::uint64_t, std::string_view> const &
+instructionCodeMap() {
+    static auto const map(
+                []() {
+                    std::unordered_map<std::uint64_t, std::string_view> r;
+                    for (auto const & p : instructionNameMap())
+                        r.emplace(p.second.code, p.first);
+                    return r;
+                }());
+    return map;
+}
+
+class IrWriter {
+
+public: /* Methods: */
+
+    IrWriter(std::ostream & os) : m_os(os) { m_buffer.reserve(bufferSize); }
+
+    void uint8(std::uint8_t const value) {
+        m_buffer.push_back(static_cast<char>(value));
+        maybeFlush();
+    }
+
+    void tag(Tag const tag) { uint8(static_cast<std::uint8_t>(tag)); }
+
+    void varint(std::uint64_t value) {
+        while (value >= 0x80u) {
+            m_buffer.push_back(static_cast<char>((value & 0x7fu) | 0x80u));
+            value >>= 7u;
+        }
+        m_buffer.push_back(static_cast<char>(value));
+        maybeFlush();
+    }
+
+    void uint64(std::uint64_t const value) {
+        char bytes[8u];
+        for (unsigned i = 0u; i < 8u; ++i)
+            bytes[i] = static_cast<char>(value >> (i * 8u));
+        write(bytes, sizeof(bytes));
+    }
+
+    void write(char const * const data, std::size_t const size) {
+        m_buffer.append(data, size);
+        maybeFlush();
+    }
+
+    /** \brief Writes a record with the ID of the given string. */
+    void stringRecord(Tag const t, std::string_view const s) {
+        auto const r(m_ids.emplace(s, m_ids.size()));
+        if (r.second) {
+            tag(Tag::Define);
+            varint(s.size());
+            write(s.data(), s.size());
+        }
+        tag(t);
+        varint(r.first->second);
+    }
+
+    void flush() {
+        m_os.write(m_buffer.data(),
+                   static_cast<std::streamsize>(m_buffer.size()));
+        m_buffer.clear();
+    }
+
+private: /* Methods: */
+
+    void maybeFlush() {
+        if (m_buffer.size() >= bufferSize)
+            flush();
+    }
+
+private: /* Fields: */
+
+    static constexpr std::size_t const bufferSize = 65536u;
+
+    std::ostream & m_os;
+    std::string m_buffer;
+    /** The IDs of the strings, referring to the values of the tokens: */
+    std::unordered_map<std::string_view, std::uint64_t> m_ids;
+
+};
+
+void writeToken(IrWriter & w, Token const & t) {
+    switch (t.type()) {
+        case Token::Type::NEWLINE:
+            return w.tag(Tag::Newline);
+        case Token::Type::DIRECTIVE:
+            return w.stringRecord(Tag::Directive, t.directiveValue());
+        case Token::Type::HEX:
+            w.tag(Tag::Hex);
+            return w.uint64(static_cast<std::uint64_t>(t.hexValue()));
+        case Token::Type::UHEX:
+            w.tag(Tag::Uhex);
+            return w.uint64(t.uhexValue());
+        case Token::Type::STRING:
+            return w.stringRecord(Tag::String, t.stringValue());
+        case Token::Type::LABEL_O:
+            w.stringRecord(Tag::LabelO, t.labelValue());
+            return w.uint64(static_cast<std::uint64_t>(t.labelOffset()));
+        case Token::Type::LABEL:
+            return w.stringRecord(Tag::Label, t.labelValue());
+        case Token::Type::KEYWORD:
+            return w.stringRecord(Tag::Keyword, t.keywordValue());
+        case Token::Type::EXPRESSION:
+            return w.stringRecord(Tag::Expression,
+                                  std::string_view(t.text(), t.length()));
+    }
+}
+
+class IrSource {
+
+public: /* Methods: */
+
+    IrSource(std::streambuf & buffer) noexcept : m_buffer(buffer) {}
+
+    std::size_t offset() const noexcept { return m_offset; }
+
+    bool uint8(std::uint8_t & value) {
+        auto const c = m_buffer.sbumpc();
+        if (std::streambuf::traits_type::eq_int_type(
+                    c,
+                    std::streambuf::traits_type::eof()))
+            return false;
+        ++m_offset;
+        value = static_cast<std::uint8_t>(c);
+        return true;
+    }
+
+    bool varint(std::uint64_t & value) {
+        value = 0u;
+        for (unsigned shift = 0u; shift < 64u; shift += 7u) {
+            std::uint8_t byte;
+            if (!uint8(byte))
+                return false;
+            auto const bits = static_cast<std::uint64_t>(byte & 0x7fu);
+            if ((bits << shift) >> shift != bits)
+                return false;
+            value |= bits << shift;
+            if (!(byte & 0x80u))
+                return true;
+        }
+        return false;
+    }
+
+    bool uint64(std::uint64_t & value) {
+        char bytes[8u];
+        if (!read(bytes, sizeof(bytes)))
+            return false;
+        value = 0u;
+        for (unsigned i = 8u; i;) {
+            --i;
+            value = (value << 8u) | static_cast<unsigned char>(bytes[i]);
+        }
+        return true;
+    }
+
+    bool read(char * const data, std::size_t const size) {
+        auto const n = static_cast<std::streamsize>(size);
+        if (m_buffer.sgetn(data, n) != n)
+            return false;
+        m_offset += size;
+        return true;
+    }
+
+    /** Reads in chunks, so that corrupt sizes fail at the end of the input
+        instead of allocating the memory up front. */
+    bool string(std::pmr::string & str) {
+        std::uint64_t size;
+        if (!varint(size))
+            return false;
+        str.clear();
+        while (size) {
+            auto const chunk = std::min<std::uint64_t>(size, 4096u);
+            auto const oldSize = str.size();
+            str.resize(oldSize + static_cast<std::size_t>(chunk));
+            if (!read(&str[oldSize], static_cast<std::size_t>(chunk)))
+                return false;
+            size -= chunk;
+        }
+        return true;
+    }
+
+private: /* Fields: */
+
+    std::streambuf & m_buffer;
+    std::size_t m_offset = 0u;
+
+};
+
+class MemoryStreamBuffer: public std::streambuf {
+
+public: /* Methods: */
+
+    MemoryStreamBuffer(char const * const data, std::size_t const size)
+            noexcept
+    {
+        auto * const d = const_cast<char *>(data);
+        setg(d, d, d + size);
+    }
+
+};
+
+} // anonymous namespace
+
+void writeBinaryIr(std::ostream & os, TokensVector const & ts) {
+    IrWriter w(os);
+    w.write(irMagic, sizeof(irMagic));
+    w.varint(irFormatVersion);
+
+    auto const & instrNameMap = instructionNameMap();
+    std::string name;
+    std::size_t macroDepth = 0u;
+    bool statementStart = true;
+    for (auto it(ts.begin()); it != ts.end(); ++it) {
+        switch (it->type()) {
+            case Token::Type::NEWLINE:
+                w.tag(Tag::Newline);
+                statementStart = true;
+                continue;
+            case Token::Type::LABEL:
+                /* Statements may follow label definitions on the same line: */
+                writeToken(w, *it);
+                continue;
+            case Token::Type::DIRECTIVE:
+                if (it->directiveValue() == "macro") {
+                    ++macroDepth;
+                } else if (macroDepth && (it->directiveValue() == "endm")) {
+                    --macroDepth;
+                }
+                break;
+            case Token::Type::KEYWORD:
+            {
+                /* The parameters of macros are keywords as well, hence
+                   instructions in their bodies are written as they are: */
+                if (!statementStart || macroDepth)
+                    break;
+                auto lineEnd(it);
+                name.clear();
+                for (; (lineEnd != ts.end())
+                       && (lineEnd->type() != Token::Type::NEWLINE);
+                     ++lineEnd)
+                {
+                    if (lineEnd->type() == Token::Type::KEYWORD) {
+                        if (!name.empty())
+                            name.push_back('_');
+                        name.append(lineEnd->keywordValue());
+                    }
+                }
+                auto const instrIt(instrNameMap.find(name));
+                if (instrIt == instrNameMap.end())
+                    break;
+                w.tag(Tag::Instruction);
+                w.uint64(instrIt->second.code);
+                for (; it != lineEnd; ++it)
+                    if (it->type() != Token::Type::KEYWORD)
+                        writeToken(w, *it);
+                --it;
+                statementStart = false;
+                continue;
+            }
+            default:
+                break;
+        }
+        writeToken(w, *it);
+        statementStart = false;
+    }
+    w.tag(Tag::End);
+    w.flush();
+}
+
+Result<std::size_t> textToBinaryIr(char const * program,
+                                   std::size_t length,
+                                   std::ostream & os,
+                                   Options const & options,
+                                   std::pmr::memory_resource * memoryResource)
+        noexcept
+{
+    assert(program);
+    try {
+        auto ts(tryTokenize(program, length, options, memoryResource));
+        if (!ts)
+            return ts.error();
+        writeBinaryIr(os, *ts);
+        if (!os)
+            return Error(ErrorCode::OutputError, 0u);
+        return Result<std::size_t>(ts->size());
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
+    } catch (...) {
+        return Error(ErrorCode::OutputError, 0u);
+    }
+}
+
+Result<std::size_t> binaryIrToText(std::istream & is,
+                                   std::ostream & os,
+                                   Options const & options,
+                                   std::pmr::memory_resource * memoryResource)
+        noexcept
+{
+    try {
+        BinaryIrReader reader(memoryResource);
+        Error error;
+        if (!reader.read(is, error, options))
+            return error;
+        writeProgramText(os, reader.tokens());
+        if (!os)
+            return Error(ErrorCode::OutputError, 0u);
+        return Result<std::size_t>(reader.tokens().size());
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
+    } catch (...) {
+        return Error(ErrorCode::OutputError, 0u);
+    }
+}
+
+void writeProgramText(std::ostream & os, TokensVector const & ts) {
+    bool lineStart = true;
+    for (auto const & t : ts) {
+        if (t.type() == Token::Type::NEWLINE) {
+            os.put('\n');
+            lineStart = true;
+            continue;
+        }
+        if (!lineStart)
+            os.put(' ');
+        os.write(t.text(), static_cast<std::streamsize>(t.length()));
+        lineStart = false;
+    }
+    if (!lineStart)
+        os.put('\n');
+}
+
+struct BinaryIrReader::Inner {
+
+/* Methods: */
+
+    Inner(std::pmr::memory_resource * memoryResource)
+        : m_tokens(memoryResource)
+        , m_writer(m_tokens)
+        , m_offsets(memoryResource)
+        , m_strings(memoryResource)
+        , m_assembler(memoryResource)
+    {}
+
+    bool read(std::streambuf & buffer, Error & error, Options const & options)
+    {
+        m_writer.clear();
+        m_offsets.clear();
+        m_strings.clear();
+        m_size = 0u;
+
+        IrSource source(buffer);
+        #define READ_FAIL_AT(code, offset) \
+            do { \
+                error = Error(ErrorCode::code, \
+                              (offset), \
+                              Error::OffsetType::BinaryIr); \
+                return false; \
+            } while (false)
+        #define READ_FAIL READ_FAIL_AT(InvalidBinaryIr, recordOffset)
+        std::size_t recordOffset = 0u;
+
+        char magic[sizeof(irMagic)];
+        std::uint64_t version;
+        if (!source.read(magic, sizeof(magic))
+            || !std::equal(magic, magic + sizeof(magic), irMagic)
+            || !source.varint(version)
+            || (version != irFormatVersion))
+            READ_FAIL;
+
+        auto const maxTokens = options.maxTokens
+                               ? options.maxTokens
+                               : m_tokens.max_size();
+        auto const & codeMap = instructionCodeMap();
+        auto & ts = m_tokens;
+        auto & w = m_writer;
+        for (;;) {
+            recordOffset = source.offset();
+            std::uint8_t tagValue;
+            if (!source.uint8(tagValue))
+                READ_FAIL;
+            auto const tag = static_cast<Tag>(tagValue);
+            if (tag == Tag::End)
+                break;
+            if (tag == Tag::Define) {
+                /* Every string is the value of at least one token: */
+                if (m_strings.size() >= maxTokens)
+                    READ_FAIL_AT(TooManyTokens, recordOffset);
+                m_strings.emplace_back();
+                if (!source.string(m_strings.back()))
+                    READ_FAIL;
+                continue;
+            }
+            if (tag == Tag::Newline) {
+                if (unlikely(options.isCancelled()))
+                    READ_FAIL_AT(Cancelled, recordOffset);
+                if (unlikely(options.isPastDeadline()))
+                    READ_FAIL_AT(DeadlineExceeded, recordOffset);
+                /* Like the tokenizer, do not produce empty lines: */
+                if (ts.empty() || (ts.back().type() == Token::Type::NEWLINE))
+                    continue;
+            }
+            if (ts.size() >= maxTokens)
+                READ_FAIL_AT(TooManyTokens, recordOffset);
+
+            std::uint64_t value;
+            switch (tag) {
+                case Tag::Newline:
+                    w.newline();
+                    break;
+                case Tag::Instruction:
+                {
+                    if (!source.uint64(value))
+                        READ_FAIL;
+                    auto const it(codeMap.find(value));
+                    if (it == codeMap.end())
+                        READ_FAIL;
+                    w.keyword(it->second);
+                    break;
+                }
+                case Tag::Keyword:
+                case Tag::Directive:
+                {
+                    auto const * const s = string(source);
+                    if (!s || !TokenWriter::isValidKeyword(*s))
+                        READ_FAIL;
+                    if (tag == Tag::Keyword) {
+                        w.keyword(*s);
+                    } else {
+                        w.directive(*s);
+                    }
+                    break;
+                }
+                case Tag::Uhex:
+                    if (!source.uint64(value))
+                        READ_FAIL;
+                    w.uhex(value);
+                    break;
+                case Tag::Hex:
+                    if (!source.uint64(value))
+                        READ_FAIL;
+                    w.hex(static_cast<std::int64_t>(value));
+                    break;
+                case Tag::String:
+                {
+                    auto const * const s = string(source);
+                    if (!s)
+                        READ_FAIL;
+                    w.string(*s);
+                    break;
+                }
+                case Tag::Label:
+                case Tag::LabelO:
+                {
+                    auto const * const s = string(source);
+                    if (!s || !TokenWriter::isValidLabelName(*s))
+                        READ_FAIL;
+                    value = 0u;
+                    if ((tag == Tag::LabelO) && !source.uint64(value))
+                        READ_FAIL;
+                    w.label(*s, static_cast<std::int64_t>(value));
+                    break;
+                }
+                case Tag::Expression:
+                {
+                    auto const * const s = string(source);
+                    if (!s || !TokenWriter::isValidExpression(*s))
+                        READ_FAIL;
+                    w.expression(*s);
+                    break;
+                }
+                default:
+                    READ_FAIL;
+            }
+            m_offsets.push_back(recordOffset);
+        }
+        #undef READ_FAIL
+        #undef READ_FAIL_AT
+
+        ts.popBackNewlines();
+        m_offsets.resize(ts.size());
+        m_size = source.offset();
+        return true;
+    }
+
+    /** \returns the string with the ID read from the source, or null. */
+    std::pmr::string const * string(IrSource & source) {
+        std::uint64_t id;
+        if (!source.varint(id) || (id >= m_strings.size()))
+            return nullptr;
+        return &m_strings[static_cast<std::size_t>(id)];
+    }
+
+    std::size_t offsetOf(std::size_t const tokenIndex) const noexcept
+    { return (tokenIndex < m_offsets.size()) ? m_offsets[tokenIndex] : m_size; }
+
+    Result<Executable> tryAssemble(std::streambuf & buffer,
+                                   Options const & options) noexcept
+    {
+        try {
+            Error error;
+            if (!read(buffer, error, options))
+                return error;
+        } catch (std::bad_alloc const &) {
+            return Error(ErrorCode::OutOfMemory, 0u);
+        }
+        auto r(m_assembler.tryAssemble(m_tokens, options));
+        if (!r && !r.error().sourceFile()
+            && (r.error().code() != ErrorCode::OutOfMemory))
+            return Error(r.error().code(),
+                         offsetOf(r.error().offset()),
+                         Error::OffsetType::BinaryIr);
+        return r;
+    }
+
+/* Fields: */
+
+    TokensVector m_tokens;
+    TokenWriter m_writer;
+    std::pmr::vector<std::size_t> m_offsets;
+    std::pmr::vector<std::pmr::string> m_strings;
+    std::size_t m_size = 0u;
+    Assembler m_assembler;
+
+};
+
+BinaryIrReader::BinaryIrReader(std::pmr::memory_resource * memoryResource)
+    : m_inner(std::make_unique<Inner>(assertReturn(memoryResource)))
+{}
+
+BinaryIrReader::BinaryIrReader(BinaryIrReader &&) noexcept = default;
+BinaryIrReader::~BinaryIrReader() noexcept = default;
+
+BinaryIrReader & BinaryIrReader::operator=(BinaryIrReader &&) noexcept
+        = default;
+
+bool BinaryIrReader::read(std::istream & is,
+                          Error & error,
+                          Options const & options)
+{
+    auto * const buffer = is.rdbuf();
+    if (!buffer) {
+        error = Error(ErrorCode::InvalidBinaryIr,
+                      0u,
+                      Error::OffsetType::BinaryIr);
+        return false;
+    }
+    return assertReturn(m_inner)->read(*buffer, error, options);
+}
+
+bool BinaryIrReader::read(char const * data,
+                          std::size_t size,
+                          Error & error,
+                          Options const & options)
+{
+    assert(data || !size);
+    MemoryStreamBuffer buffer(data, size);
+    return assertReturn(m_inner)->read(buffer, error, options);
+}
+
+TokensVector const & BinaryIrReader::tokens() const noexcept
+{ return assertReturn(m_inner)->m_tokens; }
+
+std::size_t BinaryIrReader::size() const noexcept
+{ return assertReturn(m_inner)->m_size; }
+
+std::size_t BinaryIrReader::offsetOf(std::size_t tokenIndex) const noexcept
+{ return assertReturn(m_inner)->offsetOf(tokenIndex); }
+
+Result<Executable> BinaryIrReader::tryAssemble(std::istream & is,
+                                               Options const & options)
+        noexcept
+{
+    auto * const buffer = is.rdbuf();
+    if (!buffer)
+        return Error(ErrorCode::InvalidBinaryIr,
+                     0u,
+                     Error::OffsetType::BinaryIr);
+    return assertReturn(m_inner)->tryAssemble(*buffer, options);
+}
+
+Result<Executable> BinaryIrReader::tryAssemble(char const * data,
+                                               std::size_t size,
+                                               Options const & options)
+        noexcept
+{
+    assert(data || !size);
+    MemoryStreamBuffer buffer(data, size);
+    return assertReturn(m_inner)->tryAssemble(buffer, options);
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_BINARYIR_H
+#define SHAREMIND_LIBAS_BINARYIR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <memory_resource>
+#include <sharemind/libexecutable/Executable.h>
+#include "Error.h"
+#include "Options.h"
+#include "tokens.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/*
+  The binary IR is a compact encoding of the tokens of a program, which can be
+  assembled without tokenizing any text. Its format is described in
+  binaryIr.cpp. Every program in a stream ends with an end record, so that
+  programs can be piped one after another.
+*/
+
+/**
+  \brief Writes the given tokens as one program of binary IR.
+
+  The keywords of every instruction outside of macro definitions are replaced
+  by the code of the instruction in the libvmi instruction table.
+*/
+void writeBinaryIr(std::ostream & os, TokensVector const & ts);
+
+/**
+  \brief Tokenizes the given program and writes it as binary IR.
+  \returns the number of tokens of the program, or the first error.
+*/
+Result<std::size_t> textToBinaryIr(char const * program,
+                                   std::size_t length,
+                                   std::ostream & os,
+                                   Options const & options = Options(),
+                                   std::pmr::memory_resource * memoryResource =
+                                           std::pmr::get_default_resource())
+        noexcept;
+
+/**
+  \brief Reads one program of binary IR and writes it as program text.
+  \returns the number of tokens of the program, or the first error. The offset
+           of errors is in bytes from the start of the program in the stream.
+*/
+Result<std::size_t> binaryIrToText(std::istream & is,
+                                   std::ostream & os,
+                                   Options const & options = Options(),
+                                   std::pmr::memory_resource * memoryResource =
+                                           std::pmr::get_default_resource())
+        noexcept;
+
+/** \brief Writes the given tokens as program text, one line per line. */
+void writeProgramText(std::ostream & os, TokensVector const & ts);
+
+/**
+  \brief Reads programs of binary IR into tokens and assembles them, reusing
+         its tokens and assembler context for subsequent programs.
+*/
+class BinaryIrReader {
+
+public: /* Methods: */
+
+    BinaryIrReader(std::pmr::memory_resource * memoryResource =
+                           std::pmr::get_default_resource());
+    BinaryIrReader(BinaryIrReader &&) noexcept;
+    BinaryIrReader(BinaryIrReader const &) = delete;
+    ~BinaryIrReader() noexcept;
+
+    BinaryIrReader & operator=(BinaryIrReader &&) noexcept;
+    BinaryIrReader & operator=(BinaryIrReader const &) = delete;
+
+    /**
+      \brief Reads the next program from the given stream, replacing the
+             tokens of the previous one.
+      \returns whether reading succeeded. On failure error is set, and its
+               offset is in bytes from the start of the program in the stream.
+      \note The strings defined by the program count against
+            Options::maxTokens like its tokens, but separately from them.
+      \note Only allocation failures are reported by exceptions.
+    */
+    bool read(std::istream & is, Error & error, Options const & options);
+
+    /** \brief Reads the next program from the given buffer like read(). */
+    bool read(char const * data,
+              std::size_t size,
+              Error & error,
+              Options const & options);
+
+    /** \returns the tokens of the program read last. */
+    TokensVector const & tokens() const noexcept;
+
+    /** \returns the size in bytes of the program read last. */
+    std::size_t size() const noexcept;
+
+    /**
+      \returns the offset in bytes of the record of the token with the given
+               index from the start of the program, or size() for the end of
+               the tokens.
+    */
+    std::size_t offsetOf(std::size_t tokenIndex) const noexcept;
+
+    /**
+      \brief Reads the next program from the given stream and assembles it
+             without throwing on invalid input.
+      \returns the executable, or the code and offset of the first error. The
+               offset is in bytes from the start of the program in the stream.
+    */
+    Result<Executable> tryAssemble(std::istream & is,
+                                   Options const & options = Options())
+            noexcept;
+
+    /** \brief Reads and assembles the program in the given buffer. */
+    Result<Executable> tryAssemble(char const * data,
+                                   std::size_t size,
+                                   Options const & options = Options())
+            noexcept;
+
+private: /* Fields: */
+
+    struct Inner;
+    std::unique_ptr<Inner> m_inner;
+
+};
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_BINARYIR_H */
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "foldCode.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ObjectText.h"
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+using SectionType = Object::SectionType;
+
+/** The maximum number of passes over a section. */
+constexpr std::size_t const maxPasses = 8u;
+
+/** \returns whether the code after the instruction is not reached by it. */
+bool isTerminator(ObjectText::Instruction const & instruction) noexcept {
+    auto const & name = instruction.baseName;
+    return (instruction.isJump && (name == "jmp_imm"))
+           || (name.substr(0u, 4u) == "halt")
+           || (name.substr(0u, 6u) == "return");
+}
+
+/** The code between a non-local label and the next one. */
+struct Procedure {
+
+/* Fields: */
+
+    /** The indices of the first instruction and of the one following the
+        last. */
+    std::size_t begin;
+    std::size_t end;
+
+    /** The code blocks of the procedure. */
+    std::size_t beginOffset;
+    std::size_t endOffset;
+
+};
+
+class Folder {
+
+public: /* Methods: */
+
+    Folder(ObjectText & text) : m_text(text) {
+        auto const & object = text.object();
+        for (std::size_t i = 0u; i < object.symbols.size(); ++i)
+            m_symbols.emplace(object.symbols[i].name, i);
+        for (std::size_t i = 0u; i < object.expressions.size(); ++i) {
+            auto const & p = object.expressions[i];
+            if ((p.linkingUnit == text.linkingUnit())
+                && (p.section == SectionType::Text))
+                m_expressionAt.emplace(p.offset, i);
+        }
+    }
+
+    /** \returns the number of instructions removed. */
+    std::size_t run() {
+        if (!m_text.isEditable())
+            return 0u;
+        splitProcedures();
+
+        std::unordered_map<std::string, std::size_t> first;
+        std::string key;
+        std::size_t removed = 0u;
+        auto const & instructions = m_text.instructions();
+        for (std::size_t p = 0u; p < m_procedures.size(); ++p) {
+            auto const & procedure = m_procedures[p];
+            if (!encode(procedure, key))
+                continue;
+            auto const it(first.emplace(key, p));
+            if (it.second)
+                continue;
+            /* Only procedures not fallen into may be removed: */
+            if (!procedure.begin
+                || !isTerminator(instructions[procedure.begin - 1u]))
+                continue;
+            auto const & kept = m_procedures[it.first->second];
+            for (auto i = procedure.begin; i < procedure.end; ++i)
+                m_text.redirect(i, kept.begin + (i - procedure.begin));
+            removed += procedure.end - procedure.begin;
+        }
+        if (removed)
+            m_text.commit();
+        return removed;
+    }
+
+private: /* Methods: */
+
+    void splitProcedures() {
+        auto const & object = m_text.object();
+        auto const & instructions = m_text.instructions();
+        std::vector<std::size_t> starts;
+        for (auto const & symbol : object.symbols) {
+            if ((symbol.section != SectionType::Text)
+                || (symbol.linkingUnit != m_text.linkingUnit())
+                || symbol.name.empty()
+                || (symbol.name.front() == '.')) /* Local label */
+                continue;
+            auto const i = m_text.instructionAt(symbol.offset);
+            if (i != ObjectText::npos)
+                starts.push_back(i);
+        }
+        std::sort(starts.begin(), starts.end());
+        starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+        for (std::size_t s = 0u; s < starts.size(); ++s) {
+            Procedure procedure;
+            procedure.begin = starts[s];
+            procedure.end = (s + 1u < starts.size())
+                            ? starts[s + 1u]
+                            : instructions.size();
+            procedure.beginOffset = instructions[procedure.begin].offset;
+            auto const & last = instructions[procedure.end - 1u];
+            procedure.endOffset = last.offset + last.numArgs + 1u;
+            if (isTerminator(last))
+                m_procedures.push_back(procedure);
+        }
+    }
+
+    template <typename T>
+    static void append(std::string & key, T const & value) {
+        char bytes[sizeof(value)];
+        std::memcpy(bytes, &value, sizeof(value));
+        key.append(bytes, sizeof(bytes));
+    }
+
+    static void append(std::string & key, std::string_view const value) {
+        append(key, static_cast<std::uint64_t>(value.size()));
+        key.append(value);
+    }
+
+    /**
+      \brief Appends what the given label and offset refer to, with code of
+             the procedure given by its offset in it.
+    */
+    void appendTarget(std::string & key,
+                      Procedure const & procedure,
+                      std::string_view const label,
+                      std::int64_t const addend) const
+    {
+        auto const it(m_symbols.find(label));
+        if (it == m_symbols.end()) {
+            key.push_back('N');
+            append(key, label);
+            append(key, addend);
+            return;
+        }
+        auto const & symbol = m_text.object().symbols[it->second];
+        auto const target = static_cast<std::uint64_t>(symbol.offset)
+                            + static_cast<std::uint64_t>(addend);
+        if ((symbol.section == SectionType::Text)
+            && (symbol.linkingUnit == m_text.linkingUnit())
+            && (target >= procedure.beginOffset)
+            && (target < procedure.endOffset))
+        {
+            key.push_back('S');
+            append(key, target - procedure.beginOffset);
+        } else {
+            key.push_back('T');
+            append(key, symbol.linkingUnit);
+            append(key, static_cast<std::uint8_t>(symbol.section));
+            append(key, target);
+        }
+    }
+
+    /**
+      \brief Encodes the code of the given procedure into the given key.
+      \returns whether the code could be encoded.
+    */
+    bool encode(Procedure const & procedure, std::string & key) const {
+        auto const & expressions = m_text.object().expressions;
+        key.clear();
+        for (auto o = procedure.beginOffset; o < procedure.endOffset; ++o) {
+            if (!m_text.isPatched(o)) {
+                key.push_back('B');
+                append(key, m_text.block(o).uint64[0u]);
+            } else if (auto const * const r = m_text.relocationAt(o)) {
+                key.push_back(r->isJump ? 'J' : 'R');
+                appendTarget(key, procedure, r->label, r->addend);
+            } else {
+                auto const it(m_expressionAt.find(o));
+                if (it == m_expressionAt.end())
+                    return false;
+                auto const & p = expressions[it->second];
+                key.push_back('E');
+                append(key, static_cast<std::uint8_t>(p.dataType));
+                append(key, static_cast<std::uint64_t>(p.multiplier));
+                for (auto const & op : p.expression.ops()) {
+                    append(key, static_cast<std::uint8_t>(op.code));
+                    append(key, op.value);
+                }
+                for (auto const & label : p.expression.labels()) {
+                    if (label.resolved) {
+                        key.push_back('V');
+                        append(key, label.value);
+                    } else {
+                        appendTarget(key, procedure, label.name, 0);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+private: /* Fields: */
+
+    ObjectText & m_text;
+    std::vector<Procedure> m_procedures;
+
+    /** The symbols of the object by name. */
+    std::unordered_map<std::string_view, std::size_t> m_symbols;
+
+    /** The pending expressions in the section by code block. */
+    std::unordered_map<std::size_t, std::size_t> m_expressionAt;
+
+};
+
+} // anonymous namespace
+
+std::size_t foldCode(Object & object) {
+    std::size_t removed = 0u;
+    auto const & lus = object.executable.linkingUnits;
+    for (std::size_t i = 0u; i < lus.size(); ++i) {
+        for (std::size_t pass = 0u; pass < maxPasses; ++pass) {
+            ObjectText text(object, static_cast<std::uint8_t>(i));
+            auto const r = Folder(text).run();
+            if (!r)
+                break;
+            removed += r;
+        }
+    }
+    return removed;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
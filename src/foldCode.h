@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_FOLDCODE_H
+#define SHAREMIND_LIBAS_FOLDCODE_H
+
+#include <cstddef>
+#include "Object.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief Merges identical procedures of an object containing a whole program,
+         redirecting the labels of the removed copies to the one kept.
+
+  The TEXT section of every linking unit is split into procedures at its
+  non-local labels. Two procedures are identical if their code is, where the
+  label uses and pending expressions in them are compared by the code or data
+  they refer to, and references into the procedures themselves by their
+  offsets in them. A procedure is only removed if it ends with an
+  unconditional jump, a halt or a return and the code before it does too, so
+  that no code falls through into or out of it. The code at the start of the
+  section is always kept.
+
+  The merging is repeated, so that procedures which only differ in calling
+  procedures merged before are merged as well. Linking units whose code
+  addresses are not all given by labels, see ObjectText, are left as they
+  are.
+
+  \returns the number of instructions removed.
+*/
+std::size_t foldCode(Object & object);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_FOLDCODE_H */
@@ -0,0 +1,386 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "gcSections.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <map>
+#include <sharemind/codeblock.h>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ObjectData.h"
+#include "ObjectText.h"
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+using SectionType = Object::SectionType;
+
+constexpr SectionType const dataSectionTypes[] = {
+    SectionType::RoData,
+    SectionType::Data
+};
+
+/** \returns whether the code after the instruction is not reached by it. */
+bool isTerminator(ObjectText::Instruction const & instruction) noexcept {
+    auto const & name = instruction.baseName;
+    return (instruction.isJump && (name == "jmp_imm"))
+           || (name.substr(0u, 4u) == "halt")
+           || (name.substr(0u, 6u) == "return");
+}
+
+/** The blocks of a RODATA or DATA section between its labels. */
+struct DataBlocks {
+
+/* Fields: */
+
+    /** The offsets of the blocks, starting with 0. */
+    std::vector<std::size_t> starts;
+
+    std::vector<bool> live;
+    std::size_t size = 0u;
+
+    /** Whether unreferenced blocks may be removed. */
+    bool collect = true;
+
+};
+
+class Collector {
+
+private: /* Types: */
+
+    using ExpressionKey = std::tuple<std::uint8_t, SectionType, std::size_t>;
+
+public: /* Methods: */
+
+    Collector(Object & object) : m_object(object) {}
+
+    /** \returns the number of bytes removed. */
+    std::size_t run() {
+        init();
+        while (!m_codeWork.empty() || !m_dataWork.empty()) {
+            if (!m_codeWork.empty()) {
+                auto const [lu, index] = m_codeWork.back();
+                m_codeWork.pop_back();
+                markFromInstruction(lu, index);
+            } else {
+                auto const [lu, section, block] = m_dataWork.back();
+                m_dataWork.pop_back();
+                markFromDataBlock(lu, section, block);
+            }
+        }
+        return removeDead();
+    }
+
+private: /* Methods: */
+
+    void init() {
+        auto const & symbols = m_object.symbols;
+        for (std::size_t i = 0u; i < symbols.size(); ++i)
+            m_symbols.emplace(symbols[i].name, i);
+
+        auto const numLus = m_object.executable.linkingUnits.size();
+        for (std::size_t lu = 0u; lu < numLus; ++lu) {
+            m_texts.emplace_back(m_object, static_cast<std::uint8_t>(lu));
+            m_liveCode.emplace_back(m_texts.back().instructions().size(),
+                                    false);
+            m_data.emplace_back();
+            for (std::size_t s = 0u; s < 2u; ++s) {
+                ObjectData data(m_object,
+                                static_cast<std::uint8_t>(lu),
+                                dataSectionTypes[s]);
+                auto & blocks = m_data.back()[s];
+                blocks.size = data.size();
+                blocks.starts = data.symbolOffsets();
+                if (blocks.starts.empty() || blocks.starts.front())
+                    blocks.starts.insert(blocks.starts.begin(), 0u);
+                /* Labels at the end of the section start no block: */
+                while ((blocks.starts.size() > 1u)
+                       && (blocks.starts.back() >= blocks.size))
+                    blocks.starts.pop_back();
+                blocks.live.assign(blocks.starts.size(), false);
+                blocks.collect = (data.alignment() <= 1u);
+            }
+        }
+
+        /* Index the pending expressions by location, and find the sections
+           which have to be kept whole: */
+        bool collectData = true;
+        auto const & expressions = m_object.expressions;
+        for (std::size_t i = 0u; i < expressions.size(); ++i) {
+            auto const & p = expressions[i];
+            m_expressions.emplace(ExpressionKey(p.linkingUnit,
+                                                p.section,
+                                                p.offset),
+                                  i);
+            if (p.expression.usesSectionSizes())
+                collectData = false;
+            if (p.expression.ops().size() == 1u)
+                continue;
+            for (auto const & label : p.expression.labels())
+                if (auto * const blocks = dataBlocksOf(label.name))
+                    blocks->collect = false;
+        }
+
+        for (std::size_t lu = 0u; lu < numLus; ++lu) {
+            auto const u = static_cast<std::uint8_t>(lu);
+            for (std::size_t s = 0u; s < 2u; ++s) {
+                auto & blocks = m_data[lu][s];
+                if (!blocks.size)
+                    continue;
+                if (!collectData)
+                    blocks.collect = false;
+                for (std::size_t b = 0u; b < blocks.starts.size(); ++b)
+                    if (!blocks.collect
+                        || ((b == 0u) && !isBlockLabeled(u, s, 0u)))
+                        markDataBlock(u, s, b);
+            }
+
+            auto & text = m_texts[lu];
+            if (!text.isEditable()) {
+                /* All code of the linking unit is kept: */
+                for (auto const & r : m_object.relocations)
+                    if (r.linkingUnit == u)
+                        markLabel(r.label, r.addend);
+                markExpressions(u,
+                                SectionType::Text,
+                                0u,
+                                std::numeric_limits<std::size_t>::max());
+            } else if (!text.instructions().empty()) {
+                markCode(u, 0u);
+            }
+        }
+    }
+
+    /** \returns whether a label starts the given data block. */
+    bool isBlockLabeled(std::uint8_t const lu,
+                        std::size_t const section,
+                        std::size_t const block) const noexcept
+    {
+        auto const offset = m_data[lu][section].starts[block];
+        for (auto const & symbol : m_object.symbols)
+            if ((symbol.linkingUnit == lu)
+                && (symbol.section == dataSectionTypes[section])
+                && (symbol.offset == offset))
+                return true;
+        return false;
+    }
+
+    Object::Symbol const * symbol(std::string_view const name) const noexcept
+    {
+        auto const it(m_symbols.find(name));
+        return (it != m_symbols.end())
+               ? &m_object.symbols[it->second]
+               : nullptr;
+    }
+
+    /** \returns the index of the given data section type, or 2 if none. */
+    static std::size_t dataSectionIndex(SectionType const section) noexcept {
+        for (std::size_t s = 0u; s < 2u; ++s)
+            if (dataSectionTypes[s] == section)
+                return s;
+        return 2u;
+    }
+
+    DataBlocks * dataBlocksOf(std::string_view const label) {
+        auto const * const s = symbol(label);
+        if (!s || (s->linkingUnit >= m_data.size()))
+            return nullptr;
+        auto const section = dataSectionIndex(s->section);
+        return (section < 2u) ? &m_data[s->linkingUnit][section] : nullptr;
+    }
+
+    void markLabel(std::string_view const name, std::int64_t const addend) {
+        auto const * const s = symbol(name);
+        if (!s || (s->linkingUnit >= m_texts.size()))
+            return;
+        if (s->section == SectionType::Text) {
+            std::size_t offset;
+            if (m_texts[s->linkingUnit].target(name, addend, offset))
+                markCode(s->linkingUnit, offset);
+            return;
+        }
+        auto const section = dataSectionIndex(s->section);
+        if (section >= 2u)
+            return;
+        auto const & blocks = m_data[s->linkingUnit][section];
+        auto const target = static_cast<std::int64_t>(s->offset) + addend;
+        auto const clamped = static_cast<std::size_t>(
+                    std::clamp(target,
+                               std::int64_t(0),
+                               static_cast<std::int64_t>(blocks.size)));
+        markData(s->linkingUnit,
+                 section,
+                 std::min(s->offset, clamped),
+                 std::max(s->offset, clamped));
+    }
+
+    void markCode(std::uint8_t const lu, std::size_t const offset) {
+        auto const index = m_texts[lu].instructionAt(offset);
+        if ((index == ObjectText::npos) || m_liveCode[lu][index])
+            return;
+        m_liveCode[lu][index] = true;
+        m_codeWork.emplace_back(lu, index);
+    }
+
+    /** \brief Marks the blocks containing the given range of bytes. */
+    void markData(std::uint8_t const lu,
+                  std::size_t const section,
+                  std::size_t const first,
+                  std::size_t const last)
+    {
+        auto const & starts = m_data[lu][section].starts;
+        if (!m_data[lu][section].size)
+            return;
+        auto const blockOf =
+                [&starts](std::size_t const offset) {
+                    return static_cast<std::size_t>(
+                                std::upper_bound(starts.begin(),
+                                                 starts.end(),
+                                                 offset) - starts.begin())
+                           - 1u;
+                };
+        for (auto b = blockOf(first); b <= blockOf(last); ++b)
+            markDataBlock(lu, section, b);
+    }
+
+    void markDataBlock(std::uint8_t const lu,
+                       std::size_t const section,
+                       std::size_t const block)
+    {
+        auto && live = m_data[lu][section].live[block];
+        if (live)
+            return;
+        live = true;
+        m_dataWork.emplace_back(lu, section, block);
+    }
+
+    /** \brief Marks the labels used by the expressions in the given range. */
+    void markExpressions(std::uint8_t const lu,
+                         SectionType const section,
+                         std::size_t const begin,
+                         std::size_t const end)
+    {
+        auto it(m_expressions.lower_bound(ExpressionKey(lu, section, begin)));
+        auto const last(m_expressions.lower_bound(
+                            ExpressionKey(lu, section, end)));
+        for (; it != last; ++it)
+            for (auto const & label
+                 : m_object.expressions[it->second].expression.labels())
+                if (!label.resolved)
+                    markLabel(label.name, 0);
+    }
+
+    void markFromInstruction(std::uint8_t const lu, std::size_t const index) {
+        auto const & text = m_texts[lu];
+        auto const & instruction = text.instructions()[index];
+        auto const begin = instruction.offset + 1u;
+        auto const end = begin + instruction.numArgs;
+        for (auto offset = begin; offset < end; ++offset)
+            if (auto const * const r = text.relocationAt(offset))
+                markLabel(r->label, r->addend);
+        markExpressions(lu, SectionType::Text, begin, end);
+        if (!isTerminator(instruction))
+            markCode(lu, end);
+    }
+
+    void markFromDataBlock(std::uint8_t const lu,
+                           std::size_t const section,
+                           std::size_t const block)
+    {
+        auto const & blocks = m_data[lu][section];
+        auto const end = (block + 1u < blocks.starts.size())
+                         ? blocks.starts[block + 1u]
+                         : blocks.size;
+        markExpressions(lu,
+                        dataSectionTypes[section],
+                        blocks.starts[block],
+                        end);
+    }
+
+    std::size_t removeDead() {
+        std::size_t removed = 0u;
+        for (std::size_t lu = 0u; lu < m_texts.size(); ++lu) {
+            if (!m_texts[lu].isEditable())
+                continue;
+            /* The sections of the other linking units did not change: */
+            ObjectText text(m_object, static_cast<std::uint8_t>(lu));
+            assert(text.instructions().size() == m_liveCode[lu].size());
+            for (std::size_t i = 0u; i < m_liveCode[lu].size(); ++i) {
+                if (!m_liveCode[lu][i]) {
+                    text.remove(i);
+                    removed += (text.instructions()[i].numArgs + 1u)
+                               * sizeof(SharemindCodeBlock);
+                }
+            }
+            text.commit();
+        }
+        for (std::size_t lu = 0u; lu < m_data.size(); ++lu) {
+            for (std::size_t s = 0u; s < 2u; ++s) {
+                auto const & blocks = m_data[lu][s];
+                if (!blocks.collect)
+                    continue;
+                ObjectData data(m_object,
+                                static_cast<std::uint8_t>(lu),
+                                dataSectionTypes[s]);
+                for (std::size_t b = 0u; b < blocks.starts.size(); ++b) {
+                    if (blocks.live[b])
+                        continue;
+                    auto const end = (b + 1u < blocks.starts.size())
+                                     ? blocks.starts[b + 1u]
+                                     : blocks.size;
+                    data.remove(blocks.starts[b], end);
+                    removed += end - blocks.starts[b];
+                }
+                data.commit();
+            }
+        }
+        return removed;
+    }
+
+private: /* Fields: */
+
+    Object & m_object;
+    std::unordered_map<std::string_view, std::size_t> m_symbols;
+    std::deque<ObjectText> m_texts;
+    std::vector<std::vector<bool> > m_liveCode;
+    std::vector<std::array<DataBlocks, 2u> > m_data;
+    std::multimap<ExpressionKey, std::size_t> m_expressions;
+    std::vector<std::pair<std::uint8_t, std::size_t> > m_codeWork;
+    std::vector<std::tuple<std::uint8_t, std::size_t, std::size_t> >
+            m_dataWork;
+
+};
+
+} // anonymous namespace
+
+std::size_t gcSections(Object & object) { return Collector(object).run(); }
+
+} // namespace Assembler {
+} // namespace sharemind {
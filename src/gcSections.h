@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_GCSECTIONS_H
+#define SHAREMIND_LIBAS_GCSECTIONS_H
+
+#include <cstddef>
+#include "Object.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief Removes the unreachable code and the unreferenced RODATA and DATA of
+         an object containing a whole program.
+
+  Code is reachable from the start of the TEXT section of every linking unit.
+  The code after a reachable instruction is reachable unless the instruction
+  is an unconditional jump, a halt or a return. The targets of reachable jumps
+  are reachable, as are the code labels used by reachable code or referenced
+  data, e.g. the procedures called.
+
+  RODATA and DATA are split into blocks at their labels, and a block is kept
+  if a label of it is used by reachable code or by referenced data. The bytes
+  before the first label of a section are always kept. Sections whose labels
+  are used in arithmetic expressions are kept whole, as are all sections if
+  any expression uses the sizes of sections.
+
+  Linking units whose code addresses are not all given by labels, see
+  ObjectText, keep all of their code.
+
+  \returns the number of bytes removed from the TEXT, RODATA and DATA
+           sections.
+*/
+std::size_t gcSections(Object & object);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_GCSECTIONS_H */
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "layoutCode.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "ObjectText.h"
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+using SectionType = Object::SectionType;
+
+bool isJump(ObjectText::Instruction const & instruction) noexcept
+{ return instruction.isJump && (instruction.baseName == "jmp_imm"); }
+
+/** \returns whether the code after the instruction is not reached by it. */
+bool isTerminator(ObjectText::Instruction const & instruction) noexcept {
+    auto const & name = instruction.baseName;
+    return isJump(instruction)
+           || (name.substr(0u, 4u) == "halt")
+           || (name.substr(0u, 6u) == "return");
+}
+
+/** A run of instructions falling through to each other. */
+struct Chain {
+
+/* Fields: */
+
+    /** The index of the first instruction. */
+    std::size_t begin;
+
+    /** The index following the last instruction. */
+    std::size_t end;
+
+    /** The highest count of the instructions. */
+    std::uint64_t heat;
+
+};
+
+class Layout {
+
+public: /* Methods: */
+
+    Layout(ObjectText & text, ExecutionProfile const & profile)
+        : m_text(text)
+        , m_profile(profile)
+    {}
+
+    bool run() {
+        if (!m_text.isEditable() || m_text.instructions().empty())
+            return false;
+        std::vector<std::uint64_t> counts;
+        if (!readCounts(counts))
+            return false;
+        splitChains(counts);
+
+        /* A chain falling off the end of the section must stay last: */
+        auto const & instructions = m_text.instructions();
+        auto numMovable = m_chains.size();
+        if (!isTerminator(instructions[m_chains.back().end - 1u])
+            && (numMovable > 1u))
+            --numMovable;
+
+        std::vector<std::size_t> hot;
+        for (std::size_t c = 1u; c < numMovable; ++c)
+            if (m_chains[c].heat)
+                hot.push_back(c);
+        std::stable_sort(hot.begin(),
+                         hot.end(),
+                         [this](std::size_t const a, std::size_t const b)
+                         { return m_chains[a].heat > m_chains[b].heat; });
+
+        std::vector<bool> placed(m_chains.size(), false);
+        std::vector<std::size_t> layout;
+        layout.reserve(m_chains.size());
+        placed[0u] = true;
+        layout.push_back(0u);
+        for (std::size_t nextHot = 0u;;) {
+            auto next = jumpTarget(layout.back());
+            if ((next >= numMovable) || placed[next] || !m_chains[next].heat) {
+                while ((nextHot < hot.size()) && placed[hot[nextHot]])
+                    ++nextHot;
+                if (nextHot == hot.size())
+                    break;
+                next = hot[nextHot];
+            }
+            placed[next] = true;
+            layout.push_back(next);
+        }
+        for (std::size_t c = 0u; c < m_chains.size(); ++c)
+            if (!placed[c])
+                layout.push_back(c);
+
+        /* Let chains fall through to the chain laid out next: */
+        bool changed = false;
+        for (std::size_t i = 0u; i < layout.size(); ++i) {
+            if (layout[i] != i)
+                changed = true;
+            if ((i + 1u < layout.size())
+                && (jumpTarget(layout[i]) == layout[i + 1u]))
+                m_text.remove(m_chains[layout[i]].end - 1u);
+        }
+        if (!changed && !m_text.numRemoved())
+            return false;
+
+        std::vector<std::size_t> order;
+        order.reserve(instructions.size());
+        for (auto const c : layout)
+            for (auto i = m_chains[c].begin; i < m_chains[c].end; ++i)
+                order.push_back(i);
+        m_text.commit(order);
+        return changed;
+    }
+
+private: /* Methods: */
+
+    /**
+      \brief Reads the counts of the instructions from the profile.
+      \returns whether the profile has any entry for the instructions.
+    */
+    bool readCounts(std::vector<std::uint64_t> & counts) const {
+        auto const & object = m_text.object();
+        auto const & entries = m_profile.entries();
+        auto const size = object.instructionStarts[m_text.linkingUnit()].size();
+        counts.assign(m_text.instructions().size(), 0u);
+        bool found = false;
+        for (auto const & symbol : object.symbols) {
+            if ((symbol.section != SectionType::Text)
+                || (symbol.linkingUnit != m_text.linkingUnit())
+                || symbol.name.empty()
+                || (symbol.name.front() == '.') /* Local label */
+                || (symbol.offset >= size))
+                continue;
+            auto const it(entries.find(symbol.name));
+            if (it == entries.end())
+                continue;
+            for (auto const & entry : it->second) {
+                if (entry.first >= size - symbol.offset)
+                    break;
+                auto const i =
+                        m_text.instructionAt(symbol.offset + entry.first);
+                if (i == ObjectText::npos)
+                    continue;
+                counts[i] = std::max(counts[i], entry.second);
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    void splitChains(std::vector<std::uint64_t> const & counts) {
+        auto const & instructions = m_text.instructions();
+        m_chainAt.resize(instructions.size());
+        for (std::size_t i = 0u; i < instructions.size(); ++i) {
+            if (!i || isTerminator(instructions[i - 1u]))
+                m_chains.push_back(Chain{i, i, 0u});
+            auto & chain = m_chains.back();
+            chain.end = i + 1u;
+            chain.heat = std::max(chain.heat, counts[i]);
+            m_chainAt[i] = m_chains.size() - 1u;
+        }
+    }
+
+    /**
+      \returns the chain starting at the target of the jump ending the given
+               chain, or the number of chains if there is none.
+    */
+    std::size_t jumpTarget(std::size_t const chain) const noexcept {
+        auto const & instructions = m_text.instructions();
+        auto const & jump = instructions[m_chains[chain].end - 1u];
+        std::size_t t;
+        if (isJump(jump)) {
+            auto const * const r = m_text.relocationAt(jump.offset + 1u);
+            if (r && m_text.target(*r, t)) {
+                auto const i = m_text.instructionAt(t);
+                if ((i != ObjectText::npos)
+                    && (m_chains[m_chainAt[i]].begin == i))
+                    return m_chainAt[i];
+            }
+        }
+        return m_chains.size();
+    }
+
+private: /* Fields: */
+
+    ObjectText & m_text;
+    ExecutionProfile const & m_profile;
+    std::vector<Chain> m_chains;
+
+    /** The chain of every instruction. */
+    std::vector<std::size_t> m_chainAt;
+
+};
+
+} // anonymous namespace
+
+std::size_t layoutCode(Object & object, ExecutionProfile const & profile) {
+    std::size_t reordered = 0u;
+    auto const & lus = object.executable.linkingUnits;
+    for (std::size_t i = 0u; i < lus.size(); ++i) {
+        ObjectText text(object, static_cast<std::uint8_t>(i));
+        if (Layout(text, profile).run())
+            ++reordered;
+    }
+    return reordered;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
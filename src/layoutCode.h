@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_LAYOUTCODE_H
+#define SHAREMIND_LIBAS_LAYOUTCODE_H
+
+#include <cstddef>
+#include "ExecutionProfile.h"
+#include "Object.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief Reorders the code of an object containing a whole program by the
+         given execution profile, so that hot code is contiguous and cold code
+         is moved to the end of the TEXT section of every linking unit.
+
+  The code is split into chains of basic blocks which fall through to each
+  other, i.e. the code after an unconditional jump, a halt or a return up to
+  and including the next such instruction. Chains keep their order inside,
+  including the instructions after calls, so no jumps need to be added. The
+  chain at the start of the section stays first and is followed by the chain
+  its final jump targets if that is hot, or else by the hottest chain left,
+  where the heat of a chain is the highest count of its instructions. Chains
+  never executed follow in their original order. Jumps to the chain laid out
+  next are removed.
+
+  Linking units without entries in the profile and linking units whose code
+  addresses are not all given by labels, see ObjectText, are left as they are.
+
+  \returns the number of linking units whose code was reordered.
+*/
+std::size_t layoutCode(Object & object, ExecutionProfile const & profile);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_LAYOUTCODE_H */
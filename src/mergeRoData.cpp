@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "mergeRoData.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ObjectData.h"
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+using SectionType = Object::SectionType;
+
+/** A block of a RODATA section between its labels. */
+struct Block {
+
+/* Fields: */
+
+    std::size_t begin;
+    std::size_t end;
+
+    /** Whether other blocks may be merged into this one. */
+    bool isTarget = true;
+
+    /** Whether this block may be merged into another one. */
+    bool isSource = true;
+
+    /** The offset of the block, or the offset its labels are redirected to if
+        it is merged. */
+    std::size_t location;
+
+    bool merged = false;
+
+};
+
+class Merger {
+
+public: /* Methods: */
+
+    Merger(ObjectData & data) : m_data(data) {}
+
+    std::size_t run() {
+        if ((m_data.alignment() > 1u) || !splitBlocks() || !checkUses())
+            return 0u;
+        markExpressions();
+
+        std::size_t removed = 0u;
+        auto const redirect =
+                [this, &removed](Block & block, std::size_t const to) {
+                    m_data.redirect(block.begin, block.end, to);
+                    block.location = to;
+                    block.merged = true;
+                    removed += block.end - block.begin;
+                };
+
+        /* Remove the blocks equal to earlier ones: */
+        std::unordered_map<std::string_view, std::size_t> firstBlocks;
+        for (auto & block : m_blocks) {
+            if (!block.isTarget)
+                continue;
+            auto const it(firstBlocks.emplace(bytes(block), block.begin));
+            if (!it.second && block.isSource)
+                redirect(block, it.first->second);
+        }
+
+        /* Merge the blocks into the blocks they end: */
+        std::vector<Block *> tails;
+        for (auto & block : m_blocks)
+            if (block.isTarget && !block.merged)
+                tails.push_back(&block);
+        std::sort(tails.begin(),
+                  tails.end(),
+                  [this](Block const * const a, Block const * const b) {
+                      auto const x(bytes(*a));
+                      auto const y(bytes(*b));
+                      return std::lexicographical_compare(x.rbegin(),
+                                                          x.rend(),
+                                                          y.rbegin(),
+                                                          y.rend());
+                  });
+        for (auto i = tails.size(); i-- > 1u;) {
+            auto & block = *tails[i - 1u];
+            auto const & longer = *tails[i];
+            auto const x(bytes(block));
+            auto const y(bytes(longer));
+            if (!block.isSource
+                || (x.size() >= y.size())
+                || (y.substr(y.size() - x.size()) != x))
+                continue;
+            redirect(block, longer.location + (y.size() - x.size()));
+        }
+
+        m_data.commit();
+        return removed;
+    }
+
+private: /* Methods: */
+
+    std::string_view bytes(Block const & block) const noexcept {
+        return std::string_view(m_data.data() + block.begin,
+                                block.end - block.begin);
+    }
+
+    /** \returns whether the section has labels. */
+    bool splitBlocks() {
+        auto const size = m_data.size();
+        auto starts(m_data.symbolOffsets());
+        while (!starts.empty() && (starts.back() >= size))
+            starts.pop_back();
+        if (starts.empty())
+            return false;
+        if (starts.front()) {
+            /* The bytes before the first label are not known to be unused: */
+            m_blocks.push_back(Block{0u, starts.front(), true, false, 0u});
+        }
+        for (std::size_t i = 0u; i < starts.size(); ++i)
+            m_blocks.push_back(
+                    Block{starts[i],
+                          (i + 1u < starts.size()) ? starts[i + 1u] : size,
+                          true,
+                          true,
+                          starts[i]});
+        return true;
+    }
+
+    /** \returns the block containing the given offset. */
+    Block & blockAt(std::size_t const offset) noexcept {
+        auto const it(std::upper_bound(
+                          m_blocks.begin(),
+                          m_blocks.end(),
+                          offset,
+                          [](std::size_t const o, Block const & block) noexcept
+                          { return o < block.begin; }));
+        return *(it - 1);
+    }
+
+    /** \returns whether the labels of the section refer only to the bytes of
+                 their blocks. */
+    bool checkUses() {
+        auto const & object = m_data.object();
+        for (auto const & p : object.expressions) {
+            if (p.expression.ops().size() == 1u)
+                continue;
+            for (auto const & label : p.expression.labels()) {
+                auto const * const s = m_data.symbol(label.name);
+                if (s && m_data.contains(*s))
+                    return false;
+            }
+        }
+        for (auto const & r : object.relocations) {
+            if (!r.addend)
+                continue;
+            auto const * const s = m_data.symbol(r.label);
+            if (!s || !m_data.contains(*s) || (s->offset >= m_data.size()))
+                continue;
+            auto const & block = blockAt(s->offset);
+            auto const target = static_cast<std::int64_t>(s->offset) + r.addend;
+            if ((target < static_cast<std::int64_t>(block.begin))
+                || (target >= static_cast<std::int64_t>(block.end)))
+                return false;
+        }
+        return true;
+    }
+
+    /** \brief Excludes the blocks whose bytes are not yet known. */
+    void markExpressions() {
+        for (auto const & p : m_data.object().expressions) {
+            if ((p.linkingUnit != m_data.linkingUnit())
+                || (p.section != m_data.section())
+                || (p.offset >= m_data.size()))
+                continue;
+            auto & block = blockAt(p.offset);
+            block.isTarget = false;
+            block.isSource = false;
+            /* The value of up to 8 bytes may span the following blocks: */
+            auto * b = &block;
+            while ((b != &m_blocks.back())
+                   && (p.offset + 8u > (b + 1)->begin))
+            {
+                ++b;
+                b->isTarget = false;
+                b->isSource = false;
+            }
+        }
+    }
+
+private: /* Fields: */
+
+    ObjectData & m_data;
+    std::vector<Block> m_blocks;
+
+};
+
+} // anonymous namespace
+
+std::size_t mergeRoData(Object & object) {
+    for (auto const & p : object.expressions)
+        if (p.expression.usesSectionSizes())
+            return 0u;
+    std::size_t removed = 0u;
+    auto const & lus = object.executable.linkingUnits;
+    for (std::size_t i = 0u; i < lus.size(); ++i) {
+        ObjectData data(object,
+                        static_cast<std::uint8_t>(i),
+                        SectionType::RoData);
+        removed += Merger(data).run();
+    }
+    return removed;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_MERGERODATA_H
+#define SHAREMIND_LIBAS_MERGERODATA_H
+
+#include <cstddef>
+#include "Object.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief Stores equal constants of the RODATA sections of an object containing
+         a whole program only once.
+
+  The RODATA section of every linking unit is split into blocks at its labels,
+  see ObjectData. A block equal to an earlier block is removed and its labels
+  refer to the earlier one instead, and a block equal to the end of a longer
+  block, e.g. the tail of a longer string, is merged into it the same way.
+
+  The bytes before the first label of a section and blocks written by pending
+  expressions are not merged into other blocks. Sections whose labels are
+  used in arithmetic expressions or with offsets outside of their blocks are
+  left as they are, as are all sections if any expression uses the sizes of
+  sections.
+
+  \returns the number of bytes removed from the RODATA sections.
+*/
+std::size_t mergeRoData(Object & object);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_MERGERODATA_H */
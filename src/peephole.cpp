@@ -0,0 +1,284 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "peephole.h"
+
+#include <cstdint>
+#include <string_view>
+#include "ObjectText.h"
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+/** The maximum number of passes over a section. */
+constexpr std::size_t const maxPasses = 8u;
+
+/** The maximum number of jumps followed to find the final target. */
+constexpr std::size_t const maxJumpChain = 16u;
+
+/** The kind of an operand as named in instruction names. */
+enum class Operand { Imm, Reg, Stack, Other };
+
+Operand operandKind(std::string_view const name) noexcept {
+    if (name == "imm")
+        return Operand::Imm;
+    if (name == "reg")
+        return Operand::Reg;
+    if (name == "stack")
+        return Operand::Stack;
+    return Operand::Other;
+}
+
+/**
+  \brief A plain move of a whole value, e.g. mov_imm_reg, with the kinds of its
+         source and destination operands. Moves of partial values or through
+         references have more components in their names.
+*/
+struct Move {
+
+/* Fields: */
+
+    Operand source = Operand::Other;
+    Operand destination = Operand::Other;
+
+};
+
+bool decodeMove(ObjectText::Instruction const & instruction, Move & move) {
+    auto const & name = instruction.baseName;
+    if ((instruction.numArgs != 2u) || (name.substr(0u, 4u) != "mov_"))
+        return false;
+    auto const rest = name.substr(4u);
+    auto const sep = rest.find('_');
+    if (sep == std::string_view::npos)
+        return false;
+    move.source = operandKind(rest.substr(0u, sep));
+    move.destination = operandKind(rest.substr(sep + 1u));
+    return (move.source != Operand::Other)
+           && ((move.destination == Operand::Reg)
+               || (move.destination == Operand::Stack));
+}
+
+class Peephole {
+
+private: /* Types: */
+
+    using Instruction = ObjectText::Instruction;
+
+    struct Rule {
+
+    /* Fields: */
+
+        /** Applies the rule at the given instruction, returning whether it
+            changed anything. */
+        bool (Peephole::* apply)(std::size_t index);
+
+    };
+
+    static Rule const rules[];
+
+public: /* Methods: */
+
+    Peephole(ObjectText & text) : m_text(text) {}
+
+    /** \returns the number of instructions removed. */
+    std::size_t run();
+
+private: /* Methods: */
+
+    Instruction const & instruction(std::size_t const index) const noexcept
+    { return m_text.instructions()[index]; }
+
+    /** \returns whether the given instruction and the one after it are both
+                 kept so far. */
+    bool hasNext(std::size_t const index) const noexcept {
+        return (index + 1u < m_text.instructions().size())
+               && !m_text.isRemoved(index + 1u);
+    }
+
+    /**
+      \brief Reads an argument of an instruction.
+      \returns whether the value of the argument is known.
+    */
+    bool argument(Instruction const & instruction,
+                  std::size_t const n,
+                  std::uint64_t & value) const noexcept
+    {
+        auto const offset = instruction.offset + 1u + n;
+        if (m_text.isPatched(offset))
+            return false;
+        value = m_text.block(offset).uint64[0u];
+        return true;
+    }
+
+    bool isUnconditionalJump(Instruction const & instruction) const noexcept
+    { return instruction.isJump && (instruction.baseName == "jmp_imm"); }
+
+    /** \brief Redirects a jump to an unconditional jump to its target. */
+    bool threadJump(std::size_t const index) {
+        auto const & jump = instruction(index);
+        if (!jump.isJump)
+            return false;
+        auto & r = *m_text.relocationAt(jump.offset + 1u);
+        bool changed = false;
+        for (std::size_t i = 0u; i < maxJumpChain; ++i) {
+            std::size_t t;
+            if (!m_text.target(r, t))
+                break;
+            auto const next = m_text.instructionAt(t);
+            if ((next == ObjectText::npos)
+                || !isUnconditionalJump(instruction(next)))
+                break;
+            auto const & r2 = *m_text.relocationAt(t + 1u);
+            std::size_t t2;
+            if (!m_text.target(r2, t2) || (t2 == t))
+                break;
+            r.label = r2.label;
+            r.addend = r2.addend;
+            changed = true;
+        }
+        return changed;
+    }
+
+    /** \brief Removes an unconditional jump to the next instruction. */
+    bool removeJumpToNext(std::size_t const index) {
+        auto const & jump = instruction(index);
+        std::size_t t;
+        if (!isUnconditionalJump(jump)
+            || !m_text.target(*m_text.relocationAt(jump.offset + 1u), t)
+            || (t != jump.offset + jump.numArgs + 1u))
+            return false;
+        m_text.remove(index);
+        return true;
+    }
+
+    /** \brief Removes a move of a register or stack value to itself. */
+    bool removeSelfMove(std::size_t const index) {
+        auto const & mov = instruction(index);
+        Move move;
+        std::uint64_t source;
+        std::uint64_t destination;
+        if (!decodeMove(mov, move)
+            || (move.source != move.destination)
+            || !argument(mov, 0u, source)
+            || !argument(mov, 1u, destination)
+            || (source != destination))
+            return false;
+        m_text.remove(index);
+        return true;
+    }
+
+    /** \brief Removes an immediate move overwritten by the next move. */
+    bool removeDeadMove(std::size_t const index) {
+        auto const & first = instruction(index);
+        Move firstMove;
+        if (!hasNext(index)
+            || !decodeMove(first, firstMove)
+            || (firstMove.source != Operand::Imm))
+            return false;
+        auto const & second = instruction(index + 1u);
+        Move secondMove;
+        std::uint64_t firstDestination;
+        std::uint64_t secondDestination;
+        if (!decodeMove(second, secondMove)
+            || (secondMove.destination != firstMove.destination)
+            || !argument(first, 1u, firstDestination)
+            || !argument(second, 1u, secondDestination)
+            || (firstDestination != secondDestination))
+            return false;
+        /* The second move must not read the value of the first: */
+        if (secondMove.source == firstMove.destination) {
+            std::uint64_t secondSource;
+            if (!argument(second, 0u, secondSource)
+                || (secondSource == firstDestination))
+                return false;
+        }
+        m_text.remove(index);
+        return true;
+    }
+
+    /**
+      \brief Removes a resizestack followed by a resizestack to no more values,
+             as all values it kept are kept by the second one.
+    */
+    bool foldResizeStack(std::size_t const index) {
+        auto const & first = instruction(index);
+        if (!hasNext(index)
+            || (first.baseName != "resizestack")
+            || (first.numArgs != 1u))
+            return false;
+        auto const & second = instruction(index + 1u);
+        std::uint64_t firstSize;
+        std::uint64_t secondSize;
+        if ((second.code != first.code)
+            || !argument(first, 0u, firstSize)
+            || !argument(second, 0u, secondSize)
+            || (secondSize > firstSize))
+            return false;
+        m_text.remove(index);
+        return true;
+    }
+
+private: /* Fields: */
+
+    ObjectText & m_text;
+
+};
+
+Peephole::Rule const Peephole::rules[] = {
+    { &Peephole::threadJump },
+    { &Peephole::removeJumpToNext },
+    { &Peephole::removeSelfMove },
+    { &Peephole::removeDeadMove },
+    { &Peephole::foldResizeStack }
+};
+
+std::size_t Peephole::run() {
+    std::size_t removed = 0u;
+    for (std::size_t pass = 0u; pass < maxPasses; ++pass) {
+        if (!m_text.isEditable())
+            break;
+        bool changed = false;
+        for (std::size_t i = 0u; i < m_text.instructions().size(); ++i)
+            for (auto const & rule : rules)
+                if (!m_text.isRemoved(i) && (this->*rule.apply)(i))
+                    changed = true;
+        removed += m_text.numRemoved();
+        m_text.commit();
+        if (!changed)
+            break;
+    }
+    return removed;
+}
+
+} // anonymous namespace
+
+std::size_t peephole(Object & object) {
+    std::size_t removed = 0u;
+    auto const & lus = object.executable.linkingUnits;
+    for (std::size_t i = 0u; i < lus.size(); ++i) {
+        ObjectText text(object, static_cast<std::uint8_t>(i));
+        removed += Peephole(text).run();
+    }
+    return removed;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_PEEPHOLE_H
+#define SHAREMIND_LIBAS_PEEPHOLE_H
+
+#include <cstddef>
+#include "Object.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief Applies peephole optimizations to the TEXT sections of an object
+         containing a whole program.
+
+  The rules are matched against instructions by their names and numbers of
+  arguments in the libvmi instruction table:
+    - jumps to unconditional jumps are redirected to the final target;
+    - unconditional jumps to the next instruction are removed;
+    - moves of a register or stack value to itself are removed;
+    - an immediate move to a register or stack value which is overwritten by
+      the next instruction, also a move, is removed;
+    - a resizestack followed by a resizestack to no more values is removed.
+
+  Linking units whose code addresses are not all given by labels, see
+  ObjectText, are left unchanged.
+
+  \returns the number of instructions removed.
+*/
+std::size_t peephole(Object & object);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_PEEPHOLE_H */
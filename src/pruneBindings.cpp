@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "pruneBindings.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ObjectText.h"
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+using SectionType = Object::SectionType;
+
+/** \returns the entries of the given BIND or PDBIND section, or null. */
+std::vector<std::string> const * bindings(
+        Executable::LinkingUnit const & lu,
+        SectionType const section) noexcept
+{
+    if (section == SectionType::Bind)
+        return lu.syscallBindingsSection
+               ? &lu.syscallBindingsSection->syscallBindings
+               : nullptr;
+    return lu.pdBindingsSection ? &lu.pdBindingsSection->pdBindings : nullptr;
+}
+
+/** \returns whether every system call of the linking unit uses a label for
+             its binding. */
+bool syscallsUseLabels(Object & object, std::uint8_t const linkingUnit) {
+    if (!object.executable.linkingUnits[linkingUnit].textSection)
+        return true;
+    ObjectText text(object, linkingUnit);
+    if (!text.isEditable())
+        return false;
+    for (auto const & instruction : text.instructions())
+        if ((instruction.baseName.substr(0u, 11u) == "syscall_imm")
+            && instruction.numArgs
+            && !text.isPatched(instruction.offset + 1u))
+            return false;
+    return true;
+}
+
+class Pruner {
+
+public: /* Methods: */
+
+    Pruner(Object & object, std::uint8_t const linkingUnit)
+        : m_object(object)
+        , m_linkingUnit(linkingUnit)
+    {}
+
+    std::size_t run(SectionType const section) {
+        auto const & lu = m_object.executable.linkingUnits[m_linkingUnit];
+        auto const * const entries = bindings(lu, section);
+        if (!entries || entries->empty())
+            return 0u;
+        std::vector<bool> used;
+        if (!findUses(section, entries->size(), used))
+            return 0u;
+        if ((section == SectionType::Bind)
+            && !syscallsUseLabels(m_object, m_linkingUnit))
+            return 0u;
+
+        /* The new index of every entry, with removed entries at the number of
+           entries kept before them: */
+        std::vector<std::size_t> newIndices(entries->size());
+        std::vector<std::string> kept;
+        std::unordered_map<std::string_view, std::size_t> keptIndices;
+        for (std::size_t i = 0u; i < entries->size(); ++i) {
+            auto const & entry = (*entries)[i];
+            if (!used[i]) {
+                newIndices[i] = kept.size();
+                continue;
+            }
+            auto const it(keptIndices.find(entry));
+            if (it != keptIndices.end()) {
+                newIndices[i] = it->second;
+            } else {
+                newIndices[i] = kept.size();
+                kept.push_back(entry);
+                keptIndices.emplace((*entries)[i], newIndices[i]);
+            }
+        }
+        auto const removed = entries->size() - kept.size();
+        if (!removed)
+            return 0u;
+
+        for (auto & symbol : m_object.symbols)
+            if (contains(symbol, section))
+                symbol.offset = newIndices[symbol.offset];
+
+        /* The sections may be shared with other executables: */
+        auto & writableLu = m_object.executable.linkingUnits[m_linkingUnit];
+        if (section == SectionType::Bind) {
+            if (kept.empty()) {
+                writableLu.syscallBindingsSection.reset();
+            } else {
+                auto s(std::make_shared<
+                            Executable::SyscallBindingsSection>());
+                s->syscallBindings = std::move(kept);
+                writableLu.syscallBindingsSection = std::move(s);
+            }
+        } else {
+            if (kept.empty()) {
+                writableLu.pdBindingsSection.reset();
+            } else {
+                auto s(std::make_shared<Executable::PdBindingsSection>());
+                s->pdBindings = std::move(kept);
+                writableLu.pdBindingsSection = std::move(s);
+            }
+        }
+        return removed;
+    }
+
+private: /* Methods: */
+
+    bool contains(Object::Symbol const & symbol, SectionType const section)
+            const noexcept
+    {
+        return (symbol.section == section)
+               && (symbol.linkingUnit == m_linkingUnit);
+    }
+
+    /**
+      \brief Finds the entries whose labels are used.
+      \returns whether the section may be pruned.
+    */
+    bool findUses(SectionType const section,
+                  std::size_t const size,
+                  std::vector<bool> & used) const
+    {
+        std::unordered_map<std::string_view, std::size_t> offsets;
+        std::vector<bool> labeled(size, false);
+        for (auto const & symbol : m_object.symbols) {
+            if (!contains(symbol, section))
+                continue;
+            if (symbol.offset >= size)
+                return false;
+            labeled[symbol.offset] = true;
+            offsets.emplace(symbol.name, symbol.offset);
+        }
+        for (std::size_t i = 0u; i < size; ++i)
+            if (!labeled[i])
+                return false;
+
+        used.assign(size, false);
+        for (auto const & r : m_object.relocations) {
+            auto const it(offsets.find(r.label));
+            if (it == offsets.end())
+                continue;
+            if (r.addend)
+                return false;
+            used[it->second] = true;
+        }
+        for (auto const & p : m_object.expressions) {
+            for (auto const & label : p.expression.labels()) {
+                auto const it(offsets.find(label.name));
+                if (it == offsets.end())
+                    continue;
+                if (p.expression.ops().size() != 1u)
+                    return false;
+                used[it->second] = true;
+            }
+        }
+        return true;
+    }
+
+private: /* Fields: */
+
+    Object & m_object;
+    std::uint8_t const m_linkingUnit;
+
+};
+
+} // anonymous namespace
+
+std::size_t pruneBindings(Object & object) {
+    for (auto const & p : object.expressions)
+        if (p.expression.usesSectionSizes())
+            return 0u;
+    std::size_t removed = 0u;
+    auto const & lus = object.executable.linkingUnits;
+    for (std::size_t i = 0u; i < lus.size(); ++i) {
+        Pruner pruner(object, static_cast<std::uint8_t>(i));
+        removed += pruner.run(SectionType::Bind);
+        removed += pruner.run(SectionType::PdBind);
+    }
+    return removed;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
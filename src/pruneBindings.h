@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_PRUNEBINDINGS_H
+#define SHAREMIND_LIBAS_PRUNEBINDINGS_H
+
+#include <cstddef>
+#include "Object.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief Removes the unreferenced and duplicate entries of the BIND and PDBIND
+         sections of an object containing a whole program, so that the VM
+         resolves fewer bindings when loading it.
+
+  An entry is referenced if a label of it is used by an instruction or an
+  expression. The labels of removed duplicates refer to the first equal entry
+  kept, and the labels of the others are renumbered.
+
+  Binding indices given as plain numbers can not be followed, so a section is
+  left as it is unless every entry of it has a label. BIND sections are also
+  left as they are if any system call of the linking unit gives its binding
+  as a plain number, or if the code of the linking unit can not be decoded,
+  see ObjectText. Sections whose labels are used with offsets or in
+  arithmetic expressions are kept whole, as are all sections if any
+  expression uses the sizes of sections.
+
+  \returns the number of entries removed.
+*/
+std::size_t pruneBindings(Object & object);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_PRUNEBINDINGS_H */
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "readFile.h"
+
+#include <cassert>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+using Buffer = std::pmr::vector<char>;
+
+class FileDescriptor {
+
+public: /* Methods: */
+
+    FileDescriptor(char const * path) noexcept
+        /* Opening FIFOs without O_NONBLOCK would wait for a writer: */
+        : m_fd(::open(path, O_RDONLY | O_CLOEXEC | O_NONBLOCK))
+    {}
+
+    FileDescriptor(FileDescriptor const &) = delete;
+    FileDescriptor & operator=(FileDescriptor const &) = delete;
+
+    ~FileDescriptor() noexcept {
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+
+    int get() const noexcept { return m_fd; }
+
+private: /* Fields: */
+
+    int const m_fd;
+
+};
+
+std::shared_ptr<Buffer> makeBuffer(std::pmr::memory_resource * memoryResource,
+                                   std::size_t const size)
+{
+    return std::allocate_shared<Buffer>(
+                std::pmr::polymorphic_allocator<Buffer>(memoryResource),
+                size);
+}
+
+/** \returns whether size bytes at the given offset were read. */
+bool readFully(int const fd,
+               char * buffer,
+               std::size_t size,
+               std::uint64_t offset) noexcept
+{
+    while (size) {
+        auto const r = ::pread(fd, buffer, size, static_cast<off_t>(offset));
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        if (r == 0) /* Unexpected end of file */
+            return false;
+        auto const n = static_cast<std::size_t>(r);
+        buffer += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+ReadFileResult readFile(char const * path,
+                        std::uint64_t offset,
+                        std::uint64_t length,
+                        std::pmr::memory_resource * memoryResource,
+                        std::shared_ptr<void> & data,
+                        std::size_t & size,
+                        bool allowMapping,
+                        std::uint64_t maxLength)
+{
+    assert(path);
+    assert(memoryResource);
+
+    FileDescriptor const fd(path);
+    if (fd.get() < 0)
+        return ReadFileResult::FileError;
+
+    struct ::stat st;
+    if (::fstat(fd.get(), &st) != 0)
+        return ReadFileResult::FileError;
+    /* Other files may not have a size or an end: */
+    if (!S_ISREG(st.st_mode))
+        return ReadFileResult::FileError;
+
+    /* Check the requested range: */
+    auto const fileSize = static_cast<std::uint64_t>(st.st_size);
+    if (offset > fileSize)
+        return ReadFileResult::InvalidRange;
+    if (length == readFileToEnd) {
+        length = fileSize - offset;
+    } else if (length > fileSize - offset) {
+        return ReadFileResult::InvalidRange;
+    }
+    if (length > std::numeric_limits<std::size_t>::max())
+        return ReadFileResult::InvalidRange;
+    if (length > maxLength)
+        return ReadFileResult::TooLarge;
+    if (!length) {
+        data.reset();
+        size = 0u;
+        return ReadFileResult::Ok;
+    }
+
+    /* Try to map the range, starting at a page boundary: */
+    static auto const pageSize =
+            static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+    auto const pageOffset = offset % pageSize;
+    auto const mapOffset = offset - pageOffset;
+    if (allowMapping
+        && (length <= std::numeric_limits<std::size_t>::max() - pageOffset))
+    {
+        auto const mapLength = static_cast<std::size_t>(length + pageOffset);
+        void * const mapping = ::mmap(nullptr,
+                                      mapLength,
+                                      PROT_READ | PROT_WRITE,
+                                      MAP_PRIVATE,
+                                      fd.get(),
+                                      static_cast<off_t>(mapOffset));
+        if (mapping != MAP_FAILED) {
+            /* If allocating the control block fails, the deleter is called: */
+            data = std::shared_ptr<void>(
+                        static_cast<char *>(mapping) + pageOffset,
+                        [mapping, mapLength](void *) noexcept
+                        { ::munmap(mapping, mapLength); },
+                        std::pmr::polymorphic_allocator<char>(memoryResource));
+            size = static_cast<std::size_t>(length);
+            return ReadFileResult::Ok;
+        }
+    }
+
+    /* Fall back to a single bulk read: */
+    auto buffer(makeBuffer(memoryResource, static_cast<std::size_t>(length)));
+    if (!readFully(fd.get(), buffer->data(), buffer->size(), offset))
+        return ReadFileResult::FileError;
+    data = std::shared_ptr<void>(buffer, buffer->data());
+    size = buffer->size();
+    return ReadFileResult::Ok;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_READFILE_H
+#define SHAREMIND_LIBAS_READFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+
+
+namespace sharemind {
+namespace Assembler {
+
+enum class ReadFileResult {
+    Ok,
+    FileError,   /* The file could not be opened or read. */
+    InvalidRange, /* The range extends past the end of the file. */
+    TooLarge      /* The range is longer than allowed. */
+};
+
+constexpr std::uint64_t const readFileToEnd =
+        std::numeric_limits<std::uint64_t>::max();
+
+/**
+  \brief Provides the contents of the given range of a file.
+
+  Regular files are mapped into memory privately, so that the data is only read
+  from disk when accessed and any writes to the data are not written back to
+  the file. If a file can not be mapped, the range is read into memory
+  allocated from the given memory resource in one go. Other files, e.g. FIFOs
+  and devices, fail with FileError, as reading them might not end.
+
+  \param[in] path The path of the file.
+  \param[in] offset The offset in bytes of the range in the file.
+  \param[in] length The length in bytes of the range, or readFileToEnd for the
+                    rest of the file.
+  \param[in] memoryResource The resource to allocate any memory from.
+  \param[out] data Where to store the pointer to the data on success. Empty
+                   ranges result in an empty pointer.
+  \param[out] size Where to store the size of the data in bytes on success.
+  \param[in] allowMapping Whether the file may be mapped instead of read.
+  \param[in] maxLength The maximum length of the range, checked before any
+                       data is read.
+  \note If a mapped file is truncated or modified while the data is still in
+        use, the data may change or accessing it may raise SIGBUS.
+*/
+ReadFileResult readFile(char const * path,
+                        std::uint64_t offset,
+                        std::uint64_t length,
+                        std::pmr::memory_resource * memoryResource,
+                        std::shared_ptr<void> & data,
+                        std::size_t & size,
+                        bool allowMapping = true,
+                        std::uint64_t maxLength = readFileToEnd);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_READFILE_H */
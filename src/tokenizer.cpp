@@ -20,6 +20,7 @@
 #include "tokenizer.h"
 
 #include <cassert>
+#include <new>
 #include <sharemind/Concat.h>
 #include <sharemind/likely.h>
 #include "Exception.h"
@@ -60,14 +61,22 @@ SHAREMIND_DEFINE_EXCEPTION_CONST_STDSTRING_NOINLINE(Exception,,
 
 #define SEPARATOR_WHITESPACE ' ': case '\t': case '\r': case '\v': case '\f'
 
-#define SIMPLE_ERROR_OUT(...) throw TokenizerException(__VA_ARGS__)
-#define ERROR_OUT(...) SIMPLE_ERROR_OUT(concat(__VA_ARGS__))
+#define ERROR_OUT_AT(code, at) \
+    do { \
+        error = Error(ErrorCode::code, static_cast<std::size_t>((at) - program));\
+        return false; \
+    } while (false)
+#define ERROR_OUT(code) ERROR_OUT_AT(code, c)
 
 #define TOKENIZE_INC_CHECK_EOF(...) \
     do { \
         if (*c == '\n') { \
             sl++; \
             sc = 1; \
+            if (unlikely(options.isCancelled())) \
+                ERROR_OUT(Cancelled); \
+            if (unlikely(options.isPastDeadline())) \
+                ERROR_OUT(DeadlineExceeded); \
         } else \
             sc++; \
         if (++c == e) \
@@ -75,6 +84,8 @@ SHAREMIND_DEFINE_EXCEPTION_CONST_STDSTRING_NOINLINE(Exception,,
     } while (0)
 #define TOKENIZE_INC_CHECK_EOF_OK TOKENIZE_INC_CHECK_EOF(goto tokenize_ok;)
 
+namespace {
+
 std::string asciiCharToPrintable(char const c) {
     switch (c) {
         case ASCII_LETTER:
@@ -97,21 +108,29 @@ std::string asciiCharToPrintable(char const c) {
     }
 }
 
-#define ERROR_OUT_UNEXPECTED(expected, found, what) \
-    ERROR_OUT("Expected " expected " while parsing " what ", but '", \
-               asciiCharToPrintable((found)), "' encountered!")
-#define TOKENIZE_INC_CHECK_EOF_UNEXPECTED(...) \
-    TOKENIZE_INC_CHECK_EOF(SIMPLE_ERROR_OUT( \
-            "Unexpected end-of-file while parsing " __VA_ARGS__ "!" );)
+#define TOKENIZE_INC_CHECK_EOF_UNEXPECTED \
+    TOKENIZE_INC_CHECK_EOF(ERROR_OUT(UnexpectedEndOfFile);)
 
 #define NEWTOKEN(d,type,text,len,sl,sc) \
     do { \
+        if (unlikely(ts.size() >= maxTokens)) \
+            ERROR_OUT_AT(TooManyTokens, (text)); \
         ts.emplace_back((type), (text), (len), (sl), (sc)); \
         d = &ts.back(); \
     } while (0)
 
-TokensVector tokenize(char const * program, std::size_t length) {
+bool tokenizeTo(char const * const program,
+                std::size_t const length,
+                TokensVector & ts,
+                Error & error,
+                Options const & options)
+{
     assert(program);
+    assert(ts.empty());
+
+    auto const maxTokens = options.maxTokens
+                           ? options.maxTokens
+                           : ts.max_size();
 
     char const * c = program;
     char const * t;
@@ -120,7 +139,6 @@ TokensVector tokenize(char const * program, std::size_t length) {
     std::size_t sl = 1u;
     std::size_t sc = 1u;
 
-    TokensVector ts;
     Token * lastToken = nullptr;
 
     char hexstart;
@@ -130,12 +148,12 @@ TokensVector tokenize(char const * program, std::size_t length) {
 
     /* Lex optional UTF-8 byte-order mark 0xefbbbf */
     if (unlikely(*c == '\xef')) {
-        TOKENIZE_INC_CHECK_EOF_UNEXPECTED("UTF-8 byte-order-mark");
+        TOKENIZE_INC_CHECK_EOF_UNEXPECTED;
         if (unlikely(*c != '\xbb'))
-            SIMPLE_ERROR_OUT("Invalid UTF-8 byte-order-mark!");
-        TOKENIZE_INC_CHECK_EOF_UNEXPECTED("UTF-8 byte-order-mark");
+            ERROR_OUT(InvalidByteOrderMark);
+        TOKENIZE_INC_CHECK_EOF_UNEXPECTED;
         if (unlikely(*c != '\xbf'))
-            SIMPLE_ERROR_OUT("Invalid UTF-8 byte-order-mark!");
+            ERROR_OUT(InvalidByteOrderMark);
         TOKENIZE_INC_CHECK_EOF_OK;
     }
 #define HANDLE_SEPARATOR_WHITESPACE \
@@ -178,29 +196,27 @@ TokensVector tokenize(char const * program, std::size_t length) {
         auto const what ## StartLine = sl; \
         auto const what ## StartColumn = startCol; \
         for (;;) { \
-            TOKENIZE_INC_CHECK_EOF(CREATE_START_COUNTED_TOKEN(type, what););\
+            TOKENIZE_INC_CHECK_EOF(CREATE_START_COUNTED_TOKEN(type, what); \
+                                   goto tokenize_ok;); \
             switch (*c) { \
                 case ID_TAIL: \
                     break; \
                 case '.': \
-                    TOKENIZE_INC_CHECK_EOF_UNEXPECTED(#what); \
+                    TOKENIZE_INC_CHECK_EOF_UNEXPECTED; \
                     switch (*c) { \
                         case ID_HEAD: \
                             break; \
                         default: \
-                            ERROR_OUT_UNEXPECTED("letter or underscore", \
-                                                 *c, #what); \
+                            ERROR_OUT(UnexpectedCharacter); \
                     } \
                     break; \
                 TOKEN_END_CASES(CREATE_START_COUNTED_TOKEN(type, what);); \
                 default: \
-                    ERROR_OUT_UNEXPECTED("letter, underscore, '.', " \
-                                         "whitespace, comment or end-of-file", \
-                                         *c, #what); \
+                    ERROR_OUT(UnexpectedCharacter); \
             } \
         } \
     } while (false)
-#define TOKENIZE_HEX_FROM_0_CHECK_N_CREATE(type, id, what) \
+#define TOKENIZE_HEX_FROM_0_CHECK_N_CREATE(type, id) \
     do { \
         /* Check signed range (min -8000000000000000, max 7fffffffffffffff): */\
         if (hexstart == '+') { \
@@ -208,8 +224,7 @@ TokensVector tokenize(char const * program, std::size_t length) {
             case '8': case '9': \
             case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': \
             case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': \
-                SIMPLE_ERROR_OUT("64-bit signed hexadecimal too big while " \
-                                 "parsing " what "!"); \
+                ERROR_OUT_AT(HexadecimalTooBig, id ## Start); \
             default: break; \
             } \
         } else if (hexstart == '-') { \
@@ -218,33 +233,31 @@ TokensVector tokenize(char const * program, std::size_t length) {
             case '8': \
                 while (++c2 != c) \
                     if (*c2 != '0') \
-                        SIMPLE_ERROR_OUT("64-bit signed hexadecimal too small "\
-                                         "while parsing " what "!"); \
+                        ERROR_OUT_AT(HexadecimalTooSmall, id ## Start); \
                 break; \
             case '9': \
             case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': \
             case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': \
-                SIMPLE_ERROR_OUT("64-bit signed hexadecimal too big while " \
-                                 "parsing " what "!"); \
+                ERROR_OUT_AT(HexadecimalTooSmall, id ## Start); \
             default: break; \
             } \
         } \
         CREATE_START_COUNTED_TOKEN(type, id); \
     } while (false)
-#define TOKENIZE_HEX_FROM_0(start, startCol, type, id, what) \
+#define TOKENIZE_HEX_FROM_0(start, startCol, type, id) \
     do { \
         assert(*c == '0'); \
         assert((hexstart == '0') || (hexstart == '+') || (hexstart == '-')); \
         auto const id ## Start = (start); \
         auto const id ## StartLine = sl; \
         auto const id ## StartColumn = (startCol); \
-        TOKENIZE_INC_CHECK_EOF_UNEXPECTED(what); \
+        TOKENIZE_INC_CHECK_EOF_UNEXPECTED; \
         if (unlikely(*c != 'x')) \
-            ERROR_OUT_UNEXPECTED("'x'", *c, what); \
-        TOKENIZE_INC_CHECK_EOF_UNEXPECTED(what); \
+            ERROR_OUT(UnexpectedCharacter); \
+        TOKENIZE_INC_CHECK_EOF_UNEXPECTED; \
         switch (*c) { /* First digit: */ \
             case HEXADECIMAL_DIGIT: break; \
-            default: ERROR_OUT_UNEXPECTED("hexadecimal digit", *c, what); \
+            default: ERROR_OUT(UnexpectedCharacter); \
         } \
         unsigned digitsLeft = 15u; \
         do { \
@@ -255,22 +268,18 @@ TokensVector tokenize(char const * program, std::size_t length) {
                     break; \
                 TOKEN_END_CASES(CREATE_START_COUNTED_TOKEN(type, id););\
                 default: \
-                    ERROR_OUT_UNEXPECTED("hexadecimal digit, whitespace, " \
-                                         "comment or end-of-file", \
-                                         *c, what); \
+                    ERROR_OUT(UnexpectedCharacter); \
             } \
         } while (--digitsLeft); \
         TOKENIZE_INC_CHECK_EOF( \
-                TOKENIZE_HEX_FROM_0_CHECK_N_CREATE(type, id, what); \
+                TOKENIZE_HEX_FROM_0_CHECK_N_CREATE(type, id); \
                 goto tokenize_ok;); \
         switch (*c) { \
         case HEXADECIMAL_DIGIT: \
-            SIMPLE_ERROR_OUT("64-bit hexadecimal has too many digits while " \
-                             "parsing " what "!"); \
-        TOKEN_END_CASES(TOKENIZE_HEX_FROM_0_CHECK_N_CREATE(type, id, what);); \
+            ERROR_OUT(HexadecimalTooManyDigits); \
+        TOKEN_END_CASES(TOKENIZE_HEX_FROM_0_CHECK_N_CREATE(type, id);); \
         default: \
-            ERROR_OUT_UNEXPECTED("whitespace, comment or end-of-file", \
-                                 *c, what); \
+            ERROR_OUT(UnexpectedCharacter); \
         } \
     } while (false)
 
@@ -286,14 +295,12 @@ tokenize_begin:
         case '#':
             HANDLE_COMMENT;
         case '.':
-            TOKENIZE_INC_CHECK_EOF_UNEXPECTED("directive");
+            TOKENIZE_INC_CHECK_EOF_UNEXPECTED;
             switch (*c) {
                 case ID_HEAD:
                     break;
                 default:
-                    ERROR_OUT_UNEXPECTED("letter or underscore",
-                                         *c,
-                                         "directive");
+                    ERROR_OUT(UnexpectedCharacter);
             }
             TOKENIZE_KEYWORD_OR_DIRECTIVE(c - 1u,
                                           sc - 1u,
@@ -302,27 +309,19 @@ tokenize_begin:
         case '+':
         case '-':
             hexstart = *c;
-            TOKENIZE_INC_CHECK_EOF_UNEXPECTED("signed hexadecimal");
+            TOKENIZE_INC_CHECK_EOF_UNEXPECTED;
             if (*c != '0')
-                ERROR_OUT_UNEXPECTED("'0'", *c, "signed hexadecimal");
-            TOKENIZE_HEX_FROM_0(c - 1u,
-                                sc - 1u,
-                                HEX,
-                                signedHexadecimal,
-                                "signed hexadecimal");
+                ERROR_OUT(UnexpectedCharacter);
+            TOKENIZE_HEX_FROM_0(c - 1u, sc - 1u, HEX, signedHexadecimal);
         case '0':
             hexstart = *c;
-            TOKENIZE_HEX_FROM_0(c,
-                                sc,
-                                UHEX,
-                                unsignedHexadecimal,
-                                "unsigned hexadecimal");
+            TOKENIZE_HEX_FROM_0(c, sc, UHEX, unsignedHexadecimal);
         case '"':
             t = c;
             for (;;) {
-                TOKENIZE_INC_CHECK_EOF_UNEXPECTED("string");
+                TOKENIZE_INC_CHECK_EOF_UNEXPECTED;
                 if (unlikely(*c == '\\')) {
-                    TOKENIZE_INC_CHECK_EOF_UNEXPECTED("string");
+                    TOKENIZE_INC_CHECK_EOF_UNEXPECTED;
                     continue;
                 }
 
@@ -339,48 +338,165 @@ tokenize_begin:
             TOKENIZE_INC_CHECK_EOF_OK;
             goto tokenize_begin;
         case ':': {
-            TOKENIZE_INC_CHECK_EOF_UNEXPECTED("label");
+            auto const labelStart = c;
+            auto const labelStartLine = sl;
+            auto const labelStartColumn = sc;
+            TOKENIZE_INC_CHECK_EOF_UNEXPECTED;
+            if (*c == '.') /* Local label */
+                TOKENIZE_INC_CHECK_EOF_UNEXPECTED;
             switch (*c) {
                 case ID_HEAD:
                     break;
                 default:
-                    ERROR_OUT_UNEXPECTED("letter or underscore", *c, "label");
+                    ERROR_OUT(UnexpectedCharacter);
             }
-            auto const labelStart = c - 1u;
-            auto const labelStartLine = sl;
-            auto const labelStartColumn = sc - 1u;
             for (;;) {
-                TOKENIZE_INC_CHECK_EOF();
+                TOKENIZE_INC_CHECK_EOF(
+                        CREATE_START_COUNTED_TOKEN(LABEL, label);
+                        goto tokenize_ok;);
                 switch (*c) {
                     case ID_TAIL:
                         break;
                     case '+': case '-':
                         hexstart = *c;
-                        TOKENIZE_INC_CHECK_EOF_UNEXPECTED("label offset");
+                        TOKENIZE_INC_CHECK_EOF_UNEXPECTED;
                         if (unlikely(*c != '0'))
-                            ERROR_OUT_UNEXPECTED("'0'", *c, "label offset");
+                            ERROR_OUT(UnexpectedCharacter);
                         TOKENIZE_HEX_FROM_0(labelStart,
                                             labelStartColumn,
                                             LABEL_O,
-                                            labelWithOffset,
-                                            "label with offset");
+                                            labelWithOffset);
                     TOKEN_END_CASES(CREATE_START_COUNTED_TOKEN(LABEL, label););
                     default:
-                        ERROR_OUT("Unexpected '", asciiCharToPrintable(*c),
-                                  "' found while parsing label!");
+                        ERROR_OUT(UnexpectedCharacter);
+                }
+            }
+        }
+        case '(': {
+            auto const expressionStart = c;
+            auto const expressionStartLine = sl;
+            auto const expressionStartColumn = sc;
+            std::size_t depth = 1u;
+            do {
+                TOKENIZE_INC_CHECK_EOF_UNEXPECTED;
+                switch (*c) {
+                    case '(': ++depth; break;
+                    case ')': --depth; break;
+                    case '\n': case '#': ERROR_OUT(UnexpectedCharacter);
+                    default: break;
                 }
+            } while (depth);
+            TOKENIZE_INC_CHECK_EOF(
+                    CREATE_START_COUNTED_TOKEN(EXPRESSION, expression);
+                    goto tokenize_ok;);
+            switch (*c) {
+                TOKEN_END_CASES(
+                        CREATE_START_COUNTED_TOKEN(EXPRESSION, expression););
+                default:
+                    ERROR_OUT(UnexpectedCharacter);
             }
         }
         case ID_HEAD:
             TOKENIZE_KEYWORD_OR_DIRECTIVE(c, sc, KEYWORD, keyword);
         default:
-            ERROR_OUT("Unexpected '", asciiCharToPrintable(*c), "' found!");
+            ERROR_OUT(UnexpectedCharacter);
     }
 
 tokenize_ok:
     ts.popBackNewlines();
+    return true;
+}
+
+} // anonymous namespace
+
+std::string tokenizerErrorMessage(Error const & error,
+                                  char const * program,
+                                  std::size_t length)
+{
+    assert(program || !length);
+    assert(error.offset() <= length);
+
+    std::size_t line = 1u;
+    std::size_t column = 1u;
+    for (std::size_t i = 0u; i < error.offset(); ++i) {
+        if (program[i] == '\n') {
+            ++line;
+            column = 1u;
+        } else {
+            ++column;
+        }
+    }
+
+    switch (error.code()) {
+        case ErrorCode::UnexpectedCharacter:
+            assert(error.offset() < length);
+            return concat("Unexpected '",
+                          asciiCharToPrintable(program[error.offset()]),
+                          "' found at ", line, ':', column, '!');
+        case ErrorCode::HexadecimalTooBig:
+            return concat("64-bit signed hexadecimal too big at ",
+                          line, ':', column, '!');
+        case ErrorCode::HexadecimalTooSmall:
+            return concat("64-bit signed hexadecimal too small at ",
+                          line, ':', column, '!');
+        case ErrorCode::HexadecimalTooManyDigits:
+            return concat("64-bit hexadecimal has too many digits at ",
+                          line, ':', column, '!');
+        default:
+            return concat(errorCodeToString(error.code()), " at ",
+                          line, ':', column, '!');
+    }
+}
+
+TokensVector tokenize(char const * program,
+                      std::size_t length,
+                      std::pmr::memory_resource * memoryResource)
+{ return tokenize(program, length, Options(), memoryResource); }
+
+TokensVector tokenize(char const * program,
+                      std::size_t length,
+                      Options const & options,
+                      std::pmr::memory_resource * memoryResource)
+{
+    TokensVector ts(memoryResource);
+    Error error;
+    if (!tokenizeTo(program, length, ts, error, options))
+        throw TokenizerException(tokenizerErrorMessage(error, program, length));
     return ts;
 }
 
+bool tokenize(char const * program,
+              std::size_t length,
+              TokensVector & ts,
+              Error & error,
+              Options const & options)
+{
+    ts.clear();
+    return tokenizeTo(program, length, ts, error, options);
+}
+
+Result<TokensVector> tryTokenize(char const * program,
+                                 std::size_t length,
+                                 std::pmr::memory_resource * memoryResource)
+        noexcept
+{ return tryTokenize(program, length, Options(), memoryResource); }
+
+Result<TokensVector> tryTokenize(char const * program,
+                                 std::size_t length,
+                                 Options const & options,
+                                 std::pmr::memory_resource * memoryResource)
+        noexcept
+{
+    try {
+        TokensVector ts(memoryResource);
+        Error error;
+        if (!tokenizeTo(program, length, ts, error, options))
+            return error;
+        return Result<TokensVector>(std::move(ts));
+    } catch (std::bad_alloc const &) {
+        return Error(ErrorCode::OutOfMemory, 0u);
+    }
+}
+
 } // namespace Assembler {
 } // namespace sharemind {
@@ -21,8 +21,11 @@
 #define SHAREMIND_LIBAS_TOKENIZER_H
 
 #include <memory>
+#include <memory_resource>
 #include <sharemind/ExceptionMacros.h>
+#include "Error.h"
 #include "Exception.h"
+#include "Options.h"
 #include "tokens.h"
 
 
@@ -32,9 +35,55 @@ namespace Assembler {
 SHAREMIND_DECLARE_EXCEPTION_CONST_STDSTRING_NOINLINE(Exception,
                                                      TokenizerException);
 
-TokensVector tokenize(char const * program, std::size_t length)
+/**
+  \param[in] memoryResource The memory resource used for the returned tokens.
+*/
+TokensVector tokenize(char const * program,
+                      std::size_t length,
+                      std::pmr::memory_resource * memoryResource =
+                              std::pmr::get_default_resource())
+    __attribute__ ((nonnull(1, 3), warn_unused_result));
+
+TokensVector tokenize(char const * program,
+                      std::size_t length,
+                      Options const & options,
+                      std::pmr::memory_resource * memoryResource =
+                              std::pmr::get_default_resource())
+    __attribute__ ((nonnull(1, 4), warn_unused_result));
+
+/**
+  \brief Tokenizes the given program into the given tokens vector without
+         throwing on invalid input.
+  \returns whether tokenization succeeded. On failure error is set.
+  \note Only allocation failures are reported by exceptions.
+  \note The tokens are allocated using the allocator of the given vector.
+*/
+bool tokenize(char const * program,
+              std::size_t length,
+              TokensVector & ts,
+              Error & error,
+              Options const & options = Options())
     __attribute__ ((nonnull(1), warn_unused_result));
 
+Result<TokensVector> tryTokenize(char const * program,
+                                 std::size_t length,
+                                 std::pmr::memory_resource * memoryResource =
+                                         std::pmr::get_default_resource())
+        noexcept
+    __attribute__ ((nonnull(1, 3), warn_unused_result));
+
+Result<TokensVector> tryTokenize(char const * program,
+                                 std::size_t length,
+                                 Options const & options,
+                                 std::pmr::memory_resource * memoryResource =
+                                         std::pmr::get_default_resource())
+        noexcept
+    __attribute__ ((nonnull(1, 4), warn_unused_result));
+
+std::string tokenizerErrorMessage(Error const & error,
+                                  char const * program,
+                                  std::size_t length);
+
 } /* namespace Assembler { */
 } /* namespace sharemind { */
 
@@ -71,7 +71,8 @@ std::int64_t parseHexValue(char const * const text,
     auto v = readHex(text + 3u, length - 3u);
     if (text[0] == '-') {
         assert(v <= absInt64Min);
-        return -static_cast<std::int64_t>(v);
+        /* Negate without overflowing on the minimum value: */
+        return v ? (-static_cast<std::int64_t>(v - 1u) - 1) : 0;
     } else {
         assert(text[0] == '+');
         assert(integralLessEqual(v, int64Max));
@@ -105,11 +106,12 @@ inline std::size_t parseStringLength(char const * const text,
     return l;
 }
 
-inline std::string parseString(char const * const text,
-                               std::size_t const length)
+inline std::pmr::string parseString(char const * const text,
+                                    std::size_t const length,
+                                    Token::allocator_type const & allocator)
 {
     auto const l = parseStringLength(text, length);
-    std::string r;
+    std::pmr::string r(allocator);
     r.reserve(l);
 
     auto * ip = &text[1];
@@ -155,7 +157,8 @@ inline std::int64_t parseLabelOffset(char const * const text,
     auto v = readHex(h, length - static_cast<std::size_t>(h - text));
     if (neg) {
         assert(v <= absInt64Min);
-        return -static_cast<std::int64_t>(v);
+        /* Negate without overflowing on the minimum value: */
+        return v ? (-static_cast<std::int64_t>(v - 1u) - 1) : 0;
     } else {
         assert(integralLessEqual(v, int64Max));
         return static_cast<std::int64_t>(v);
@@ -168,23 +171,24 @@ Token::Token(Type type,
              char const * text,
              std::size_t length,
              std::size_t startLine,
-             std::size_t startColumn) noexcept
+             std::size_t startColumn,
+             allocator_type const & allocator) noexcept
     : m_type(type)
     , m_text(text)
     , m_length(length)
     , m_startLine(startLine)
     , m_startColumn(startColumn)
     , m_parsedString(
-        [type, text, length]() {
+        [type, text, length, &allocator]() {
             switch (type) {
                 case Type::NEWLINE: break;
                 case Type::HEX: break;
                 case Type::UHEX: break;
-                case Type::STRING: return parseString(text, length);
+                case Type::STRING: return parseString(text, length, allocator);
                 case Type::LABEL:
                 case Type::DIRECTIVE:
-                    assert(length > 2u);
-                    return std::string(text + 1u, length - 1u);
+                    assert(length >= 2u);
+                    return std::pmr::string(text + 1u, length - 1u, allocator);
                 case Type::LABEL_O: {
                     assert(length >= 6u);
                     std::size_t l = 2u;
@@ -192,11 +196,13 @@ Token::Token(Type type,
                         ++l;
                     assert(text[l + 1] == '0');
                     assert(text[l + 2] == 'x');
-                    return std::string(text + 1u, l - 1u);
+                    return std::pmr::string(text + 1u, l - 1u, allocator);
                 }
-                case Type::KEYWORD: return std::string(text, length);
+                case Type::KEYWORD:
+                    return std::pmr::string(text, length, allocator);
+                case Type::EXPRESSION: break;
             }
-            return std::string();
+            return std::pmr::string(allocator);
         }())
     , m_parsedNumeric(
         [type, text, length]() {
@@ -210,11 +216,54 @@ Token::Token(Type type,
             case Type::LABEL: r.hex = 0u; break;
             case Type::LABEL_O: r.hex = parseLabelOffset(text, length); break;
             case Type::KEYWORD: break;
+            case Type::EXPRESSION: break;
             }
             return r;
         }())
 {}
 
+Token::Token(Type type,
+             char const * text,
+             std::size_t length,
+             std::size_t startLine,
+             std::size_t startColumn,
+             std::string_view parsedString,
+             std::uint64_t parsedNumeric,
+             allocator_type const & allocator)
+    : m_type(type)
+    , m_text(text)
+    , m_length(length)
+    , m_startLine(startLine)
+    , m_startColumn(startColumn)
+    , m_parsedString(parsedString, allocator)
+{
+    if (type == Type::UHEX) {
+        m_parsedNumeric.uhex = parsedNumeric;
+    } else {
+        m_parsedNumeric.hex = static_cast<std::int64_t>(parsedNumeric);
+    }
+}
+
+Token::Token(Token && move, allocator_type const & allocator)
+    : m_type(move.m_type)
+    , m_text(move.m_text)
+    , m_length(move.m_length)
+    , m_startLine(move.m_startLine)
+    , m_startColumn(move.m_startColumn)
+    , m_parsedString(std::move(move.m_parsedString), allocator)
+    , m_parsedNumeric(move.m_parsedNumeric)
+{}
+
+Token::Token(Token const & copy, allocator_type const & allocator)
+    : m_type(copy.m_type)
+    , m_text(copy.m_text)
+    , m_length(copy.m_length)
+    , m_startLine(copy.m_startLine)
+    , m_startColumn(copy.m_startColumn)
+    , m_parsedString(copy.m_parsedString, allocator)
+    , m_parsedNumeric(copy.m_parsedNumeric)
+{}
+
 std::ostream & operator<<(std::ostream & os, Token::Type const type) {
     #define SHAREMIND_LIBAS_TOKENS_T(v) \
             case Token::Type::v: os << #v; break
@@ -227,6 +276,7 @@ std::ostream & operator<<(std::ostream & os, Token::Type const type) {
         SHAREMIND_LIBAS_TOKENS_T(LABEL_O);
         SHAREMIND_LIBAS_TOKENS_T(LABEL);
         SHAREMIND_LIBAS_TOKENS_T(KEYWORD);
+        SHAREMIND_LIBAS_TOKENS_T(EXPRESSION);
     }
     #undef SHAREMIND_LIBAS_TOKENS_T
     return os;
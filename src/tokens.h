@@ -23,7 +23,9 @@
 #include <cassert>
 #include <cstdint>
 #include <iosfwd>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 
@@ -44,25 +46,55 @@ public: /* Types: */
         STRING,
         LABEL_O,
         LABEL,
-        KEYWORD
+        KEYWORD,
+        EXPRESSION
     };
 
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
 public: /* Methods: */
 
     Token(Type type,
           char const * text,
           std::size_t length,
           std::size_t startLine,
-          std::size_t startColumn) noexcept;
+          std::size_t startColumn,
+          allocator_type const & allocator = allocator_type()) noexcept;
+
+    /**
+      \brief Constructs a token from its text and the values the text would be
+             parsed to, which are given instead of parsing the text.
+      \param[in] parsedString The value of a STRING, the name of a DIRECTIVE
+                              without the dot, the name of a LABEL or LABEL_O
+                              without the colon or a KEYWORD.
+      \param[in] parsedNumeric The value of a HEX or UHEX, or the offset of a
+                               LABEL_O cast to unsigned.
+    */
+    Token(Type type,
+          char const * text,
+          std::size_t length,
+          std::size_t startLine,
+          std::size_t startColumn,
+          std::string_view parsedString,
+          std::uint64_t parsedNumeric,
+          allocator_type const & allocator = allocator_type());
 
     Token(Token &&) noexcept = default;
     Token(Token const &) = default;
 
+    Token(Token && move, allocator_type const & allocator);
+    Token(Token const & copy, allocator_type const & allocator);
+
     Token & operator=(Token &&) noexcept = default;
     Token & operator=(Token const &) = default;
 
     Type type() const noexcept { return m_type; }
 
+    char const * text() const noexcept { return m_text; }
+    std::size_t length() const noexcept { return m_length; }
+    std::size_t startLine() const noexcept { return m_startLine; }
+    std::size_t startColumn() const noexcept { return m_startColumn; }
+
     std::int64_t hexValue() const noexcept {
         assert(m_type == Type::HEX);
         return m_parsedNumeric.hex;
@@ -73,17 +105,17 @@ public: /* Methods: */
         return m_parsedNumeric.uhex;
     }
 
-    std::string const & directiveValue() const noexcept {
+    std::pmr::string const & directiveValue() const noexcept {
         assert(m_type == Type::DIRECTIVE);
         return m_parsedString;
     }
 
-    std::string const & stringValue() const noexcept {
+    std::pmr::string const & stringValue() const noexcept {
         assert(m_type == Type::STRING);
         return m_parsedString;
     }
 
-    std::string const & labelValue() const noexcept {
+    std::pmr::string const & labelValue() const noexcept {
         assert((m_type == Type::LABEL) || (m_type == Type::LABEL_O));
         return m_parsedString;
     }
@@ -93,7 +125,7 @@ public: /* Methods: */
         return m_parsedNumeric.hex;
     }
 
-    std::string const & keywordValue() const noexcept {
+    std::pmr::string const & keywordValue() const noexcept {
         assert(m_type == Type::KEYWORD);
         return m_parsedString;
     }
@@ -105,7 +137,7 @@ private: /* Fields: */
     std::size_t m_length;
     std::size_t m_startLine;
     std::size_t m_startColumn;
-    std::string m_parsedString;
+    std::pmr::string m_parsedString;
     union ParsedNumeric {
         ParsedNumeric() noexcept : hex(0) {}
         std::int64_t hex;
@@ -117,12 +149,12 @@ private: /* Fields: */
 std::ostream & operator<<(std::ostream & os, Token::Type const type);
 std::ostream & operator<<(std::ostream & os, Token const & token);
 
-class TokensVector: public std::vector<Token> {
+class TokensVector: public std::pmr::vector<Token> {
 
 public: /* Methods: */
 
-    using std::vector<Token>::vector;
-    using std::vector<Token>::operator=;
+    using std::pmr::vector<Token>::vector;
+    using std::pmr::vector<Token>::operator=;
 
     void popBackNewlines() noexcept;
 
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#include "zeroDataToBss.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "ObjectData.h"
+
+
+namespace sharemind {
+namespace Assembler {
+namespace {
+
+using SectionType = Object::SectionType;
+
+/** The static value of the memory pointer of the DATA section. */
+constexpr std::uint64_t const dataMemoryPointer = 2u;
+
+class Mover {
+
+public: /* Methods: */
+
+    Mover(ObjectData & data) noexcept
+        : m_data(data)
+        , m_object(data.object())
+        , m_linkingUnit(data.linkingUnit())
+    {}
+
+    /** \returns the number of bytes moved. */
+    std::size_t run() {
+        auto const size = m_data.size();
+        if (!size || !isMovable())
+            return 0u;
+
+        /* The section becomes the whole BSS section, so offsets from the
+           memory pointer stay the same: */
+        moveAlignment(m_data.alignment());
+        for (auto & symbol : m_object.symbols)
+            if (m_data.contains(symbol))
+                symbol.section = SectionType::Bss;
+
+        /* The memory pointer of the section is now that of BSS: */
+        for (auto & r : m_object.relocations)
+            if ((r.linkingUnit == m_linkingUnit) && (r.label == "DATA"))
+                r.label = "BSS";
+        for (auto & p : m_object.expressions)
+            if (p.linkingUnit == m_linkingUnit)
+                for (auto & label : p.expression.labels())
+                    if (!label.resolved && (label.name == "DATA"))
+                        label.name = "BSS";
+
+        /* The sections may be shared with other executables: */
+        auto & lu = m_object.executable.linkingUnits[m_linkingUnit];
+        lu.bssSection = std::make_shared<Executable::BssSection>(size);
+        lu.rwDataSection.reset();
+        return size;
+    }
+
+private: /* Methods: */
+
+    /** \returns whether the section can be moved to BSS. */
+    bool isMovable() const {
+        auto const & lu = m_object.executable.linkingUnits[m_linkingUnit];
+        if (lu.bssSection && lu.bssSection->sizeInBytes)
+            return false;
+        if (usesRawDataPointer())
+            return false;
+        auto const * const bytes = m_data.data();
+        if (std::any_of(bytes,
+                        bytes + m_data.size(),
+                        [](char const c) noexcept { return c != '\0'; }))
+            return false;
+        for (auto const & p : m_object.expressions) {
+            /* Pending expressions write their values later: */
+            if ((p.linkingUnit == m_linkingUnit)
+                && (p.section == SectionType::Data))
+                return false;
+            /* Other linking units would use the wrong memory pointer: */
+            if (p.linkingUnit != m_linkingUnit)
+                for (auto const & label : p.expression.labels())
+                    if (!label.resolved && isDataLabel(label.name))
+                        return false;
+        }
+        for (auto const & r : m_object.relocations)
+            if ((r.linkingUnit != m_linkingUnit) && isDataLabel(r.label))
+                return false;
+        return true;
+    }
+
+    /**
+      \returns whether an instruction argument in the TEXT section of the
+               linking unit has the value of the DATA memory pointer without
+               being a use of the :DATA label, in which case it can not be
+               told whether the value is used as that pointer.
+    */
+    bool usesRawDataPointer() const {
+        if (m_linkingUnit >= m_object.instructionStarts.size())
+            return true;
+        auto const & starts = m_object.instructionStarts[m_linkingUnit];
+        auto const & text =
+                m_object.executable.linkingUnits[m_linkingUnit].textSection;
+        if (!text)
+            return false;
+        auto const & code = text->instructions;
+        if (starts.size() != code.size())
+            return true;
+        std::vector<bool> relocated(code.size(), false);
+        for (auto const & r : m_object.relocations)
+            if ((r.linkingUnit == m_linkingUnit) && (r.codeIndex < code.size()))
+                relocated[r.codeIndex] = true;
+        for (std::size_t i = 0u; i < code.size(); ++i)
+            if (!starts[i]
+                && !relocated[i]
+                && (code[i].uint64[0u] == dataMemoryPointer))
+                return true;
+        return false;
+    }
+
+    bool isDataLabel(std::string_view const name) const noexcept {
+        auto const * const symbol = m_data.symbol(name);
+        return symbol && m_data.contains(*symbol);
+    }
+
+    /** \brief Records the alignment of the section for the BSS section. */
+    void moveAlignment(std::size_t const alignment) {
+        auto & alignments = m_object.alignments;
+        alignments.erase(
+                    std::remove_if(
+                        alignments.begin(),
+                        alignments.end(),
+                        [this](Object::Alignment const & a) noexcept {
+                            return (a.linkingUnit == m_linkingUnit)
+                                   && (a.section == SectionType::Data);
+                        }),
+                    alignments.end());
+        if (alignment <= 1u)
+            return;
+        for (auto & a : alignments) {
+            if ((a.linkingUnit == m_linkingUnit)
+                && (a.section == SectionType::Bss))
+            {
+                a.alignment = std::max(a.alignment, alignment);
+                return;
+            }
+        }
+        alignments.push_back(
+                    Object::Alignment{m_linkingUnit,
+                                      SectionType::Bss,
+                                      alignment});
+    }
+
+private: /* Fields: */
+
+    ObjectData & m_data;
+    Object & m_object;
+    std::uint8_t const m_linkingUnit;
+
+};
+
+} // anonymous namespace
+
+std::size_t zeroDataToBss(Object & object) {
+    for (auto const & p : object.expressions)
+        if (p.expression.usesSectionSizes())
+            return 0u;
+    std::size_t moved = 0u;
+    auto const & lus = object.executable.linkingUnits;
+    for (std::size_t i = 0u; i < lus.size(); ++i) {
+        ObjectData data(object,
+                        static_cast<std::uint8_t>(i),
+                        SectionType::Data);
+        moved += Mover(data).run();
+    }
+    return moved;
+}
+
+} // namespace Assembler {
+} // namespace sharemind {
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#ifndef SHAREMIND_LIBAS_ZERODATATOBSS_H
+#define SHAREMIND_LIBAS_ZERODATATOBSS_H
+
+#include <cstddef>
+#include "Object.h"
+
+
+namespace sharemind {
+namespace Assembler {
+
+/**
+  \brief Moves the DATA sections which only contain zeroes to the empty BSS
+         sections of an object containing a whole program.
+
+  The labels of a moved section refer to the same offsets in the BSS section,
+  and the uses of the :DATA label constant in its linking unit are replaced by
+  :BSS. The object must thus refer to the DATA memory pointer by the label
+  DATA, see Options::zeroDataToBss.
+
+  DATA sections are left as they are if the BSS section of their linking unit
+  is not empty, if an instruction argument in that linking unit has the value
+  of the DATA memory pointer other than by the label DATA, if they are written
+  by pending expressions or if their labels are used by other linking units.
+  All sections are left as they are if any expression uses the sizes of
+  sections.
+
+  \returns the number of bytes moved.
+*/
+std::size_t zeroDataToBss(Object & object);
+
+} /* namespace Assembler { */
+} /* namespace sharemind { */
+
+#endif /* SHAREMIND_LIBAS_ZERODATATOBSS_H */
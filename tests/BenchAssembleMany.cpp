@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/assembleMany.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+std::string makeProgram(std::size_t const index) {
+    std::string program;
+    for (std::size_t i = 0u; i < 2000u; ++i) {
+        program += ":l" + std::to_string(i) + "\n";
+        program += "push imm 0x" + std::to_string(index + i) + "\n";
+        program += "jmp imm :l" + std::to_string((i * 7u) % 2000u) + "\n";
+    }
+    program += "halt imm 0x0\n";
+    return program;
+}
+
+} // anonymous namespace
+
+/*
+  Assembles the same batch of programs with 1..N threads, where N is given as
+  the first argument or defaults to the number of hardware threads, and
+  prints the throughput and speedup for each number of threads.
+*/
+int main(int argc, char ** argv) {
+    std::size_t maxThreads = std::thread::hardware_concurrency();
+    if (argc > 1)
+        maxThreads = std::strtoull(argv[1], nullptr, 10);
+    if (!maxThreads)
+        maxThreads = 1u;
+
+    static constexpr std::size_t const numSources = 256u;
+    static constexpr unsigned const rounds = 5u;
+    std::vector<std::string> programs;
+    std::vector<AssemblySource> sources;
+    programs.reserve(numSources);
+    for (std::size_t i = 0u; i < numSources; ++i) {
+        programs.emplace_back(makeProgram(i));
+        sources.push_back({programs.back().data(), programs.back().size()});
+    }
+
+    double baseline = 0.0;
+    std::cout << "threads  programs/s  speedup\n";
+    for (std::size_t numThreads = 1u; numThreads <= maxThreads; ++numThreads)
+    {
+        AssemblerPool pool(numThreads);
+        pool.assembleMany(sources.data(), sources.size()); // Warm up
+        auto const start(std::chrono::steady_clock::now());
+        for (unsigned round = 0u; round < rounds; ++round)
+            pool.assembleMany(sources.data(), sources.size());
+        std::chrono::duration<double> const elapsed(
+                    std::chrono::steady_clock::now() - start);
+        auto const throughput = (numSources * rounds) / elapsed.count();
+        if (numThreads == 1u)
+            baseline = throughput;
+        std::cout << numThreads << "  " << throughput << "  "
+                  << (throughput / baseline) << '\n';
+    }
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/ExecutableCache.h"
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+std::string makeProgram(std::size_t const index) {
+    std::string program;
+    for (std::size_t i = 0u; i < 2000u; ++i) {
+        program += ":l" + std::to_string(i) + "\n";
+        program += "push imm 0x" + std::to_string(index + i) + "\n";
+        program += "jmp imm :l" + std::to_string((i * 7u) % 2000u) + "\n";
+    }
+    program += "halt imm 0x0\n";
+    return program;
+}
+
+template <typename F>
+double millisecondsPerProgram(std::vector<std::string> const & programs,
+                              F && f)
+{
+    auto const start(std::chrono::steady_clock::now());
+    for (auto const & program : programs)
+        f(program);
+    std::chrono::duration<double, std::milli> const elapsed(
+                std::chrono::steady_clock::now() - start);
+    return elapsed.count() / programs.size();
+}
+
+} // anonymous namespace
+
+/*
+  Assembles a set of programs without the cache, then through an empty
+  cache (cold), then through the filled cache (warm), and prints the time
+  per program for each.
+*/
+int main() {
+    std::vector<std::string> programs;
+    for (std::size_t i = 0u; i < 64u; ++i)
+        programs.emplace_back(makeProgram(i));
+
+    auto const dir(std::filesystem::temp_directory_path()
+                   / "sharemind-libas-BenchExecutableCache");
+    std::filesystem::remove_all(dir);
+
+    sharemind::Assembler::Assembler assembler;
+    auto const uncached =
+            millisecondsPerProgram(
+                programs,
+                [&assembler](std::string const & program)
+                { assembler.tryAssemble(program.data(), program.size()); });
+
+    ExecutableCache cache(dir.string());
+    auto const run =
+            [&cache](std::string const & program)
+            { cache.tryAssemble(program.data(), program.size()); };
+    auto const cold = millisecondsPerProgram(programs, run);
+    auto const warm = millisecondsPerProgram(programs, run);
+    std::filesystem::remove_all(dir);
+
+    std::cout << "uncached: " << uncached << " ms/program\n"
+              << "cold:     " << cold << " ms/program\n"
+              << "warm:     " << warm << " ms/program ("
+              << cache.numHits() << " hits)\n";
+}
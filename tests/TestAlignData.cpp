@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+/** \returns the serialized executable of the program. */
+std::string assembleImage(char const * program, Options const & options) {
+    auto const r(tryAssemble(program, std::strlen(program), options));
+    assert(r);
+    std::ostringstream oss;
+    oss << *r;
+    return oss.str();
+}
+
+Options aligning() {
+    Options options;
+    options.alignData = true;
+    return options;
+}
+
+/* The program must assemble to the given program with explicit padding: */
+void testPadded(char const * program,
+                Options const & options,
+                char const * expected)
+{ assert(assembleImage(program, options) == assembleImage(expected, {})); }
+
+void testAlignDirective() {
+    testPadded("push imm :a\n"
+               "halt imm 0x0\n"
+               ".section RODATA\n"
+               ".data uint8 0x1\n"
+               ".align 0x4\n"
+               ":a\n"
+               ".data uint8 0x2\n"
+               ".balign 0x2 0xff\n",
+               {},
+               "push imm :a\n"
+               "halt imm 0x0\n"
+               ".section RODATA\n"
+               ".data uint8 0x1\n"
+               ".data uint8 0x0\n"
+               ".data uint8 0x0\n"
+               ".data uint8 0x0\n"
+               ":a\n"
+               ".data uint8 0x2\n"
+               ".data uint8 0xff\n");
+    /* BSS is padded by its size: */
+    testPadded("halt imm 0x0\n"
+               ".section BSS\n"
+               ".data uint8 0x0\n"
+               ".align 0x8\n",
+               {},
+               "halt imm 0x0\n"
+               ".section BSS\n"
+               ".data uint64 0x0\n");
+}
+
+void testInvalidAlignDirective() {
+    for (char const * program : { "halt imm 0x0\n.section DATA\n.align 0x3\n",
+                                  "halt imm 0x0\n.section DATA\n.align 0x0\n",
+                                  "halt imm 0x0\n.section DATA\n"
+                                  ".align 0x2 0x100\n" })
+    {
+        auto const r(tryAssemble(program, std::strlen(program)));
+        assert(!r);
+        assert(r.error().code() == ErrorCode::InvalidParameter);
+    }
+    static char const inText[] = "halt imm 0x0\n.align 0x2\n";
+    auto const r(tryAssemble(inText, sizeof(inText) - 1u));
+    assert(!r);
+    assert(r.error().code() == ErrorCode::UnexpectedToken);
+}
+
+/* Labels followed by values only after newlines and other labels refer to
+   the values after their padding: */
+void testLabelLookahead() {
+    testPadded("push imm :a\n"
+               "push imm :b\n"
+               "push imm :c\n"
+               "halt imm 0x0\n"
+               ".section DATA\n"
+               ".data uint8 0x1\n"
+               ":a\n"
+               "\n"
+               ":b\n"
+               ".data uint32 0x2\n"
+               ":c\n"
+               ".data string \"s\"\n",
+               aligning(),
+               "push imm :a\n"
+               "push imm :b\n"
+               "push imm :c\n"
+               "halt imm 0x0\n"
+               ".section DATA\n"
+               ".data uint8 0x1\n"
+               ".data uint8 0x0\n"
+               ".data uint8 0x0\n"
+               ".data uint8 0x0\n"
+               ":a\n"
+               ":b\n"
+               ".data uint32 0x2\n"
+               ":c\n"
+               ".data string \"s\"\n");
+    /* Without the option labels and values are not aligned: */
+    static char const unaligned[] =
+            "push imm :a\n"
+            "halt imm 0x0\n"
+            ".section DATA\n"
+            ".data uint8 0x1\n"
+            ":a\n"
+            ".data uint16 0x2\n";
+    testPadded(unaligned, {}, unaligned);
+}
+
+/* Linking keeps the alignment of the sections of objects: */
+void testLinkedAlignment() {
+    static char const a[] =
+            "halt imm 0x0\n"
+            ".section RODATA\n"
+            ".data uint8 0x1\n";
+    static char const b[] =
+            "push imm :b\n"
+            ".section RODATA\n"
+            ".align 0x8\n"
+            ":b\n"
+            ".data uint8 0x2\n";
+    auto const ra(tryAssembleObject(a, sizeof(a) - 1u));
+    auto const rb(tryAssembleObject(b, sizeof(b) - 1u));
+    assert(ra && rb);
+    auto const r(link({&*ra, &*rb}));
+    assert(r);
+    auto const & lu = r->linkingUnits.front();
+    assert(lu.roDataSection->sizeInBytes == 9u);
+    assert(lu.textSection->instructions[3u].uint64[0u] == 8u);
+}
+
+} // anonymous namespace
+
+int main() {
+    testAlignDirective();
+    testInvalidAlignDirective();
+    testLabelLookahead();
+    testLinkedAlignment();
+}
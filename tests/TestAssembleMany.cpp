@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/assemble.h"
+#include "../src/assembleMany.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+/** \returns a program assembled from index, invalid for every seventh. */
+std::string makeProgram(std::size_t const index) {
+    std::string program;
+    for (std::size_t i = 0u; i < index % 50u; ++i)
+        program += "push imm 0x" + std::to_string(index + i) + "\n";
+    program += "jmp imm :end\n";
+    if (index % 7u == 0u)
+        program += "push imm :undefined\n";
+    program += ":end\nhalt imm 0x0\n";
+    return program;
+}
+
+bool sameText(Executable const & a, Executable const & b) {
+    auto const & as = a.linkingUnits.front().textSection->instructions;
+    auto const & bs = b.linkingUnits.front().textSection->instructions;
+    if (as.size() != bs.size())
+        return false;
+    for (std::size_t i = 0u; i < as.size(); ++i)
+        if (as[i].uint64[0u] != bs[i].uint64[0u])
+            return false;
+    return true;
+}
+
+struct Batch {
+
+/* Methods: */
+
+    Batch(std::size_t const numSources) {
+        programs.reserve(numSources);
+        for (std::size_t i = 0u; i < numSources; ++i) {
+            programs.emplace_back(makeProgram(i));
+            sources.push_back({programs.back().data(),
+                               programs.back().size()});
+            auto r(tryAssemble(programs.back().data(),
+                               programs.back().size()));
+            if (r) {
+                expected.emplace_back(std::move(r).value());
+                valid.push_back(true);
+            } else {
+                expected.emplace_back();
+                valid.push_back(false);
+            }
+        }
+    }
+
+    /** \brief Checks the results of the first results.size() sources. */
+    void check(std::vector<AssembleManyResult> const & results) const {
+        assert(results.size() <= sources.size());
+        for (std::size_t i = 0u; i < results.size(); ++i) {
+            assert(results[i].hasError() == !valid[i]);
+            if (valid[i])
+                assert(sameText(results[i].executable(), expected[i]));
+        }
+    }
+
+/* Fields: */
+
+    std::vector<std::string> programs;
+    std::vector<AssemblySource> sources;
+    std::vector<Executable> expected;
+    std::vector<bool> valid;
+
+};
+
+void testEmpty() {
+    assert(assembleMany(nullptr, 0u).empty());
+    AssemblerPool pool(4u);
+    assert(pool.assembleMany(nullptr, 0u).empty());
+}
+
+/* Every job must be run exactly once, whatever the number of threads, and
+   give the same result as assembling it alone: */
+void testThreadCounts() {
+    Batch const batch(1000u);
+    assert(!batch.valid[0u] && batch.valid[1u]);
+    for (std::size_t numThreads = 1u; numThreads <= 16u; ++numThreads)
+        batch.check(assembleMany(batch.sources.data(),
+                                 batch.sources.size(),
+                                 numThreads));
+    /* Fewer sources than threads: */
+    auto const results(assembleMany(batch.sources.data(), 3u, 16u));
+    assert(results.size() == 3u);
+    batch.check(results);
+}
+
+/* The workers of a pool must pick up every batch, of any size: */
+void testPoolReuse() {
+    Batch const batch(500u);
+    AssemblerPool pool(8u);
+    assert(pool.numThreads() >= 1u && pool.numThreads() <= 8u);
+    for (std::size_t round = 0u; round < 200u; ++round) {
+        auto const numSources = (round * 37u) % batch.sources.size();
+        auto const results(pool.assembleMany(batch.sources.data(),
+                                             numSources));
+        assert(results.size() == numSources);
+        batch.check(results);
+    }
+}
+
+/* Batches submitted to one pool from several threads run one by one: */
+void testConcurrentCallers() {
+    Batch const batch(300u);
+    AssemblerPool pool(4u);
+    std::vector<std::thread> callers;
+    for (std::size_t i = 0u; i < 4u; ++i)
+        callers.emplace_back(
+                    [&batch, &pool]() {
+                        for (std::size_t round = 0u; round < 20u; ++round) {
+                            auto const results(
+                                    pool.assembleMany(batch.sources.data(),
+                                                      batch.sources.size()));
+                            assert(results.size() == batch.sources.size());
+                            batch.check(results);
+                        }
+                    });
+    for (auto & caller : callers)
+        caller.join();
+}
+
+} // anonymous namespace
+
+int main() {
+    testEmpty();
+    testThreadCounts();
+    testPoolReuse();
+    testConcurrentCallers();
+}
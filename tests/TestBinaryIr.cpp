@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "../src/assemble.h"
+#include "../src/binaryIr.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+static char const program[] =
+        ".macro pushtwo a b\n"
+        "push imm a\n"
+        "push imm b\n"
+        ".endm\n"
+        ":start mov imm 0x1 reg 0x0\n"
+        ".pushtwo 0x2 -0x3\n"
+        "jz imm :start+0x0 uint8 reg 0x0\n"
+        "push imm (:s + 0x1)\n"
+        "halt imm 0x0\n"
+        ".section RODATA\n"
+        ":s\n"
+        ".data string \"a\\\"b\\n\"\n"
+        ".section BIND\n"
+        ":f .bind \"Mod::f\"\n";
+
+std::string serialize(Executable const & exe) {
+    std::ostringstream oss;
+    oss << exe;
+    return oss.str();
+}
+
+std::string toBinaryIr(char const * text) {
+    std::ostringstream oss;
+    auto const r(textToBinaryIr(text, std::strlen(text), oss));
+    assert(r);
+    return oss.str();
+}
+
+/** \returns the header of a program of binary IR. */
+std::string header() { return std::string("SMASIR\0\0\x01", 9u); }
+
+/* Assembling the binary IR must be assembling the text: */
+void testSameAsText() {
+    auto const expected(tryAssemble(program, sizeof(program) - 1u));
+    assert(expected);
+
+    /* Programs are read one after another from a stream: */
+    std::istringstream iss(toBinaryIr(program) + toBinaryIr(program));
+    BinaryIrReader reader;
+    for (unsigned i = 0u; i < 2u; ++i) {
+        auto const r(reader.tryAssemble(iss));
+        assert(r);
+        assert(serialize(*r) == serialize(*expected));
+    }
+
+    /* The text written back must assemble to the same executable: */
+    std::istringstream ir(toBinaryIr(program));
+    std::ostringstream text;
+    assert(binaryIrToText(ir, text));
+    auto const again(tryAssemble(text.str().c_str(), text.str().size()));
+    assert(again);
+    assert(serialize(*again) == serialize(*expected));
+}
+
+void testReadError(std::string const & ir,
+                   ErrorCode const code,
+                   std::size_t const offset,
+                   Options const & options = Options())
+{
+    BinaryIrReader reader;
+    Error error;
+    assert(!reader.read(ir.data(), ir.size(), error, options));
+    assert(error.code() == code);
+    assert(error.offsetType() == Error::OffsetType::BinaryIr);
+    assert(error.offset() == offset);
+}
+
+/* Errors of corrupt or truncated programs are at the records causing them: */
+void testCorrupt() {
+    auto const h(header());
+    testReadError(std::string("SMASIR\0\1\x01", 9u),
+                  ErrorCode::InvalidBinaryIr,
+                  0u);
+    testReadError(std::string("SMASIR\0\0\x02", 9u),
+                  ErrorCode::InvalidBinaryIr,
+                  0u);
+    /* Missing end record: */
+    testReadError(h, ErrorCode::InvalidBinaryIr, 9u);
+    /* Unknown tag: */
+    testReadError(h + "\x02\xff", ErrorCode::InvalidBinaryIr, 10u);
+    /* String ID out of range: */
+    testReadError(h + std::string("\x01\x01k\x04\x01", 5u),
+                  ErrorCode::InvalidBinaryIr,
+                  12u);
+    /* Truncated varint: */
+    testReadError(h + "\x01\x80", ErrorCode::InvalidBinaryIr, 9u);
+    /* Varint overflowing 64 bits: */
+    testReadError(h + "\x01\xff\xff\xff\xff\xff\xff\xff\xff\xff\x7f",
+                  ErrorCode::InvalidBinaryIr,
+                  9u);
+    /* Truncated string and value: */
+    testReadError(h + "\x01\x05" "ab", ErrorCode::InvalidBinaryIr, 9u);
+    testReadError(h + "\x06\x01\x02", ErrorCode::InvalidBinaryIr, 9u);
+    /* Invalid keyword and unknown instruction code: */
+    testReadError(h + std::string("\x01\x01+\x04\x00", 5u),
+                  ErrorCode::InvalidBinaryIr,
+                  12u);
+    testReadError(h + std::string("\x03\xff\xff\xff\xff\xff\xff\xff\xff", 9u),
+                  ErrorCode::InvalidBinaryIr,
+                  9u);
+}
+
+/* Strings defined count against the maximum number of tokens: */
+void testDefineLimit() {
+    Options options;
+    options.maxTokens = 2u;
+    testReadError(header() + "\x01\x01" "a" "\x01\x01" "b" "\x01\x01" "c",
+                  ErrorCode::TooManyTokens,
+                  15u,
+                  options);
+}
+
+/* Errors of assembling are at the records of the tokens causing them: */
+void testAssembleError() {
+    auto const ir(toBinaryIr("nop\npush imm :missing\n"));
+    BinaryIrReader reader;
+    auto const r(reader.tryAssemble(ir.data(), ir.size()));
+    assert(!r);
+    assert(r.error().code() == ErrorCode::UndefinedLabel);
+    assert(r.error().offsetType() == Error::OffsetType::BinaryIr);
+    assert(r.error().offset() < ir.size());
+    assert(ir[r.error().offset()] == '\x09');
+}
+
+} // anonymous namespace
+
+int main() {
+    testSameAsText();
+    testCorrupt();
+    testDefineLimit();
+    testAssembleError();
+}
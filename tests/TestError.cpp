@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <string>
+#include "../src/assemble.h"
+#include "../src/tokenizer.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+void testLineAndColumn() {
+    static char const program[] = "halt imm 0x0\n  foo imm 0x0\nnop\n";
+    auto const r(tryAssemble(program, std::strlen(program)));
+    assert(!r);
+    assert(r.error().offsetType() == Error::OffsetType::Text);
+    auto const message(r.error().message(program, std::strlen(program)));
+    assert(message.find("2:3") != std::string::npos);
+}
+
+/* Only the text up to the line of the error is tokenized again, hence the
+   rest of the text need not even tokenize: */
+void testPrefixOnly() {
+    static char const program[] = "halt imm 0x0\nfoo\n!";
+    Error const error(ErrorCode::UnknownInstruction, 13u);
+    auto const message(error.message(program, std::strlen(program)));
+    assert(message.find("foo") != std::string::npos);
+    assert(message.find("2:1") != std::string::npos);
+}
+
+/* Token indexes are not byte offsets into any text: */
+void testTokenIndex() {
+    static char const program[] = "halt imm 0x0\nfoo imm 0x0\n";
+    auto const ts(tokenize(program, std::strlen(program)));
+    auto const r(sharemind::Assembler::Assembler().tryAssemble(ts));
+    assert(!r);
+    assert(r.error().offsetType() == Error::OffsetType::TokenIndex);
+    assert(r.error().offset() == 4u);
+    auto const message(r.error().message(nullptr, 0u));
+    assert(message.find("token 4") != std::string::npos);
+}
+
+} // anonymous namespace
+
+int main() {
+    testLineAndColumn();
+    testPrefixOnly();
+    testTokenIndex();
+}
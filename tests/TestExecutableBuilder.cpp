@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "../src/assemble.h"
+#include "../src/ExecutableBuilder.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+using Argument = ExecutableBuilder::Argument;
+using DataType = ExecutableBuilder::DataType;
+using Section = ExecutableBuilder::Section;
+
+std::string serialize(Executable const & exe) {
+    std::ostringstream oss;
+    oss << exe;
+    return oss.str();
+}
+
+/* The executable built must be the one assembled from the equivalent text: */
+void testSameAsText() {
+    static char const program[] =
+            "mov_imm_reg 0x1234 0x2\n"
+            "push_imm -0x5\n"
+            ":loop\n"
+            "push_imm :s+0x1\n"
+            "jz_imm_uint8_reg :loop 0x1\n"
+            "halt_imm 0x0\n"
+            ".section RODATA\n"
+            ":s\n"
+            ".data string \"a\\\"b\\n\"\n"
+            ".align 0x4 0xff\n"
+            ".data int16 -0x3\n"
+            ".fill 0x2 uint8 0x7\n"
+            ".data uint64 (:s + 0x1)\n"
+            ".section BIND\n"
+            ":f\n"
+            ".bind \"Mod::f\"\n";
+    ExecutableBuilder b;
+    b.instruction("mov_imm_reg", 0x1234u, 2u);
+    b.instruction("push_imm", -5);
+    b.label("loop");
+    b.instruction("push_imm", Argument::label("s", 1));
+    b.instruction("jz_imm_uint8_reg", Argument::label("loop"), 1u);
+    b.instruction("halt_imm", 0u);
+    b.section(Section::RoData);
+    b.label("s");
+    b.data("a\"b\n");
+    b.align(4u, 0xffu);
+    b.data(DataType::Int16, -3);
+    b.fill(2u, DataType::UInt8, 7u);
+    b.data(DataType::UInt64, Argument::expression("(:s + 0x1)"));
+    b.section(Section::Bind);
+    b.label("f");
+    b.bind("Mod::f");
+    assert(b.numStatements() == 16u);
+
+    auto const text(tryAssemble(program, sizeof(program) - 1u));
+    auto const built(b.tryBuild());
+    assert(text && built);
+    assert(serialize(*built) == serialize(*text));
+    assert(serialize(b.build()) == serialize(*text));
+}
+
+/* Invalid statements throw before anything of them is appended: */
+void testNothingAppendedOnThrow() {
+    ExecutableBuilder b;
+    b.instruction("nop");
+    auto const numTokens = b.tokens().size();
+    auto const expectThrow =
+            [&b, numTokens](auto && f) {
+                try {
+                    f();
+                    assert(false);
+                } catch (ExecutableBuilderException const &) {}
+                assert(b.numStatements() == 1u);
+                assert(b.tokens().size() == numTokens);
+            };
+    expectThrow([&b] { b.instruction("mov imm", 1u, 2u); });
+    expectThrow([&b] { b.instruction(""); });
+    expectThrow([&b] {
+                    b.instruction("mov_imm_reg",
+                                  1u,
+                                  Argument::label("a+b"));
+                });
+    expectThrow([&b] {
+                    b.instruction("jmp_imm", Argument::expression("(0x1))"));
+                });
+    expectThrow([&b] { b.data(DataType::UInt8, Argument::label("")); });
+    expectThrow([&b] {
+                    b.fill(1u, DataType::UInt8, Argument::expression("0x1"));
+                });
+    expectThrow([&b] { b.label("a+b"); });
+
+    b.instruction("halt_imm", 0u);
+    assert(b.tryBuild());
+}
+
+/* Errors are located by the index of their statement: */
+void testErrorStatement() {
+    ExecutableBuilder b;
+    b.instruction("nop");
+    b.instruction("bogus", 1u);
+    b.instruction("halt_imm", 0u);
+    auto const r(b.tryBuild());
+    assert(!r);
+    assert(r.error().code() == ErrorCode::UnknownInstruction);
+    assert(r.error().offsetType() == Error::OffsetType::Statement);
+    assert(r.error().offset() == 1u);
+
+    b.clear();
+    assert(!b.numStatements() && b.tokens().empty());
+    b.instruction("halt_imm", 0u);
+    assert(b.tryBuild());
+}
+
+} // anonymous namespace
+
+int main() {
+    testSameAsText();
+    testNothingAppendedOnThrow();
+    testErrorStatement();
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include "../src/ExecutableCache.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+std::filesystem::path cacheDirectory() {
+    auto const dir(std::filesystem::temp_directory_path()
+                   / "sharemind-libas-TestExecutableCache");
+    std::filesystem::remove_all(dir);
+    return dir;
+}
+
+void testHit() {
+    auto const dir(cacheDirectory());
+    static char const program[] = "push imm 0x1\nhalt imm 0x0\n";
+    ExecutableCache cache(dir.string());
+    for (unsigned i = 0u; i < 2u; ++i)
+        assert(cache.tryAssemble(program, std::strlen(program)));
+    assert(cache.numMisses() == 1u);
+    assert(cache.numHits() == 1u);
+    std::filesystem::remove_all(dir);
+}
+
+/* An entry whose stored program differs from the given program, as after a
+   hash collision, must not be used: */
+void testProgramMismatch() {
+    auto const dir(cacheDirectory());
+    static char const program[] = "push imm 0x1\nhalt imm 0x0\n";
+    ExecutableCache cache(dir.string());
+    assert(cache.tryAssemble(program, std::strlen(program)));
+
+    auto const entry(std::filesystem::directory_iterator(dir)->path());
+    std::string contents;
+    {
+        std::ifstream f(entry, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(f),
+                        std::istreambuf_iterator<char>());
+    }
+    auto const offset = contents.find(program);
+    assert(offset != std::string::npos);
+    contents[offset + 11u] = '2'; // push imm 0x2
+    {
+        std::ofstream f(entry, std::ios::binary | std::ios::trunc);
+        f << contents;
+    }
+
+    assert(cache.tryAssemble(program, std::strlen(program)));
+    assert(cache.numMisses() == 2u);
+    assert(cache.numHits() == 0u);
+    std::filesystem::remove_all(dir);
+}
+
+/* Temporary files left over by crashed processes are removed on eviction,
+   unless they might still be written to: */
+void testStaleTempFiles() {
+    auto const dir(cacheDirectory());
+    std::filesystem::create_directory(dir);
+    auto const stale(dir / "tmp-0000000000000001-0000000000000000");
+    auto const recent(dir / "tmp-0000000000000001-0000000000000001");
+    std::ofstream(stale) << "x";
+    std::ofstream(recent) << "x";
+    std::filesystem::last_write_time(
+                stale,
+                std::filesystem::last_write_time(stale)
+                - std::chrono::hours(2));
+
+    static char const program[] = "push imm 0x1\nhalt imm 0x0\n";
+    ExecutableCache cache(dir.string(), 1024u * 1024u);
+    assert(cache.tryAssemble(program, std::strlen(program)));
+    assert(!std::filesystem::exists(stale));
+    assert(std::filesystem::exists(recent));
+    std::filesystem::remove_all(dir);
+}
+
+} // anonymous namespace
+
+int main() {
+    testHit();
+    testProgramMismatch();
+    testStaleTempFiles();
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include "../src/assemble.h"
+#include "../src/Expression.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+bool evaluate(std::string const & text, std::uint64_t & value) {
+    Expression expression;
+    if (!expression.parse(text.c_str(), text.size()))
+        return false;
+    return expression.evaluate(value) == Expression::EvaluationResult::Ok;
+}
+
+std::string nested(std::size_t const depth) {
+    return std::string(depth, '(') + "0x1" + std::string(depth, ')');
+}
+
+void testNesting() {
+    std::uint64_t value;
+    assert(evaluate(nested(Expression::maxNestingDepth + 1u), value));
+    assert(value == 1u);
+    assert(!evaluate(nested(Expression::maxNestingDepth + 2u), value));
+    assert(!evaluate(nested(1000000u), value));
+
+    auto const program("push imm " + nested(1000000u) + "\n");
+    auto const r(tryAssemble(program.c_str(), program.size()));
+    assert(!r);
+    assert(r.error().code() == ErrorCode::InvalidExpression);
+}
+
+void testUnaryChains() {
+    std::uint64_t value;
+    assert(evaluate("(" + std::string(1000000u, '-') + "0x1)", value));
+    assert(value == 1u);
+    assert(evaluate("(" + std::string(999999u, '-') + "0x1)", value));
+    assert(value == static_cast<std::uint64_t>(-1));
+    assert(evaluate("(0x2 * - + -0x3)", value));
+    assert(value == 6u);
+}
+
+} // anonymous namespace
+
+int main() {
+    testNesting();
+    testUnaryChains();
+}
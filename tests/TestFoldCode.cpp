@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+/** \returns the serialized executable of the program. */
+std::string assembleImage(char const * program, Options const & options) {
+    auto const r(tryAssemble(program, std::strlen(program), options));
+    assert(r);
+    std::ostringstream oss;
+    oss << *r;
+    return oss.str();
+}
+
+/* The folded program must be the given equivalent program: */
+void testFolded(char const * program, char const * expected) {
+    Options const plain;
+    Options fold;
+    fold.foldCode = true;
+    assert(assembleImage(program, fold) == assembleImage(expected, plain));
+}
+
+/* Programs without procedures which can be merged are left as they are: */
+void testKept(char const * program) { testFolded(program, program); }
+
+void testIdentical() {
+    testFolded(":start\n"
+               "jz imm :f uint8 reg 0x0\n"
+               "jmp imm :g\n"
+               ":f\n"
+               "mov imm 0x1 reg 0x1\n"
+               "halt imm 0x0\n"
+               ":g\n"
+               "mov imm 0x1 reg 0x1\n"
+               "halt imm 0x0\n",
+               ":start\n"
+               "jz imm :f uint8 reg 0x0\n"
+               "jmp imm :f\n"
+               ":f\n"
+               "mov imm 0x1 reg 0x1\n"
+               "halt imm 0x0\n");
+    /* Jumps into the procedures themselves are compared by their offsets: */
+    testFolded(":start\n"
+               "jz imm :f uint8 reg 0x0\n"
+               "jmp imm :g\n"
+               ":f\n"
+               "uinc reg 0x0\n"
+               "jz imm :f uint8 reg 0x0\n"
+               "halt imm 0x0\n"
+               ":g\n"
+               "uinc reg 0x0\n"
+               "jz imm :g uint8 reg 0x0\n"
+               "halt imm 0x0\n",
+               ":start\n"
+               "jz imm :f uint8 reg 0x0\n"
+               "jmp imm :f\n"
+               ":f\n"
+               "uinc reg 0x0\n"
+               "jz imm :f uint8 reg 0x0\n"
+               "halt imm 0x0\n");
+}
+
+/* Procedures which only differ in jumping to procedures merged before are
+   merged as well: */
+void testRepeated() {
+    testFolded(":start\n"
+               "jz imm :f2 uint8 reg 0x0\n"
+               "jmp imm :g2\n"
+               ":f\n"
+               "halt imm 0x1\n"
+               ":g\n"
+               "halt imm 0x1\n"
+               ":f2\n"
+               "jmp imm :f\n"
+               ":g2\n"
+               "jmp imm :g\n",
+               ":start\n"
+               "jz imm :f2 uint8 reg 0x0\n"
+               "jmp imm :f2\n"
+               ":f\n"
+               "halt imm 0x1\n"
+               ":f2\n"
+               "jmp imm :f\n");
+}
+
+void testGuards() {
+    /* Code falls through into the second copy: */
+    testKept(":start\n"
+             "jz imm :f uint8 reg 0x0\n"
+             "jmp imm :h\n"
+             ":f\n"
+             "halt imm 0x1\n"
+             ":h\n"
+             "nop\n"
+             ":g\n"
+             "halt imm 0x1\n");
+    /* The copies refer to different data: */
+    testKept(":start\n"
+             "jz imm :f uint8 reg 0x0\n"
+             "jmp imm :g\n"
+             ":f\n"
+             "push imm :x\n"
+             "halt imm 0x0\n"
+             ":g\n"
+             "push imm :y\n"
+             "halt imm 0x0\n"
+             ".section RODATA\n"
+             ":x\n"
+             ".data uint8 0x1\n"
+             ":y\n"
+             ".data uint8 0x2\n");
+}
+
+} // anonymous namespace
+
+int main() {
+    testIdentical();
+    testRepeated();
+    testGuards();
+}
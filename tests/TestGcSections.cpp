@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+/** \returns the serialized executable of the program. */
+std::string assembleImage(char const * program, Options const & options) {
+    auto const r(tryAssemble(program, std::strlen(program), options));
+    assert(r);
+    std::ostringstream oss;
+    oss << *r;
+    return oss.str();
+}
+
+/* The collected program must be the given equivalent program: */
+void testCollected(char const * program, char const * expected) {
+    Options const plain;
+    Options collect;
+    collect.gcSections = true;
+    assert(assembleImage(program, collect) == assembleImage(expected, plain));
+}
+
+/* Programs left unchanged as all of them is reachable or referenced: */
+void testKept(char const * program) { testCollected(program, program); }
+
+void testCode() {
+    testCollected("halt imm 0x0\n"
+                  "nop\n"
+                  "nop\n",
+                  "halt imm 0x0\n");
+    testCollected("jmp imm :b\n"
+                  ":a\n"
+                  "nop\n"
+                  "halt imm 0x1\n"
+                  ":b\n"
+                  "halt imm 0x0\n",
+                  "jmp imm :b\n"
+                  ":b\n"
+                  "halt imm 0x0\n");
+    /* Conditional jumps reach the code after them: */
+    testKept("jz imm :b uint8 reg 0x0\n"
+             "halt imm 0x1\n"
+             ":b\n"
+             "halt imm 0x0\n");
+    /* Code labels used as values are reachable: */
+    testKept("push imm :a\n"
+             "halt imm 0x0\n"
+             ":a\n"
+             "halt imm 0x1\n");
+}
+
+void testData() {
+    testCollected("push imm :b\n"
+                  "halt imm 0x0\n"
+                  ".section RODATA\n"
+                  ":a\n"
+                  ".data uint32 0x1\n"
+                  ":b\n"
+                  ".data uint32 0x2\n",
+                  "push imm :b\n"
+                  "halt imm 0x0\n"
+                  ".section RODATA\n"
+                  ":b\n"
+                  ".data uint32 0x2\n");
+    /* Data used only by unreachable code is removed, but not the bytes
+       before the first label: */
+    testCollected("halt imm 0x0\n"
+                  "push imm :a\n"
+                  ".section DATA\n"
+                  ".data uint8 0x7\n"
+                  ":a\n"
+                  ".data uint32 0x1\n",
+                  "halt imm 0x0\n"
+                  ".section DATA\n"
+                  ".data uint8 0x7\n");
+    /* Labels in arithmetic keep their sections whole: */
+    testKept("push imm (:b + 0x4)\n"
+             "halt imm 0x0\n"
+             ".section RODATA\n"
+             ":a\n"
+             ".data uint32 0x1\n"
+             ":b\n"
+             ".data uint32 0x2\n"
+             ":c\n"
+             ".data uint32 0x3\n");
+}
+
+} // anonymous namespace
+
+int main() {
+    testCode();
+    testData();
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+ErrorCode assembleError(std::string const & program,
+                        Options const & options)
+{
+    auto const r(tryAssemble(program.c_str(), program.size(), options));
+    assert(!r);
+    return r.error().code();
+}
+
+Options fileAccessOptions() {
+    Options options;
+    options.allowFileAccess = true;
+    return options;
+}
+
+/* Files which might not end are not read: */
+void testNonRegularFiles() {
+    auto const options(fileAccessOptions());
+    assert(assembleError(".section RODATA\n.incbin \"/dev/zero\"\n", options)
+           == ErrorCode::FileReadError);
+    assert(assembleError(".include \"/dev/zero\"\n", options)
+           == ErrorCode::FileReadError);
+
+    auto const fifo(std::filesystem::temp_directory_path()
+                    / "sharemind-libas-TestIncludeFiles.fifo");
+    std::filesystem::remove(fifo);
+    assert(::mkfifo(fifo.c_str(), 0600) == 0);
+    auto const incbin(".section RODATA\n.incbin \"" + fifo.string() + "\"\n");
+    auto const include(".include \"" + fifo.string() + "\"\n");
+    auto const incbinError(assembleError(incbin, options));
+    auto const includeError(assembleError(include, options));
+    std::filesystem::remove(fifo);
+    assert(incbinError == ErrorCode::FileReadError);
+    assert(includeError == ErrorCode::FileReadError);
+}
+
+void testSectionSizeLimit() {
+    auto const path(std::filesystem::temp_directory_path()
+                    / "sharemind-libas-TestIncludeFiles.bin");
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f << std::string(4096u, 'x');
+    }
+    auto options(fileAccessOptions());
+    options.maxSectionSize = 4096u;
+    auto const program(".section RODATA\n.data uint8 0x0\n.incbin \""
+                       + path.string() + "\"\n");
+    auto const error(assembleError(program, options));
+    options.maxSectionSize = 4097u;
+    auto const r(tryAssemble(program.c_str(), program.size(), options));
+    std::filesystem::remove(path);
+    assert(error == ErrorCode::SectionSizeLimitExceeded);
+    assert(r);
+    assert(r->linkingUnits.front().roDataSection->sizeInBytes == 4097u);
+}
+
+} // anonymous namespace
+
+int main() {
+    testNonRegularFiles();
+    testSectionSizeLimit();
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "../src/assemble.h"
+#include "../src/ExecutionProfile.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+/** \returns the serialized executable of the program. */
+std::string assembleImage(char const * program, Options const & options) {
+    auto const r(tryAssemble(program, std::strlen(program), options));
+    assert(r);
+    std::ostringstream oss;
+    oss << *r;
+    return oss.str();
+}
+
+/* The program laid out by the profile must be the given equivalent program: */
+void testLayout(char const * program,
+                ExecutionProfile const & profile,
+                char const * expected)
+{
+    Options const plain;
+    Options layout;
+    layout.profile = &profile;
+    assert(assembleImage(program, layout) == assembleImage(expected, plain));
+}
+
+/* The chain a jump from the first chain goes to follows it, and the jump is
+   removed: */
+void testJumpTarget() {
+    ExecutionProfile profile;
+    profile.add("start", 0u, 1u);
+    profile.add("b", 0u, 1u);
+    testLayout(":start\n"
+               "jmp imm :b\n"
+               ":a\n"
+               "halt imm 0x1\n"
+               ":b\n"
+               "halt imm 0x0\n",
+               profile,
+               ":start\n"
+               ":b\n"
+               "halt imm 0x0\n"
+               ":a\n"
+               "halt imm 0x1\n");
+}
+
+/* Hotter chains come first, and chains never executed keep their order: */
+void testHottest() {
+    ExecutionProfile profile;
+    profile.add("start", 0u, 6u);
+    profile.add("c", 0u, 1u);
+    profile.add("d", 0u, 5u);
+    testLayout(":start\n"
+               "jz imm :d uint8 reg 0x0\n"
+               "halt imm 0x0\n"
+               ":a\n"
+               "halt imm 0x1\n"
+               ":b\n"
+               "halt imm 0x2\n"
+               ":c\n"
+               "halt imm 0x3\n"
+               ":d\n"
+               "halt imm 0x4\n",
+               profile,
+               ":start\n"
+               "jz imm :d uint8 reg 0x0\n"
+               "halt imm 0x0\n"
+               ":d\n"
+               "halt imm 0x4\n"
+               ":c\n"
+               "halt imm 0x3\n"
+               ":a\n"
+               "halt imm 0x1\n"
+               ":b\n"
+               "halt imm 0x2\n");
+}
+
+/* Programs without profile entries or with jumps to raw offsets are left as
+   they are: */
+void testUnchanged() {
+    ExecutionProfile profile;
+    profile.add("x", 0u, 1u);
+    static char const unprofiled[] =
+            ":start\n"
+            "jmp imm :b\n"
+            ":a\n"
+            "halt imm 0x1\n"
+            ":b\n"
+            "halt imm 0x0\n";
+    testLayout(unprofiled, profile, unprofiled);
+
+    profile.add("b", 0u, 1u);
+    static char const raw[] =
+            ":start\n"
+            "jmp imm 0x4\n"
+            ":a\n"
+            "halt imm 0x1\n"
+            ":b\n"
+            "halt imm 0x0\n";
+    testLayout(raw, profile, raw);
+}
+
+} // anonymous namespace
+
+int main() {
+    testJumpTarget();
+    testHottest();
+    testUnchanged();
+}
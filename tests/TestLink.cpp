@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+Object assemblePart(char const * program) {
+    auto r(tryAssembleObject(program, std::strlen(program)));
+    assert(r);
+    return std::move(r).value();
+}
+
+/* Link errors locate the object, the token and the label: */
+void testUndefinedLabel() {
+    auto const a(assemblePart("halt imm 0x0\n"));
+    auto const b(assemblePart("push imm 0x0\npush imm :missing\n"));
+    auto const r(link({&a, &b}));
+    assert(!r);
+    auto const & error = r.error();
+    assert(error.code() == ErrorCode::UndefinedLabel);
+    assert(error.objectIndex() == 1u);
+    assert(error.offsetType() == Error::OffsetType::TokenIndex);
+    assert(error.offset() == 6u);
+    assert(error.label() && (*error.label() == "missing"));
+    assert(error.message(nullptr, 0u).find("missing") != std::string::npos);
+}
+
+void testUndefinedLabelInExpression() {
+    auto const a(assemblePart("push imm (:missing + 0x1)\nhalt imm 0x0\n"));
+    auto const r(link({&a}));
+    assert(!r);
+    assert(r.error().code() == ErrorCode::UndefinedLabel);
+    assert(r.error().objectIndex() == 0u);
+    assert(r.error().offset() == 2u);
+    assert(r.error().label() && (*r.error().label() == "missing"));
+}
+
+void testDuplicateLabel() {
+    auto const a(assemblePart(":start\nhalt imm 0x0\n"));
+    auto const b(assemblePart(":start\nnop\n"));
+    auto const r(link({&a, &b}));
+    assert(!r);
+    assert(r.error().code() == ErrorCode::DuplicateLabel);
+    assert(r.error().objectIndex() == 1u);
+    assert(r.error().offsetType() == Error::OffsetType::None);
+    assert(r.error().label() && (*r.error().label() == "start"));
+}
+
+/* The token indexes are kept by the object format: */
+void testSerializedTokenIndex() {
+    auto const a(assemblePart("nop\nnop\npush imm :missing\nhalt imm 0x0\n"));
+    std::stringstream ss;
+    ss << a;
+    Object b;
+    ss >> b;
+    assert(ss);
+    auto const r(link({&b}));
+    assert(!r);
+    assert(r.error().offset() == 6u);
+}
+
+} // anonymous namespace
+
+int main() {
+    testUndefinedLabel();
+    testUndefinedLabelInExpression();
+    testDuplicateLabel();
+    testSerializedTokenIndex();
+}
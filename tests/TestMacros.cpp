@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+std::string assembleImage(char const * program) {
+    auto const r(tryAssemble(program, std::strlen(program)));
+    assert(r);
+    std::ostringstream oss;
+    oss << *r;
+    return oss.str();
+}
+
+/* The program must assemble like the given program without macros: */
+void testExpanded(char const * program, char const * expected)
+{ assert(assembleImage(program) == assembleImage(expected)); }
+
+void testExpansions() {
+    testExpanded(".macro pushtwo a b\n"
+                 "push imm a\n"
+                 "push imm b\n"
+                 ".endm\n"
+                 ".macro pushfour a b\n"
+                 ".pushtwo a b\n"
+                 ".pushtwo b a\n"
+                 ".endm\n"
+                 ".pushfour 0x1 :end\n"
+                 ".pushtwo 0x3 0x4\n"
+                 ".pushfour :end 0x2\n"
+                 ":end\n"
+                 "halt imm 0x0\n",
+                 "push imm 0x1\n"
+                 "push imm :end\n"
+                 "push imm :end\n"
+                 "push imm 0x1\n"
+                 "push imm 0x3\n"
+                 "push imm 0x4\n"
+                 "push imm :end\n"
+                 "push imm 0x2\n"
+                 "push imm 0x2\n"
+                 "push imm :end\n"
+                 ":end\n"
+                 "halt imm 0x0\n");
+    /* Macros defined by expansions outlive them: */
+    testExpanded(".macro define\n"
+                 ".macro inner a\n"
+                 "push imm a\n"
+                 ".endm\n"
+                 ".endm\n"
+                 ".define\n"
+                 ".macro other\n"
+                 "nop\n"
+                 "nop\n"
+                 ".endm\n"
+                 ".other\n"
+                 ".inner 0x5\n"
+                 ".other\n"
+                 ".inner 0x6\n"
+                 "halt imm 0x0\n",
+                 "nop\n"
+                 "nop\n"
+                 "push imm 0x5\n"
+                 "nop\n"
+                 "nop\n"
+                 "push imm 0x6\n"
+                 "halt imm 0x0\n");
+}
+
+std::size_t errorOffset(char const * program, ErrorCode const code) {
+    auto const r(tryAssemble(program, std::strlen(program)));
+    assert(!r);
+    assert(r.error().code() == code);
+    return r.error().offset();
+}
+
+/* Label uses waiting for the end of the program are located at the tokens
+   they were copied from, even after later expansions: */
+void testErrorsAfterExpansions() {
+    static char const inBody[] =
+            ".macro use\n"
+            "push imm :missing\n"
+            ".endm\n"
+            ".use\n"
+            ".use\n"
+            "halt imm 0x0\n";
+    assert(errorOffset(inBody, ErrorCode::UndefinedLabel)
+           == static_cast<std::size_t>(std::strstr(inBody, ":missing")
+                                       - inBody));
+
+    static char const inArgument[] =
+            ".macro use a\n"
+            "push imm a\n"
+            ".endm\n"
+            ".macro twice a\n"
+            ".use a\n"
+            ".use 0x0\n"
+            ".endm\n"
+            ".twice :missing\n"
+            ".twice 0x1\n"
+            "halt imm 0x0\n";
+    assert(errorOffset(inArgument, ErrorCode::UndefinedLabel)
+           == static_cast<std::size_t>(std::strstr(inArgument, ":missing")
+                                       - inArgument));
+
+    static char const jumpTarget[] =
+            ".macro jump\n"
+            "jmp imm :a+0x1\n"
+            ".endm\n"
+            ".jump\n"
+            ".jump\n"
+            ":a\n"
+            "push imm 0x0\n"
+            "halt imm 0x0\n";
+    assert(errorOffset(jumpTarget, ErrorCode::InvalidJumpTarget)
+           == static_cast<std::size_t>(std::strstr(jumpTarget, ":a+")
+                                       - jumpTarget));
+}
+
+} // anonymous namespace
+
+int main() {
+    testExpansions();
+    testErrorsAfterExpansions();
+}
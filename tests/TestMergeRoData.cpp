@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+Executable assembleProgram(char const * program, Options const & options) {
+    auto r(tryAssemble(program, std::strlen(program), options));
+    assert(r);
+    return std::move(r).value();
+}
+
+/** \returns the RODATA bytes the argument of the instruction refers to. */
+std::uint32_t valueAt(Executable const & exe, std::size_t const argument) {
+    auto const & lu = exe.linkingUnits.front();
+    auto const offset = lu.textSection->instructions[argument].uint64[0u];
+    assert(offset + sizeof(std::uint32_t) <= lu.roDataSection->sizeInBytes);
+    std::uint32_t r;
+    std::memcpy(&r,
+                static_cast<char const *>(lu.roDataSection->data.get())
+                + offset,
+                sizeof(r));
+    return r;
+}
+
+/* A block merged into an earlier equal block which is then merged into the
+   tail of a longer block must follow it there: */
+void testMergedTwice() {
+    static char const program[] =
+            "push imm :a\n"
+            "push imm :b\n"
+            "push imm :c\n"
+            "push imm :d\n"
+            "halt imm 0x0\n"
+            ".section RODATA\n"
+            ":a\n"
+            ".data uint32 0x0\n"
+            ":b\n"
+            ".data string \"s0\"\n"
+            ".data uint32 0x0\n"
+            ":c\n"
+            ".data uint32 0x0\n"
+            ":d\n"
+            ".data string \"s0\"\n";
+    Options const plain;
+    Options merge;
+    merge.mergeRoData = true;
+    auto const before(assembleProgram(program, plain));
+    auto const after(assembleProgram(program, merge));
+    assert(after.linkingUnits.front().roDataSection->sizeInBytes
+           < before.linkingUnits.front().roDataSection->sizeInBytes);
+    for (std::size_t argument : { 1u, 3u, 5u })
+        assert(valueAt(after, argument) == valueAt(before, argument));
+}
+
+} // anonymous namespace
+
+int main() {
+    testMergedTwice();
+}
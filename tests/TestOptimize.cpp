@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+Options allOptimizations() {
+    Options options;
+    options.peephole = true;
+    options.gcSections = true;
+    options.foldCode = true;
+    options.mergeRoData = true;
+    options.pruneBindings = true;
+    options.zeroDataToBss = true;
+    return options;
+}
+
+/* Invalid programs are assembled once, and the errors found when linking
+   the optimized program are those of assembling it without optimizations: */
+void testSameError(char const * program) {
+    auto const plain(tryAssemble(program, std::strlen(program)));
+    auto const optimized(tryAssemble(program,
+                                     std::strlen(program),
+                                     allOptimizations()));
+    assert(!plain && !optimized);
+    assert(optimized.error().code() == plain.error().code());
+    assert(optimized.error().offset() == plain.error().offset());
+}
+
+void testErrors() {
+    testSameError("push imm :missing\nhalt imm 0x0\n");
+    testSameError("nop\npush imm (:missing + 0x1)\nhalt imm 0x0\n");
+    testSameError("jmp imm :d\nhalt imm 0x0\n.section DATA\n:d\n"
+                  ".data uint8 0x0\n");
+    testSameError("nop\nfoo imm 0x0\n");
+    testSameError(":a\n:a\nhalt imm 0x0\n");
+}
+
+/* Errors found when linking the optimized program are not hidden by
+   assembling it again: */
+void testCancelled() {
+    static char const program[] = "halt imm 0x0\n";
+    std::atomic<bool> cancelled(true);
+    auto options(allOptimizations());
+    options.cancelFlag = &cancelled;
+    auto const r(tryAssemble(program, std::strlen(program), options));
+    assert(!r);
+    assert(r.error().code() == ErrorCode::Cancelled);
+}
+
+} // anonymous namespace
+
+int main() {
+    testErrors();
+    testCancelled();
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+/** \returns the code of all linking units of the assembled program. */
+std::vector<std::uint64_t> assembleText(char const * program,
+                                        Options const & options)
+{
+    auto const r(tryAssemble(program, std::strlen(program), options));
+    assert(r);
+    std::vector<std::uint64_t> text;
+    for (auto const & lu : r->linkingUnits)
+        if (lu.textSection)
+            for (auto const & block : lu.textSection->instructions)
+                text.push_back(block.uint64[0u]);
+    return text;
+}
+
+/* The optimized program must be the given equivalent program: */
+void testRule(char const * program, char const * expected) {
+    Options const plain;
+    Options optimize;
+    optimize.peephole = true;
+    assert(assembleText(program, optimize) == assembleText(expected, plain));
+}
+
+/* Programs left unchanged because the guard of a rule does not hold: */
+void testGuard(char const * program) { testRule(program, program); }
+
+void testThreadJump() {
+    testRule("jmp imm :a\n"
+             "halt imm 0x0\n"
+             ":a\n"
+             "jmp imm :b\n"
+             "halt imm 0x1\n"
+             ":b\n"
+             "halt imm 0x2\n",
+             "jmp imm :b\n"
+             "halt imm 0x0\n"
+             ":a\n"
+             "jmp imm :b\n"
+             "halt imm 0x1\n"
+             ":b\n"
+             "halt imm 0x2\n");
+    /* A jump to itself is not followed: */
+    testGuard("jmp imm :a\n"
+              "halt imm 0x0\n"
+              ":a\n"
+              "jmp imm :a\n");
+}
+
+void testRemoveJumpToNext() {
+    testRule("nop\n"
+             "jmp imm :a\n"
+             ":a\n"
+             "halt imm 0x0\n",
+             "nop\n"
+             "halt imm 0x0\n");
+    /* Conditional jumps are kept: */
+    testGuard("jz imm :a uint8 reg 0x0\n"
+              ":a\n"
+              "halt imm 0x0\n");
+}
+
+void testRemoveSelfMove() {
+    testRule("mov reg 0x1 reg 0x1\n"
+             "halt imm 0x0\n",
+             "halt imm 0x0\n");
+    testGuard("mov reg 0x1 reg 0x2\n"
+              "halt imm 0x0\n");
+    testGuard("mov reg 0x1 stack 0x1\n"
+              "halt imm 0x0\n");
+}
+
+void testRemoveDeadMove() {
+    testRule("mov imm 0x1 reg 0x0\n"
+             "mov imm 0x2 reg 0x0\n"
+             "halt imm 0x0\n",
+             "mov imm 0x2 reg 0x0\n"
+             "halt imm 0x0\n");
+    testRule("mov imm 0x1 stack 0x0\n"
+             "mov reg 0x0 stack 0x0\n"
+             "halt imm 0x0\n",
+             "mov reg 0x0 stack 0x0\n"
+             "halt imm 0x0\n");
+    testGuard("mov imm 0x1 reg 0x0\n"
+              "mov imm 0x2 reg 0x1\n"
+              "halt imm 0x0\n");
+    testGuard("mov imm 0x1 reg 0x0\n"
+              "mov imm 0x2 stack 0x0\n"
+              "halt imm 0x0\n");
+    /* The second move reads the destination of the first one, and is later
+       removed as a move to itself: */
+    testRule("mov imm 0x1 reg 0x0\n"
+             "mov reg 0x0 reg 0x0\n"
+             "halt imm 0x0\n",
+             "mov imm 0x1 reg 0x0\n"
+             "halt imm 0x0\n");
+}
+
+void testFoldResizeStack() {
+    testRule("resizestack 0x4\n"
+             "resizestack 0x2\n"
+             "halt imm 0x0\n",
+             "resizestack 0x2\n"
+             "halt imm 0x0\n");
+    testGuard("resizestack 0x2\n"
+              "resizestack 0x4\n"
+              "halt imm 0x0\n");
+}
+
+} // anonymous namespace
+
+int main() {
+    testThreadJump();
+    testRemoveJumpToNext();
+    testRemoveSelfMove();
+    testRemoveDeadMove();
+    testFoldResizeStack();
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+/** \returns the serialized executable of the program. */
+std::string assembleImage(char const * program, Options const & options) {
+    auto const r(tryAssemble(program, std::strlen(program), options));
+    assert(r);
+    std::ostringstream oss;
+    oss << *r;
+    return oss.str();
+}
+
+/* The pruned program must be the given equivalent program: */
+void testPruned(char const * program, char const * expected) {
+    Options const plain;
+    Options prune;
+    prune.pruneBindings = true;
+    assert(assembleImage(program, prune) == assembleImage(expected, plain));
+}
+
+/* Programs whose bindings can not all be followed are left as they are: */
+void testKept(char const * program) { testPruned(program, program); }
+
+void testUnused() {
+    testPruned(".section BIND\n"
+               ":a .bind \"foo\"\n"
+               ":b .bind \"bar\"\n"
+               ":c .bind \"baz\"\n"
+               ".section PDBIND\n"
+               ":p .bind \"pd1\"\n"
+               ":q .bind \"pd2\"\n"
+               ".section TEXT\n"
+               "syscall imm :c\n"
+               "syscall imm :b\n"
+               "mov imm :q reg 0x0\n"
+               "halt imm 0x0\n",
+               ".section BIND\n"
+               ":b .bind \"bar\"\n"
+               ":c .bind \"baz\"\n"
+               ".section PDBIND\n"
+               ":q .bind \"pd2\"\n"
+               ".section TEXT\n"
+               "syscall imm :c\n"
+               "syscall imm :b\n"
+               "mov imm :q reg 0x0\n"
+               "halt imm 0x0\n");
+}
+
+void testDuplicates() {
+    testPruned(".section BIND\n"
+               ":a .bind \"foo\"\n"
+               ":b .bind \"bar\"\n"
+               ":c .bind \"foo\"\n"
+               ".section TEXT\n"
+               "syscall imm :c\n"
+               "syscall imm :b\n"
+               "syscall imm :a\n"
+               "halt imm 0x0\n",
+               ".section BIND\n"
+               ":a .bind \"foo\"\n"
+               ":b .bind \"bar\"\n"
+               ".section TEXT\n"
+               "syscall imm :a\n"
+               "syscall imm :b\n"
+               "syscall imm :a\n"
+               "halt imm 0x0\n");
+}
+
+void testGuards() {
+    /* An entry without a label: */
+    testKept(".section BIND\n"
+             ":a .bind \"foo\"\n"
+             ".bind \"bar\"\n"
+             ".section TEXT\n"
+             "syscall imm :a\n"
+             "halt imm 0x0\n");
+    /* A system call given as a plain number: */
+    testKept(".section BIND\n"
+             ":a .bind \"foo\"\n"
+             ":b .bind \"bar\"\n"
+             ".section TEXT\n"
+             "syscall imm 0x1\n"
+             "syscall imm :a\n"
+             "halt imm 0x0\n");
+    /* Labels with offsets and in arithmetic: */
+    testKept(".section BIND\n"
+             ":a .bind \"foo\"\n"
+             ":b .bind \"bar\"\n"
+             ".section TEXT\n"
+             "syscall imm :a+0x1\n"
+             "halt imm 0x0\n");
+    testKept(".section BIND\n"
+             ":a .bind \"foo\"\n"
+             ":b .bind \"bar\"\n"
+             ".section TEXT\n"
+             "syscall imm (:a + 0x1)\n"
+             "halt imm 0x0\n");
+}
+
+} // anonymous namespace
+
+int main() {
+    testUnused();
+    testDuplicates();
+    testGuards();
+}
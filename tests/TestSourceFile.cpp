@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../src/SourceFile.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+std::shared_ptr<SourceFile const> load(std::filesystem::path const & path) {
+    std::shared_ptr<SourceFile const> file;
+    Error error;
+    auto const r = loadSourceFile(path.c_str(), Options(), file, error);
+    assert(r);
+    return file;
+}
+
+void testLeastRecentlyUsedEviction(
+        std::vector<std::filesystem::path> const & paths)
+{
+    clearSourceFileCache();
+    auto const a(load(paths[0u]));
+    auto const aSize = sourceFileCacheSize();
+    assert(aSize > 0u);
+
+    /* Room for two of the equal files: */
+    setSourceFileCacheLimit(2u * aSize);
+    auto const b(load(paths[1u]));
+    assert(sourceFileCacheSize() == 2u * aSize);
+    assert(load(paths[0u]) == a);
+    auto const c(load(paths[2u]));
+    assert(sourceFileCacheSize() == 2u * aSize);
+    assert(load(paths[0u]) == a);
+    assert(load(paths[2u]) == c);
+    assert(load(paths[1u]) != b); /* Evicted */
+
+    /* Files larger than the limit are not cached: */
+    setSourceFileCacheLimit(aSize - 1u);
+    assert(sourceFileCacheSize() == 0u);
+    assert(load(paths[0u]) != a);
+    assert(sourceFileCacheSize() == 0u);
+
+    setSourceFileCacheLimit(defaultSourceFileCacheLimit);
+    load(paths[0u]);
+    assert(sourceFileCacheSize() == aSize);
+    clearSourceFileCache();
+    assert(sourceFileCacheSize() == 0u);
+}
+
+} // anonymous namespace
+
+int main() {
+    std::vector<std::filesystem::path> paths;
+    for (char const name : { 'a', 'b', 'c' }) {
+        paths.emplace_back(std::filesystem::temp_directory_path()
+                           / (std::string("sharemind-libas-TestSourceFile-")
+                              + name + ".sa"));
+        std::ofstream f(paths.back(), std::ios::binary | std::ios::trunc);
+        f << "halt imm 0x0\n";
+    }
+    testLeastRecentlyUsedEviction(paths);
+    for (auto const & path : paths)
+        std::filesystem::remove(path);
+}
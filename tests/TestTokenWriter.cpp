@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include "../src/TokenWriter.h"
+#include "../src/tokenizer.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+std::string_view textOf(Token const & token)
+{ return std::string_view(token.text(), token.length()); }
+
+/* The tokens written must be those tokenized from their texts, with the same
+   values even though the writer does not parse the texts: */
+void testSameAsTokenized() {
+    TokensVector written;
+    TokenWriter w(written);
+    w.keyword("mov_imm_reg");
+    w.uhex(0u);
+    w.uhex(std::numeric_limits<std::uint64_t>::max());
+    w.newline();
+    w.directive("data");
+    w.keyword("int64");
+    w.hex(std::numeric_limits<std::int64_t>::min());
+    w.hex(std::numeric_limits<std::int64_t>::max());
+    w.hex(-1);
+    w.newline();
+    w.label("a");
+    w.label(".local");
+    w.label("b", -0x10);
+    w.label("c", std::numeric_limits<std::int64_t>::max());
+    w.newline();
+    w.directive("bind");
+    w.string("");
+    w.string("\"\\\n\r\t\v\b\f\a");
+    w.string(std::string_view("x\0y", 3u));
+    w.expression("(:a + (0x1 * :b))");
+
+    std::string program;
+    for (auto const & token : written) {
+        if (!program.empty() && (program.back() != '\n')
+            && (token.type() != Token::Type::NEWLINE))
+            program.push_back(' ');
+        program.append(textOf(token));
+    }
+    auto const tokenized(tokenize(program.c_str(), program.size()));
+    assert(tokenized.size() == written.size());
+    for (std::size_t i = 0u; i < written.size(); ++i) {
+        auto const & a = written[i];
+        auto const & b = tokenized[i];
+        assert(a.type() == b.type());
+        assert(textOf(a) == textOf(b));
+        assert(a.startLine() == b.startLine());
+        switch (a.type()) {
+        case Token::Type::HEX:
+            assert(a.hexValue() == b.hexValue());
+            break;
+        case Token::Type::UHEX:
+            assert(a.uhexValue() == b.uhexValue());
+            break;
+        case Token::Type::STRING:
+            assert(a.stringValue() == b.stringValue());
+            break;
+        case Token::Type::LABEL:
+        case Token::Type::LABEL_O:
+            assert(a.labelValue() == b.labelValue());
+            assert(a.labelOffset() == b.labelOffset());
+            break;
+        case Token::Type::KEYWORD:
+            assert(a.keywordValue() == b.keywordValue());
+            break;
+        case Token::Type::DIRECTIVE:
+            assert(a.directiveValue() == b.directiveValue());
+            break;
+        case Token::Type::NEWLINE:
+        case Token::Type::EXPRESSION:
+            break;
+        }
+    }
+
+    w.clear();
+    assert(written.empty());
+    assert(w.line() == 1u);
+}
+
+void testValidation() {
+    assert(TokenWriter::isValidKeyword("mov_imm_reg"));
+    assert(TokenWriter::isValidKeyword("ns.push_imm"));
+    assert(!TokenWriter::isValidKeyword(""));
+    assert(!TokenWriter::isValidKeyword("1mov"));
+    assert(!TokenWriter::isValidKeyword("ns."));
+    assert(!TokenWriter::isValidKeyword("mov imm"));
+
+    assert(TokenWriter::isValidLabelName("start"));
+    assert(TokenWriter::isValidLabelName(".local"));
+    assert(!TokenWriter::isValidLabelName(""));
+    assert(!TokenWriter::isValidLabelName("."));
+    assert(!TokenWriter::isValidLabelName("a+b"));
+    assert(!TokenWriter::isValidLabelName("1a"));
+
+    assert(TokenWriter::isValidExpression("(:a + 0x1)"));
+    assert(TokenWriter::isValidExpression("((0x1))"));
+    assert(!TokenWriter::isValidExpression(""));
+    assert(!TokenWriter::isValidExpression("0x1"));
+    assert(!TokenWriter::isValidExpression("(0x1"));
+    assert(!TokenWriter::isValidExpression("(0x1))"));
+    assert(!TokenWriter::isValidExpression("(0x1 # comment)"));
+    assert(!TokenWriter::isValidExpression("(0x1\n)"));
+}
+
+} // anonymous namespace
+
+int main() {
+    testSameAsTokenized();
+    testValidation();
+}
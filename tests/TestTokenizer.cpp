@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include "../src/assemble.h"
+#include "../src/tokenizer.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+/* The input is not null-terminated, hence tokens at its end must not be read
+   past it: */
+void testTokenAtEnd(char const * const program) {
+    auto const length = std::strlen(program);
+    std::unique_ptr<char[]> buffer(new char[length]);
+    std::memcpy(buffer.get(), program, length);
+    auto const r(tryTokenize(buffer.get(), length));
+    assert(r);
+    auto const & last = r->back();
+    auto const lastLength = std::strlen(std::strrchr(program, ' ') + 1);
+    assert(last.text() == buffer.get() + length - lastLength);
+    assert(last.length() == lastLength);
+}
+
+void testLabelAtEndOfIncludedFile() {
+    auto const path(std::filesystem::temp_directory_path()
+                    / "sharemind-libas-TestTokenizer.sa");
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        f << "halt imm 0x0\n:end";
+    }
+    std::string const program(".include \"" + path.string() + "\"\n");
+    Options options;
+    options.allowFileAccess = true;
+    auto const r(tryAssemble(program.c_str(), program.size(), options));
+    std::filesystem::remove(path);
+    assert(r);
+}
+
+} // anonymous namespace
+
+int main() {
+    testTokenAtEnd("push imm :label");
+    testTokenAtEnd("push imm :.local");
+    testTokenAtEnd("push imm :label+0x1");
+    testTokenAtEnd("halt imm 0x0");
+    testTokenAtEnd("nop .section");
+    testLabelAtEndOfIncludedFile();
+}
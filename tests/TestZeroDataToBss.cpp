@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) Cybernetica
+ *
+ * Research/Commercial License Usage
+ * Licensees holding a valid Research License or Commercial License
+ * for the Software may use this file according to the written
+ * agreement between you and Cybernetica.
+ *
+ * GNU General Public License Usage
+ * Alternatively, this file may be used under the terms of the GNU
+ * General Public License version 3.0 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.  Please review the following information to
+ * ensure the GNU General Public License version 3.0 requirements will be
+ * met: http://www.gnu.org/copyleft/gpl-3.0.html.
+ *
+ * For further information, please contact us at sharemind@cyber.ee.
+ */
+
+
+#undef NDEBUG
+#include <cassert>
+#include <cstring>
+#include "../src/assemble.h"
+
+
+using namespace sharemind;
+using namespace sharemind::Assembler;
+
+namespace {
+
+Executable assembleProgram(char const * program, Options const & options) {
+    auto r(tryAssemble(program, std::strlen(program), options));
+    assert(r);
+    return std::move(r).value();
+}
+
+std::uint64_t argument(Executable const & exe, std::size_t const index)
+{ return exe.linkingUnits.front().textSection->instructions[index].uint64[0u]; }
+
+Options moving() {
+    Options options;
+    options.zeroDataToBss = true;
+    return options;
+}
+
+/* The memory pointer becomes that of BSS, and labels keep their offsets: */
+void testMoved() {
+    static char const program[] =
+            "push imm :DATA\n"
+            "push imm :b\n"
+            "halt imm 0x0\n"
+            ".section DATA\n"
+            ":a\n"
+            ".data uint64 0x0\n"
+            ":b\n"
+            ".data uint32 0x0\n";
+    auto const before(assembleProgram(program, Options()));
+    auto const after(assembleProgram(program, moving()));
+    auto const & lu = after.linkingUnits.front();
+    assert(!lu.rwDataSection);
+    assert(lu.bssSection && (lu.bssSection->sizeInBytes == 12u));
+    assert(argument(before, 1u) == 0x2u);
+    assert(argument(after, 1u) == 0x3u);
+    assert(argument(after, 3u) == argument(before, 3u));
+}
+
+/* Offsets from the memory pointer would refer to the old BSS contents: */
+void testNonEmptyBss() {
+    static char const program[] =
+            "push imm :DATA\n"
+            "push imm 0x8\n"
+            "halt imm 0x0\n"
+            ".section DATA\n"
+            ".data uint64 0x0\n"
+            ".data uint64 0x0\n"
+            ".section BSS\n"
+            ".data uint64 0x0\n";
+    auto const after(assembleProgram(program, moving()));
+    auto const & lu = after.linkingUnits.front();
+    assert(lu.rwDataSection && (lu.rwDataSection->sizeInBytes == 16u));
+    assert(lu.bssSection->sizeInBytes == 8u);
+    assert(argument(after, 1u) == 0x2u);
+}
+
+/* A raw value of the memory pointer could not be replaced: */
+void testRawDataPointer() {
+    static char const program[] =
+            "push imm 0x2\n"
+            "halt imm 0x0\n"
+            ".section DATA\n"
+            ".data uint64 0x0\n";
+    auto const after(assembleProgram(program, moving()));
+    auto const & lu = after.linkingUnits.front();
+    assert(lu.rwDataSection && (lu.rwDataSection->sizeInBytes == 8u));
+    assert(!lu.bssSection || !lu.bssSection->sizeInBytes);
+}
+
+/* Sections with non-zero bytes are kept: */
+void testNonZero() {
+    static char const program[] =
+            "push imm :DATA\n"
+            "halt imm 0x0\n"
+            ".section DATA\n"
+            ".data uint64 0x1\n";
+    auto const after(assembleProgram(program, moving()));
+    assert(after.linkingUnits.front().rwDataSection);
+    assert(argument(after, 1u) == 0x2u);
+}
+
+} // anonymous namespace
+
+int main() {
+    testMoved();
+    testNonEmptyBss();
+    testRawDataPointer();
+    testNonZero();
+}